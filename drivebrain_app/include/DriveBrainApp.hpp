@@ -28,6 +28,7 @@
 #include <sstream>
 #include <spdlog/spdlog.h>
 #include <atomic>
+#include <array>
 
 struct DriveBrainSettings {
     bool run_db_service{true};
@@ -44,6 +45,10 @@ public:
     void run();
     void stop();
 
+    /// @brief the CAN commands (drivebrain_speed_set_input, drivebrain_torque_lim_input) of one
+    ///        control cycle, new messages every call so they can be handed to another thread
+    static std::array<std::shared_ptr<google::protobuf::Message>, 2> make_control_msgs(const core::SpeedControlOut &out_struct, const core::VehicleState &state);
+
 private:
     // Private member functions
     void _process_loop();
@@ -57,10 +62,9 @@ private:
     std::optional<std::string> _dbc_path;
     boost::asio::io_context _io_context;
     
-    core::common::ThreadSafeDeque<std::shared_ptr<google::protobuf::Message>> _rx_queue;
-    core::common::ThreadSafeDeque<std::shared_ptr<google::protobuf::Message>> _can_tx_queue;
-    core::common::ThreadSafeDeque<std::shared_ptr<google::protobuf::Message>> _eth_tx_queue;
-    core::common::ThreadSafeDeque<std::shared_ptr<google::protobuf::Message>> _live_telem_queue;
+    // control outputs, only the newest commands matter if a driver falls behind
+    comms::CANDriver::bustype _can_tx_bus{64, util::RingPolicy::Overwrite};
+    comms::MCUETHComms::bustype _eth_tx_bus{64, util::RingPolicy::Overwrite};
 
     std::vector<core::common::Configurable*> _configurable_components;
     std::unique_ptr<common::MCAPProtobufLogger> _mcap_logger;
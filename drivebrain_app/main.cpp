@@ -81,6 +81,7 @@ std::pair<std::string, std::string> parse_arguments(int argc, char* argv[]) {
 int main(int argc, char *argv[])
 {
     std::signal(SIGINT, signal_handler);
+    std::signal(SIGTERM, signal_handler);
     
     try {
 
@@ -0,0 +1,674 @@
+// turns logger MCAPs into one column per signal, so that plotting a signal of a run is mapping one
+// array instead of decoding every message of its type (or of the whole file) in python.
+
+// the chunks of an MCAP are decompressed and decoded in parallel, one chunk at a time per thread,
+// and the columns are written in chunk order so they stay in the order the messages were logged.
+// the messages are decoded as in mcap_replay (compiled in type, else the schema in the MCAP) and
+// the fields of each message type are looked up once, not per message.
+
+// for every input <dir>/<name>.mcap the columns go into <dir>/<name>_columns/ (or <out>/<name>/):
+// - <topic>.bin per channel: the log times (uint64 ns since the epoch) followed by one array per
+//   scalar field, nested messages flattened to dotted names (eg. vn_vel_m_s.x). bools are uint8 and
+//   enums int32, repeated, string and bytes fields are left out. little endian, every array 64 byte
+//   aligned
+// - index.json with the offset, dtype and row count of every array, eg. in python:
+//     msg = index["messages"][i]
+//     np.memmap(dir / msg["file"], dtype=msg["signals"]["vn_vel_m_s.x"]["dtype"], mode="r",
+//               offset=msg["signals"]["vn_vel_m_s.x"]["offset"], shape=(msg["count"],))
+
+// the column sizes come from the statistics in the summary, so an MCAP that was cut off needs to go
+// through mcap_recover first.
+
+// usage: mcap_columns [-j threads] [-o out_dir] <input.mcap>...
+
+#include <McapSchemaPool.hpp>
+
+#include <mcap/reader.hpp>
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/message.h>
+
+#include <boost/program_options.hpp>
+#include <nlohmann/json.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "the columns are written in host byte order");
+
+namespace
+{
+    constexpr uint64_t column_alignment = 64;
+    // nested messages deeper than this are left out, protos can be recursive
+    constexpr int max_depth = 8;
+
+    struct Column
+    {
+        std::string name;
+        // the message fields down to the one holding the value, then the value's field
+        std::vector<const google::protobuf::FieldDescriptor *> path;
+        google::protobuf::FieldDescriptor::CppType type;
+        const char *dtype;
+        size_t size;
+        uint64_t offset = 0;
+    };
+
+    // one per channel of the input
+    struct ChannelLayout
+    {
+        std::string topic;
+        std::string schema;
+        const google::protobuf::Message *prototype = nullptr;
+        std::vector<Column> columns;
+        std::vector<std::string> skipped;
+        std::string file_name;
+        uint64_t capacity = 0; // rows, from the statistics
+        uint64_t rows = 0;     // written so far
+        uint64_t overflow = 0; // more rows than the statistics said
+        int fd = -1;
+    };
+
+    // the rows of one chunk for one channel
+    struct ChannelRows
+    {
+        std::vector<uint64_t> times;
+        std::vector<std::vector<std::byte>> columns;
+    };
+
+    struct ChunkResult
+    {
+        std::unordered_map<mcap::ChannelId, ChannelRows> channels;
+        uint64_t undecodable = 0;
+        std::string problem;
+    };
+
+    bool column_type(google::protobuf::FieldDescriptor::CppType type, const char *&dtype, size_t &size)
+    {
+        using FD = google::protobuf::FieldDescriptor;
+        switch (type)
+        {
+        case FD::CPPTYPE_DOUBLE: dtype = "float64"; size = 8; return true;
+        case FD::CPPTYPE_FLOAT: dtype = "float32"; size = 4; return true;
+        case FD::CPPTYPE_INT32: dtype = "int32"; size = 4; return true;
+        case FD::CPPTYPE_INT64: dtype = "int64"; size = 8; return true;
+        case FD::CPPTYPE_UINT32: dtype = "uint32"; size = 4; return true;
+        case FD::CPPTYPE_UINT64: dtype = "uint64"; size = 8; return true;
+        case FD::CPPTYPE_BOOL: dtype = "uint8"; size = 1; return true;
+        case FD::CPPTYPE_ENUM: dtype = "int32"; size = 4; return true;
+        default: return false;
+        }
+    }
+
+    void add_columns(ChannelLayout &layout, const google::protobuf::Descriptor *descriptor, const std::string &prefix,
+                     std::vector<const google::protobuf::FieldDescriptor *> &path)
+    {
+        for (int i = 0; i < descriptor->field_count(); i++)
+        {
+            const auto field = descriptor->field(i);
+            const std::string name = prefix + field->name();
+            if (field->is_repeated())
+            {
+                layout.skipped.push_back(name);
+                continue;
+            }
+            path.push_back(field);
+            Column column;
+            if (field->cpp_type() == google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE)
+            {
+                if (path.size() < max_depth)
+                {
+                    add_columns(layout, field->message_type(), name + ".", path);
+                }
+                else
+                {
+                    layout.skipped.push_back(name);
+                }
+            }
+            else if (column_type(field->cpp_type(), column.dtype, column.size))
+            {
+                column.name = name;
+                column.path = path;
+                column.type = field->cpp_type();
+                layout.columns.push_back(std::move(column));
+            }
+            else
+            {
+                layout.skipped.push_back(name);
+            }
+            path.pop_back();
+        }
+    }
+
+    template <typename T>
+    void append(std::vector<std::byte> &column, T value)
+    {
+        const size_t size = column.size();
+        column.resize(size + sizeof(T));
+        std::memcpy(column.data() + size, &value, sizeof(T));
+    }
+
+    void append_row(const ChannelLayout &layout, const google::protobuf::Message &msg, ChannelRows &rows)
+    {
+        using FD = google::protobuf::FieldDescriptor;
+        for (size_t i = 0; i < layout.columns.size(); i++)
+        {
+            const Column &column = layout.columns[i];
+            const google::protobuf::Message *parent = &msg;
+            for (size_t depth = 0; depth + 1 < column.path.size(); depth++)
+            {
+                // an unset sub message gives its default instance, ie. zeros
+                parent = &parent->GetReflection()->GetMessage(*parent, column.path[depth]);
+            }
+            const auto reflection = parent->GetReflection();
+            const auto field = column.path.back();
+            auto &out = rows.columns[i];
+            switch (column.type)
+            {
+            case FD::CPPTYPE_DOUBLE: append(out, reflection->GetDouble(*parent, field)); break;
+            case FD::CPPTYPE_FLOAT: append(out, reflection->GetFloat(*parent, field)); break;
+            case FD::CPPTYPE_INT32: append(out, reflection->GetInt32(*parent, field)); break;
+            case FD::CPPTYPE_INT64: append(out, reflection->GetInt64(*parent, field)); break;
+            case FD::CPPTYPE_UINT32: append(out, reflection->GetUInt32(*parent, field)); break;
+            case FD::CPPTYPE_UINT64: append(out, reflection->GetUInt64(*parent, field)); break;
+            case FD::CPPTYPE_BOOL: append(out, static_cast<uint8_t>(reflection->GetBool(*parent, field))); break;
+            case FD::CPPTYPE_ENUM: append(out, static_cast<int32_t>(reflection->GetEnumValue(*parent, field))); break;
+            default: break;
+            }
+        }
+    }
+
+    bool write_at(int fd, const void *data, size_t size, uint64_t offset)
+    {
+        const auto bytes = static_cast<const std::byte *>(data);
+        size_t written = 0;
+        while (written < size)
+        {
+            const ssize_t res = ::pwrite(fd, bytes + written, size - written, static_cast<off_t>(offset + written));
+            if (res < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            written += static_cast<size_t>(res);
+        }
+        return true;
+    }
+
+    // decodes chunks into rows, one per thread
+    class ChunkDecoder
+    {
+    public:
+        ChunkDecoder(const std::string &path, const std::unordered_map<mcap::ChannelId, ChannelLayout> &layouts)
+            : _file(std::fopen(path.c_str(), "rb")), _layouts(layouts)
+        {
+            if (_file != nullptr)
+            {
+                _reader = std::make_unique<mcap::FileReader>(_file);
+            }
+        }
+        ~ChunkDecoder()
+        {
+            _reader.reset();
+            if (_file != nullptr)
+            {
+                std::fclose(_file);
+            }
+        }
+        ChunkDecoder(const ChunkDecoder &) = delete;
+        ChunkDecoder &operator=(const ChunkDecoder &) = delete;
+
+        /// @brief decodes the chunk record at offset
+        void decode_chunk(uint64_t offset, ChunkResult &result)
+        {
+            if (!_reader)
+            {
+                result.problem = "cannot open the input";
+                return;
+            }
+            mcap::Record record;
+            const auto status = mcap::McapReader::ReadRecord(*_reader, offset, &record);
+            if (!status.ok())
+            {
+                result.problem = status.message;
+                return;
+            }
+            _handle_record(record, result);
+        }
+
+        /// @brief decodes every record of the data section, for files without a chunk index
+        void decode_all(uint64_t end, ChunkResult &result)
+        {
+            if (!_reader)
+            {
+                result.problem = "cannot open the input";
+                return;
+            }
+            // past the magic at the start of the file
+            mcap::RecordReader records(*_reader, 8, end);
+            while (auto record = records.next())
+            {
+                if (record->opcode == mcap::OpCode::DataEnd)
+                {
+                    return;
+                }
+                _handle_record(*record, result);
+            }
+            if (!records.status().ok())
+            {
+                result.problem = records.status().message;
+            }
+        }
+
+    private:
+        void _handle_record(const mcap::Record &record, ChunkResult &result)
+        {
+            if (record.opcode == mcap::OpCode::Message)
+            {
+                mcap::Message message;
+                if (mcap::McapReader::ParseMessage(record, &message).ok())
+                {
+                    _handle_message(message, result);
+                }
+                else
+                {
+                    result.undecodable++;
+                }
+            }
+            else if (record.opcode == mcap::OpCode::Chunk)
+            {
+                _handle_chunk(record, result);
+            }
+        }
+
+        void _handle_chunk(const mcap::Record &record, ChunkResult &result)
+        {
+            mcap::Chunk chunk;
+            auto status = mcap::McapReader::ParseChunk(record, &chunk);
+            if (!status.ok())
+            {
+                result.problem = status.message;
+                return;
+            }
+            const std::byte *records = chunk.records;
+            if (chunk.compression == "lz4")
+            {
+                status = mcap::LZ4Reader::DecompressAll(chunk.records, chunk.compressedSize, chunk.uncompressedSize, &_decompressed);
+                records = _decompressed.data();
+            }
+            else if (chunk.compression == "zstd")
+            {
+                status = mcap::ZStdReader::DecompressAll(chunk.records, chunk.compressedSize, chunk.uncompressedSize, &_decompressed);
+                records = _decompressed.data();
+            }
+            else if (!chunk.compression.empty())
+            {
+                status = mcap::Status(mcap::StatusCode::UnrecognizedCompression, "unknown chunk compression " + chunk.compression);
+            }
+            if (!status.ok())
+            {
+                result.problem = status.message;
+                return;
+            }
+
+            mcap::BufferReader buffer;
+            buffer.reset(records, chunk.uncompressedSize, chunk.uncompressedSize);
+            mcap::RecordReader chunk_records(buffer, 0, chunk.uncompressedSize);
+            while (auto chunk_record = chunk_records.next())
+            {
+                if (chunk_record->opcode == mcap::OpCode::Message)
+                {
+                    _handle_record(*chunk_record, result);
+                }
+            }
+            if (!chunk_records.status().ok())
+            {
+                result.problem = chunk_records.status().message;
+            }
+        }
+
+        void _handle_message(const mcap::Message &message, ChunkResult &result)
+        {
+            const auto layout = _layouts.find(message.channelId);
+            if (layout == _layouts.end())
+            {
+                return;
+            }
+            auto &msg = _messages[message.channelId];
+            if (!msg)
+            {
+                msg.reset(layout->second.prototype->New());
+            }
+            if (!msg->ParseFromArray(message.data, static_cast<int>(message.dataSize)))
+            {
+                result.undecodable++;
+                return;
+            }
+            auto &rows = result.channels[message.channelId];
+            if (rows.columns.empty())
+            {
+                rows.columns.resize(layout->second.columns.size());
+            }
+            rows.times.push_back(message.logTime);
+            append_row(layout->second, *msg, rows);
+        }
+
+    private:
+        std::FILE *_file;
+        std::unique_ptr<mcap::FileReader> _reader;
+        const std::unordered_map<mcap::ChannelId, ChannelLayout> &_layouts;
+        mcap::ByteArray _decompressed;
+        // parsed into again and again, per channel
+        std::unordered_map<mcap::ChannelId, std::unique_ptr<google::protobuf::Message>> _messages;
+    };
+
+    std::string file_name_of(const std::string &topic)
+    {
+        std::string name = topic;
+        for (char &c : name)
+        {
+            if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '-' && c != '.')
+            {
+                c = '_';
+            }
+        }
+        return name.empty() ? "unnamed" : name;
+    }
+
+    bool convert(const std::filesystem::path &input_path, const std::filesystem::path &out_dir, unsigned threads)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        mcap::McapReader reader;
+        auto status = reader.open(input_path.string());
+        if (!status.ok())
+        {
+            std::cerr << "failed to open " << input_path << ": " << status.message << std::endl;
+            return false;
+        }
+        status = reader.readSummary(mcap::ReadSummaryMethod::NoFallbackScan);
+        if (!status.ok() || !reader.statistics())
+        {
+            std::cerr << input_path << " has no summary with statistics, run mcap_recover on it first" << std::endl;
+            return false;
+        }
+        const auto statistics = *reader.statistics();
+
+        std::error_code error;
+        std::filesystem::create_directories(out_dir, error);
+        if (error)
+        {
+            std::cerr << "failed to create " << out_dir << ": " << error.message() << std::endl;
+            return false;
+        }
+
+        // the columns of every channel that has messages, and where they go in its file
+        common::McapSchemaPool schemas;
+        std::unordered_map<mcap::ChannelId, ChannelLayout> layouts;
+        std::map<std::string, int> file_names;
+        for (const auto &[channel_id, channel] : reader.channels())
+        {
+            const auto count = statistics.channelMessageCounts.find(channel_id);
+            const auto schema = reader.schema(channel->schemaId);
+            if (count == statistics.channelMessageCounts.end() || count->second == 0 || !schema)
+            {
+                continue;
+            }
+            ChannelLayout layout;
+            layout.topic = channel->topic;
+            layout.schema = schema->name;
+            layout.prototype = schemas.prototype(*schema);
+            if (layout.prototype == nullptr)
+            {
+                continue;
+            }
+            std::vector<const google::protobuf::FieldDescriptor *> path;
+            add_columns(layout, layout.prototype->GetDescriptor(), "", path);
+
+            layout.file_name = file_name_of(channel->topic);
+            if (file_names[layout.file_name]++ > 0)
+            {
+                layout.file_name += "_" + std::to_string(channel_id);
+            }
+            layout.file_name += ".bin";
+            layout.capacity = count->second;
+            uint64_t offset = layout.capacity * sizeof(uint64_t);
+            for (auto &column : layout.columns)
+            {
+                offset = (offset + column_alignment - 1) / column_alignment * column_alignment;
+                column.offset = offset;
+                offset += layout.capacity * column.size;
+            }
+
+            const auto file_path = out_dir / layout.file_name;
+            layout.fd = ::open(file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (layout.fd < 0 || ::ftruncate(layout.fd, static_cast<off_t>(offset)) != 0)
+            {
+                std::cerr << "failed to create " << file_path << ": " << std::strerror(errno) << std::endl;
+                for (auto &[id, other] : layouts)
+                {
+                    ::close(other.fd);
+                }
+                if (layout.fd >= 0)
+                {
+                    ::close(layout.fd);
+                }
+                return false;
+            }
+            layouts.emplace(channel_id, std::move(layout));
+        }
+
+        // a chunk per job, or the whole data section at once if the file is not chunked
+        std::vector<uint64_t> chunk_offsets;
+        for (const auto &index : reader.chunkIndexes())
+        {
+            chunk_offsets.push_back(index.chunkStartOffset);
+        }
+        std::sort(chunk_offsets.begin(), chunk_offsets.end());
+        const bool chunked = !chunk_offsets.empty();
+        const size_t num_jobs = chunked ? chunk_offsets.size() : 1;
+        const uint64_t data_end = reader.footer() && reader.footer()->summaryStart != 0 ? reader.footer()->summaryStart
+                                                                                        : reader.dataSource()->size();
+        threads = static_cast<unsigned>(std::min<size_t>(std::max(threads, 1u), num_jobs));
+
+        // the threads take chunks in order and the results are written in order. they do not get
+        // further ahead of the writing than window chunks, so only that many are in memory
+        const size_t window = 2 * threads;
+        std::mutex results_mtx;
+        std::condition_variable results_cv;
+        std::vector<std::unique_ptr<ChunkResult>> results(num_jobs);
+        size_t next_job = 0;
+        size_t next_write = 0;
+
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; t++)
+        {
+            workers.emplace_back([&]()
+            {
+                ChunkDecoder decoder(input_path.string(), layouts);
+                while (true)
+                {
+                    size_t job;
+                    {
+                        std::unique_lock lk(results_mtx);
+                        results_cv.wait(lk, [&]() { return next_job >= num_jobs || next_job < next_write + window; });
+                        if (next_job >= num_jobs)
+                        {
+                            return;
+                        }
+                        job = next_job++;
+                    }
+                    auto result = std::make_unique<ChunkResult>();
+                    if (chunked)
+                    {
+                        decoder.decode_chunk(chunk_offsets[job], *result);
+                    }
+                    else
+                    {
+                        decoder.decode_all(data_end, *result);
+                    }
+                    {
+                        std::unique_lock lk(results_mtx);
+                        results[job] = std::move(result);
+                    }
+                    results_cv.notify_all();
+                }
+            });
+        }
+
+        bool ok = true;
+        uint64_t undecodable = 0;
+        uint64_t rows = 0;
+        std::string problem;
+        for (size_t job = 0; job < num_jobs; job++)
+        {
+            std::unique_ptr<ChunkResult> result;
+            {
+                std::unique_lock lk(results_mtx);
+                results_cv.wait(lk, [&]() { return results[job] != nullptr; });
+                result = std::move(results[job]);
+                next_write = job + 1;
+            }
+            results_cv.notify_all();
+
+            undecodable += result->undecodable;
+            if (problem.empty() && !result->problem.empty())
+            {
+                problem = result->problem;
+            }
+            for (const auto &[channel_id, channel_rows] : result->channels)
+            {
+                auto &layout = layouts.at(channel_id);
+                uint64_t count = channel_rows.times.size();
+                if (layout.rows + count > layout.capacity)
+                {
+                    layout.overflow += layout.rows + count - layout.capacity;
+                    count = layout.capacity - layout.rows;
+                }
+                ok &= write_at(layout.fd, channel_rows.times.data(), count * sizeof(uint64_t), layout.rows * sizeof(uint64_t));
+                for (size_t i = 0; i < layout.columns.size(); i++)
+                {
+                    const auto &column = layout.columns[i];
+                    ok &= write_at(layout.fd, channel_rows.columns[i].data(), count * column.size, column.offset + layout.rows * column.size);
+                }
+                layout.rows += count;
+                rows += count;
+            }
+        }
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+
+        nlohmann::json index;
+        index["source"] = input_path.filename().string();
+        index["messages"] = nlohmann::json::array();
+        for (auto &[channel_id, layout] : layouts)
+        {
+            ::close(layout.fd);
+            if (layout.overflow > 0)
+            {
+                std::cerr << layout.topic << " has " << layout.overflow << " more messages than the statistics say, they are left out" << std::endl;
+            }
+            nlohmann::json message;
+            message["topic"] = layout.topic;
+            message["schema"] = layout.schema;
+            message["file"] = layout.file_name;
+            message["count"] = layout.rows;
+            message["time"] = {{"dtype", "uint64"}, {"offset", 0}};
+            message["signals"] = nlohmann::json::object();
+            for (const auto &column : layout.columns)
+            {
+                message["signals"][column.name] = {{"dtype", column.dtype}, {"offset", column.offset}};
+            }
+            message["skipped"] = layout.skipped;
+            index["messages"].push_back(std::move(message));
+        }
+        std::ofstream index_file(out_dir / "index.json");
+        index_file << index.dump(2) << std::endl;
+        ok &= index_file.good();
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const double megabytes = reader.dataSource()->size() / (1024.0 * 1024.0);
+        reader.close();
+        std::cout << input_path << ": " << rows << " messages on " << layouts.size() << " channels into " << out_dir << " in " << seconds
+                  << " s (" << megabytes / seconds << " MB/s with " << threads << " threads)" << std::endl;
+        if (undecodable > 0)
+        {
+            std::cout << undecodable << " messages could not be decoded" << std::endl;
+        }
+        if (!problem.empty())
+        {
+            std::cerr << "problem reading " << input_path << ": " << problem << std::endl;
+        }
+        if (!ok)
+        {
+            std::cerr << "failed to write the columns of " << input_path << std::endl;
+        }
+        return ok;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    namespace po = boost::program_options;
+    std::vector<std::string> inputs;
+    std::string out_dir;
+    unsigned threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("input,i", po::value<std::vector<std::string>>(&inputs)->required(), "MCAPs to convert")
+        ("output,o", po::value<std::string>(&out_dir), "directory to put a directory of columns per input in (default next to each input)")
+        ("threads,j", po::value<unsigned>(&threads), "number of threads decoding chunks (default one per core)");
+    po::positional_options_description positional;
+    positional.add("input", -1);
+
+    try
+    {
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+        if (vm.count("help"))
+        {
+            std::cout << desc << std::endl;
+            return 0;
+        }
+        po::notify(vm);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    bool ok = true;
+    for (const auto &input : inputs)
+    {
+        const std::filesystem::path input_path = input;
+        const auto input_out_dir = out_dir.empty() ? input_path.parent_path() / (input_path.stem().string() + "_columns")
+                                                   : std::filesystem::path(out_dir) / input_path.stem();
+        ok &= convert(input_path, input_out_dir, threads);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+// rebuilds an MCAP that was cut off, eg. by the drivebrain being killed or losing power while logging.
+// such a file has every chunk that was completely written before, but no summary section (chunk
+// index, statistics, footer), so foxglove can neither seek in it nor always open it.
+
+// the messages are read from the start of the file in order until the first record that is cut
+// off, and written with their schemas and channels into a new MCAP that gets a proper summary. the
+// chunk that was still being filled when the file was cut off is lost, at most chunk_size_kb of
+// messages.
+
+// usage: mcap_recover <input.mcap> [output.mcap]
+// the output defaults to <input>_recovered.mcap next to the input
+
+#include <mcap/reader.hpp>
+#include <mcap/writer.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " <input.mcap> [output.mcap]" << std::endl;
+        return 1;
+    }
+    const std::filesystem::path input_path = argv[1];
+    std::filesystem::path output_path = (argc > 2) ? std::filesystem::path(argv[2])
+                                                   : input_path.parent_path() / (input_path.stem().string() + "_recovered" + input_path.extension().string());
+
+    mcap::McapReader reader;
+    auto status = reader.open(input_path.string());
+    if (!status.ok())
+    {
+        std::cerr << "failed to open " << input_path << ": " << status.message << std::endl;
+        return 1;
+    }
+    if (reader.readSummary(mcap::ReadSummaryMethod::NoFallbackScan).ok())
+    {
+        std::cout << input_path << " has its summary, nothing to recover" << std::endl;
+        return 0;
+    }
+    // the summary reader may have seen part of the schemas and channels, start over clean
+    reader.close();
+    status = reader.open(input_path.string());
+    if (!status.ok())
+    {
+        std::cerr << "failed to open " << input_path << ": " << status.message << std::endl;
+        return 1;
+    }
+
+    const std::string profile = reader.header() ? reader.header()->profile : std::string("");
+    mcap::McapWriterOptions options(profile);
+    mcap::McapWriter writer;
+    status = writer.open(output_path.string(), options);
+    if (!status.ok())
+    {
+        std::cerr << "failed to open " << output_path << " for writing: " << status.message << std::endl;
+        return 1;
+    }
+
+    // the writer numbers schemas and channels in the order they are added, they usually end up
+    // with the same ids as in the input but nothing relies on that
+    std::unordered_map<mcap::SchemaId, mcap::SchemaId> schema_ids;
+    std::unordered_map<mcap::ChannelId, mcap::ChannelId> channel_ids;
+    uint64_t recovered = 0;
+    std::string problem;
+    const auto on_problem = [&](const mcap::Status &status)
+    {
+        // everything from the first problem on is what got cut off
+        if (problem.empty())
+        {
+            problem = status.message;
+        }
+    };
+
+    for (const auto &view : reader.readMessages(on_problem, mcap::ReadMessageOptions()))
+    {
+        auto channel_id = channel_ids.find(view.channel->id);
+        if (channel_id == channel_ids.end())
+        {
+            mcap::SchemaId schema_id = 0;
+            if (view.schema)
+            {
+                auto known_schema = schema_ids.find(view.schema->id);
+                if (known_schema == schema_ids.end())
+                {
+                    mcap::Schema schema(view.schema->name, view.schema->encoding, view.schema->data);
+                    writer.addSchema(schema);
+                    known_schema = schema_ids.emplace(view.schema->id, schema.id).first;
+                }
+                schema_id = known_schema->second;
+            }
+            mcap::Channel channel(view.channel->topic, view.channel->messageEncoding, schema_id, view.channel->metadata);
+            writer.addChannel(channel);
+            channel_id = channel_ids.emplace(view.channel->id, channel.id).first;
+        }
+
+        mcap::Message message = view.message;
+        message.channelId = channel_id->second;
+        status = writer.write(message);
+        if (!status.ok())
+        {
+            std::cerr << "failed to write to " << output_path << ": " << status.message << std::endl;
+            writer.close();
+            return 1;
+        }
+        recovered++;
+    }
+    writer.close();
+    reader.close();
+
+    std::cout << "recovered " << recovered << " messages on " << channel_ids.size() << " channels from " << input_path
+              << " into " << output_path << std::endl;
+    if (!problem.empty())
+    {
+        std::cout << "the input ends with: " << problem << std::endl;
+    }
+    return 0;
+}
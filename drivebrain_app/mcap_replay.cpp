@@ -0,0 +1,426 @@
+// runs a recorded MCAP back through the state estimator and the controller, eg. to see what a
+// controller change would have done on a run, or to profile the pipeline with the message mix of a
+// real run instead of a synthetic one.
+
+// the messages are read in log time order and handed to StateEstimator::handle_recv_process with
+// their log time as the receive time, which is the acquisition time for the received messages in
+// logs from drivebrain. the controller is stepped every get_dt_sec() of the recording in between,
+// like the process loop does, and its CAN commands go through a tx bus of the same type as the CAN
+// driver's. everything is driven by a virtual clock that only moves with the recording
+// (the estimator checks its input timestamps against it too), so the same recording and config
+// always give the same output, at any speed.
+
+// messages are decoded as the compiled in type of their schema name if there is one (the estimator
+// needs those), otherwise from the schema embedded in the MCAP.
+
+// the output MCAP gets what the pipeline produced, the VehicleData, InputStaleness and
+// EstimationSignals of every cycle and the CAN commands, stamped with virtual time so it lines up
+// with the input in foxglove and two replays can be diffed. those message types are not fed back in
+// from the input.
+
+// usage: mcap_replay <input.mcap> [-o output.mcap] [-p config.json] [-s speed]
+// speed 1 replays at the recorded timing, 10 ten times as fast, 0 (default) as fast as possible
+
+#include <JsonFileHandler.hpp>
+#include <Logger.hpp>
+#include <MsgLogger.hpp>
+#include <SimpleController.hpp>
+#include <StateEstimator.hpp>
+#include <CANComms.hpp>
+#include <MessagePool.hpp>
+#include <ProtobufUtils.hpp>
+#include <McapSchemaPool.hpp>
+#include "DriveBrainApp.hpp"
+
+#include <mcap/reader.hpp>
+#include <mcap/writer.hpp>
+
+#include <google/protobuf/descriptor.h>
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "hytech.pb.h"
+#include "hytech_msgs.pb.h"
+#include <db_service/v1/estimation/input_staleness.pb.h>
+#include <db_service/v1/estimation/input_latency.pb.h>
+#include <db_service/v1/estimation/estimation_signals.pb.h>
+
+namespace
+{
+    std::atomic<bool> stop_signal{false};
+    void signal_handler(int)
+    {
+        stop_signal.store(true);
+    }
+
+    // turns mcap messages back into pooled protobuf messages
+    class MessageDecoder
+    {
+    public:
+        /// @return nullptr if the schema is not protobuf or the message does not parse
+        std::shared_ptr<google::protobuf::Message> decode(const mcap::MessageView &view)
+        {
+            if (!view.schema)
+            {
+                return nullptr;
+            }
+            const auto prototype = _schemas.prototype(*view.schema);
+            if (prototype == nullptr)
+            {
+                return nullptr;
+            }
+            auto msg = _pool.acquire(*prototype);
+            if (!msg->ParseFromArray(view.message.data, static_cast<int>(view.message.dataSize)))
+            {
+                return nullptr;
+            }
+            return msg;
+        }
+
+        /// @brief number of schemas that had to be built from the mcap
+        size_t embedded_schemas() const { return _schemas.embedded_schemas(); }
+
+    private:
+        common::McapSchemaPool _schemas;
+        // destroyed before the schemas, some of its messages can be of their types
+        util::MessagePool _pool;
+    };
+
+    // writes what the pipeline produced, the channels are added as their first message comes
+    class OutputWriter
+    {
+    public:
+        bool open(const std::string &path)
+        {
+            mcap::McapWriterOptions options("protobuf");
+            const auto status = _writer.open(path, options);
+            if (!status.ok())
+            {
+                std::cerr << "failed to open " << path << " for writing: " << status.message << std::endl;
+                return false;
+            }
+            _open = true;
+            return true;
+        }
+
+        void write(const google::protobuf::Message &msg, uint64_t log_time_ns)
+        {
+            if (!_open)
+            {
+                return;
+            }
+            const auto descriptor = msg.GetDescriptor();
+            auto channel_id = _channel_ids.find(descriptor);
+            if (channel_id == _channel_ids.end())
+            {
+                mcap::Schema schema(descriptor->full_name(), "protobuf", util::serialized_file_descriptor_set(descriptor));
+                _writer.addSchema(schema);
+                mcap::Channel channel(descriptor->name(), "protobuf", schema.id);
+                _writer.addChannel(channel);
+                channel_id = _channel_ids.emplace(descriptor, channel.id).first;
+            }
+            msg.SerializeToString(&_buffer);
+
+            mcap::Message out;
+            out.channelId = channel_id->second;
+            out.sequence = _written++;
+            out.logTime = log_time_ns;
+            out.publishTime = log_time_ns;
+            out.data = reinterpret_cast<const std::byte *>(_buffer.data());
+            out.dataSize = _buffer.size();
+            _writer.write(out);
+        }
+
+        void close()
+        {
+            if (_open)
+            {
+                _writer.close();
+                _open = false;
+            }
+        }
+
+        uint64_t written() const { return _written; }
+
+    private:
+        mcap::McapWriter _writer;
+        bool _open = false;
+        std::unordered_map<const google::protobuf::Descriptor *, mcap::ChannelId> _channel_ids;
+        std::string _buffer;
+        uint64_t _written = 0;
+    };
+
+    struct Options
+    {
+        std::string input;
+        std::string output;
+        std::string param_path = "config/drivebrain_config.json";
+        double speed = 0;
+    };
+
+    Options parse_arguments(int argc, char *argv[])
+    {
+        namespace po = boost::program_options;
+        Options options;
+        po::options_description desc("Allowed options");
+        desc.add_options()
+            ("help,h", "produce help message")
+            ("input,i", po::value<std::string>(&options.input)->required(), "MCAP to replay")
+            ("output,o", po::value<std::string>(&options.output), "MCAP to write the pipeline outputs to (default <input>_replay.mcap)")
+            ("param-path,p", po::value<std::string>(&options.param_path), "Path to the parameter JSON file")
+            ("speed,s", po::value<double>(&options.speed), "1 for the recorded timing, N for N times as fast, 0 as fast as possible (default)");
+        po::positional_options_description positional;
+        positional.add("input", 1);
+
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+        if (vm.count("help"))
+        {
+            std::cout << desc << std::endl;
+            std::exit(0);
+        }
+        po::notify(vm);
+
+        if (options.output.empty())
+        {
+            const std::filesystem::path input_path = options.input;
+            options.output = (input_path.parent_path() / (input_path.stem().string() + "_replay.mcap")).string();
+        }
+        return options;
+    }
+
+    // durations of the pipeline steps, for profiling
+    struct Timings
+    {
+        std::vector<uint32_t> samples_ns;
+
+        void add(std::chrono::steady_clock::duration elapsed)
+        {
+            samples_ns.push_back(static_cast<uint32_t>(std::min<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(), UINT32_MAX)));
+        }
+
+        void print(const std::string &name)
+        {
+            if (samples_ns.empty())
+            {
+                return;
+            }
+            std::sort(samples_ns.begin(), samples_ns.end());
+            const auto at = [&](double quantile) { return samples_ns[static_cast<size_t>(quantile * (samples_ns.size() - 1))] / 1000.0; };
+            std::cout << name << ": " << samples_ns.size() << " calls, p50 " << at(0.5) << " us, p99 " << at(0.99)
+                      << " us, max " << at(1.0) << " us" << std::endl;
+        }
+    };
+}
+
+int main(int argc, char *argv[])
+{
+    std::signal(SIGINT, signal_handler);
+    std::signal(SIGTERM, signal_handler);
+
+    Options options;
+    try
+    {
+        options = parse_arguments(argc, argv);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    if (options.speed < 0)
+    {
+        std::cerr << "speed cannot be negative" << std::endl;
+        return 1;
+    }
+
+    mcap::McapReader reader;
+    auto status = reader.open(options.input);
+    if (!status.ok())
+    {
+        std::cerr << "failed to open " << options.input << ": " << status.message << std::endl;
+        return 1;
+    }
+    OutputWriter output;
+    if (!output.open(options.output))
+    {
+        return 1;
+    }
+
+    // the virtual clock, in system clock microseconds like the receive times
+    std::chrono::microseconds virtual_now{0};
+
+    core::Logger logger(core::LogLevel::INFO);
+    core::JsonFileHandler config(options.param_path);
+    std::function<void(std::shared_ptr<google::protobuf::Message>)> log_output = [&](std::shared_ptr<google::protobuf::Message> msg)
+    {
+        output.write(*msg, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(virtual_now).count()));
+    };
+    // the replay has its own output file, the name the message logger comes up with is not used
+    auto message_logger = std::make_shared<core::MsgLogger<std::shared_ptr<google::protobuf::Message>>>(
+        ".mcap", true, log_output, []() {}, [](const std::string &) {}, [](std::shared_ptr<google::protobuf::Message>) {});
+
+    core::StateEstimator state_estimator(logger, config, message_logger);
+    state_estimator.set_clock([&]() { return virtual_now; });
+    if (!state_estimator.init())
+    {
+        std::cerr << "failed to init the state estimator with " << options.param_path << std::endl;
+        return 1;
+    }
+    control::SimpleController controller(logger, config);
+    if (!controller.init())
+    {
+        std::cerr << "failed to init the controller with " << options.param_path << std::endl;
+        return 1;
+    }
+    const float dt_sec = controller.get_dt_sec();
+    // a step period that rounds down to nothing would never get past the first step
+    if (!(dt_sec * 1000000.0f >= 1.0f))
+    {
+        std::cerr << "the controller's step period of " << dt_sec << " s in " << options.param_path << " has to be at least 1 us" << std::endl;
+        return 1;
+    }
+    const std::chrono::microseconds step_period(static_cast<int64_t>(dt_sec * 1000000.0f));
+
+    comms::CANDriver::bustype tx_bus(64, util::RingPolicy::Overwrite);
+    auto tx_reader = tx_bus.subscribe();
+
+    // what the pipeline produces, the recorded ones are replaced by the replay's
+    const std::unordered_set<std::string> outputs = {
+        hytech_msgs::VehicleData::descriptor()->full_name(),
+        db_service::v1::estimation::InputStaleness::descriptor()->full_name(),
+        db_service::v1::estimation::InputLatencies::descriptor()->full_name(),
+        db_service::v1::estimation::EstimationSignals::descriptor()->full_name(),
+        hytech::drivebrain_speed_set_input::descriptor()->full_name(),
+        hytech::drivebrain_torque_lim_input::descriptor()->full_name()};
+
+    Timings recv_timings;
+    Timings cycle_timings;
+    const auto step = [&]()
+    {
+        const auto start = std::chrono::steady_clock::now();
+        auto state_and_validity = state_estimator.get_latest_state_and_validity();
+        auto out_struct = controller.step_controller(state_and_validity.first);
+        state_estimator.set_previous_control_output(out_struct);
+        auto cycle_msgs = DriveBrainApp::make_control_msgs(out_struct, state_and_validity.first);
+        tx_bus.publish(std::make_move_iterator(cycle_msgs.begin()), std::make_move_iterator(cycle_msgs.end()));
+        cycle_timings.add(std::chrono::steady_clock::now() - start);
+
+        std::shared_ptr<google::protobuf::Message> tx_msg;
+        while (tx_reader->try_take(tx_msg))
+        {
+            log_output(tx_msg);
+        }
+    };
+
+    // paces the replay, does nothing as fast as possible
+    std::chrono::microseconds first_time{0};
+    std::chrono::steady_clock::time_point wall_start;
+    const auto wait_until = [&](std::chrono::microseconds time)
+    {
+        if (options.speed > 0)
+        {
+            std::this_thread::sleep_until(wall_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>((time - first_time) / options.speed));
+        }
+    };
+
+    MessageDecoder decoder;
+    uint64_t replayed = 0;
+    uint64_t undecodable = 0;
+    uint64_t steps = 0;
+    bool started = false;
+    std::chrono::microseconds next_step{0};
+    std::string problem;
+    const auto on_problem = [&](const mcap::Status &status)
+    {
+        if (problem.empty())
+        {
+            problem = status.message;
+        }
+    };
+    mcap::ReadMessageOptions read_options;
+    // producers on different threads can log slightly out of order
+    read_options.readOrder = mcap::ReadMessageOptions::ReadOrder::LogTimeOrder;
+
+    const auto replay_start = std::chrono::steady_clock::now();
+    for (const auto &view : reader.readMessages(on_problem, read_options))
+    {
+        if (stop_signal.load())
+        {
+            break;
+        }
+        const std::chrono::microseconds log_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds(view.message.logTime));
+        if (!started)
+        {
+            started = true;
+            first_time = log_time;
+            next_step = log_time + step_period;
+            wall_start = std::chrono::steady_clock::now();
+        }
+
+        // the control cycles that would have run before this message came in
+        while (next_step <= log_time && !stop_signal.load())
+        {
+            wait_until(next_step);
+            virtual_now = next_step;
+            step();
+            steps++;
+            next_step += step_period;
+        }
+
+        if (view.schema && outputs.count(view.schema->name) > 0)
+        {
+            continue;
+        }
+        auto msg = decoder.decode(view);
+        if (!msg)
+        {
+            undecodable++;
+            continue;
+        }
+        wait_until(log_time);
+        virtual_now = std::max(virtual_now, log_time);
+        const auto start = std::chrono::steady_clock::now();
+        state_estimator.handle_recv_process(std::move(msg), log_time);
+        recv_timings.add(std::chrono::steady_clock::now() - start);
+        replayed++;
+    }
+    const auto replay_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - replay_start).count();
+    output.close();
+    reader.close();
+
+    const double recorded_time = std::chrono::duration<double>(virtual_now - first_time).count();
+    std::cout << "replayed " << replayed << " messages and " << steps << " control cycles (" << recorded_time << " s recorded) in "
+              << replay_time << " s, " << (replay_time > 0 ? recorded_time / replay_time : 0) << "x real time" << std::endl;
+    std::cout << "wrote " << output.written() << " messages to " << options.output << std::endl;
+    if (undecodable > 0)
+    {
+        std::cout << undecodable << " messages could not be decoded" << std::endl;
+    }
+    if (decoder.embedded_schemas() > 0)
+    {
+        std::cout << decoder.embedded_schemas() << " message types were decoded with the schema in the mcap" << std::endl;
+    }
+    if (!problem.empty())
+    {
+        std::cout << "the input ends with: " << problem << std::endl;
+    }
+    recv_timings.print("handle_recv_process");
+    cycle_timings.print("control cycle");
+    return 0;
+}
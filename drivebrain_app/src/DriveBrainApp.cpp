@@ -2,6 +2,8 @@
 #include "DriveBrainApp.hpp"
 
 #include "hytech.pb.h"
+#include <array>
+#include <iterator>
 #include <mutex>
 #include <thread>
 
@@ -18,7 +20,8 @@ DriveBrainApp::DriveBrainApp(const std::string& param_path, const std::string& d
 
     spdlog::set_level(spdlog::level::warn);
 
-    _mcap_logger = std::make_unique<common::MCAPProtobufLogger>("temp");
+    _mcap_logger = std::make_unique<common::MCAPProtobufLogger>(_logger, _config, "temp");
+    _configurable_components.push_back(_mcap_logger.get());
     
     _controller = std::make_unique<control::SimpleController>(_logger, _config);
     _configurable_components.push_back(_controller.get());
@@ -30,19 +33,29 @@ DriveBrainApp::DriveBrainApp(const std::string& param_path, const std::string& d
     // _configurable_components.push_back(_matlab_math.get());
     
     _foxglove_server = std::make_unique<core::FoxgloveWSServer>(_configurable_components);
+    _mcap_logger->set_diagnostics_handler(
+        std::bind(&core::FoxgloveWSServer::send_live_telem_msg, std::ref(*_foxglove_server), std::placeholders::_1));
     
     _message_logger = std::make_shared<core::MsgLogger<std::shared_ptr<google::protobuf::Message>>>(
         ".mcap", true,
         std::bind(&common::MCAPProtobufLogger::log_msg, std::ref(*_mcap_logger), std::placeholders::_1),
         std::bind(&common::MCAPProtobufLogger::close_current_mcap, std::ref(*_mcap_logger)),
         std::bind(&common::MCAPProtobufLogger::open_new_mcap, std::ref(*_mcap_logger), std::placeholders::_1),
-        std::bind(&core::FoxgloveWSServer::send_live_telem_msg, std::ref(*_foxglove_server), std::placeholders::_1));
+        [this](std::shared_ptr<google::protobuf::Message> msg)
+        {
+            // the live_decimation rules keep the wireless link from carrying everything at full rate
+            if (_mcap_logger->keep_live(*msg))
+            {
+                _foxglove_server->send_live_telem_msg(std::move(msg));
+            }
+        });
     
-    _state_estimator = std::make_unique<core::StateEstimator>(_logger, _message_logger);
+    _state_estimator = std::make_unique<core::StateEstimator>(_logger, _config, _message_logger);
+    _configurable_components.push_back(_state_estimator.get());
     
     bool construction_failed = false;
     _driver = std::make_unique<comms::CANDriver>(
-        _config, _logger, _message_logger,_can_tx_queue, _io_context, 
+        _config, _logger, _message_logger,_can_tx_bus, _io_context, 
         _dbc_path, construction_failed, *_state_estimator);
     
     if (construction_failed) {
@@ -52,7 +65,7 @@ DriveBrainApp::DriveBrainApp(const std::string& param_path, const std::string& d
     _configurable_components.push_back(_driver.get());
     
     _eth_driver = std::make_unique<comms::MCUETHComms>(
-        _logger, _eth_tx_queue, _message_logger, *_state_estimator,
+        _logger, _eth_tx_bus, _message_logger, *_state_estimator,
         _io_context, "192.168.1.30", 2001, 2000);
     if(_settings.use_vectornav)
     {
@@ -62,10 +75,22 @@ DriveBrainApp::DriveBrainApp(const std::string& param_path, const std::string& d
     if (!_controller->init()) {
         throw std::runtime_error("Failed to initialize controller");
     }
+
+    if (!_mcap_logger->init()) {
+        throw std::runtime_error("Failed to initialize MCAP logger");
+    }
+
+    if (!_state_estimator->init()) {
+        throw std::runtime_error("Failed to initialize state estimator");
+    }
 }
 
 DriveBrainApp::~DriveBrainApp() {
     _stop_signal.store(true);
+
+    // the logger thread keeps writing diagnostics until the logger is destroyed, which is after the
+    // foxglove server is
+    _mcap_logger->set_diagnostics_handler(nullptr);
     
     if (_process_thread.joinable()) {
         _process_thread.join();
@@ -86,10 +111,44 @@ DriveBrainApp::~DriveBrainApp() {
     spdlog::info("joined io context");
 }
 
-void DriveBrainApp::_process_loop() {
-    // auto out_msg = std::make_shared<hytech_msgs::MCUCommandData>();
+std::array<std::shared_ptr<google::protobuf::Message>, 2> DriveBrainApp::make_control_msgs(const core::SpeedControlOut &out_struct, const core::VehicleState &state) {
     auto desired_rpm_msg = std::make_shared<hytech::drivebrain_speed_set_input>();
     auto torque_limit_msg = std::make_shared<hytech::drivebrain_torque_lim_input>();
+    auto temp_desired_torques = state.matlab_math_temp_out;
+
+    if(temp_desired_torques.res_torque_lim_nm.FL < 0) {
+        desired_rpm_msg->set_drivebrain_set_rpm_fl(0);
+    } else {
+        desired_rpm_msg->set_drivebrain_set_rpm_fl(out_struct.desired_rpms.FL);
+    }
+
+    if(temp_desired_torques.res_torque_lim_nm.FR < 0) {
+        desired_rpm_msg->set_drivebrain_set_rpm_fr(0);
+    } else {
+        desired_rpm_msg->set_drivebrain_set_rpm_fr(out_struct.desired_rpms.FR);
+    }
+
+    if(temp_desired_torques.res_torque_lim_nm.RL < 0) {
+        desired_rpm_msg->set_drivebrain_set_rpm_rl(0);
+    } else {
+        desired_rpm_msg->set_drivebrain_set_rpm_rl(out_struct.desired_rpms.RL);
+    }
+
+    if(temp_desired_torques.res_torque_lim_nm.RR < 0) {
+        desired_rpm_msg->set_drivebrain_set_rpm_rr(0);
+    } else {
+        desired_rpm_msg->set_drivebrain_set_rpm_rr(out_struct.desired_rpms.RR);
+    }
+
+    torque_limit_msg->set_drivebrain_torque_fl(::abs(temp_desired_torques.res_torque_lim_nm.FL));
+    torque_limit_msg->set_drivebrain_torque_fl(::abs(temp_desired_torques.res_torque_lim_nm.FR));
+    torque_limit_msg->set_drivebrain_torque_fl(::abs(temp_desired_torques.res_torque_lim_nm.RL));
+    torque_limit_msg->set_drivebrain_torque_fl(::abs(temp_desired_torques.res_torque_lim_nm.RR));
+
+    return {desired_rpm_msg, torque_limit_msg};
+}
+
+void DriveBrainApp::_process_loop() {
     auto loop_time = _controller->get_dt_sec();
     auto loop_time_micros = (int)(loop_time * 1000000.0f);
     std::chrono::microseconds loop_chrono_time(loop_time_micros);
@@ -100,43 +159,13 @@ void DriveBrainApp::_process_loop() {
         auto state_and_validity = _state_estimator->get_latest_state_and_validity();
         // TODO handle invalid state. need tc mux
         auto out_struct = _controller->step_controller(state_and_validity.first);
-        auto temp_desired_torques = state_and_validity.first.matlab_math_temp_out;
         _state_estimator->set_previous_control_output(out_struct);
 
-        if(temp_desired_torques.res_torque_lim_nm.FL < 0) {
-            desired_rpm_msg->set_drivebrain_set_rpm_fl(0);
-        } else {
-            desired_rpm_msg->set_drivebrain_set_rpm_fl(out_struct.desired_rpms.FL);
-        }
-
-        if(temp_desired_torques.res_torque_lim_nm.FR < 0) {
-            desired_rpm_msg->set_drivebrain_set_rpm_fr(0);
-        } else {
-            desired_rpm_msg->set_drivebrain_set_rpm_fr(out_struct.desired_rpms.FR);
-        }
-
-        if(temp_desired_torques.res_torque_lim_nm.RL < 0) {
-            desired_rpm_msg->set_drivebrain_set_rpm_rl(0);
-        } else {
-            desired_rpm_msg->set_drivebrain_set_rpm_rl(out_struct.desired_rpms.RL);
-        }
-
-        if(temp_desired_torques.res_torque_lim_nm.RR < 0) {
-            desired_rpm_msg->set_drivebrain_set_rpm_rr(0);
-        } else {
-            desired_rpm_msg->set_drivebrain_set_rpm_rr(out_struct.desired_rpms.RR);
-        }
-
-        torque_limit_msg->set_drivebrain_torque_fl(::abs(temp_desired_torques.res_torque_lim_nm.FL));
-        torque_limit_msg->set_drivebrain_torque_fl(::abs(temp_desired_torques.res_torque_lim_nm.FR));
-        torque_limit_msg->set_drivebrain_torque_fl(::abs(temp_desired_torques.res_torque_lim_nm.RL));
-        torque_limit_msg->set_drivebrain_torque_fl(::abs(temp_desired_torques.res_torque_lim_nm.RR));
-
-        {
-            std::unique_lock lk(_can_tx_queue.mtx);
-            _can_tx_queue.deque.push_back(desired_rpm_msg);
-            _can_tx_queue.deque.push_back(torque_limit_msg);
-        }
+        // the CAN output thread encodes these after we have moved on to the next cycle, so they are
+        // new messages every cycle
+        auto cycle_msgs = make_control_msgs(out_struct, state_and_validity.first);
+        // published together so that the output thread wakes once and both frames go out in one batch
+        _can_tx_bus.publish(std::make_move_iterator(cycle_msgs.begin()), std::make_move_iterator(cycle_msgs.end()));
 
         auto end_time = std::chrono::high_resolution_clock::now();
         auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
@@ -158,6 +187,8 @@ void signal_handler(int signal)
 void DriveBrainApp::run() {
 
     std::signal(SIGINT, signal_handler);
+    // systemd stops the service with SIGTERM, shutting down cleanly finishes the current mcap
+    std::signal(SIGTERM, signal_handler);
     _db_service_thread = std::thread([this]() {
         
         if (!_settings.run_db_service) return;
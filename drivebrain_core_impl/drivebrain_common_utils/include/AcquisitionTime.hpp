@@ -0,0 +1,69 @@
+#ifndef __ACQUISITIONTIME_H__
+#define __ACQUISITIONTIME_H__
+
+#include <chrono>
+#include <cstddef>
+#include <optional>
+
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+
+// acquisition times are when a message's data got to drivebrain at the earliest point that we can
+// see: the kernel receive timestamp of a CAN frame or UDP packet, the time the serial read that a
+// VectorNav packet came in completed. they are in system clock microseconds (CLOCK_REALTIME, the
+// same as the kernel timestamps) like the state estimator's input timestamps, so that a backlog on
+// the io_context does not make old data look new.
+
+// the message logger callbacks only take the message, so a receive path sets the acquisition time
+// for its thread around handing a message to the message logger and the MCAP logger stamps the
+// message with it instead of the time that it got to log_msg:
+
+//     util::AcquisitionTime acquired(rx_time);
+//     _message_logger->log_msg(msg);
+
+namespace util
+{
+    class AcquisitionTime
+    {
+    public:
+        /// @brief sets the acquisition time of the messages logged on this thread until the scope ends
+        explicit AcquisitionTime(std::chrono::microseconds time);
+        ~AcquisitionTime();
+        AcquisitionTime(const AcquisitionTime &) = delete;
+        AcquisitionTime &operator=(const AcquisitionTime &) = delete;
+
+        /// @return the acquisition time set on this thread, nullopt outside of a scope
+        static std::optional<std::chrono::microseconds> current();
+
+    private:
+        std::optional<std::chrono::microseconds> _previous;
+    };
+
+    /// @brief the system clock now in the microseconds of acquisition times, for when there is no
+    ///        earlier time for a message
+    inline std::chrono::microseconds system_now_us()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch());
+    }
+
+    /// @brief room for the receive timestamp control messages of one recvmsg
+    constexpr size_t rx_timestamp_cmsg_size = CMSG_SPACE(sizeof(struct scm_timestamping)) + CMSG_SPACE(sizeof(struct timespec));
+
+    /// @brief turns on kernel software receive timestamps in the control data of every message read
+    ///        with recvmsg / recvmmsg, SO_TIMESTAMPING or SO_TIMESTAMPNS on kernels / drivers without it
+    /// @return false if neither one could be turned on, errno says why
+    bool enable_rx_timestamps(int fd);
+
+    /// @brief gets the SO_TIMESTAMPING / SO_TIMESTAMPNS receive time out of a received message's control data
+    std::optional<std::chrono::microseconds> kernel_rx_time(const struct msghdr &hdr);
+
+    /// @brief turns on the kernel keeping the receive time of the last packet for last_kernel_rx_time,
+    ///        for sockets that are read without recvmsg. not together with enable_rx_timestamps, the
+    ///        kernel does not keep the last one then
+    /// @return false if the socket does not support it, errno says why
+    bool enable_last_rx_time(int fd);
+
+    /// @brief the kernel receive time of the last packet read from a socket (SIOCGSTAMPNS)
+    std::optional<std::chrono::microseconds> last_kernel_rx_time(int fd);
+}
+#endif // __ACQUISITIONTIME_H__
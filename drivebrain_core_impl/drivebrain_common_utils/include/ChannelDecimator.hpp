@@ -0,0 +1,94 @@
+#ifndef __CHANNELDECIMATOR_H__
+#define __CHANNELDECIMATOR_H__
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/message.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// decides per message type whether a message goes on, so that eg. the 1 kHz VehicleData can be
+// logged at full rate but sent over the wireless link at 50 Hz. the decision is made from the
+// message's descriptor before anything serializes the message.
+
+// the rules are given as a comma separated list of <message name>:<rule>, every message not in it
+// goes through at full rate:
+// - full: every message
+// - every=N: every Nth message
+// - hz=X: at most X messages a second, the first one after the last let through is let through
+// - on_change: only messages that differ from the last one let through (compared field by field)
+// eg. "VehicleData:hz=50, VNData:every=4, drivetrain_status_telem:on_change"
+
+// keep can be called from any number of threads at once, also while the rules are changed.
+namespace util
+{
+    class ChannelDecimator
+    {
+    public:
+        enum class Mode : uint8_t
+        {
+            Full,
+            EveryNth,
+            MaxRate,
+            OnChange
+        };
+
+        struct Rule
+        {
+            Mode mode = Mode::Full;
+            uint32_t every = 1;
+            double max_hz = 0;
+        };
+
+        /// @param descriptors the message types to decimate, a message's channel is its index in
+        ///        here. entries can be nullptr for unused channels
+        explicit ChannelDecimator(const std::vector<const google::protobuf::Descriptor *> &descriptors);
+
+        /// @return nullopt if the rule is not one of the rules above
+        static std::optional<Rule> parse_rule(const std::string &rule);
+
+        /// @brief replaces the rules, channels that are not in the list go back to full rate
+        /// @return false if the list does not parse, the rules stay as they were then. message names
+        ///         that are not one of the channels are warned about and skipped
+        bool set_rules(const std::string &rules);
+
+        /// @param now_ns steady clock, only used by hz rules
+        /// @return true if the message goes on
+        bool keep(const google::protobuf::Message &msg, int64_t now_ns);
+
+        /// @brief the same without looking up the channel of the message
+        bool keep(size_t channel, const google::protobuf::Message &msg, int64_t now_ns);
+
+        /// @brief number of messages of a channel that did not go on
+        uint64_t decimated(size_t channel) const { return _channels[channel].decimated.load(std::memory_order_relaxed); }
+
+    private:
+        struct Channel
+        {
+            std::atomic<Mode> mode{Mode::Full};
+            std::atomic<uint32_t> every{1};
+            std::atomic<int64_t> period_ns{0};
+
+            std::atomic<uint64_t> count{0};
+            std::atomic<int64_t> next_ns{0}; // earliest time the next message goes on with hz
+            std::atomic<uint64_t> decimated{0};
+
+            std::mutex last_mtx; // only taken by on_change
+            std::unique_ptr<google::protobuf::Message> last;
+        };
+
+        std::unordered_map<const google::protobuf::Descriptor *, size_t> _channel_of;
+        std::unique_ptr<Channel[]> _channels;
+        size_t _num_channels;
+        // false while every channel is at full rate, keep returns right away then
+        std::atomic<bool> _any_rules{false};
+    };
+}
+#endif // __CHANNELDECIMATOR_H__
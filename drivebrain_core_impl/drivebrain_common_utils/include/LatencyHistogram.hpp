@@ -0,0 +1,85 @@
+#ifndef __LATENCYHISTOGRAM_H__
+#define __LATENCYHISTOGRAM_H__
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// counts latencies in power of two microsecond buckets: bucket 0 is < 1 us, bucket i is
+// [2^(i-1), 2^i) us and the last bucket is everything from 2^(num_buckets-2) us up. recording is
+// a couple of instructions and one relaxed atomic add so it can be done on the receive paths, from
+// any number of threads. a snapshot of the counts can be taken from any thread and may be a few
+// records behind.
+namespace util
+{
+    class LatencyHistogram
+    {
+    public:
+        static constexpr size_t num_buckets = 24; // the last one starts at ~4.2 s
+        using Counts = std::array<uint64_t, num_buckets>;
+
+        void record(std::chrono::microseconds latency)
+        {
+            _buckets[bucket(latency.count())].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        Counts counts() const
+        {
+            Counts counts;
+            for (size_t i = 0; i < num_buckets; i++)
+            {
+                counts[i] = _buckets[i].load(std::memory_order_relaxed);
+            }
+            return counts;
+        }
+
+        /// @brief the bucket of a latency, negative ones (eg. from a clock step) go in bucket 0
+        static size_t bucket(int64_t latency_us)
+        {
+            if (latency_us < 1)
+            {
+                return 0;
+            }
+            const size_t bits = 64 - static_cast<size_t>(__builtin_clzll(static_cast<uint64_t>(latency_us)));
+            return bits < num_buckets ? bits : num_buckets - 1;
+        }
+
+        /// @brief first latency in us that is past a bucket, 0 for the last bucket which has no end
+        static int64_t bucket_end_us(size_t bucket)
+        {
+            return bucket + 1 < num_buckets ? (int64_t{1} << bucket) : 0;
+        }
+
+        /// @return the end of the bucket that the quantile (0 to 1) of the counts is in, the start of
+        ///         the last bucket if it is in that one. 0 if nothing was counted
+        static int64_t quantile_us(const Counts &counts, double quantile)
+        {
+            uint64_t total = 0;
+            for (auto count : counts)
+            {
+                total += count;
+            }
+            if (total == 0)
+            {
+                return 0;
+            }
+            const auto rank = static_cast<uint64_t>(quantile * static_cast<double>(total - 1)) + 1;
+            uint64_t seen = 0;
+            for (size_t i = 0; i + 1 < num_buckets; i++)
+            {
+                seen += counts[i];
+                if (seen >= rank)
+                {
+                    return bucket_end_us(i);
+                }
+            }
+            return int64_t{1} << (num_buckets - 2);
+        }
+
+    private:
+        std::array<std::atomic<uint64_t>, num_buckets> _buckets{};
+    };
+}
+#endif // __LATENCYHISTOGRAM_H__
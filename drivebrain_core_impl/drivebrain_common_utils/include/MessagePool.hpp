@@ -0,0 +1,64 @@
+#ifndef __MESSAGEPOOL_H__
+#define __MESSAGEPOOL_H__
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/message.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// pool of protobuf messages for the receive paths that create a message per frame / packet / state
+// snapshot and hand it out as a shared_ptr to the state estimator, MCAP logger and foxglove.
+
+// every pooled message is created once together with its shared_ptr control block and the pool
+// keeps one reference to it. a message is free again once the pool's reference is the only one
+// left, ie. every consumer dropped its copy, and is then cleared and handed out again. clearing keeps
+// the memory of sub messages and strings so a reused message needs no allocations to fill in either.
+// once every message type has as many messages as are in flight at a time, acquiring does no heap
+// allocations at all.
+
+// a pool is meant to be acquired from by a single producer thread, the messages it hands out can be
+// copied and released on any thread.
+
+namespace util
+{
+    class MessagePool
+    {
+    public:
+        /// @param max_per_type max number of messages kept per type. if that many are in flight at
+        ///        once, acquire falls back to creating a message that does not go back into the pool
+        explicit MessagePool(size_t max_per_type = 256) : _max_per_type(max_per_type) {}
+
+        /// @brief gets a cleared message of the same type as the prototype
+        std::shared_ptr<google::protobuf::Message> acquire(const google::protobuf::Message &prototype);
+
+        /// @brief gets a cleared message of a generated message type
+        template <typename MsgType>
+        std::shared_ptr<MsgType> acquire()
+        {
+            return std::static_pointer_cast<MsgType>(acquire(MsgType::default_instance()));
+        }
+
+        /// @brief number of messages the pool had to create (and heap allocate) so far
+        size_t allocations() const { return _allocations.load(std::memory_order_relaxed); }
+
+        /// @brief number of times a message was handed out again instead of being created
+        size_t reuses() const { return _reuses.load(std::memory_order_relaxed); }
+
+    private:
+        struct TypePool
+        {
+            std::vector<std::shared_ptr<google::protobuf::Message>> messages;
+            size_t next = 0; // messages come back roughly in the order they were handed out
+        };
+
+        size_t _max_per_type;
+        std::unordered_map<const google::protobuf::Descriptor *, TypePool> _pools;
+        std::atomic<size_t> _allocations{0};
+        std::atomic<size_t> _reuses{0};
+    };
+}
+#endif // __MESSAGEPOOL_H__
@@ -20,5 +20,10 @@ namespace util
     std::vector<const google::protobuf::FileDescriptor *> get_pb_descriptors(const std::vector<std::string> &filenames);
     std::optional<std::unordered_map<std::string, uint32_t>> generate_name_to_id_map(const std::vector<std::string> &filenames);
     google::protobuf::FileDescriptorSet build_file_descriptor_set(const google::protobuf::Descriptor *toplevelDescriptor);
+
+    /// @brief build_file_descriptor_set serialized, the schema data of an mcap / foxglove channel.
+    ///        built once per .proto file the first time it is asked for and kept for the rest of the
+    ///        process, every message type of a file has the same one. safe to call from any thread
+    const std::string &serialized_file_descriptor_set(const google::protobuf::Descriptor *descriptor);
 }
 #endif // __PROTOBUFUTILS_H__
\ No newline at end of file
@@ -0,0 +1,408 @@
+#ifndef __RINGBUS_H__
+#define __RINGBUS_H__
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// bounded ring buffer for handing messages from one producer thread to any number of readers, eg.
+// the control loop to the CAN output thread. every reader has its own cursor into the ring so each one
+// gets every message, and reading is a copy of one element (a shared_ptr for protobuf messages) instead
+// of locking and copying the whole queue like with core::common::ThreadSafeDeque.
+
+// the fast paths are lock free: the producer writes the slot and bumps the head, a reader compares its
+// cursor with the head and copies the slot out. the mutex and condition variables are only used to put
+// a waiting reader (or a blocked producer) to sleep and are only touched by the producer if someone is
+// actually sleeping.
+
+// when the ring is full the policy decides what happens:
+// - Overwrite: the readers that are behind lose their oldest messages (counted in dropped()). the
+//   producer never waits on a reader, except for the few ns a reader needs to copy the slot that is
+//   being overwritten.
+// - Block: the producer waits until the slowest reader has read the oldest message.
+
+// publish() is only allowed from one thread at a time, several producers have to serialize on their own.
+
+namespace util
+{
+    enum class RingPolicy
+    {
+        Overwrite,
+        Block
+    };
+
+    template <typename T, size_t MaxReaders = 4>
+    class RingBus
+    {
+    private:
+        struct alignas(64) Cursor
+        {
+            // sequence number of the next message for this reader. the top bit is set while the reader
+            // copies a message out so that the producer does not overwrite it at the same time
+            std::atomic<uint64_t> next{0};
+            std::atomic<uint64_t> dropped{0};
+            std::atomic<bool> active{false};
+            std::atomic<bool> stopped{false};
+        };
+        static constexpr uint64_t _busy = uint64_t{1} << 63;
+
+    public:
+        class Reader
+        {
+        public:
+            ~Reader()
+            {
+                _cursor.active.store(false);
+                _bus._wake_producer();
+            }
+            Reader(const Reader &) = delete;
+            Reader &operator=(const Reader &) = delete;
+
+            /// @brief copies out the next message without waiting
+            /// @return false if there is nothing new
+            bool try_read(T &out) { return _bus._try_read(_cursor, out, false); }
+
+            /// @brief waits for the next message
+            /// @return false once the reader is stopped, or the bus is closed and there is nothing left to read
+            bool read(T &out) { return _wait_read(out, false); }
+
+            /// @brief same as try_read() and read() but moves the message out of the ring, so that eg. a
+            ///        shared_ptr is released once the reader is done with it instead of once it is
+            ///        overwritten. only for buses with this one reader
+            bool try_take(T &out) { return _bus._try_read(_cursor, out, true); }
+            bool take(T &out) { return _wait_read(out, true); }
+
+            /// @brief makes read() return false right away, even with messages left, eg. when the
+            ///        consumer thread is shutting down
+            void stop()
+            {
+                {
+                    std::lock_guard lk(_bus._wait_mtx);
+                    _cursor.stopped.store(true);
+                }
+                _bus._data_cv.notify_all();
+            }
+
+            /// @brief number of messages published that this reader has not read yet
+            uint64_t depth() const
+            {
+                const uint64_t next = _cursor.next.load() & ~_busy;
+                return _bus._head.load() - next;
+            }
+
+            /// @brief number of messages this reader lost to the producer overwriting them
+            uint64_t dropped() const { return _cursor.dropped.load(std::memory_order_relaxed); }
+
+        private:
+            friend class RingBus;
+            Reader(RingBus &bus, Cursor &cursor) : _bus(bus), _cursor(cursor) {}
+
+            bool _wait_read(T &out, bool take)
+            {
+                while (!_cursor.stopped.load())
+                {
+                    if (_bus._try_read(_cursor, out, take))
+                    {
+                        return true;
+                    }
+                    if (_bus._closed.load())
+                    {
+                        return false;
+                    }
+                    std::unique_lock lk(_bus._wait_mtx);
+                    _bus._readers_waiting.fetch_add(1);
+                    _bus._data_cv.wait(lk, [this]()
+                                       { return depth() > 0 || _cursor.stopped.load() || _bus._closed.load(); });
+                    _bus._readers_waiting.fetch_sub(1);
+                }
+                return false;
+            }
+
+            RingBus &_bus;
+            Cursor &_cursor;
+        };
+
+        /// @param capacity number of messages in the ring, rounded up to a power of two
+        /// @param policy what publishing does when the ring is full
+        RingBus(size_t capacity, RingPolicy policy) : _policy(policy)
+        {
+            size_t rounded = 1;
+            while (rounded < capacity)
+            {
+                rounded <<= 1;
+            }
+            _slots.resize(rounded);
+            _mask = rounded - 1;
+        }
+        RingBus(const RingBus &) = delete;
+        RingBus &operator=(const RingBus &) = delete;
+
+        /// @brief adds a reader that gets every message published from now on. readers are normally added
+        ///        before the producer starts
+        /// @return nullptr if there are already MaxReaders readers
+        std::unique_ptr<Reader> subscribe()
+        {
+            std::lock_guard lk(_wait_mtx);
+            for (auto &cursor : _cursors)
+            {
+                if (!cursor.active.load())
+                {
+                    cursor.stopped.store(false);
+                    cursor.dropped.store(0);
+                    cursor.next.store(_head.load());
+                    cursor.active.store(true);
+                    return std::unique_ptr<Reader>(new Reader(*this, cursor));
+                }
+            }
+            return nullptr;
+        }
+
+        /// @brief publishes one message
+        /// @return false if the bus was closed
+        bool publish(T value)
+        {
+            if (!_reserve(_producer.next))
+            {
+                return false;
+            }
+            _slots[_producer.next & _mask] = std::move(value);
+            _commit(++_producer.next);
+            return true;
+        }
+
+        /// @brief publishes a range of messages that readers only see once all of them are in the
+        ///        ring, eg. every frame of a control cycle so that they go out in one batch
+        template <typename Iter>
+        bool publish(Iter first, Iter last)
+        {
+            for (; first != last; ++first)
+            {
+                if (_producer.next - _head.load(std::memory_order_relaxed) == capacity())
+                {
+                    _commit(_producer.next);
+                }
+                if (!_reserve(_producer.next))
+                {
+                    _commit(_producer.next);
+                    return false;
+                }
+                _slots[_producer.next & _mask] = *first;
+                ++_producer.next;
+            }
+            _commit(_producer.next);
+            return true;
+        }
+
+        /// @brief gets called on the producer thread with every message that is about to be overwritten
+        ///        before a reader got to it (once per reader that loses it), eg. to count drops by
+        ///        content. set before publishing starts
+        void on_overwrite(std::function<void(const T &)> handler) { _overwrite_handler = std::move(handler); }
+
+        /// @brief wakes up everyone waiting, readers return what is left and then false from read()
+        void close()
+        {
+            {
+                std::lock_guard lk(_wait_mtx);
+                _closed.store(true);
+            }
+            _data_cv.notify_all();
+            _space_cv.notify_all();
+        }
+
+        size_t capacity() const { return _slots.size(); }
+
+        /// @brief number of messages published so far
+        uint64_t published() const { return _head.load(std::memory_order_relaxed); }
+
+        /// @brief messages lost by all current readers
+        uint64_t dropped() const
+        {
+            uint64_t total = 0;
+            for (const auto &cursor : _cursors)
+            {
+                if (cursor.active.load(std::memory_order_relaxed))
+                {
+                    total += cursor.dropped.load(std::memory_order_relaxed);
+                }
+            }
+            return total;
+        }
+
+        /// @brief depth of the reader that is furthest behind
+        uint64_t max_depth() const
+        {
+            uint64_t depth = 0;
+            for (const auto &cursor : _cursors)
+            {
+                if (cursor.active.load(std::memory_order_relaxed))
+                {
+                    const uint64_t next = cursor.next.load() & ~_busy;
+                    const uint64_t head = _head.load();
+                    depth = std::max(depth, head - next);
+                }
+            }
+            return depth;
+        }
+
+    private:
+        // makes sure the slot of message seq can be written, ie. no reader still needs the message
+        // that is in it (seq - capacity)
+        bool _reserve(uint64_t seq)
+        {
+            if (seq < capacity())
+            {
+                return true;
+            }
+            const uint64_t oldest = seq - capacity();
+            // every reader was past this point last time we looked, nothing to check
+            if (oldest < _producer.readers_past)
+            {
+                return true;
+            }
+
+            uint64_t readers_past = seq;
+            for (auto &cursor : _cursors)
+            {
+                if (!cursor.active.load())
+                {
+                    continue;
+                }
+                uint64_t next = cursor.next.load();
+                while ((next & ~_busy) <= oldest)
+                {
+                    if (_policy == RingPolicy::Block)
+                    {
+                        if (!_wait_for_reader(cursor, oldest))
+                        {
+                            return false;
+                        }
+                        next = cursor.next.load();
+                    }
+                    else if (next & _busy)
+                    {
+                        // the reader is copying the oldest message right now
+                        std::this_thread::yield();
+                        next = cursor.next.load();
+                    }
+                    else if (cursor.next.compare_exchange_weak(next, oldest + 1))
+                    {
+                        cursor.dropped.fetch_add(oldest + 1 - next, std::memory_order_relaxed);
+                        // this reader is past them now, the producer writes them only after this
+                        for (uint64_t dropped = next; _overwrite_handler && dropped <= oldest; dropped++)
+                        {
+                            _overwrite_handler(_slots[dropped & _mask]);
+                        }
+                        next = oldest + 1;
+                    }
+                }
+                readers_past = std::min(readers_past, next & ~_busy);
+            }
+            _producer.readers_past = readers_past;
+            return true;
+        }
+
+        bool _wait_for_reader(Cursor &cursor, uint64_t oldest)
+        {
+            auto caught_up = [&]()
+            {
+                return (cursor.next.load() & ~_busy) > oldest || !cursor.active.load() || _closed.load();
+            };
+            // readers are normally only a moment behind, try not to sleep
+            for (int i = 0; i < 64 && !caught_up(); i++)
+            {
+                std::this_thread::yield();
+            }
+            std::unique_lock lk(_wait_mtx);
+            _producer_waiting.store(true);
+            _space_cv.wait(lk, caught_up);
+            _producer_waiting.store(false);
+            return !_closed.load();
+        }
+
+        void _commit(uint64_t head)
+        {
+            _head.store(head);
+            if (_readers_waiting.load() > 0)
+            {
+                std::lock_guard lk(_wait_mtx);
+                _data_cv.notify_all();
+            }
+        }
+
+        bool _try_read(Cursor &cursor, T &out, bool take)
+        {
+            uint64_t next = cursor.next.load();
+            if (_policy == RingPolicy::Overwrite)
+            {
+                // claim the slot first, if the producer moved the cursor in the meantime it overwrote
+                // the message we were about to read and we start over at the new oldest one
+                do
+                {
+                    if (next >= _head.load())
+                    {
+                        return false;
+                    }
+                } while (!cursor.next.compare_exchange_weak(next, next | _busy));
+            }
+            else if (next >= _head.load())
+            {
+                return false;
+            }
+            if (take)
+            {
+                out = std::move(_slots[next & _mask]);
+            }
+            else
+            {
+                out = _slots[next & _mask];
+            }
+            cursor.next.store(next + 1);
+            _wake_producer();
+            return true;
+        }
+
+        void _wake_producer()
+        {
+            if (_producer_waiting.load())
+            {
+                std::lock_guard lk(_wait_mtx);
+                _space_cv.notify_one();
+            }
+        }
+
+    private:
+        const RingPolicy _policy;
+        std::vector<T> _slots;
+        std::function<void(const T &)> _overwrite_handler;
+        uint64_t _mask;
+
+        // only touched by the producer
+        struct alignas(64) ProducerState
+        {
+            uint64_t next = 0;         // sequence number of the next message to write
+            uint64_t readers_past = 0; // every reader cursor was at least here at the last check
+        } _producer;
+
+        // messages before this are readable
+        alignas(64) std::atomic<uint64_t> _head{0};
+
+        std::array<Cursor, MaxReaders> _cursors;
+
+        // only for sleeping
+        std::mutex _wait_mtx;
+        std::condition_variable _data_cv;
+        std::condition_variable _space_cv;
+        std::atomic<int> _readers_waiting{0};
+        std::atomic<bool> _producer_waiting{false};
+        std::atomic<bool> _closed{false};
+    };
+}
+#endif // __RINGBUS_H__
@@ -0,0 +1,72 @@
+#ifndef __TRIPLEBUFFER_H__
+#define __TRIPLEBUFFER_H__
+
+#include <atomic>
+#include <cstdint>
+
+// hands the newest version of a value from one writer thread to one reader thread without either
+// of them ever waiting on the other, eg. the vehicle state from the threads that receive inputs to
+// the control loop.
+
+// there are three copies of the value: the one the writer fills, the one the reader reads and the
+// newest published one in between. publishing swaps the writer's copy with the one in between,
+// reading swaps the reader's copy with it if it has been published to since. both are one atomic
+// exchange, so the reader always gets a whole version of the value and never blocks the writer.
+
+// the writer's copy is not the value it published last but whatever the reader let go of, so every
+// write has to fill in the whole value. several writer threads have to take turns (eg. with a mutex
+// that only they take), the same for several readers.
+namespace util
+{
+    template <typename T>
+    class TripleBuffer
+    {
+    public:
+        TripleBuffer() = default;
+        explicit TripleBuffer(const T &initial)
+        {
+            for (auto &buffer : _buffers)
+            {
+                buffer.value = initial;
+            }
+        }
+        TripleBuffer(const TripleBuffer &) = delete;
+        TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+        /// @brief the copy to fill in before publish(), writer only
+        T &write_buffer() { return _buffers[_write].value; }
+
+        /// @brief makes the write buffer the newest value, writer only
+        void publish()
+        {
+            const uint8_t previous = _middle.exchange(_write | _fresh, std::memory_order_acq_rel);
+            _write = previous & _index_mask;
+        }
+
+        /// @brief the newest published value, stays as it is until the next read(). reader only
+        const T &read()
+        {
+            if (_middle.load(std::memory_order_relaxed) & _fresh)
+            {
+                const uint8_t previous = _middle.exchange(_read, std::memory_order_acq_rel);
+                _read = previous & _index_mask;
+            }
+            return _buffers[_read].value;
+        }
+
+    private:
+        static constexpr uint8_t _index_mask = 0x3;
+        static constexpr uint8_t _fresh = 0x4; // published to since the reader last swapped
+
+        // own cache lines, so the writer filling its copy does not slow down the reader reading its one
+        struct alignas(64) Buffer
+        {
+            T value{};
+        };
+        Buffer _buffers[3];
+        alignas(64) std::atomic<uint8_t> _middle{1};
+        alignas(64) uint8_t _write = 0; // writer only
+        alignas(64) uint8_t _read = 2;  // reader only
+    };
+}
+#endif // __TRIPLEBUFFER_H__
@@ -0,0 +1,104 @@
+#include <AcquisitionTime.hpp>
+
+#include <cerrno>
+#include <cstring>
+
+#include <linux/net_tstamp.h>
+#include <linux/sockios.h>
+#include <sys/ioctl.h>
+#include <time.h>
+
+namespace util
+{
+    namespace
+    {
+        // in here and not in the header so that every library sees the same one
+        thread_local std::optional<std::chrono::microseconds> current_acquisition_time;
+
+        std::optional<std::chrono::microseconds> to_micros(const struct timespec &ts)
+        {
+            if (ts.tv_sec == 0 && ts.tv_nsec == 0)
+            {
+                return std::nullopt;
+            }
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec));
+        }
+    }
+
+    AcquisitionTime::AcquisitionTime(std::chrono::microseconds time) : _previous(current_acquisition_time)
+    {
+        current_acquisition_time = time;
+    }
+
+    AcquisitionTime::~AcquisitionTime()
+    {
+        current_acquisition_time = _previous;
+    }
+
+    std::optional<std::chrono::microseconds> AcquisitionTime::current()
+    {
+        return current_acquisition_time;
+    }
+
+    bool enable_rx_timestamps(int fd)
+    {
+        // software receive timestamps are taken by the kernel when the packet is queued on the socket
+        // and are in CLOCK_REALTIME, same as std::chrono::system_clock
+        int ts_flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+        if (::setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &ts_flags, sizeof(ts_flags)) == 0)
+        {
+            return true;
+        }
+        int enable = 1;
+        return ::setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) == 0;
+    }
+
+    std::optional<std::chrono::microseconds> kernel_rx_time(const struct msghdr &hdr)
+    {
+        for (auto *cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(const_cast<struct msghdr *>(&hdr), cmsg))
+        {
+            if (cmsg->cmsg_level != SOL_SOCKET)
+            {
+                continue;
+            }
+            struct timespec ts = {};
+            if (cmsg->cmsg_type == SO_TIMESTAMPING)
+            {
+                // ts[0] is the software stamp, ts[2] the raw hardware stamp which is not in the system clock domain
+                struct scm_timestamping stamps;
+                std::memcpy(&stamps, CMSG_DATA(cmsg), sizeof(stamps));
+                ts = stamps.ts[0];
+            }
+            else if (cmsg->cmsg_type == SO_TIMESTAMPNS)
+            {
+                std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            }
+            else
+            {
+                continue;
+            }
+            if (auto time = to_micros(ts))
+            {
+                return time;
+            }
+        }
+        return std::nullopt;
+    }
+
+    bool enable_last_rx_time(int fd)
+    {
+        // the first SIOCGSTAMPNS turns the timestamps on, there is no packet to have one yet
+        struct timespec ts = {};
+        return ::ioctl(fd, SIOCGSTAMPNS, &ts) == 0 || errno == ENOENT;
+    }
+
+    std::optional<std::chrono::microseconds> last_kernel_rx_time(int fd)
+    {
+        struct timespec ts = {};
+        if (::ioctl(fd, SIOCGSTAMPNS, &ts) < 0)
+        {
+            return std::nullopt;
+        }
+        return to_micros(ts);
+    }
+}
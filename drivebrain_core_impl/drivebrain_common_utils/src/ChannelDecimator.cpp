@@ -0,0 +1,205 @@
+#include <ChannelDecimator.hpp>
+
+#include <google/protobuf/util/message_differencer.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <utility>
+
+#include <spdlog/spdlog.h>
+
+namespace util
+{
+    namespace
+    {
+        std::string trim(const std::string &str)
+        {
+            const auto begin = str.find_first_not_of(" \t");
+            if (begin == std::string::npos)
+            {
+                return "";
+            }
+            return str.substr(begin, str.find_last_not_of(" \t") - begin + 1);
+        }
+    }
+
+    ChannelDecimator::ChannelDecimator(const std::vector<const google::protobuf::Descriptor *> &descriptors)
+        : _channels(std::make_unique<Channel[]>(descriptors.size())), _num_channels(descriptors.size())
+    {
+        for (size_t channel = 0; channel < descriptors.size(); channel++)
+        {
+            if (descriptors[channel] != nullptr)
+            {
+                _channel_of[descriptors[channel]] = channel;
+            }
+        }
+    }
+
+    std::optional<ChannelDecimator::Rule> ChannelDecimator::parse_rule(const std::string &rule)
+    {
+        Rule parsed;
+        if (rule == "full")
+        {
+            return parsed;
+        }
+        if (rule == "on_change")
+        {
+            parsed.mode = Mode::OnChange;
+            return parsed;
+        }
+
+        const auto equals = rule.find('=');
+        if (equals == std::string::npos)
+        {
+            return std::nullopt;
+        }
+        const std::string name = rule.substr(0, equals);
+        const std::string value = rule.substr(equals + 1);
+        char *end = nullptr;
+        if (name == "every")
+        {
+            const unsigned long every = std::strtoul(value.c_str(), &end, 10);
+            if (value.empty() || *end != '\0' || every < 1 || every > UINT32_MAX)
+            {
+                return std::nullopt;
+            }
+            parsed.mode = Mode::EveryNth;
+            parsed.every = static_cast<uint32_t>(every);
+            return parsed;
+        }
+        if (name == "hz")
+        {
+            const double hz = std::strtod(value.c_str(), &end);
+            if (value.empty() || *end != '\0' || !(hz > 0))
+            {
+                return std::nullopt;
+            }
+            parsed.mode = Mode::MaxRate;
+            parsed.max_hz = hz;
+            return parsed;
+        }
+        return std::nullopt;
+    }
+
+    bool ChannelDecimator::set_rules(const std::string &rules)
+    {
+        // everything is parsed before anything changes
+        std::vector<std::pair<size_t, Rule>> parsed;
+        std::stringstream stream(rules);
+        std::string entry;
+        while (std::getline(stream, entry, ','))
+        {
+            entry = trim(entry);
+            if (entry.empty())
+            {
+                continue;
+            }
+            const auto colon = entry.find(':');
+            if (colon == std::string::npos)
+            {
+                spdlog::error("decimation rule {} is not <message name>:<rule>", entry);
+                return false;
+            }
+            const std::string name = trim(entry.substr(0, colon));
+            const auto rule = parse_rule(trim(entry.substr(colon + 1)));
+            if (!rule)
+            {
+                spdlog::error("unknown decimation rule for {}: {}", name, entry.substr(colon + 1));
+                return false;
+            }
+            auto channel = std::find_if(_channel_of.begin(), _channel_of.end(),
+                                        [&](const auto &descriptor_channel) { return descriptor_channel.first->name() == name; });
+            if (channel == _channel_of.end())
+            {
+                spdlog::warn("decimation rule for {}, which is not a known message", name);
+                continue;
+            }
+            parsed.emplace_back(channel->second, *rule);
+        }
+
+        std::vector<Rule> channel_rules(_num_channels);
+        for (const auto &[channel, rule] : parsed)
+        {
+            channel_rules[channel] = rule;
+        }
+        bool any_rules = false;
+        for (size_t channel = 0; channel < _num_channels; channel++)
+        {
+            const Rule &rule = channel_rules[channel];
+            Channel &state = _channels[channel];
+            if (rule.mode == Mode::OnChange && state.mode.load() != Mode::OnChange)
+            {
+                // whatever was last seen before is from who knows when
+                std::unique_lock lk(state.last_mtx);
+                state.last.reset();
+            }
+            state.every.store(rule.every, std::memory_order_relaxed);
+            state.period_ns.store(rule.mode == Mode::MaxRate ? static_cast<int64_t>(1e9 / rule.max_hz) : 0, std::memory_order_relaxed);
+            state.mode.store(rule.mode);
+            any_rules |= rule.mode != Mode::Full;
+        }
+        _any_rules = any_rules;
+        return true;
+    }
+
+    bool ChannelDecimator::keep(const google::protobuf::Message &msg, int64_t now_ns)
+    {
+        if (!_any_rules.load(std::memory_order_relaxed))
+        {
+            return true;
+        }
+        auto channel = _channel_of.find(msg.GetDescriptor());
+        if (channel == _channel_of.end())
+        {
+            return true;
+        }
+        return keep(channel->second, msg, now_ns);
+    }
+
+    bool ChannelDecimator::keep(size_t channel, const google::protobuf::Message &msg, int64_t now_ns)
+    {
+        Channel &state = _channels[channel];
+        bool kept = true;
+        switch (state.mode.load(std::memory_order_relaxed))
+        {
+        case Mode::Full:
+            break;
+        case Mode::EveryNth:
+            kept = state.count.fetch_add(1, std::memory_order_relaxed) % state.every.load(std::memory_order_relaxed) == 0;
+            break;
+        case Mode::MaxRate:
+        {
+            int64_t next = state.next_ns.load(std::memory_order_relaxed);
+            const int64_t period = state.period_ns.load(std::memory_order_relaxed);
+            // stays on the period grid so the rate averages out to max_hz, but does not make up for a
+            // pause in the messages with a burst
+            const int64_t after = (now_ns - next < period) ? next + period : now_ns + period;
+            // the exchange fails if another thread let the message for this slot through
+            kept = now_ns >= next && state.next_ns.compare_exchange_strong(next, after, std::memory_order_relaxed);
+            break;
+        }
+        case Mode::OnChange:
+        {
+            std::unique_lock lk(state.last_mtx);
+            if (state.last && state.last->GetDescriptor() == msg.GetDescriptor() &&
+                google::protobuf::util::MessageDifferencer::Equals(*state.last, msg))
+            {
+                kept = false;
+                break;
+            }
+            if (!state.last || state.last->GetDescriptor() != msg.GetDescriptor())
+            {
+                state.last.reset(msg.New());
+            }
+            state.last->CopyFrom(msg);
+            break;
+        }
+        }
+        if (!kept)
+        {
+            state.decimated.fetch_add(1, std::memory_order_relaxed);
+        }
+        return kept;
+    }
+}
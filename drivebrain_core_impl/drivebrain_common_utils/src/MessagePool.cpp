@@ -0,0 +1,35 @@
+#include <MessagePool.hpp>
+
+namespace util
+{
+    std::shared_ptr<google::protobuf::Message> MessagePool::acquire(const google::protobuf::Message &prototype)
+    {
+        TypePool &pool = _pools[prototype.GetDescriptor()];
+
+        // the oldest message is normally the one that got released, so this is usually the first check
+        const size_t count = pool.messages.size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            std::shared_ptr<google::protobuf::Message> &msg = pool.messages[pool.next];
+            pool.next = (pool.next + 1 == count) ? 0 : pool.next + 1;
+            if (msg.use_count() == 1)
+            {
+                // the last other owner released it with acq_rel, make sure everything it did with the
+                // message happened before we clear it
+                std::atomic_thread_fence(std::memory_order_acquire);
+                msg->Clear();
+                _reuses.fetch_add(1, std::memory_order_relaxed);
+                return msg;
+            }
+        }
+
+        _allocations.fetch_add(1, std::memory_order_relaxed);
+        std::shared_ptr<google::protobuf::Message> msg(prototype.New());
+        if (count < _max_per_type)
+        {
+            pool.messages.push_back(msg);
+            pool.next = 0;
+        }
+        return msg;
+    }
+}
@@ -1,4 +1,6 @@
 #include <ProtobufUtils.hpp>
+#include <mutex>
+#include <unordered_map>
 #include <spdlog/spdlog.h>
 
 namespace util
@@ -64,4 +66,19 @@ namespace util
         }
         return fdSet;
     }
+
+    const std::string &serialized_file_descriptor_set(const google::protobuf::Descriptor *descriptor)
+    {
+        static std::mutex cache_mtx;
+        // references into an unordered_map stay valid as it grows
+        static std::unordered_map<const google::protobuf::FileDescriptor *, std::string> cache;
+
+        std::unique_lock lk(cache_mtx);
+        auto cached = cache.find(descriptor->file());
+        if (cached == cache.end())
+        {
+            cached = cache.emplace(descriptor->file(), build_file_descriptor_set(descriptor).SerializeAsString()).first;
+        }
+        return cached->second;
+    }
 }
@@ -0,0 +1,381 @@
+// generates the typed CAN codec (GeneratedCANCodec.hpp) from a DBC at build time.
+
+// the DBC is compiled into CANMessageCodec plans exactly like the driver does at runtime and every
+// plan is then written out as straight line C++: one decode and one encode function per message
+// that calls the generated protobuf setters / getters with the signal layouts as template arguments
+// of the codegen:: helpers. the conversions are spelled out the same way as in CANMessageCodec so
+// both produce identical messages and frames (unit_test/GeneratedCANCodecTest.cpp checks this).
+
+// usage: can_codec_gen <dbc path> <output cpp> [protobuf package] [protobuf header]
+
+#include <CANCodec.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+
+using comms::CANMessageCodec;
+using comms::CANSignalLayout;
+using FieldKind = CANMessageCodec::FieldKind;
+
+// protobuf appends an underscore to names that are C++ keywords
+static std::string cpp_name(const std::string &name)
+{
+    static const std::set<std::string> keywords = {
+        "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor", "bool", "break", "case",
+        "catch", "char", "class", "compl", "const", "constexpr", "const_cast", "continue", "decltype",
+        "default", "delete", "do", "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern",
+        "false", "float", "for", "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace",
+        "new", "noexcept", "not", "not_eq", "nullptr", "operator", "or", "or_eq", "private", "protected",
+        "public", "register", "reinterpret_cast", "return", "short", "signed", "sizeof", "static",
+        "static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local", "throw",
+        "true", "try", "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual", "void",
+        "volatile", "wchar_t", "while", "xor", "xor_eq"};
+    return keywords.count(name) ? name + "_" : name;
+}
+
+static std::string class_name(const std::string &full_name)
+{
+    std::string out;
+    std::istringstream stream(full_name);
+    std::string part;
+    while (std::getline(stream, part, '.'))
+    {
+        out += (out.empty() ? "" : "::") + cpp_name(part);
+    }
+    return out;
+}
+
+static std::string double_literal(double value)
+{
+    // hex float literals round trip exactly
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%a", value);
+    return buf;
+}
+
+static std::string layout_args(const CANSignalLayout &layout)
+{
+    std::ostringstream out;
+    out << static_cast<int>(layout.first_byte) << ", " << static_cast<int>(layout.byte_count) << ", "
+        << static_cast<int>(layout.shift) << ", " << (layout.big_endian ? "true" : "false") << ", 0x"
+        << std::hex << layout.mask << "ULL";
+    return out.str();
+}
+
+static std::string extract_expr(const CANSignalLayout &layout)
+{
+    return "codegen::extract<" + layout_args(layout) + ">(data)";
+}
+
+static std::string to_integer_expr(const CANSignalLayout &layout, const std::string &raw)
+{
+    if (!layout.is_signed)
+    {
+        return "static_cast<int64_t>(" + raw + ")";
+    }
+    return "codegen::sign_extend<" + std::to_string(layout.bit_size) + ">(" + raw + ")";
+}
+
+// CANSignalLayout::raw_to_phys
+static std::string raw_to_phys_expr(const CANSignalLayout &layout, const std::string &raw)
+{
+    std::string val;
+    switch (layout.value_kind)
+    {
+    case CANSignalLayout::ValueKind::Float:
+        val = "static_cast<double>(codegen::float_from_bits(" + raw + "))";
+        break;
+    case CANSignalLayout::ValueKind::Double:
+        val = "codegen::double_from_bits(" + raw + ")";
+        break;
+    case CANSignalLayout::ValueKind::Integer:
+    default:
+        val = layout.is_signed ? "static_cast<double>(" + to_integer_expr(layout, raw) + ")" : "static_cast<double>(" + raw + ")";
+        break;
+    }
+    return val + " * " + double_literal(layout.factor) + " + " + double_literal(layout.offset);
+}
+
+static std::string field_type(FieldKind kind)
+{
+    switch (kind)
+    {
+    case FieldKind::Float:
+        return "float";
+    case FieldKind::Double:
+        return "double";
+    case FieldKind::Int32:
+        return "int32_t";
+    case FieldKind::Int64:
+        return "int64_t";
+    case FieldKind::UInt32:
+        return "uint32_t";
+    case FieldKind::UInt64:
+        return "uint64_t";
+    case FieldKind::Bool:
+        return "bool";
+    case FieldKind::Enum:
+    default:
+        return "int";
+    }
+}
+
+// the value passed to the setter, same conversions as CANMessageCodec::decode_into
+static std::string decode_value_expr(const CANMessageCodec::SignalDecodeStep &step, const std::string &raw)
+{
+    const CANSignalLayout &layout = step.layout;
+    if (step.kind == FieldKind::Enum)
+    {
+        return "static_cast<" + class_name(step.field->enum_type()->full_name()) + ">(static_cast<int>(" + to_integer_expr(layout, raw) + "))";
+    }
+
+    // integer signals with no scaling are exact in a double, so the double round trip can be skipped
+    // whenever the result is the same. everything else goes through the double like the plans do
+    const bool exact_integer = layout.value_kind == CANSignalLayout::ValueKind::Integer && !step.use_raw_value &&
+                               layout.factor == 1.0 && layout.offset == 0.0 && layout.bit_size <= 53;
+    if (exact_integer)
+    {
+        const std::string integer = layout.is_signed ? to_integer_expr(layout, raw) : raw;
+        const uint16_t bits = layout.bit_size;
+        switch (step.kind)
+        {
+        case FieldKind::Bool:
+            return "(" + raw + " != 0)";
+        case FieldKind::Int64:
+            return "static_cast<int64_t>(" + integer + ")";
+        case FieldKind::Int32:
+            if (bits <= 31 || (layout.is_signed && bits <= 32))
+            {
+                return "static_cast<int32_t>(" + integer + ")";
+            }
+            break;
+        case FieldKind::UInt32:
+            if (!layout.is_signed && bits <= 32)
+            {
+                return "static_cast<uint32_t>(" + integer + ")";
+            }
+            break;
+        case FieldKind::UInt64:
+            if (!layout.is_signed)
+            {
+                return "static_cast<uint64_t>(" + integer + ")";
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    const std::string value = step.use_raw_value
+                                  ? "static_cast<double>(static_cast<int>(" + to_integer_expr(layout, raw) + "))"
+                                  : "(" + raw_to_phys_expr(layout, raw) + ")";
+    if (step.kind == FieldKind::Bool)
+    {
+        return "(" + value + " != 0.0)";
+    }
+    if (step.kind == FieldKind::Double)
+    {
+        return value;
+    }
+    return "static_cast<" + field_type(step.kind) + ">(" + value + ")";
+}
+
+// CANSignalLayout::phys_to_raw of a field's value, same as raw_value_of in CANCodec.cpp
+static std::string encode_raw_expr(const CANMessageCodec::SignalEncodeStep &step, const std::string &getter)
+{
+    const CANSignalLayout &layout = step.layout;
+    if (step.kind == FieldKind::Bool)
+    {
+        return "(" + getter + " ? uint64_t{1} : uint64_t{0})";
+    }
+
+    const std::string phys = (step.kind == FieldKind::Float || step.kind == FieldKind::Double) ? getter : "static_cast<double>(" + getter + ")";
+    const std::string scaled = "((" + phys + " - " + double_literal(layout.offset) + ") / " + double_literal(layout.factor) + ")";
+    switch (layout.value_kind)
+    {
+    case CANSignalLayout::ValueKind::Float:
+        return "codegen::float_to_bits(static_cast<float>" + scaled + ")";
+    case CANSignalLayout::ValueKind::Double:
+        return "codegen::double_to_bits" + scaled;
+    case CANSignalLayout::ValueKind::Integer:
+    default:
+        return "codegen::integer_to_raw(" + scaled + ", " + std::to_string(layout.bit_size) + ", " + (layout.is_signed ? "true" : "false") + ")";
+    }
+}
+
+static std::string hex_literal(uint64_t value)
+{
+    std::ostringstream out;
+    out << "0x" << std::hex << value << "ULL";
+    return out.str();
+}
+
+// writes the block that inserts one signal. the mux switch also keeps its value in mux_value
+// so that the muxed signals after it can check it
+static void write_encode_step(std::ostream &out, const CANMessageCodec::SignalEncodeStep &step, bool is_mux)
+{
+    const std::string getter = "msg." + cpp_name(step.field->lowercase_name()) + "()";
+    const std::string insert = "codegen::insert<" + layout_args(step.layout) + ">(data, " + (is_mux ? "mux_value" : "raw") + ");\n";
+    const std::string keep_mux = "mux_value = raw & " + hex_literal(step.layout.mask) + ";\n";
+
+    out << "        {\n";
+    if (step.kind == FieldKind::Enum)
+    {
+        out << "            static constexpr std::array<std::pair<int, uint64_t>, " << step.enum_raw_values.size() << "> raw_values = {{";
+        for (size_t i = 0; i < step.enum_raw_values.size(); i++)
+        {
+            out << (i ? ", " : "") << "{" << step.enum_raw_values[i].first << ", " << hex_literal(step.enum_raw_values[i].second) << "}";
+        }
+        out << "}};\n";
+        out << "            uint64_t raw = 0;\n";
+        out << "            if (codegen::enum_to_raw(raw_values, static_cast<int>(" << getter << "), raw))\n";
+        out << "            {\n";
+        if (is_mux)
+        {
+            out << "                " << keep_mux;
+            out << "                mux_known = true;\n";
+        }
+        out << "                " << insert;
+        out << "            }\n";
+    }
+    else
+    {
+        out << "            const uint64_t raw = " << encode_raw_expr(step, getter) << ";\n";
+        if (is_mux)
+        {
+            out << "            " << keep_mux;
+            out << "            mux_known = true;\n";
+        }
+        out << "            " << insert;
+    }
+    out << "        }\n";
+}
+
+static void write_message(std::ostream &out, const CANMessageCodec::MessageDecodePlan &plan, const CANMessageCodec::MessageEncodePlan &encode_plan)
+{
+    const std::string name = cpp_name(plan.descriptor->name());
+    const std::string type = class_name(plan.descriptor->full_name());
+
+    out << "    // " << plan.descriptor->name() << ", CAN ID 0x" << std::hex << (plan.can_id & CAN_EFF_MASK) << std::dec
+        << ((plan.can_id & CAN_EFF_FLAG) ? " (extended)" : "") << ", " << static_cast<int>(plan.message_size) << " bytes\n";
+
+    out << "    void decode_" << name << "(const uint8_t *data, google::protobuf::Message &out)\n";
+    out << "    {\n";
+    out << "        auto &msg = static_cast<" << type << " &>(out);\n";
+    if (plan.has_mux)
+    {
+        out << "        const uint64_t mux = " << extract_expr(plan.mux_layout) << ";\n";
+    }
+    for (const auto &step : plan.steps)
+    {
+        if (step.is_muxed && !plan.has_mux)
+        {
+            continue;
+        }
+        const std::string indent = step.is_muxed ? "            " : "        ";
+        if (step.is_muxed)
+        {
+            out << "        if (mux == " << step.mux_switch_value << "ULL)\n        {\n";
+        }
+        out << indent << "msg.set_" << cpp_name(step.field->lowercase_name()) << "(" << decode_value_expr(step, extract_expr(step.layout)) << ");\n";
+        if (step.is_muxed)
+        {
+            out << "        }\n";
+        }
+    }
+    out << "    }\n\n";
+
+    out << "    void encode_" << name << "(const google::protobuf::Message &in, uint8_t *data)\n";
+    out << "    {\n";
+    out << "        const auto &msg = static_cast<const " << type << " &>(in);\n";
+    if (encode_plan.mux_step >= 0)
+    {
+        // the mux switch goes first so that only the muxed signals it selects get encoded
+        out << "        bool mux_known = false;\n";
+        out << "        uint64_t mux_value = 0;\n";
+        write_encode_step(out, encode_plan.steps[encode_plan.mux_step], true);
+    }
+    for (size_t i = 0; i < encode_plan.steps.size(); i++)
+    {
+        const auto &step = encode_plan.steps[i];
+        if (static_cast<int>(i) == encode_plan.mux_step || (step.is_muxed && encode_plan.mux_step < 0))
+        {
+            continue;
+        }
+        if (step.is_muxed)
+        {
+            out << "        if (mux_known && mux_value == " << step.mux_switch_value << "ULL)\n";
+        }
+        write_encode_step(out, step, false);
+    }
+    if (encode_plan.mux_step >= 0)
+    {
+        out << "        (void)mux_known;\n";
+    }
+    out << "    }\n\n";
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "usage: can_codec_gen <dbc path> <output cpp> [protobuf package] [protobuf header]" << std::endl;
+        return 1;
+    }
+    const std::string dbc_path = argv[1];
+    const std::string out_path = argv[2];
+    const std::string package = (argc > 3) ? argv[3] : "hytech";
+    const std::string pb_header = (argc > 4) ? argv[4] : package + ".pb.h";
+
+    std::unique_ptr<dbcppp::INetwork> net;
+    {
+        std::ifstream idbc(dbc_path);
+        net = dbcppp::INetwork::LoadDBCFromIs(idbc);
+    }
+    CANMessageCodec codec;
+    if (!net || !codec.build(*net, google::protobuf::DescriptorPool::generated_pool(),
+                             google::protobuf::MessageFactory::generated_factory(), package))
+    {
+        std::cerr << "can_codec_gen: no messages in " << dbc_path << " could be matched to " << package << " protobuf messages" << std::endl;
+        return 1;
+    }
+
+    std::ostringstream out;
+    out << "// generated by can_codec_gen from " << dbc_path << ", do not edit\n\n";
+    out << "#include <GeneratedCANCodec.hpp>\n";
+    out << "#include <CANCodegenSupport.hpp>\n\n";
+    out << "#include <" << pb_header << ">\n\n";
+    out << "namespace comms\n{\nnamespace\n{\n";
+    for (const auto &plan : codec.decode_plans())
+    {
+        write_message(out, plan, *codec.find_encode_plan(plan.descriptor));
+    }
+    out << "}\n\n";
+
+    out << "namespace generated\n{\n";
+    out << "    const GeneratedMessageCodec message_codecs[] = {\n";
+    for (const auto &plan : codec.decode_plans())
+    {
+        const std::string name = cpp_name(plan.descriptor->name());
+        out << "        {0x" << std::hex << plan.can_id << "U, 0x" << CANMessageCodec::fingerprint(plan, *codec.find_encode_plan(plan.descriptor))
+            << std::dec << "ULL, &" << class_name(plan.descriptor->full_name()) << "::descriptor, &decode_" << name << ", &encode_" << name << "},\n";
+    }
+    out << "    };\n";
+    out << "    const size_t num_message_codecs = sizeof(message_codecs) / sizeof(message_codecs[0]);\n";
+    out << "}\n}\n";
+
+    // always written so that it is newer than the generator and the DBC, the build copies it over
+    // the codec source only if it changed
+    std::ofstream file(out_path);
+    file << out.str();
+    if (!file)
+    {
+        std::cerr << "can_codec_gen: couldnt write " << out_path << std::endl;
+        return 1;
+    }
+    std::cout << "can_codec_gen: generated " << codec.decode_plans().size() << " messages from " << dbc_path << std::endl;
+    return 0;
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+// system includes
+#include <linux/can.h>
+
+// protobuf
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/message.h>
+
+// dbcppp
+#include <Network.h>
+
+#include <MessagePool.hpp>
+
+// c++ stl includes
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// the CAN message codec is the message conversion half of the CAN driver with no socket
+// handling in it so that it can be unit tested on its own.
+
+// on construction the DBC gets compiled once into flat per-CAN-ID decode plans. each plan
+// holds the bit layout and scaling of every signal along with the already resolved protobuf
+// field descriptor and setter to use, so decoding a received frame does no string handling,
+// no map lookups and no dbcppp message cloning.
+
+// CAN FD messages (DBC messages longer than 8 bytes, up to 64) go through the same plans, the
+// only difference is the frame they end up in.
+
+// the same is done for sending: each protobuf message type gets an encode plan keyed by its
+// descriptor with the enum name -> raw value tables already resolved from the DBC value
+// descriptions, so encoding is a straight pack of the fields into the frame payload.
+
+// on top of the plans, typed decode / encode functions generated from config/hytech.dbc at build
+// time (see codegen/CANCodecGen.cpp) can be switched in with use_generated(). they do the same
+// conversions as the plans but call the generated hytech:: setters / getters directly instead of
+// going through reflection. a message only uses its generated functions if its plans fingerprint
+// the same as the ones they were generated from, so a DBC that changed after the build still works.
+
+namespace comms
+{
+    /// @brief bit position, size and scaling of a single DBC signal within a frame's payload
+    struct CANSignalLayout
+    {
+        enum class ValueKind : uint8_t
+        {
+            Integer,
+            Float,
+            Double
+        };
+
+        /// @brief creates the layout from the DBC description of the signal
+        /// @param start_bit the DBC start bit (lsb for little endian, msb in DBC "sawtooth" numbering for big endian)
+        /// @param bit_size size of the signal in bits (1 - 64)
+        /// @param big_endian true for motorola (@0) signals, false for intel (@1) signals
+        /// @param is_signed true for signed (-) signals
+        /// @param value_kind integer or IEEE float / double (SIG_VALTYPE_) signals
+        /// @param factor DBC scale
+        /// @param offset DBC offset
+        static CANSignalLayout create(uint64_t start_bit, uint64_t bit_size, bool big_endian, bool is_signed,
+                                      ValueKind value_kind, double factor, double offset);
+
+        /// @brief gets the raw (unscaled, not sign extended) value of the signal out of the payload
+        uint64_t extract(const uint8_t *data) const;
+
+        /// @brief writes the raw value of the signal into the payload, leaving other bits untouched
+        void insert(uint8_t *data, uint64_t raw) const;
+
+        /// @brief sign extends the raw value if the signal is signed
+        int64_t to_integer(uint64_t raw) const;
+
+        /// @brief same conversion as dbcppp's ISignal::RawToPhys
+        double raw_to_phys(uint64_t raw) const;
+
+        /// @brief same conversion as dbcppp's ISignal::PhysToRaw (truncating), except that integer
+        ///        signals are clamped to the raw values they can hold and NaN is 0
+        uint64_t phys_to_raw(double phys) const;
+
+        /// @brief number of payload bytes needed to hold this signal
+        size_t required_bytes() const { return static_cast<size_t>(first_byte) + byte_count; }
+
+        uint64_t mask;
+        double factor;
+        double offset;
+        uint16_t bit_size;
+        uint8_t first_byte; // first payload byte that the signal touches
+        uint8_t byte_count; // number of payload bytes the signal spans (up to 9)
+        uint8_t shift;      // right shift of the spanned bytes to get to the lsb of the signal
+        bool big_endian;
+        bool is_signed;
+        ValueKind value_kind;
+    };
+
+    /// @brief typed decode / encode functions generated at build time for one DBC message
+    struct GeneratedMessageCodec
+    {
+        uint32_t can_id;
+        uint64_t fingerprint; // CANMessageCodec::fingerprint() of the plans the functions were generated from
+        const google::protobuf::Descriptor *(*descriptor)();
+        void (*decode)(const uint8_t *data, google::protobuf::Message &out);
+        void (*encode)(const google::protobuf::Message &msg, uint8_t *data);
+    };
+
+    class CANMessageCodec
+    {
+    public:
+        /// @brief which protobuf reflection getter / setter gets used for a field, resolved once when building plans
+        enum class FieldKind : uint8_t
+        {
+            Float,
+            Double,
+            Int32,
+            Int64,
+            UInt32,
+            UInt64,
+            Bool,
+            Enum
+        };
+
+        struct SignalDecodeStep
+        {
+            CANSignalLayout layout;
+            const google::protobuf::FieldDescriptor *field;
+            FieldKind kind;
+            bool use_raw_value;         // signals that have a value table get set from their raw value
+            bool is_muxed;              // only decoded when the mux switch of the message matches
+            uint64_t mux_switch_value;
+        };
+
+        struct MessageDecodePlan
+        {
+            uint32_t can_id;
+            uint8_t message_size;
+            bool is_fd; // messages longer than 8 bytes can only be sent as CAN FD frames
+            const google::protobuf::Descriptor *descriptor;
+            const google::protobuf::Message *prototype;
+            bool has_mux;
+            CANSignalLayout mux_layout;
+            std::vector<SignalDecodeStep> steps;
+            // generated typed decode, used instead of the steps when set
+            void (*typed_decode)(const uint8_t *data, google::protobuf::Message &out);
+        };
+
+        struct SignalEncodeStep
+        {
+            CANSignalLayout layout;
+            const google::protobuf::FieldDescriptor *field;
+            FieldKind kind;
+            bool is_muxed;              // only encoded when the encoded mux switch value matches
+            uint64_t mux_switch_value;
+            // (protobuf enum number, raw DBC value) pairs sorted by enum number, only for enum fields
+            std::vector<std::pair<int, uint64_t>> enum_raw_values;
+        };
+
+        struct MessageEncodePlan
+        {
+            uint32_t can_id;
+            uint8_t message_size;
+            bool is_fd;
+            int mux_step; // index of the step that encodes the mux switch, -1 if none
+            std::vector<SignalEncodeStep> steps;
+            // generated typed encode, used instead of the steps when set
+            void (*typed_encode)(const google::protobuf::Message &msg, uint8_t *data);
+        };
+
+        CANMessageCodec() { _std_id_index.fill(-1); }
+
+        /// @brief compiles the decode and encode plans for every message of the network that has a protobuf message of the same (lowercase) name
+        /// @param network the parsed DBC
+        /// @param pool descriptor pool to look up the protobuf messages in
+        /// @param factory factory to get the prototype messages from
+        /// @param package protobuf package of the CAN messages
+        /// @return true if at least one message was able to be planned
+        bool build(const dbcppp::INetwork &network,
+                   const google::protobuf::DescriptorPool *pool = google::protobuf::DescriptorPool::generated_pool(),
+                   google::protobuf::MessageFactory *factory = google::protobuf::MessageFactory::generated_factory(),
+                   const std::string &package = "hytech");
+
+        /// @brief gets the decode plan for a CAN ID (including the EFF flag for extended IDs)
+        /// @return nullptr if the ID is not in the DBC
+        const MessageDecodePlan *find_decode_plan(uint32_t can_id) const;
+
+        /// @brief decodes a payload into a newly created protobuf message
+        /// @param can_id CAN ID including the EFF flag for extended IDs
+        /// @param data the payload, at least 8 bytes (the data of a classic or FD frame)
+        /// @param len payload length of the frame. frames shorter than their DBC message get zero padded
+        /// @param pool if given the message comes out of the pool instead of being newly allocated
+        /// @return nullptr if the CAN ID is unknown
+        std::shared_ptr<google::protobuf::Message> decode(uint32_t can_id, const uint8_t *data, size_t len, util::MessagePool *pool = nullptr) const;
+
+        /// @brief decodes a payload into an existing message of the plan's type
+        static void decode_into(const MessageDecodePlan &plan, const uint8_t *data, google::protobuf::Message &out);
+
+        /// @brief gets the encode plan for a protobuf message type
+        /// @return nullptr if the message type has no CAN message in the DBC
+        const MessageEncodePlan *find_encode_plan(const google::protobuf::Descriptor *descriptor) const;
+
+        /// @brief encodes a protobuf message into a CAN frame. classic messages fill the frame the same way as a
+        ///        struct can_frame (flags are 0), FD messages get CANFD_FDF and the payload length rounded up to a valid FD length
+        /// @return nullopt if the message type has no CAN message in the DBC
+        std::optional<canfd_frame> encode(const google::protobuf::Message &msg) const;
+
+        /// @brief encodes the fields of a message into a zeroed payload of at least plan.message_size bytes
+        static void encode_into(const MessageEncodePlan &plan, const google::protobuf::Message &msg, uint8_t *data);
+
+        /// @brief builds kernel CAN_RAW_FILTER entries that only let through frames that have a decode plan
+        /// @param allow_list if not empty, narrows the filter to these messages (DBC message names, case insensitive, or IDs)
+        /// @return one exact match filter per CAN ID
+        std::vector<can_filter> make_rx_filters(const std::vector<std::string> &allow_list = {}) const;
+
+        /// @brief switches the messages that have generated functions over to them
+        /// @param codecs the generated functions, eg. comms::generated::message_codecs
+        /// @param count number of entries in codecs
+        /// @return the number of messages that are now decoded / encoded by generated functions
+        size_t use_generated(const GeneratedMessageCodec *codecs, size_t count);
+
+        /// @brief hash of everything about a message's plans that gets baked into its generated functions
+        ///        (layouts, scaling, field numbers and types, mux and enum tables)
+        static uint64_t fingerprint(const MessageDecodePlan &plan, const MessageEncodePlan &encode_plan);
+
+        const std::vector<MessageDecodePlan> &decode_plans() const { return _decode_plans; }
+
+        static std::string to_lowercase(std::string s);
+
+        /// @brief rounds a payload length up to the next length that a CAN FD frame can have (0 - 8, 12, 16, 20, 24, 32, 48, 64)
+        static uint8_t fd_frame_len(size_t len);
+
+    private:
+        std::vector<MessageDecodePlan> _decode_plans;
+        // dense index for standard (11 bit) IDs, sorted (id, plan index) pairs for extended IDs
+        std::array<int16_t, CAN_SFF_MASK + 1> _std_id_index;
+        std::vector<std::pair<uint32_t, uint16_t>> _ext_id_index;
+        std::unordered_map<const google::protobuf::Descriptor *, MessageEncodePlan> _encode_plans;
+    };
+}
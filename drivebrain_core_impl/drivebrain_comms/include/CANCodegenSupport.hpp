@@ -0,0 +1,145 @@
+#pragma once
+
+// c++ stl includes
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+// bit packing helpers that the generated CAN codec (codegen/CANCodecGen.cpp) is written in terms of.
+// they are the same operations as CANSignalLayout::extract / insert / to_integer but with the layout
+// as template arguments, so every signal compiles down to a few shifts and masks on fixed offsets.
+
+namespace comms
+{
+    namespace codegen
+    {
+        /// @brief gets the raw value of a signal out of the payload, see CANSignalLayout::extract
+        template <uint8_t FirstByte, uint8_t ByteCount, uint8_t Shift, bool BigEndian, uint64_t Mask>
+        constexpr uint64_t extract(const uint8_t *data)
+        {
+            // only a 64 bit signal that is not byte aligned spans more than 8 bytes
+            using acc_t = std::conditional_t<(ByteCount > 8), unsigned __int128, uint64_t>;
+            acc_t acc = 0;
+            for (uint8_t i = 0; i < ByteCount; ++i)
+            {
+                acc = (acc << 8) | data[BigEndian ? (FirstByte + i) : (FirstByte + ByteCount - 1 - i)];
+            }
+            return static_cast<uint64_t>(acc >> Shift) & Mask;
+        }
+
+        /// @brief writes the raw value of a signal into the payload, see CANSignalLayout::insert
+        template <uint8_t FirstByte, uint8_t ByteCount, uint8_t Shift, bool BigEndian, uint64_t Mask>
+        constexpr void insert(uint8_t *data, uint64_t raw)
+        {
+            using acc_t = std::conditional_t<(ByteCount > 8), unsigned __int128, uint64_t>;
+            const acc_t value = static_cast<acc_t>(raw & Mask) << Shift;
+            const acc_t value_mask = static_cast<acc_t>(Mask) << Shift;
+            for (uint8_t i = 0; i < ByteCount; ++i)
+            {
+                const unsigned bit_pos = BigEndian ? (ByteCount - 1 - i) * 8 : i * 8;
+                const auto byte_mask = static_cast<uint8_t>(value_mask >> bit_pos);
+                const auto byte_value = static_cast<uint8_t>(value >> bit_pos);
+                uint8_t &byte = data[FirstByte + i];
+                byte = static_cast<uint8_t>((byte & ~byte_mask) | (byte_value & byte_mask));
+            }
+        }
+
+        /// @brief sign extends a raw value of a signed signal, see CANSignalLayout::to_integer
+        template <uint16_t BitSize>
+        constexpr int64_t sign_extend(uint64_t raw)
+        {
+            if constexpr (BitSize < 64)
+            {
+                constexpr uint64_t mask = (uint64_t{1} << BitSize) - 1;
+                if ((raw >> (BitSize - 1)) & 1)
+                {
+                    raw |= ~mask;
+                }
+            }
+            return static_cast<int64_t>(raw);
+        }
+
+        inline float float_from_bits(uint64_t raw)
+        {
+            float val;
+            const auto bits = static_cast<uint32_t>(raw);
+            std::memcpy(&val, &bits, sizeof(val));
+            return val;
+        }
+
+        inline double double_from_bits(uint64_t raw)
+        {
+            double val;
+            std::memcpy(&val, &raw, sizeof(val));
+            return val;
+        }
+
+        inline uint64_t float_to_bits(float val)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &val, sizeof(bits));
+            return bits;
+        }
+
+        inline uint64_t double_to_bits(double val)
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &val, sizeof(bits));
+            return bits;
+        }
+
+        /// @brief the raw value of an integer signal from its scaled value (truncating), clamped to
+        ///        what the signal can hold. NaN gives 0. CANSignalLayout::phys_to_raw uses it too so
+        ///        that the generated codec encodes exactly the same
+        inline uint64_t integer_to_raw(double scaled, uint16_t bit_size, bool is_signed)
+        {
+            if (std::isnan(scaled))
+            {
+                return 0;
+            }
+            const uint64_t mask = (bit_size >= 64) ? ~uint64_t{0} : ((uint64_t{1} << bit_size) - 1);
+            if (is_signed)
+            {
+                // 2^(bit_size - 1), past it the cast to int64 is undefined for a 64 bit signal
+                const double limit = std::ldexp(1.0, bit_size - 1);
+                if (scaled >= limit)
+                {
+                    return mask >> 1;
+                }
+                if (scaled <= -limit)
+                {
+                    return (mask >> 1) + 1;
+                }
+                return static_cast<uint64_t>(static_cast<int64_t>(scaled)) & mask;
+            }
+            if (scaled >= std::ldexp(1.0, bit_size))
+            {
+                return mask;
+            }
+            if (scaled <= 0.0)
+            {
+                return 0;
+            }
+            return static_cast<uint64_t>(scaled);
+        }
+
+        /// @brief looks up the raw DBC value of a protobuf enum value
+        /// @return false if the enum value has no value description in the DBC
+        template <size_t N>
+        constexpr bool enum_to_raw(const std::array<std::pair<int, uint64_t>, N> &table, int number, uint64_t &raw)
+        {
+            for (const auto &entry : table)
+            {
+                if (entry.first == number)
+                {
+                    raw = entry.second;
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+}
@@ -5,12 +5,17 @@
 #include <Logger.hpp>
 #include <MsgLogger.hpp>
 #include <StateEstimator.hpp>
+#include <CANCodec.hpp>
+#include <RingBus.hpp>
+#include <AcquisitionTime.hpp>
 #include <hytech.pb.h> // generated from CAN description
 
 // system includes
 #include <linux/can.h>
 #include <linux/can/raw.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
 #include <net/if.h>
 
 // protobuf
@@ -34,6 +39,10 @@
 #include <condition_variable>
 #include <functional>
 #include <optional>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <vector>
 
 #include <unistd.h>
 #include <cstring>
@@ -55,76 +64,173 @@
 
 namespace comms
 {
+    // the driver can serve several SocketCAN interfaces (eg. separate telemetry and powertrain buses) from
+    // one instance. canbus_device is a comma separated list of interfaces and path_to_dbc either one DBC for
+    // all of them or one per interface. every socket is serviced by the same io_context and every
+    // outgoing message is sent on the first bus whose DBC has it.
     class CANDriver : public core::common::Configurable
     {
     public:
-        using FieldVariant = std::variant<int32_t, int64_t, uint32_t, uint64_t, float, double, bool, std::string, std::monostate>;
-        using deqtype = core::common::ThreadSafeDeque<std::shared_ptr<google::protobuf::Message>>;
+        using bustype = util::RingBus<std::shared_ptr<google::protobuf::Message>>;
         using loggertype = core::MsgLogger<std::shared_ptr<google::protobuf::Message>>;
         /// @brief constructur
         /// @param json_file_handler the file handler 
-        /// @param in_deq tx queue
-        /// @param out_deq receive queue
+        /// @param in_bus tx messages, the driver subscribes a reader to it
         /// @param io_context boost asio required context
-        CANDriver(core::JsonFileHandler &json_file_handler, core::Logger& logger, std::shared_ptr<loggertype> message_logger, deqtype &in_deq, boost::asio::io_context& io_context, std::optional<std::string> dbc_path, bool &construction_failed, core::StateEstimator &state_estimator) : 
+        /// @param dbc_path overrides path_to_dbc, same format (one DBC or one per bus)
+        CANDriver(core::JsonFileHandler &json_file_handler, core::Logger& logger, std::shared_ptr<loggertype> message_logger, bustype &in_bus, boost::asio::io_context& io_context, std::optional<std::string> dbc_path, bool &construction_failed, core::StateEstimator &state_estimator) : 
             Configurable(logger, json_file_handler, "CANDriver"),
             _logger(logger),
             _message_logger(message_logger),
-            _input_deque_ref(in_deq),
-            _socket(io_context),
+            _tx_reader(in_bus.subscribe()),
+            _io_context(io_context),
             _dbc_path(dbc_path),
             _state_estimator(state_estimator)
         {
-            _running = true;
+            construction_failed = !init() || !_tx_reader;
+            // started after init so that the output thread never sees the buses being set up
             _output_thread = std::thread(&comms::CANDriver::_handle_send_msg_from_queue, this);
-            construction_failed = !init();
         }
         ~CANDriver();
         bool init();
         void _handle_send_msg_from_queue();
-        std::shared_ptr<google::protobuf::Message> pb_msg_recv(const can_frame &in_frame);
-        void set_field_values_of_pb_msg(const std::unordered_map<std::string, FieldVariant> &field_values, std::shared_ptr<google::protobuf::Message> message);
 
-        // TODO: move this into a util library?
+        /// @brief decodes a received frame into its protobuf message using the decode plan built in init()
+        /// @param in_frame the received frame
+        /// @param bus index of the bus (in canbus_device order) that the frame was received on
+        /// @return nullptr if the CAN ID is not in the DBC
+        std::shared_ptr<google::protobuf::Message> pb_msg_recv(const can_frame &in_frame, size_t bus = 0);
+        /// @brief same as above for a classic or FD frame received on an FD enabled socket
+        std::shared_ptr<google::protobuf::Message> pb_msg_recv(const canfd_frame &in_frame, size_t bus = 0);
 
-        /// @brief get the value from a field within a protobuf message based on the name of the field
-        /// @param message
-        /// @param field_name
-        /// @return variant of types
-        FieldVariant get_field_value(std::shared_ptr<google::protobuf::Message> message, const std::string &field_name);
+        /// @brief number of CAN interfaces the driver is serving
+        size_t num_buses() const { return _buses.size(); }
 
-        // for exposing to the test framework directly
-    protected:
-        // socket operations
-        bool _open_socket(const std::string& interface_name);
-        void _do_read();
-        void _send_message(const struct can_frame& frame);
+        struct RxStats
+        {
+            uint64_t frames;                // frames handed to _handle_recv_CAN_frame
+            uint64_t wakeups;               // read completions / recvmmsg calls that returned frames
+            uint64_t kernel_stamped_frames; // frames that came with a kernel receive timestamp
+        };
 
-        void _handle_recv_CAN_frame(const struct can_frame& frame);
+        /// @brief receive counters over all buses, frames / wakeups is the average batch size
+        RxStats get_rx_stats() const;
 
-        std::shared_ptr<google::protobuf::Message> _get_pb_msg_by_name(const std::string &name);
-        std::optional<can_frame> _get_CAN_msg(std::shared_ptr<google::protobuf::Message> msg);
+        struct TxStats
+        {
+            uint64_t frames_sent;
+            uint64_t frames_dropped;   // frames that were not able to be sent after retrying
+            uint64_t frames_coalesced; // frames replaced by a newer frame with the same CAN ID in the same batch
+            uint64_t enobufs_events;   // sendmmsg calls that failed because the interface tx queue was full
+            uint64_t flushes;
+            uint64_t queue_depth;      // messages published to the tx bus that the output thread has not read yet
+            uint64_t queue_dropped;    // messages overwritten on the tx bus before the output thread read them
+        };
+
+        /// @brief transmit counters over all buses
+        TxStats get_tx_stats() const;
+
+        /// @brief pool that received messages are decoded into, for checking that receiving does not allocate
+        const util::MessagePool &get_rx_pool() const { return _rx_pool; }
 
     private:
-        static std::string _to_lowercase(std::string s);
+        // every frame is read into / sent from a canfd_frame. a classic frame is the first CAN_MTU bytes of
+        // one with flags 0, so the same buffers work for both and the byte count tells which one it is
+        static constexpr size_t _rx_batch_size = 64;
+        struct RxControlBuffer
+        {
+            alignas(struct cmsghdr) char data[util::rx_timestamp_cmsg_size];
+        };
+
+        /// @brief one SocketCAN interface along with the DBC that describes its traffic and its rx / tx buffers
+        struct CANBus
+        {
+            explicit CANBus(boost::asio::io_context &io_context) : socket(io_context) {}
+
+            size_t index;
+            std::string device;
+            std::shared_ptr<const CANMessageCodec> codec; // shared between buses that use the same DBC
+            boost::asio::posix::stream_descriptor socket;
+
+            // non-batched read buffer
+            struct canfd_frame frame;
+
+            // batched receive buffers. recvmmsg writes straight into rx_frames and the timestamp
+            // control messages into rx_cmsg_bufs, everything is set up once in _open_socket
+            std::array<struct canfd_frame, _rx_batch_size> rx_frames;
+            std::array<struct iovec, _rx_batch_size> rx_iovecs;
+            std::array<struct mmsghdr, _rx_batch_size> rx_msgs;
+            std::array<RxControlBuffer, _rx_batch_size> rx_cmsg_bufs;
+
+            // transmit batch. only touched by the output thread, the frames stay put until sendmmsg returns
+            // so there is nothing referencing them after a flush
+            std::vector<struct canfd_frame> tx_frames;
+            std::vector<std::shared_ptr<google::protobuf::Message>> tx_frame_msgs;
+            std::vector<struct iovec> tx_iovecs;
+            std::vector<struct mmsghdr> tx_msgs;
+        };
+
+        // for exposing to the test framework directly
+    protected:
+        // socket operations
+        bool _open_socket(CANBus &bus);
+        void _do_read(CANBus &bus);
+        /// @brief waits for the socket to become readable and drains up to _rx_batch_size frames with one recvmmsg call
+        void _do_batched_read(CANBus &bus);
+        void _read_batch(CANBus &bus);
+        /// @brief adds a frame to the bus' pending tx batch, replacing a pending frame with the same CAN ID
+        void _queue_tx_frame(CANBus &bus, const struct canfd_frame &frame, std::shared_ptr<google::protobuf::Message> msg);
+        /// @brief sends the bus' pending tx batch with sendmmsg, retrying on ENOBUFS
+        /// @return the number of frames at the front of the batch that were sent
+        size_t _flush_tx_frames(CANBus &bus);
+
+        /// @param bus the bus the frame was received on
+        /// @param frame the received frame
+        /// @param rx_time kernel receive time (system clock epoch) if available, otherwise the time it was read.
+        ///        the frame's acquisition time for the state estimator and the MCAP log
+        void _handle_recv_CAN_frame(const CANBus &bus, const struct canfd_frame& frame, std::chrono::microseconds rx_time);
+
+        /// @brief splits a comma separated param (device list, DBC list, rx_allow_list) into its trimmed entries
+        static std::vector<std::string> _split_list(const std::string &list);
+
+        /// @brief encodes a protobuf message into its CAN frame using the encode plan built in init()
+        /// @param msg the message to send
+        /// @param bus_index set to the index of the bus the frame has to be sent on
+        /// @return nullopt if the message type has no CAN message in any DBC, or if it is an FD message and FD is not enabled
+        std::optional<canfd_frame> _get_CAN_msg(std::shared_ptr<google::protobuf::Message> msg, size_t *bus_index = nullptr);
 
     private:
         core::Logger& _logger;
         std::shared_ptr<loggertype> _message_logger;
-        deqtype &_input_deque_ref;
+        std::unique_ptr<bustype::Reader> _tx_reader;
+        boost::asio::io_context &_io_context;
 
         std::condition_variable _cv;
         std::thread _output_thread;
 
-        struct can_frame _frame;
+        std::vector<std::unique_ptr<CANBus>> _buses;
+
+        // received messages, only acquired from on the io_context thread
+        util::MessagePool _rx_pool;
+
+        bool _can_fd = false;
+        bool _batched_receive = false;
+        bool _kernel_rx_filter = false;
+        std::vector<std::string> _rx_allow_list;
+        std::atomic<uint64_t> _rx_frame_count{0};
+        std::atomic<uint64_t> _rx_wakeup_count{0};
+        std::atomic<uint64_t> _rx_stamped_count{0};
+
+        static constexpr int _tx_max_retries = 3;
+        static constexpr std::chrono::microseconds _tx_retry_backoff{100};
+        std::atomic<uint64_t> _tx_sent_count{0};
+        std::atomic<uint64_t> _tx_dropped_count{0};
+        std::atomic<uint64_t> _tx_coalesced_count{0};
+        std::atomic<uint64_t> _tx_enobufs_count{0};
+        std::atomic<uint64_t> _tx_flush_count{0};
 
-        boost::asio::posix::stream_descriptor _socket;
         std::optional<std::string> _dbc_path;
 
-        std::unordered_map<uint64_t, std::unique_ptr<dbcppp::IMessage>> _messages;
-        std::unordered_map<std::string, uint64_t> _messages_names_and_ids;
-        int _CAN_socket; // can socket bound to
-        bool _running = false;
         core::StateEstimator & _state_estimator;
     };
 }
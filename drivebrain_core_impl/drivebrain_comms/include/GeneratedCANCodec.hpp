@@ -0,0 +1,19 @@
+#pragma once
+
+#include <CANCodec.hpp>
+
+// c++ stl includes
+#include <cstddef>
+
+// typed decode / encode functions for every message in config/hytech.dbc. the definitions are
+// generated at build time by can_codec_gen (codegen/CANCodecGen.cpp), hand them to
+// CANMessageCodec::use_generated to use them instead of the reflection based plans.
+
+namespace comms
+{
+    namespace generated
+    {
+        extern const GeneratedMessageCodec message_codecs[];
+        extern const size_t num_message_codecs;
+    }
+}
@@ -4,6 +4,8 @@
 #include <Logger.hpp>
 #include <StateEstimator.hpp>
 #include <MsgLogger.hpp>
+#include <MessagePool.hpp>
+#include <RingBus.hpp>
 
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
@@ -27,12 +29,12 @@ namespace comms
     class MCUETHComms
     {
     public:
-        using deqtype = core::common::ThreadSafeDeque<std::shared_ptr<google::protobuf::Message>>;
+        using bustype = util::RingBus<std::shared_ptr<google::protobuf::Message>>;
         using loggertype = core::MsgLogger<std::shared_ptr<google::protobuf::Message>>;
         MCUETHComms() = delete;
         ~MCUETHComms();
         MCUETHComms(core::Logger &logger,
-                    deqtype &in_deq,
+                    bustype &in_bus,
                     std::shared_ptr<loggertype> message_logger,
                     core::StateEstimator &state_estimator,
                     boost::asio::io_context &io_context,
@@ -60,9 +62,10 @@ namespace comms
         std::string _send_ip;
         boost::asio::ip::udp::socket _socket;
         boost::asio::ip::udp::endpoint _remote_endpoint;
-        std::shared_ptr<hytech_msgs::MCUOutputData> _mcu_msg;
-        deqtype &_input_deque_ref; // "input" = the messages that get input to the ethernet comms driver to send out
-        bool _running = false;
+        // MCUOutputData messages, only acquired from in _handle_receive on the io_context thread. every
+        // packet gets its own since the logger may serialize it after the next one came in
+        util::MessagePool _msg_pool;
+        std::unique_ptr<bustype::Reader> _tx_reader; // reader of the messages that get input to the ethernet comms driver to send out
         std::thread _output_thread;
     };
 
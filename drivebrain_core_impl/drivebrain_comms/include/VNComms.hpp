@@ -4,6 +4,8 @@
 #include <Logger.hpp>
 #include <MsgLogger.hpp>
 #include <StateEstimator.hpp>
+#include <MessagePool.hpp>
+#include <AcquisitionTime.hpp>
 
 // protobuf
 #include <google/protobuf/any.pb.h>
@@ -24,6 +26,7 @@
 #include <condition_variable>
 #include <functional>
 #include <optional>
+#include <chrono>
 
 #include <unistd.h>
 #include <cstring>
@@ -60,10 +63,13 @@ namespace comms {
             SerialPort _serial;
             std::shared_ptr<loggertype> _message_logger; 
             config _config;    
+            // VNData messages, only acquired from in _handle_recieve on the io_context thread
+            util::MessagePool _msg_pool;
 
         public: 
             // Public methods
-            void log_proto_message(std::shared_ptr<google::protobuf::Message> msg);  
+            /// @param acquired_at system clock time that the packet was read at
+            void log_proto_message(std::shared_ptr<google::protobuf::Message> msg, std::chrono::microseconds acquired_at);
         
         private:
             // Private methods
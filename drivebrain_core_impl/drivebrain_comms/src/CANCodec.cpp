@@ -0,0 +1,705 @@
+#include <CANCodec.hpp>
+#include <CANCodegenSupport.hpp>
+
+// standard includes
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+
+// logging includes
+#include <spdlog/spdlog.h>
+
+namespace comms
+{
+    CANSignalLayout CANSignalLayout::create(uint64_t start_bit, uint64_t bit_size, bool big_endian, bool is_signed,
+                                            ValueKind value_kind, double factor, double offset)
+    {
+        CANSignalLayout layout{};
+        layout.bit_size = static_cast<uint16_t>(bit_size);
+        layout.mask = (bit_size >= 64) ? ~uint64_t{0} : ((uint64_t{1} << bit_size) - 1);
+        layout.factor = factor;
+        layout.offset = offset;
+        layout.big_endian = big_endian;
+        layout.is_signed = is_signed;
+        layout.value_kind = value_kind;
+
+        if (!big_endian)
+        {
+            // intel: the start bit is the lsb, bits count up through the bytes
+            layout.first_byte = static_cast<uint8_t>(start_bit / 8);
+            layout.shift = static_cast<uint8_t>(start_bit % 8);
+            layout.byte_count = static_cast<uint8_t>((layout.shift + bit_size + 7) / 8);
+        }
+        else
+        {
+            // motorola: the start bit is the msb in sawtooth numbering. convert to a position
+            // counted from the msb of the first byte so the signal is a contiguous run of bits
+            const uint64_t msb = (start_bit / 8) * 8 + (7 - (start_bit % 8));
+            const uint64_t lsb = msb + bit_size - 1;
+            layout.first_byte = static_cast<uint8_t>(msb / 8);
+            layout.byte_count = static_cast<uint8_t>((lsb / 8) - (msb / 8) + 1);
+            layout.shift = static_cast<uint8_t>(7 - (lsb % 8));
+        }
+        return layout;
+    }
+
+    uint64_t CANSignalLayout::extract(const uint8_t *data) const
+    {
+        // a 64 bit signal that is not byte aligned spans 9 bytes
+        unsigned __int128 acc = 0;
+        if (big_endian)
+        {
+            for (uint8_t i = 0; i < byte_count; ++i)
+            {
+                acc = (acc << 8) | data[first_byte + i];
+            }
+        }
+        else
+        {
+            for (uint8_t i = byte_count; i > 0; --i)
+            {
+                acc = (acc << 8) | data[first_byte + i - 1];
+            }
+        }
+        return static_cast<uint64_t>(acc >> shift) & mask;
+    }
+
+    void CANSignalLayout::insert(uint8_t *data, uint64_t raw) const
+    {
+        const unsigned __int128 value = static_cast<unsigned __int128>(raw & mask) << shift;
+        const unsigned __int128 value_mask = static_cast<unsigned __int128>(mask) << shift;
+        for (uint8_t i = 0; i < byte_count; ++i)
+        {
+            const unsigned bit_pos = big_endian ? (byte_count - 1 - i) * 8 : i * 8;
+            const auto byte_mask = static_cast<uint8_t>(value_mask >> bit_pos);
+            const auto byte_value = static_cast<uint8_t>(value >> bit_pos);
+            uint8_t &byte = data[first_byte + i];
+            byte = static_cast<uint8_t>((byte & ~byte_mask) | (byte_value & byte_mask));
+        }
+    }
+
+    int64_t CANSignalLayout::to_integer(uint64_t raw) const
+    {
+        if (is_signed && bit_size < 64 && ((raw >> (bit_size - 1)) & 1))
+        {
+            raw |= ~mask;
+        }
+        return static_cast<int64_t>(raw);
+    }
+
+    double CANSignalLayout::raw_to_phys(uint64_t raw) const
+    {
+        switch (value_kind)
+        {
+        case ValueKind::Float:
+        {
+            float val;
+            const auto bits = static_cast<uint32_t>(raw);
+            std::memcpy(&val, &bits, sizeof(val));
+            return static_cast<double>(val) * factor + offset;
+        }
+        case ValueKind::Double:
+        {
+            double val;
+            std::memcpy(&val, &raw, sizeof(val));
+            return val * factor + offset;
+        }
+        case ValueKind::Integer:
+        default:
+            if (is_signed)
+            {
+                return static_cast<double>(to_integer(raw)) * factor + offset;
+            }
+            return static_cast<double>(raw) * factor + offset;
+        }
+    }
+
+    uint64_t CANSignalLayout::phys_to_raw(double phys) const
+    {
+        const double scaled = (phys - offset) / factor;
+        switch (value_kind)
+        {
+        case ValueKind::Float:
+        {
+            const auto val = static_cast<float>(scaled);
+            uint32_t bits;
+            std::memcpy(&bits, &val, sizeof(bits));
+            return bits;
+        }
+        case ValueKind::Double:
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &scaled, sizeof(bits));
+            return bits;
+        }
+        case ValueKind::Integer:
+        default:
+            return codegen::integer_to_raw(scaled, bit_size, is_signed);
+        }
+    }
+
+    std::string CANMessageCodec::to_lowercase(std::string s)
+    {
+        std::transform(s.begin(), s.end(), s.begin(),
+                       [](unsigned char c) { return std::tolower(c); });
+        return s;
+    }
+
+    uint8_t CANMessageCodec::fd_frame_len(size_t len)
+    {
+        static constexpr std::array<uint8_t, 7> fd_lens = {12, 16, 20, 24, 32, 48, 64};
+        if (len <= CAN_MAX_DLEN)
+        {
+            return static_cast<uint8_t>(len);
+        }
+        for (uint8_t fd_len : fd_lens)
+        {
+            if (len <= fd_len)
+            {
+                return fd_len;
+            }
+        }
+        return CANFD_MAX_DLEN;
+    }
+
+    static CANSignalLayout layout_of(const dbcppp::ISignal &sig)
+    {
+        CANSignalLayout::ValueKind kind = CANSignalLayout::ValueKind::Integer;
+        if (sig.ExtendedValueType() == dbcppp::ISignal::EExtendedValueType::Float)
+        {
+            kind = CANSignalLayout::ValueKind::Float;
+        }
+        else if (sig.ExtendedValueType() == dbcppp::ISignal::EExtendedValueType::Double)
+        {
+            kind = CANSignalLayout::ValueKind::Double;
+        }
+        return CANSignalLayout::create(sig.StartBit(), sig.BitSize(),
+                                       sig.ByteOrder() == dbcppp::ISignal::EByteOrder::BigEndian,
+                                       sig.ValueType() == dbcppp::ISignal::EValueType::Signed,
+                                       kind, sig.Factor(), sig.Offset());
+    }
+
+    static std::optional<CANMessageCodec::FieldKind> field_kind_of(const google::protobuf::FieldDescriptor *field)
+    {
+        using fd = google::protobuf::FieldDescriptor;
+        using fk = CANMessageCodec::FieldKind;
+        switch (field->cpp_type())
+        {
+        case fd::CPPTYPE_FLOAT:
+            return fk::Float;
+        case fd::CPPTYPE_DOUBLE:
+            return fk::Double;
+        case fd::CPPTYPE_INT32:
+            return fk::Int32;
+        case fd::CPPTYPE_INT64:
+            return fk::Int64;
+        case fd::CPPTYPE_UINT32:
+            return fk::UInt32;
+        case fd::CPPTYPE_UINT64:
+            return fk::UInt64;
+        case fd::CPPTYPE_BOOL:
+            return fk::Bool;
+        case fd::CPPTYPE_ENUM:
+            return fk::Enum;
+        default:
+            return std::nullopt;
+        }
+    }
+
+    bool CANMessageCodec::build(const dbcppp::INetwork &network,
+                                const google::protobuf::DescriptorPool *pool,
+                                google::protobuf::MessageFactory *factory,
+                                const std::string &package)
+    {
+        _decode_plans.clear();
+        _std_id_index.fill(-1);
+        _ext_id_index.clear();
+        _encode_plans.clear();
+
+        for (const dbcppp::IMessage &msg : network.Messages())
+        {
+            const std::string pb_name = package + "." + to_lowercase(msg.Name());
+            const google::protobuf::Descriptor *desc = pool->FindMessageTypeByName(pb_name);
+            if (!desc)
+            {
+                spdlog::warn("no protobuf message {} for CAN message {}, it will not be decoded", pb_name, msg.Name());
+                continue;
+            }
+
+            if (msg.MessageSize() > CANFD_MAX_DLEN)
+            {
+                spdlog::warn("CAN message {} is longer than a CAN FD frame, it will not be decoded", msg.Name());
+                continue;
+            }
+
+            MessageDecodePlan plan{};
+            plan.can_id = static_cast<uint32_t>(msg.Id());
+            plan.message_size = static_cast<uint8_t>(msg.MessageSize());
+            plan.is_fd = msg.MessageSize() > CAN_MAX_DLEN;
+            plan.descriptor = desc;
+            plan.prototype = factory->GetPrototype(desc);
+
+            const dbcppp::ISignal *mux_sig = msg.MuxSignal();
+            plan.has_mux = (mux_sig != nullptr);
+            if (mux_sig)
+            {
+                plan.mux_layout = layout_of(*mux_sig);
+            }
+
+            MessageEncodePlan encode_plan{};
+            encode_plan.can_id = plan.can_id;
+            encode_plan.message_size = plan.message_size;
+            encode_plan.is_fd = plan.is_fd;
+            encode_plan.mux_step = -1;
+
+            const size_t max_bytes = std::max<size_t>(msg.MessageSize(), CAN_MAX_DLEN);
+            for (const dbcppp::ISignal &sig : msg.Signals())
+            {
+                const google::protobuf::FieldDescriptor *field = desc->FindFieldByName(sig.Name());
+                if (!field)
+                {
+                    spdlog::warn("no field {} in protobuf message {}", sig.Name(), pb_name);
+                    continue;
+                }
+                auto kind = field_kind_of(field);
+                if (field->is_repeated() || !kind)
+                {
+                    spdlog::warn("Unsupported field type for field: {}", field->full_name());
+                    continue;
+                }
+
+                SignalDecodeStep step{};
+                step.layout = layout_of(sig);
+                step.field = field;
+                step.kind = *kind;
+                step.use_raw_value = sig.ValueEncodingDescriptions_Size() > 1;
+                step.is_muxed = sig.MultiplexerIndicator() == dbcppp::ISignal::EMultiplexer::MuxValue;
+                step.mux_switch_value = sig.MultiplexerSwitchValue();
+
+                if (step.layout.required_bytes() > max_bytes)
+                {
+                    spdlog::warn("signal {} of {} does not fit in the message, skipping", sig.Name(), msg.Name());
+                    continue;
+                }
+
+                SignalEncodeStep encode_step{};
+                encode_step.layout = step.layout;
+                encode_step.field = field;
+                encode_step.kind = step.kind;
+                encode_step.is_muxed = step.is_muxed;
+                encode_step.mux_switch_value = step.mux_switch_value;
+                if (step.kind == FieldKind::Enum)
+                {
+                    // enum values are sent as the raw value of the DBC value description with the same name
+                    const google::protobuf::EnumDescriptor *enum_desc = field->enum_type();
+                    for (int i = 0; i < enum_desc->value_count(); ++i)
+                    {
+                        const google::protobuf::EnumValueDescriptor *enum_val = enum_desc->value(i);
+                        for (const auto &enc : sig.ValueEncodingDescriptions())
+                        {
+                            if (enc.Description() == enum_val->name())
+                            {
+                                encode_step.enum_raw_values.emplace_back(enum_val->number(), static_cast<uint64_t>(enc.Value()));
+                                break;
+                            }
+                        }
+                    }
+                    std::sort(encode_step.enum_raw_values.begin(), encode_step.enum_raw_values.end());
+                }
+                if (mux_sig && mux_sig->Name() == sig.Name())
+                {
+                    encode_plan.mux_step = static_cast<int>(encode_plan.steps.size());
+                }
+
+                plan.steps.push_back(step);
+                encode_plan.steps.push_back(std::move(encode_step));
+            }
+
+            _encode_plans[desc] = std::move(encode_plan);
+
+            const auto index = static_cast<int16_t>(_decode_plans.size());
+            if (!(plan.can_id & CAN_EFF_FLAG) && plan.can_id <= CAN_SFF_MASK)
+            {
+                _std_id_index[plan.can_id] = index;
+            }
+            else
+            {
+                _ext_id_index.emplace_back(plan.can_id, static_cast<uint16_t>(index));
+            }
+            _decode_plans.push_back(std::move(plan));
+        }
+
+        std::sort(_ext_id_index.begin(), _ext_id_index.end());
+        return !_decode_plans.empty();
+    }
+
+    std::vector<can_filter> CANMessageCodec::make_rx_filters(const std::vector<std::string> &allow_list) const
+    {
+        std::vector<uint32_t> ids;
+        if (allow_list.empty())
+        {
+            for (const auto &plan : _decode_plans)
+            {
+                ids.push_back(plan.can_id);
+            }
+        }
+        else
+        {
+            for (const auto &entry : allow_list)
+            {
+                const MessageDecodePlan *plan = nullptr;
+                char *end = nullptr;
+                const unsigned long id = std::strtoul(entry.c_str(), &end, 0);
+                if (!entry.empty() && end != nullptr && *end == '\0')
+                {
+                    // extended IDs can be given with or without the EFF flag
+                    plan = find_decode_plan((id > CAN_SFF_MASK) ? (static_cast<uint32_t>(id) | CAN_EFF_FLAG) : static_cast<uint32_t>(id));
+                }
+                else
+                {
+                    const std::string name = to_lowercase(entry);
+                    auto it = std::find_if(_decode_plans.begin(), _decode_plans.end(),
+                                           [&name](const MessageDecodePlan &p) { return p.descriptor->name() == name; });
+                    plan = (it != _decode_plans.end()) ? &(*it) : nullptr;
+                }
+
+                if (!plan)
+                {
+                    spdlog::warn("CAN allow list entry {} is not a message in the DBC, ignoring it", entry);
+                    continue;
+                }
+                ids.push_back(plan->can_id);
+            }
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        }
+
+        // masks that cover every ID bit plus the EFF and RTR flags are exact matches, which the kernel
+        // keeps in hashed per-ID receive lists instead of checking every filter against every frame
+        std::vector<can_filter> filters;
+        filters.reserve(ids.size());
+        for (uint32_t id : ids)
+        {
+            can_filter filter{};
+            filter.can_id = id;
+            filter.can_mask = CAN_EFF_FLAG | CAN_RTR_FLAG | ((id & CAN_EFF_FLAG) ? CAN_EFF_MASK : CAN_SFF_MASK);
+            filters.push_back(filter);
+        }
+        return filters;
+    }
+
+    const CANMessageCodec::MessageDecodePlan *CANMessageCodec::find_decode_plan(uint32_t can_id) const
+    {
+        if (can_id <= CAN_SFF_MASK)
+        {
+            const int16_t index = _std_id_index[can_id];
+            return (index < 0) ? nullptr : &_decode_plans[index];
+        }
+
+        auto it = std::lower_bound(_ext_id_index.begin(), _ext_id_index.end(), can_id,
+                                   [](const std::pair<uint32_t, uint16_t> &entry, uint32_t id) { return entry.first < id; });
+        if (it != _ext_id_index.end() && it->first == can_id)
+        {
+            return &_decode_plans[it->second];
+        }
+        return nullptr;
+    }
+
+    std::shared_ptr<google::protobuf::Message> CANMessageCodec::decode(uint32_t can_id, const uint8_t *data, size_t len, util::MessagePool *pool) const
+    {
+        const MessageDecodePlan *plan = find_decode_plan(can_id);
+        if (!plan)
+        {
+            return nullptr;
+        }
+        std::shared_ptr<google::protobuf::Message> msg = pool ? pool->acquire(*plan->prototype)
+                                                              : std::shared_ptr<google::protobuf::Message>(plan->prototype->New());
+        if (len < plan->message_size)
+        {
+            // a frame shorter than the DBC says (eg. a classic frame for an FD message), dont read past its payload
+            uint8_t padded[CANFD_MAX_DLEN] = {};
+            std::memcpy(padded, data, std::min<size_t>(len, CANFD_MAX_DLEN));
+            decode_into(*plan, padded, *msg);
+        }
+        else
+        {
+            decode_into(*plan, data, *msg);
+        }
+        return msg;
+    }
+
+    void CANMessageCodec::decode_into(const MessageDecodePlan &plan, const uint8_t *data, google::protobuf::Message &out)
+    {
+        if (plan.typed_decode)
+        {
+            plan.typed_decode(data, out);
+            return;
+        }
+
+        const google::protobuf::Reflection *reflection = out.GetReflection();
+        const uint64_t mux_value = plan.has_mux ? plan.mux_layout.extract(data) : 0;
+
+        for (const SignalDecodeStep &step : plan.steps)
+        {
+            if (step.is_muxed && (!plan.has_mux || mux_value != step.mux_switch_value))
+            {
+                continue;
+            }
+
+            const uint64_t raw = step.layout.extract(data);
+            // signals with a value table are stored as their raw value
+            const double value = step.use_raw_value
+                                     ? static_cast<double>(static_cast<int>(step.layout.to_integer(raw)))
+                                     : step.layout.raw_to_phys(raw);
+
+            switch (step.kind)
+            {
+            case FieldKind::Float:
+                reflection->SetFloat(&out, step.field, static_cast<float>(value));
+                break;
+            case FieldKind::Double:
+                reflection->SetDouble(&out, step.field, value);
+                break;
+            case FieldKind::Int32:
+                reflection->SetInt32(&out, step.field, static_cast<int32_t>(value));
+                break;
+            case FieldKind::Int64:
+                reflection->SetInt64(&out, step.field, static_cast<int64_t>(value));
+                break;
+            case FieldKind::UInt32:
+                reflection->SetUInt32(&out, step.field, static_cast<uint32_t>(value));
+                break;
+            case FieldKind::UInt64:
+                reflection->SetUInt64(&out, step.field, static_cast<uint64_t>(value));
+                break;
+            case FieldKind::Bool:
+                reflection->SetBool(&out, step.field, value != 0.0);
+                break;
+            case FieldKind::Enum:
+                reflection->SetEnumValue(&out, step.field, static_cast<int>(step.layout.to_integer(raw)));
+                break;
+            }
+        }
+    }
+
+    const CANMessageCodec::MessageEncodePlan *CANMessageCodec::find_encode_plan(const google::protobuf::Descriptor *descriptor) const
+    {
+        auto it = _encode_plans.find(descriptor);
+        return (it != _encode_plans.end()) ? &it->second : nullptr;
+    }
+
+    std::optional<canfd_frame> CANMessageCodec::encode(const google::protobuf::Message &msg) const
+    {
+        const MessageEncodePlan *plan = find_encode_plan(msg.GetDescriptor());
+        if (!plan)
+        {
+            return std::nullopt;
+        }
+        canfd_frame frame{};
+        frame.can_id = plan->can_id;
+        frame.len = plan->is_fd ? fd_frame_len(plan->message_size) : plan->message_size;
+        frame.flags = plan->is_fd ? CANFD_FDF : 0;
+        encode_into(*plan, msg, frame.data);
+        return frame;
+    }
+
+    static std::optional<uint64_t> raw_value_of(const CANMessageCodec::SignalEncodeStep &step, const google::protobuf::Message &msg,
+                                                const google::protobuf::Reflection *reflection)
+    {
+        using fk = CANMessageCodec::FieldKind;
+        switch (step.kind)
+        {
+        case fk::Float:
+            return step.layout.phys_to_raw(reflection->GetFloat(msg, step.field));
+        case fk::Double:
+            return step.layout.phys_to_raw(reflection->GetDouble(msg, step.field));
+        case fk::Int32:
+            return step.layout.phys_to_raw(static_cast<double>(reflection->GetInt32(msg, step.field)));
+        case fk::Int64:
+            return step.layout.phys_to_raw(static_cast<double>(reflection->GetInt64(msg, step.field)));
+        case fk::UInt32:
+            return step.layout.phys_to_raw(static_cast<double>(reflection->GetUInt32(msg, step.field)));
+        case fk::UInt64:
+            return step.layout.phys_to_raw(static_cast<double>(reflection->GetUInt64(msg, step.field)));
+        case fk::Bool:
+            return reflection->GetBool(msg, step.field) ? 1 : 0;
+        case fk::Enum:
+        {
+            const int number = reflection->GetEnumValue(msg, step.field);
+            auto it = std::lower_bound(step.enum_raw_values.begin(), step.enum_raw_values.end(), number,
+                                       [](const std::pair<int, uint64_t> &entry, int n) { return entry.first < n; });
+            if (it != step.enum_raw_values.end() && it->first == number)
+            {
+                return it->second;
+            }
+            // enum value has no matching value description in the DBC
+            return std::nullopt;
+        }
+        }
+        return std::nullopt;
+    }
+
+    void CANMessageCodec::encode_into(const MessageEncodePlan &plan, const google::protobuf::Message &msg, uint8_t *data)
+    {
+        if (plan.typed_encode)
+        {
+            plan.typed_encode(msg, data);
+            return;
+        }
+
+        const google::protobuf::Reflection *reflection = msg.GetReflection();
+
+        // the mux switch goes first so that only the muxed signals it selects get encoded
+        bool mux_known = false;
+        uint64_t mux_value = 0;
+        if (plan.mux_step >= 0)
+        {
+            const SignalEncodeStep &mux = plan.steps[plan.mux_step];
+            if (auto raw = raw_value_of(mux, msg, reflection))
+            {
+                mux_value = *raw & mux.layout.mask;
+                mux.layout.insert(data, mux_value);
+                mux_known = true;
+            }
+        }
+
+        for (size_t i = 0; i < plan.steps.size(); ++i)
+        {
+            const SignalEncodeStep &step = plan.steps[i];
+            if (static_cast<int>(i) == plan.mux_step)
+            {
+                continue;
+            }
+            if (step.is_muxed && (!mux_known || mux_value != step.mux_switch_value))
+            {
+                continue;
+            }
+            if (auto raw = raw_value_of(step, msg, reflection))
+            {
+                step.layout.insert(data, *raw);
+            }
+        }
+    }
+
+    namespace
+    {
+    // FNV-1a, only has to be stable between the generator and the library built from the same source
+    class Fingerprint
+    {
+    public:
+        template <typename T>
+        void add(const T &value)
+        {
+            // anything else could hash a pointer, which is not the same in the generator and the library
+            static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>, "only numbers are hashed by their bytes");
+            uint8_t bytes[sizeof(T)];
+            std::memcpy(bytes, &value, sizeof(T));
+            for (uint8_t byte : bytes)
+            {
+                _hash = (_hash ^ byte) * 0x100000001b3ULL;
+            }
+        }
+
+        // the characters, whatever string type the caller has
+        void add(std::string_view value)
+        {
+            add(value.size());
+            for (char c : value)
+            {
+                add(c);
+            }
+        }
+
+        void add(const CANSignalLayout &layout)
+        {
+            add(layout.mask);
+            add(layout.factor);
+            add(layout.offset);
+            add(layout.bit_size);
+            add(layout.first_byte);
+            add(layout.byte_count);
+            add(layout.shift);
+            add(layout.big_endian);
+            add(layout.is_signed);
+            add(layout.value_kind);
+        }
+
+        uint64_t value() const { return _hash; }
+
+    private:
+        uint64_t _hash = 0xcbf29ce484222325ULL;
+    };
+    }
+
+    uint64_t CANMessageCodec::fingerprint(const MessageDecodePlan &plan, const MessageEncodePlan &encode_plan)
+    {
+        Fingerprint fp;
+        fp.add(plan.can_id);
+        fp.add(plan.message_size);
+        // std::string or absl::string_view depending on the protobuf version
+        const auto &full_name = plan.descriptor->full_name();
+        fp.add(std::string_view(full_name.data(), full_name.size()));
+        fp.add(plan.has_mux);
+        if (plan.has_mux)
+        {
+            fp.add(plan.mux_layout);
+        }
+        fp.add(plan.steps.size());
+        for (const SignalDecodeStep &step : plan.steps)
+        {
+            fp.add(step.layout);
+            fp.add(step.field->number());
+            fp.add(step.kind);
+            fp.add(step.use_raw_value);
+            fp.add(step.is_muxed);
+            fp.add(step.mux_switch_value);
+        }
+        fp.add(encode_plan.mux_step);
+        fp.add(encode_plan.steps.size());
+        for (const SignalEncodeStep &step : encode_plan.steps)
+        {
+            fp.add(step.field->number());
+            fp.add(step.enum_raw_values.size());
+            for (const auto &[number, raw] : step.enum_raw_values)
+            {
+                fp.add(number);
+                fp.add(raw);
+            }
+        }
+        return fp.value();
+    }
+
+    size_t CANMessageCodec::use_generated(const GeneratedMessageCodec *codecs, size_t count)
+    {
+        size_t num_used = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const GeneratedMessageCodec &generated = codecs[i];
+            auto *plan = const_cast<MessageDecodePlan *>(find_decode_plan(generated.can_id));
+            if (!plan)
+            {
+                continue;
+            }
+            auto encode_it = _encode_plans.find(plan->descriptor);
+            // the generated functions cast straight to the generated message class, so the plan
+            // has to be for that exact descriptor and not just one with the same name
+            if (plan->descriptor != generated.descriptor() || encode_it == _encode_plans.end())
+            {
+                continue;
+            }
+            if (fingerprint(*plan, encode_it->second) != generated.fingerprint)
+            {
+                spdlog::warn("CAN message {} changed since the typed codec was generated, using the DBC plans for it", plan->descriptor->name());
+                continue;
+            }
+            plan->typed_decode = generated.decode;
+            encode_it->second.typed_encode = generated.encode;
+            num_used++;
+        }
+        return num_used;
+    }
+}
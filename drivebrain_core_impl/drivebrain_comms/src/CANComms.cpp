@@ -1,11 +1,14 @@
 // this
 #include <CANComms.hpp>
+#include <GeneratedCANCodec.hpp>
 
 // standard includes
 #include <cctype>
 #include <cerrno>
 #include <cstring>
 #include <iostream>
+#include <sstream>
+#include <unordered_map>
 // networking includes
 #include <fcntl.h>
 #include <filesystem>
@@ -19,15 +22,10 @@
 
 // https://docs.kernel.org/networking/can.html
 
-std::string comms::CANDriver::_to_lowercase(std::string s) {
-    std::transform(s.begin(), s.end(), s.begin(),
-                   [](unsigned char c) { return std::tolower(c); } // correct
-    );
-    return s;
-}
 comms::CANDriver::~CANDriver() {
-    _running = false;
-    _input_deque_ref.cv.notify_all();
+    if (_tx_reader) {
+        _tx_reader->stop();
+    }
     _output_thread.join();
 }
 bool comms::CANDriver::init() {
@@ -39,36 +37,83 @@ bool comms::CANDriver::init() {
     if (!(canbus_device && dbc_file_path)) {
         _logger.log_string("couldnt get params", core::LogLevel::ERROR);
         return false;
-    } else if (!std::filesystem::exists(*dbc_file_path)) {
-        std::string msg("params file does not exist! ");
-        msg += " ";
-        msg += (*dbc_file_path);
-        _logger.log_string(msg, core::LogLevel::ERROR);
+    }
+
+    // either one DBC shared by every bus or one per bus, in the same order as the devices
+    auto devices = _split_list(*canbus_device);
+    auto dbc_paths = _split_list(*dbc_file_path);
+    if (devices.empty() || dbc_paths.empty() || (dbc_paths.size() != 1 && dbc_paths.size() != devices.size())) {
+        _logger.log_string("path_to_dbc must be one DBC or one DBC per canbus_device", core::LogLevel::ERROR);
         return false;
     }
-    std::shared_ptr<dbcppp::INetwork> net;
-    {
-        std::ifstream idbc((*dbc_file_path).c_str());
-        net = dbcppp::INetwork::LoadDBCFromIs(idbc);
+
+    _batched_receive = get_parameter_value<bool>("batched_receive").value_or(false);
+    _kernel_rx_filter = get_parameter_value<bool>("kernel_rx_filter").value_or(false);
+    _can_fd = get_parameter_value<bool>("can_fd").value_or(false);
+    _rx_allow_list = _split_list(get_parameter_value<std::string>("rx_allow_list").value_or(""));
+
+    // "dbc" decodes / encodes through the plans built from the DBC at runtime, "generated" uses the
+    // typed functions generated from config/hytech.dbc at build time for every message that still matches
+    auto codec_backend = get_parameter_value<std::string>("codec_backend").value_or("dbc");
+    if (codec_backend != "dbc" && codec_backend != "generated") {
+        _logger.log_string("unknown codec_backend " + codec_backend + ", using dbc", core::LogLevel::WARNING);
     }
 
-    for (const auto &msg : net->Messages()) {
-        _messages.insert(std::make_pair(msg.Id(), msg.Clone()));
-        _messages_names_and_ids.insert(std::make_pair(_to_lowercase(msg.Name()), msg.Id()));
+    // each DBC is only parsed and compiled once no matter how many buses use it
+    std::unordered_map<std::string, std::shared_ptr<const CANMessageCodec>> codecs;
+    for (const auto &path : dbc_paths) {
+        if (codecs.count(path) != 0) {
+            continue;
+        }
+        if (!std::filesystem::exists(path)) {
+            std::string msg("params file does not exist! ");
+            msg += " ";
+            msg += path;
+            _logger.log_string(msg, core::LogLevel::ERROR);
+            return false;
+        }
+        std::shared_ptr<dbcppp::INetwork> net;
+        {
+            std::ifstream idbc(path.c_str());
+            net = dbcppp::INetwork::LoadDBCFromIs(idbc);
+        }
+        auto codec = std::make_shared<CANMessageCodec>();
+        if (!net || !codec->build(*net)) {
+            _logger.log_string("no CAN messages in " + path + " could be matched to protobuf messages", core::LogLevel::ERROR);
+            return false;
+        }
+        if (codec_backend == "generated") {
+            auto num_generated = codec->use_generated(generated::message_codecs, generated::num_message_codecs);
+            spdlog::info("{} of {} CAN messages in {} use the generated codec", num_generated, codec->decode_plans().size(), path);
+        }
+        codecs[path] = std::move(codec);
     }
 
-    if (!_open_socket(*canbus_device)) {
-        _logger.log_string("couldnt open socket", core::LogLevel::ERROR);
-        return false;
+    for (size_t i = 0; i < devices.size(); i++) {
+        auto bus = std::make_unique<CANBus>(_io_context);
+        bus->index = i;
+        bus->device = devices[i];
+        bus->codec = codecs.at(dbc_paths.size() == 1 ? dbc_paths.front() : dbc_paths[i]);
+        if (!_open_socket(*bus)) {
+            _logger.log_string("couldnt open socket for " + bus->device, core::LogLevel::ERROR);
+            return false;
+        }
+        _buses.push_back(std::move(bus));
     }
 
     _logger.log_string("inited, started read", core::LogLevel::INFO);
 
-    _do_read();
+    for (auto &bus : _buses) {
+        if (_batched_receive) {
+            _do_batched_read(*bus);
+        } else {
+            _do_read(*bus);
+        }
+    }
     return true;
 }
 
-bool comms::CANDriver::_open_socket(const std::string &interface_name) {
+bool comms::CANDriver::_open_socket(CANBus &bus) {
     int raw_socket = ::socket(PF_CAN, SOCK_RAW, CAN_RAW);
     if (raw_socket < 0) {
         auto err_str = std::string("Error creating CAN socket: ") + std::string(strerror(errno));
@@ -77,10 +122,40 @@ bool comms::CANDriver::_open_socket(const std::string &interface_name) {
         return false;
     }
 
-    struct ifreq ifr;
-    std::strcpy(ifr.ifr_name, interface_name.c_str());
+    struct ifreq ifr = {};
+    std::strncpy(ifr.ifr_name, bus.device.c_str(), IFNAMSIZ - 1);
+    ifr.ifr_name[IFNAMSIZ - 1] = '\0';
     ioctl(raw_socket, SIOCGIFINDEX, &ifr);
 
+    if (_can_fd) {
+        int enable = 1;
+        if (::setsockopt(raw_socket, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &enable, sizeof(enable)) < 0) {
+            auto err_str = std::string("Error enabling CAN FD frames: ") + std::string(strerror(errno));
+            _logger.log_string(err_str.c_str(), core::LogLevel::ERROR);
+
+            ::close(raw_socket);
+            return false;
+        }
+        // the socket option works on any interface, the interface MTU is what says if it can carry FD frames
+        struct ifreq mtu_ifr = ifr; // ifr_mtu shares storage with ifr_ifindex
+        if (ioctl(raw_socket, SIOCGIFMTU, &mtu_ifr) == 0 && mtu_ifr.ifr_mtu != CANFD_MTU) {
+            _logger.log_string(bus.device + " is not CAN FD capable (MTU is not CANFD_MTU), FD frames will fail to send", core::LogLevel::WARNING);
+        }
+    }
+
+    // filters go on before bind so that nothing unfiltered gets queued in between
+    if (_kernel_rx_filter) {
+        auto filters = bus.codec->make_rx_filters(_rx_allow_list);
+        if (filters.empty() || filters.size() > CAN_RAW_FILTER_MAX) {
+            _logger.log_string("CAN receive filter would be empty or too large, receiving every frame", core::LogLevel::WARNING);
+        } else if (::setsockopt(raw_socket, SOL_CAN_RAW, CAN_RAW_FILTER, filters.data(), filters.size() * sizeof(struct can_filter)) < 0) {
+            auto err_str = std::string("couldnt set CAN receive filter, receiving every frame: ") + std::string(strerror(errno));
+            _logger.log_string(err_str.c_str(), core::LogLevel::WARNING);
+        } else {
+            spdlog::info("installed {} CAN receive filters on {}", filters.size(), bus.device);
+        }
+    }
+
     struct sockaddr_can addr;
     addr.can_family = AF_CAN;
     addr.can_ifindex = ifr.ifr_ifindex;
@@ -93,318 +168,266 @@ bool comms::CANDriver::_open_socket(const std::string &interface_name) {
         return false;
     }
 
-    _socket.assign(raw_socket); // Assign the native socket to Boost.Asio descriptor
+    // the kernel receive times are the frames' acquisition times. the batched reads get them with
+    // every frame, the single frame reads with SIOCGSTAMPNS after the read
+    if (!(_batched_receive ? util::enable_rx_timestamps(raw_socket) : util::enable_last_rx_time(raw_socket))) {
+        auto err_str = std::string("couldnt enable CAN receive timestamps, using read time: ") + std::string(strerror(errno));
+        _logger.log_string(err_str.c_str(), core::LogLevel::WARNING);
+    }
+
+    if (_batched_receive) {
+        for (size_t i = 0; i < _rx_batch_size; i++) {
+            bus.rx_iovecs[i].iov_base = &bus.rx_frames[i];
+            bus.rx_iovecs[i].iov_len = sizeof(struct canfd_frame);
+            bus.rx_msgs[i] = {};
+            bus.rx_msgs[i].msg_hdr.msg_iov = &bus.rx_iovecs[i];
+            bus.rx_msgs[i].msg_hdr.msg_iovlen = 1;
+            bus.rx_msgs[i].msg_hdr.msg_control = bus.rx_cmsg_bufs[i].data;
+            bus.rx_msgs[i].msg_hdr.msg_controllen = util::rx_timestamp_cmsg_size;
+        }
+    }
+
+    bus.socket.assign(raw_socket); // Assign the native socket to Boost.Asio descriptor
     return true;
 }
 
-void comms::CANDriver::_do_read() {
-    boost::asio::async_read(_socket, boost::asio::buffer(&_frame, sizeof(_frame)),
-                            [this](boost::system::error_code ec, std::size_t bytes_transferred) {
-                                if (!ec && bytes_transferred == sizeof(_frame)) {
-                                    _handle_recv_CAN_frame(_frame);
-                                    _do_read(); // Continue reading for the next frame
+void comms::CANDriver::_do_read(CANBus &bus) {
+    // each read of a raw CAN socket returns exactly one frame, CAN_MTU or CANFD_MTU bytes long
+    bus.socket.async_read_some(boost::asio::buffer(&bus.frame, sizeof(bus.frame)),
+                            [this, &bus](boost::system::error_code ec, std::size_t bytes_transferred) {
+                                if (!ec && (bytes_transferred == CAN_MTU || bytes_transferred == CANFD_MTU)) {
+                                    _rx_wakeup_count.fetch_add(1, std::memory_order_relaxed);
+                                    auto kernel_time = util::last_kernel_rx_time(bus.socket.native_handle());
+                                    if (kernel_time) {
+                                        _rx_stamped_count.fetch_add(1, std::memory_order_relaxed);
+                                    }
+                                    _handle_recv_CAN_frame(bus, bus.frame, kernel_time.value_or(util::system_now_us()));
+                                    _do_read(bus); // Continue reading for the next frame
                                 } else if (ec) {
-                                    spdlog::error("Error receiving CAN message: {}", ec.message());
+                                    spdlog::error("Error receiving CAN message on {}: {}", bus.device, ec.message());
                                 }
                             });
 }
 
-void comms::CANDriver::_send_message(const struct can_frame &frame) {
-    boost::asio::async_write(
-        _socket, boost::asio::buffer(&frame, sizeof(frame)),
-        [this](boost::system::error_code ec, std::size_t /*bytes_transferred*/) {
-            if (ec) {
-                spdlog::error("Error sending CAN message: {}", ec.message());
-            }
-        });
+void comms::CANDriver::_do_batched_read(CANBus &bus) {
+    bus.socket.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+                       [this, &bus](boost::system::error_code ec) {
+                           if (!ec) {
+                               _read_batch(bus);
+                               _do_batched_read(bus);
+                           } else if (ec != boost::asio::error::operation_aborted) {
+                               spdlog::error("Error waiting on CAN socket {}: {}", bus.device, ec.message());
+                           }
+                       });
 }
 
-void comms::CANDriver::_handle_recv_CAN_frame(const struct can_frame &frame) {
-    auto msg = pb_msg_recv(frame);
-    if (msg) {
-        _state_estimator.handle_recv_process(msg);
-        _message_logger->log_msg(msg);
+void comms::CANDriver::_read_batch(CANBus &bus) {
+    // the kernel overwrites the control lengths with what it actually wrote
+    for (auto &msg : bus.rx_msgs) {
+        msg.msg_hdr.msg_controllen = util::rx_timestamp_cmsg_size;
+        msg.msg_hdr.msg_flags = 0;
     }
-}
 
-// gets a protobuf message from just the name of it
-std::shared_ptr<google::protobuf::Message>
-comms::CANDriver::_get_pb_msg_by_name(const std::string &name) {
-    // Create a dynamic message factory
-    std::shared_ptr<google::protobuf::Message> prototype_message;
-
-    const google::protobuf::Descriptor *desc = google::protobuf::DescriptorPool::generated_pool()->FindMessageTypeByName("hytech." + name);
-    if (!desc) {
-        spdlog::error("Prototype message does not exist in descriptor pool");
-        return nullptr;
+    // one call per wakeup: if more than a batch is queued the socket is still readable and
+    // the next async_wait completes straight away, without starving the other handlers on the io_context
+    int num_frames = ::recvmmsg(bus.socket.native_handle(), bus.rx_msgs.data(), _rx_batch_size, MSG_DONTWAIT, nullptr);
+    if (num_frames < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            spdlog::error("Error receiving CAN messages on {}: {}", bus.device, strerror(errno));
+        }
+        return;
     }
-    prototype_message.reset(google::protobuf::MessageFactory::generated_factory()->GetPrototype(desc)->New());
-    if (!prototype_message)
-    {
-        spdlog::error("Failed to create prototype message");
-        return nullptr;
+    if (num_frames == 0) {
+        return;
+    }
+    _rx_wakeup_count.fetch_add(1, std::memory_order_relaxed);
+
+    auto read_time = util::system_now_us();
+    for (int i = 0; i < num_frames; i++) {
+        if (bus.rx_msgs[i].msg_len != CAN_MTU && bus.rx_msgs[i].msg_len != CANFD_MTU) {
+            continue;
+        }
+        auto kernel_time = util::kernel_rx_time(bus.rx_msgs[i].msg_hdr);
+        if (kernel_time) {
+            _rx_stamped_count.fetch_add(1, std::memory_order_relaxed);
+        }
+        _handle_recv_CAN_frame(bus, bus.rx_frames[i], kernel_time.value_or(read_time));
     }
-    return prototype_message;
 }
 
-// Function to set fields dynamically using reflection
-void comms::CANDriver::set_field_values_of_pb_msg(
-    const std::unordered_map<std::string, comms::CANDriver::FieldVariant> &field_values,
-    std::shared_ptr<google::protobuf::Message> message) {
-    const google::protobuf::Descriptor *descriptor = message->GetDescriptor();
-    const google::protobuf::Reflection *reflection = message->GetReflection();
-
-    for (int i = 0; i < descriptor->field_count(); ++i) {
-        const google::protobuf::FieldDescriptor *field = descriptor->field(i);
-
-        // Get the field name and check if it exists in the provided field_values
-        // map
-        std::string field_name = field->name();
-        auto it = field_values.find(field_name);
-
-        if (it != field_values.end()) {
-            // Set field values based on field type
-            if (field->is_repeated()) {
-                spdlog::warn("Unsupported field type for field: {}", field_name);
-                continue;
-            }
-            
-            switch (field->type()) 
-            {
-            case google::protobuf::FieldDescriptor::TYPE_ENUM:
-                
-                reflection->SetEnumValue(message.get(), field, (int)std::get<int32_t>(it->second));
-                
-                break;
-            case google::protobuf::FieldDescriptor::TYPE_FLOAT:
-                
-                if (std::holds_alternative<double>(it->second))
-                {
-                    reflection->SetFloat(message.get(), field, (float)std::get<double>(it->second));    
-                    
-                } else if (std::holds_alternative<int32_t>(it->second))
-                {
-                    reflection->SetFloat(message.get(), field, (float)std::get<int32_t>(it->second));    
-                    
-                } else {
-                    spdlog::warn("unable to parse float for field name {}. unknown field variant type", field_name);
-                }
-                break;
-            case google::protobuf::FieldDescriptor::TYPE_BOOL:
-                
-                if (std::holds_alternative<double>(it->second))
-                {
-                    reflection->SetBool(message.get(), field, (bool)std::get<double>(it->second));    
-                    
-                } else if (std::holds_alternative<int32_t>(it->second))
-                {
-                    reflection->SetBool(message.get(), field, (bool)std::get<int32_t>(it->second));    
-                    
-                } else {
-                    spdlog::warn("unable to parse bool for field name {}. unknown field variant type", field_name);
-                }
-                
-                
-                break;
-            case google::protobuf::FieldDescriptor::TYPE_DOUBLE:
-                
-                reflection->SetDouble(message.get(), field, std::get<double>(it->second));
-                
-                break;
-            case google::protobuf::FieldDescriptor::TYPE_INT32:
-                
-                reflection->SetInt32(message.get(), field, (int32_t)std::get<double>(it->second));
-                
-                break;
-            default:
-                break;
-            }
+comms::CANDriver::RxStats comms::CANDriver::get_rx_stats() const {
+    return {_rx_frame_count.load(std::memory_order_relaxed),
+            _rx_wakeup_count.load(std::memory_order_relaxed),
+            _rx_stamped_count.load(std::memory_order_relaxed)};
+}
+
+std::vector<std::string> comms::CANDriver::_split_list(const std::string &list) {
+    std::vector<std::string> entries;
+    std::string entry;
+    std::istringstream stream(list);
+    while (std::getline(stream, entry, ',')) {
+        auto first = entry.find_first_not_of(" \t");
+        if (first == std::string::npos) {
+            continue;
         }
+        auto last = entry.find_last_not_of(" \t");
+        entries.push_back(entry.substr(first, last - first + 1));
     }
+    return entries;
+}
+
+comms::CANDriver::TxStats comms::CANDriver::get_tx_stats() const {
+    return {_tx_sent_count.load(std::memory_order_relaxed),
+            _tx_dropped_count.load(std::memory_order_relaxed),
+            _tx_coalesced_count.load(std::memory_order_relaxed),
+            _tx_enobufs_count.load(std::memory_order_relaxed),
+            _tx_flush_count.load(std::memory_order_relaxed),
+            _tx_reader ? _tx_reader->depth() : 0,
+            _tx_reader ? _tx_reader->dropped() : 0};
 }
 
-std::shared_ptr<google::protobuf::Message> comms::CANDriver::pb_msg_recv(const can_frame &frame) {
-    auto iter = _messages.find(frame.can_id);
-    if (iter != _messages.end())
-    {
-        auto msg = iter->second->Clone();
-        auto msg_to_populate = _get_pb_msg_by_name(_to_lowercase(msg->Name()));
-        if (!msg_to_populate) {
-            return nullptr;
+void comms::CANDriver::_queue_tx_frame(CANBus &bus, const struct canfd_frame &frame, std::shared_ptr<google::protobuf::Message> msg) {
+    // batches are a handful of frames per control cycle so a linear search is cheapest. only the
+    // newest command for a CAN ID is worth putting on the bus if the output thread fell behind
+    for (size_t i = 0; i < bus.tx_frames.size(); i++) {
+        if (bus.tx_frames[i].can_id == frame.can_id) {
+            bus.tx_frames[i] = frame;
+            bus.tx_frame_msgs[i] = std::move(msg);
+            _tx_coalesced_count.fetch_add(1, std::memory_order_relaxed);
+            return;
         }
+    }
+    bus.tx_frames.push_back(frame);
+    bus.tx_frame_msgs.push_back(std::move(msg));
+}
 
-        std::unordered_map<std::string, comms::CANDriver::FieldVariant> msg_field_map;
-        for (const dbcppp::ISignal &sig : msg->Signals()) {
-            const dbcppp::ISignal *mux_sig = msg->MuxSignal();
+size_t comms::CANDriver::_flush_tx_frames(CANBus &bus) {
+    const size_t num_frames = bus.tx_frames.size();
+    if (num_frames == 0) {
+        return 0;
+    }
 
-            if (sig.MultiplexerIndicator() != dbcppp::ISignal::EMultiplexer::MuxValue ||
-                (mux_sig && mux_sig->Decode(frame.data) == sig.MultiplexerSwitchValue()))
-            {
-                auto raw_value = sig.Decode(frame.data);
-
-                // Check if the signal has enum descriptions (ValueEncodingDescriptions)
-                if (sig.ValueEncodingDescriptions_Size() > 1)
-                {
-                    // Enum signal: Cast the decoded raw value to an integer and store it
-                    msg_field_map[sig.Name()] = static_cast<int>(raw_value);
-                }
-                else {
-                    // TODO get correct type from raw signal and store it in the map. right now they are all doubles
-                    msg_field_map[sig.Name()] = sig.RawToPhys(raw_value);
-                }
+    // the frame vector may have reallocated since the last flush so the headers get re-pointed every time
+    bus.tx_iovecs.resize(num_frames);
+    bus.tx_msgs.resize(num_frames);
+    for (size_t i = 0; i < num_frames; i++) {
+        bus.tx_iovecs[i].iov_base = &bus.tx_frames[i];
+        bus.tx_iovecs[i].iov_len = (bus.tx_frames[i].flags & CANFD_FDF) ? CANFD_MTU : CAN_MTU;
+        bus.tx_msgs[i] = {};
+        bus.tx_msgs[i].msg_hdr.msg_iov = &bus.tx_iovecs[i];
+        bus.tx_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
 
+    size_t sent = 0;
+    int retries = 0;
+    while (sent < num_frames) {
+        int res = ::sendmmsg(bus.socket.native_handle(), bus.tx_msgs.data() + sent, static_cast<unsigned int>(num_frames - sent), MSG_DONTWAIT);
+        if (res > 0) {
+            sent += static_cast<size_t>(res);
+            continue;
+        }
+
+        if (errno == EINTR) {
+            continue;
+        } else if (errno == ENOBUFS || errno == EAGAIN || errno == EWOULDBLOCK) {
+            // the interface tx queue is full, give the controller a moment to drain it
+            _tx_enobufs_count.fetch_add(1, std::memory_order_relaxed);
+            if (retries++ < _tx_max_retries) {
+                std::this_thread::sleep_for(_tx_retry_backoff);
+                continue;
             }
-        } 
-        set_field_values_of_pb_msg(msg_field_map, msg_to_populate);
-        return msg_to_populate;
+        } else {
+            spdlog::error("Error sending CAN messages on {}: {}", bus.device, strerror(errno));
+        }
+        break;
     }
 
-    return nullptr;
+    _tx_flush_count.fetch_add(1, std::memory_order_relaxed);
+    _tx_sent_count.fetch_add(sent, std::memory_order_relaxed);
+    _tx_dropped_count.fetch_add(num_frames - sent, std::memory_order_relaxed);
+    return sent;
 }
 
-comms::CANDriver::FieldVariant
-comms::CANDriver::get_field_value(std::shared_ptr<google::protobuf::Message> message,
-                                  const std::string &field_name) {
-    if (!message) {
-        spdlog::error("Message is null");
-        return std::monostate{};
+void comms::CANDriver::_handle_recv_CAN_frame(const CANBus &bus, const struct canfd_frame &frame, std::chrono::microseconds rx_time) {
+    _rx_frame_count.fetch_add(1, std::memory_order_relaxed);
+    auto msg = bus.codec->decode(frame.can_id, frame.data, frame.len, &_rx_pool);
+    if (msg) {
+        _state_estimator.handle_recv_process(msg, rx_time);
+        util::AcquisitionTime acquired(rx_time);
+        _message_logger->log_msg(msg);
     }
+}
 
-    const google::protobuf::Descriptor *descriptor = message->GetDescriptor();
-    const google::protobuf::Reflection *reflection = message->GetReflection();
-    const google::protobuf::FieldDescriptor *field = descriptor->FindFieldByName(field_name);
-
-    if (field == nullptr) {
-        spdlog::warn("Field not found: {}", field_name);
-        return std::monostate{};
+std::shared_ptr<google::protobuf::Message> comms::CANDriver::pb_msg_recv(const can_frame &frame, size_t bus) {
+    if (bus >= _buses.size()) {
+        return nullptr;
     }
+    return _buses[bus]->codec->decode(frame.can_id, frame.data, frame.len);
+}
 
-    // Retrieve the value based on the field type
-    switch (field->cpp_type()) {
-    case google::protobuf::FieldDescriptor::CPPTYPE_INT32:
-        return reflection->GetInt32(*message, field);
-    case google::protobuf::FieldDescriptor::CPPTYPE_INT64:
-        return reflection->GetInt64(*message, field);
-    case google::protobuf::FieldDescriptor::CPPTYPE_UINT32:
-        return reflection->GetUInt32(*message, field);
-    case google::protobuf::FieldDescriptor::CPPTYPE_UINT64:
-        return reflection->GetUInt64(*message, field);
-    case google::protobuf::FieldDescriptor::CPPTYPE_DOUBLE:
-        return reflection->GetDouble(*message, field);
-    case google::protobuf::FieldDescriptor::CPPTYPE_FLOAT:
-        return reflection->GetFloat(*message, field);
-    case google::protobuf::FieldDescriptor::CPPTYPE_BOOL:
-        return reflection->GetBool(*message, field);
-    case google::protobuf::FieldDescriptor::CPPTYPE_STRING:
-        return reflection->GetString(*message, field);
-    case google::protobuf::FieldDescriptor::CPPTYPE_ENUM:
-        return reflection->GetEnum(*message, field)->name();
-    case google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE:
-        spdlog::warn("Nested messages not supported");
-        return std::monostate{};
-    default:
-        spdlog::warn("Unsupported field type");
-        return std::monostate{};
+std::shared_ptr<google::protobuf::Message> comms::CANDriver::pb_msg_recv(const canfd_frame &frame, size_t bus) {
+    if (bus >= _buses.size()) {
+        return nullptr;
     }
+    return _buses[bus]->codec->decode(frame.can_id, frame.data, frame.len);
 }
 
-std::optional<can_frame>
-comms::CANDriver::_get_CAN_msg(std::shared_ptr<google::protobuf::Message> pb_msg) {
-    // - [x] get an associated CAN message based on the name of the input message
-    can_frame frame{};
-    std::string type_url = pb_msg->GetTypeName();
-    std::string messageTypeName = type_url.substr(type_url.find_last_of('.') + 1);
-
-    if (_messages_names_and_ids.find(messageTypeName) != _messages_names_and_ids.end())
-    {
-        auto id = _messages_names_and_ids[messageTypeName];
-        auto msg = _messages[id]->Clone();
-        frame.can_id = id;
-        frame.len = msg->MessageSize();
-        for (const auto &sig : msg->Signals())
-        {
-            auto field_value = get_field_value(pb_msg, sig.Name());
-
-            std::visit([&sig, &frame](const FieldVariant &arg)
-                       {
-            if (std::holds_alternative<std::monostate>(arg)) {
-                spdlog::info("No value found or unsupported field");
-            } else if (std::holds_alternative<float>(arg)){
-                auto val = std::get<float>(arg);
-                sig.Encode(sig.PhysToRaw(val), frame.data);
-            } else if(std::holds_alternative<int32_t>(arg)){
-                auto val = std::get<int32_t>(arg);
-                sig.Encode(sig.PhysToRaw(val), frame.data);
-            } else if(std::holds_alternative<int64_t>(arg)){
-                auto val = std::get<int64_t>(arg);
-                sig.Encode(sig.PhysToRaw(val), frame.data);
-            } else if(std::holds_alternative<uint64_t>(arg)){
-                auto val = std::get<uint64_t>(arg);
-                sig.Encode(sig.PhysToRaw(val), frame.data);
-            } else if(std::holds_alternative<bool>(arg)){
-                auto val = std::get<bool>(arg);
-                sig.Encode(val, frame.data);
-            
-            } else if (std::holds_alternative<std::string>(arg)){
-                auto enum_name = std::get<std::string>(arg);
-                bool found = false;
-
-                // iterating to find correct value
-                for (const auto &enc : sig.ValueEncodingDescriptions())
-                {
-                    if (enc.Description() == enum_name)
-                    {
-                        sig.Encode(enc.Value(), frame.data);
-                        found = true;
-                        break;
-                    }
-                }
-
-                if (!found)
-                {
-                    spdlog::info("enum not found");
-                }
-            } else {
-                spdlog::info("uh not supported yet");
-            } },
-                       field_value);
+std::optional<canfd_frame>
+comms::CANDriver::_get_CAN_msg(std::shared_ptr<google::protobuf::Message> pb_msg, size_t *bus_index) {
+    // a message goes out on the first bus whose DBC has it. buses sharing a DBC all have it,
+    // so list the bus that should carry the shared messages first in canbus_device
+    std::optional<canfd_frame> frame;
+    for (const auto &bus : _buses) {
+        if (bus->codec->find_encode_plan(pb_msg->GetDescriptor()) != nullptr) {
+            frame = bus->codec->encode(*pb_msg);
+            if (bus_index) {
+                *bus_index = bus->index;
+            }
+            break;
         }
-    } else {
+    }
+    if (!frame) {
         spdlog::warn("WARNING: not creating a frame to send due to not finding frame name");
+    } else if ((frame->flags & CANFD_FDF) && !_can_fd) {
+        spdlog::warn("WARNING: not sending {}, it is a CAN FD message and can_fd is not enabled", pb_msg->GetTypeName());
         return std::nullopt;
     }
-
     return frame;
 }
 
 void comms::CANDriver::_handle_send_msg_from_queue() {
-    // we will assume that this queue only has messages that we want to send
-    core::common::ThreadSafeDeque<std::shared_ptr<google::protobuf::Message>> q;
-    while (_running) {
+    // we will assume that this bus only has messages that we want to send
+    if (!_tx_reader) {
+        return;
+    }
+    std::shared_ptr<google::protobuf::Message> msg;
+    while (_tx_reader->read(msg)) {
+        for (auto &bus : _buses)
         {
-            std::unique_lock lk(_input_deque_ref.mtx);
-            // TODO unfuck this, queue management shouldnt live within the queue
-            // itself
-            _input_deque_ref.cv.wait(
-                lk, [this]() { return !_input_deque_ref.deque.empty() || !_running; });
-
-            if (_input_deque_ref.deque.empty()) {
-                return;
-            }
-
-            q.deque = _input_deque_ref.deque;
-            _input_deque_ref.deque.clear();
+            bus->tx_frames.clear();
+            bus->tx_frame_msgs.clear();
         }
-
-        for (const auto &msg : q.deque)
+        // everything published since the last wakeup, normally the frames of one control cycle
+        do
         {
-            auto can_msg = _get_CAN_msg(msg);
+            size_t bus_index = 0;
+            auto can_msg = _get_CAN_msg(msg, &bus_index);
             if (can_msg)
             {
-                _send_message(*can_msg);
-                _message_logger->log_msg(msg);
+                _queue_tx_frame(*_buses[bus_index], *can_msg, std::move(msg));
             }
+        } while (_tx_reader->try_read(msg));
+        msg.reset();
+
+        // one sendmmsg per bus for everything that was queued since the last wakeup (normally one control cycle)
+        for (auto &bus : _buses)
+        {
+            auto num_sent = _flush_tx_frames(*bus);
+            for (size_t i = 0; i < num_sent; i++)
+            {
+                _message_logger->log_msg(bus->tx_frame_msgs[i]);
+            }
+            bus->tx_frame_msgs.clear();
         }
-        q.deque.clear();
     }
-}
\ No newline at end of file
+}
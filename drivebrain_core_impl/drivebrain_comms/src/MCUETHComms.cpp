@@ -1,29 +1,35 @@
 #include <MCUETHComms.hpp>
+#include <AcquisitionTime.hpp>
 #include "hytech_msgs.pb.h"
 #include <spdlog/spdlog.h>
 
+#include <cstring>
+
 
 using boost::asio::ip::udp;
 namespace comms
 {
     MCUETHComms::MCUETHComms(core::Logger &logger,
-                             deqtype &in_deq,
+                             bustype &in_bus,
                              std::shared_ptr<loggertype> message_logger,
                              core::StateEstimator &state_estimator,
                              boost::asio::io_context &io_context,
                              const std::string &send_ip,
                              uint16_t recv_port,
                              uint16_t send_port) : _logger(logger),
-                                                   _input_deque_ref(in_deq),
+                                                   _tx_reader(in_bus.subscribe()),
                                                    _message_logger(message_logger),
                                                    _socket(io_context, udp::endpoint(udp::v4(), recv_port)),
                                                    _state_estimator(state_estimator),
                                                    _send_port(send_port),
                                                    _send_ip(send_ip)
     {
-        _mcu_msg = std::make_shared<hytech_msgs::MCUOutputData>();
+        // the kernel receive time of a packet is its acquisition time, read with SIOCGSTAMPNS after the packet
+        if (!util::enable_last_rx_time(_socket.native_handle()))
+        {
+            spdlog::warn("couldnt enable MCU ETH receive timestamps, using read time: {}", strerror(errno));
+        }
         _logger.log_string("starting out thread", core::LogLevel::INFO);
-        _running = true;
         _output_thread = std::thread(&MCUETHComms::_handle_send_msg_from_queue, this);
         _logger.log_string("starting eth comms recv", core::LogLevel::INFO);
         _start_receive();
@@ -31,34 +37,27 @@ namespace comms
     }
     MCUETHComms::~MCUETHComms()
     {
-        _running = false;
-        _input_deque_ref.cv.notify_all();
+        if (_tx_reader)
+        {
+            _tx_reader->stop();
+        }
         _output_thread.join();
         spdlog::warn("destructed MCU ETH COMMS");
     }
 
     void MCUETHComms::_handle_send_msg_from_queue()
     {
-        // we will assume that this queue only has messages that we want to send
-        while (_running)
+        if (!_tx_reader)
         {
-            {
-                std::unique_lock lk(_input_deque_ref.mtx);
-                // TODO unfuck this, queue management shouldnt live within the queue itself
-                _input_deque_ref.cv.wait(lk, [this]()
-                                         { return !_input_deque_ref.deque.empty() || !_running; });
-
-                if (_input_deque_ref.deque.empty())
-                {
-                    return;
-                }
-                for (const auto &msg : _input_deque_ref.deque)
-                {
-                    _send_message(msg);
-                    _message_logger->log_msg(msg);
-                }
-                _input_deque_ref.deque.clear();
-            }
+            _logger.log_string("no reader left on the eth tx bus, not sending", core::LogLevel::ERROR);
+            return;
+        }
+        // we will assume that this bus only has messages that we want to send
+        std::shared_ptr<google::protobuf::Message> msg;
+        while (_tx_reader->read(msg))
+        {
+            _send_message(msg);
+            _message_logger->log_msg(msg);
         }
     }
     void MCUETHComms::_send_message(std::shared_ptr<google::protobuf::Message> msg_out)
@@ -78,10 +77,15 @@ namespace comms
 
         if (!error)
         {
-            _mcu_msg->ParseFromArray(_recv_buffer.data(), size);
-            auto out_msg = static_cast<std::shared_ptr<google::protobuf::Message>>(_mcu_msg);
-            _state_estimator.handle_recv_process(out_msg);
-            _message_logger->log_msg(out_msg);
+            const auto rx_time = util::last_kernel_rx_time(_socket.native_handle()).value_or(util::system_now_us());
+            auto mcu_msg = _msg_pool.acquire<hytech_msgs::MCUOutputData>();
+            mcu_msg->ParseFromArray(_recv_buffer.data(), size);
+            auto out_msg = static_cast<std::shared_ptr<google::protobuf::Message>>(mcu_msg);
+            _state_estimator.handle_recv_process(out_msg, rx_time);
+            {
+                util::AcquisitionTime acquired(rx_time);
+                _message_logger->log_msg(out_msg);
+            }
             _start_receive();
         }
     }
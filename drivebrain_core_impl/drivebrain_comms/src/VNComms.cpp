@@ -70,9 +70,10 @@ namespace comms
         _start_recieve();
     }
 
-    void VNDriver::log_proto_message(std::shared_ptr<google::protobuf::Message> msg)
+    void VNDriver::log_proto_message(std::shared_ptr<google::protobuf::Message> msg, std::chrono::microseconds acquired_at)
     {
-        _state_estimator.handle_recv_process(static_cast<std::shared_ptr<google::protobuf::Message>>(msg));
+        _state_estimator.handle_recv_process(static_cast<std::shared_ptr<google::protobuf::Message>>(msg), acquired_at);
+        util::AcquisitionTime acquired(acquired_at);
         _message_logger->log_msg(static_cast<std::shared_ptr<google::protobuf::Message>>(msg));
     }
 
@@ -137,7 +138,7 @@ namespace comms
             auto vel_body = packet.extractVec3f();
 
             // Create the protobuf message to send
-            std::shared_ptr<hytech_msgs::VNData> msg_out = std::make_shared<hytech_msgs::VNData>();
+            std::shared_ptr<hytech_msgs::VNData> msg_out = this_instance->_msg_pool.acquire<hytech_msgs::VNData>();
 
             hytech_msgs::xyz_vector *linear_vel_msg = msg_out->mutable_vn_vel_m_s();
             linear_vel_msg->set_x(vel_body.x);
@@ -177,7 +178,9 @@ namespace comms
             vn_ins_msg->set_gnss_heading_ins((ins_status >> 8) & 0b1); 
             vn_ins_msg->set_gnss_compass((ins_status >> 9) & 0b1); 
 
-            this_instance->log_proto_message(static_cast<std::shared_ptr<google::protobuf::Message>>(msg_out));
+            // ts is when the serial read that the packet finished in completed, see _start_recieve
+            const auto acquired_at = std::chrono::seconds(ts._sec) + std::chrono::microseconds(ts._usec);
+            this_instance->log_proto_message(static_cast<std::shared_ptr<google::protobuf::Message>>(msg_out), acquired_at);
         }
         else
         {
@@ -200,7 +203,10 @@ namespace comms
                     return;
                 }
                 // _logger.log_string("logging", core::LogLevel::INFO);
-                _processor.processReceivedData((char *)(_input_buff.data()), bytesCount);
+                // serial has no kernel timestamps, the earliest time for the packets in this read is now.
+                // the packet finder hands it to _handle_recieve with every packet that it completes
+                const TimeStamp read_time = TimeStamp::get();
+                _processor.processReceivedData((char *)(_input_buff.data()), bytesCount, false, read_time);
                 // Initiate another asynchronous read
                 _start_recieve();
             });
@@ -1,6 +1,10 @@
 #include <foxglove_server.hpp>
 #include <variant>
 #include <hytech_msgs.pb.h>
+#include <db_service/v1/logger/logger_diagnostics.pb.h>
+#include <db_service/v1/estimation/input_staleness.pb.h>
+#include <db_service/v1/estimation/input_latency.pb.h>
+#include <db_service/v1/estimation/estimation_signals.pb.h>
 #include <ProtobufUtils.hpp>
 
 #include <queue>
@@ -71,13 +75,17 @@ core::FoxgloveWSServer::FoxgloveWSServer(std::vector<core::common::Configurable
 
     // TODO make the .proto file name a parameter
 
-    auto potential_id_map = util::generate_name_to_id_map({"hytech_msgs.proto", "hytech.proto"});
+    // the MCAP logger's diagnostics and the estimator's input staleness, latencies and signals go out live too
+    const std::vector<std::string> proto_files = {"hytech_msgs.proto", "hytech.proto", "db_service/v1/logger/logger_diagnostics.proto",
+                                                  "db_service/v1/estimation/input_staleness.proto", "db_service/v1/estimation/input_latency.proto",
+                                                  "db_service/v1/estimation/estimation_signals.proto"};
+    auto potential_id_map = util::generate_name_to_id_map(proto_files);
     if (potential_id_map)
     {
         _id_name_map = *potential_id_map;
     }
 
-    auto descriptors = util::get_pb_descriptors({"hytech_msgs.proto", "hytech.proto"});
+    auto descriptors = util::get_pb_descriptors(proto_files);
 
     std::vector<foxglove::ChannelWithoutId> channels;
 
@@ -91,7 +99,7 @@ core::FoxgloveWSServer::FoxgloveWSServer(std::vector<core::common::Configurable
             server_channel.topic = message_descriptor->name();
             server_channel.encoding = "protobuf";
             server_channel.schemaName = message_descriptor->full_name();
-            server_channel.schema = foxglove::base64Encode(util::build_file_descriptor_set(message_descriptor).SerializeAsString());
+            server_channel.schema = foxglove::base64Encode(util::serialized_file_descriptor_set(message_descriptor));
             channels.push_back(server_channel);
         }
     }
@@ -0,0 +1,130 @@
+#ifndef __ESTIMATIONPIPELINE_H__
+#define __ESTIMATIONPIPELINE_H__
+
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <VehicleDataTypes.hpp>
+#include <LatencyHistogram.hpp>
+
+// the estimators that turn the raw inputs into more of the vehicle state (filters, tire models,
+// sensor conversions, slip estimation) as stages that run one after the other every control cycle,
+// so that a new one can be added without changing the StateEstimator.
+
+// every stage says which signals it reads and which it writes, by name. a stage runs after the
+// stages that write the signals it reads, otherwise in the order the stages were added. signals
+// that no stage writes are ones that the state estimator fills in from the inputs (eg.
+// raw_steering_analog, current_rpms) and do not order anything. every signal a stage writes gets a
+// float in the pipeline's SignalTable and the stage writes it there. the ones that are fields of
+// core::VehicleState (steering_angle_deg, matlab_math_temp_out_fl to _rr for
+// matlab_math_temp_out.res_torque_lim_nm) are copied into the state by the pipeline right after
+// their stage steps, so later stages can read them from either. the whole table is published by the
+// StateEstimator as a db_service.v1.estimation.EstimationSignals with every VehicleData.
+
+// each stage's step time goes into a histogram so that a codegen'd model that blows the control
+// loop's budget shows up as that stage.
+
+// the pipeline is built once before the first cycle and only stepped from the control loop after
+// that, building sorts the stages and sets up everything so that a step does not allocate.
+namespace estimation
+{
+    /// @brief the values of the signals that the stages write, one float each. the slots are assigned
+    ///        when the pipeline is built and stay put, stages look theirs up once in bind()
+    class SignalTable
+    {
+    public:
+        static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+        /// @return npos if no stage writes the signal
+        size_t index(const std::string &name) const
+        {
+            auto index = _indices.find(name);
+            return index == _indices.end() ? npos : index->second;
+        }
+        float &operator[](size_t index) { return _values[index]; }
+        float operator[](size_t index) const { return _values[index]; }
+        /// @brief the names of the signals in the order of their slots
+        const std::vector<std::string> &names() const { return _names; }
+
+    private:
+        friend class EstimationPipeline;
+        std::unordered_map<std::string, size_t> _indices;
+        std::vector<std::string> _names;
+        std::vector<float> _values;
+    };
+
+    /// @brief what a stage gets to work with in a cycle
+    struct EstimationFrame
+    {
+        const core::RawInputData &raw;
+        core::VehicleState &state;
+        SignalTable &signals;
+        float dt_s; // since the last cycle, 0 in the first one
+    };
+
+    class EstimationStage
+    {
+    public:
+        virtual ~EstimationStage() = default;
+
+        virtual std::string name() const = 0;
+        /// @brief the signals that the stage reads
+        virtual std::vector<std::string> inputs() const = 0;
+        /// @brief the signals that the stage writes, no two stages can write the same one
+        virtual std::vector<std::string> outputs() const = 0;
+        /// @brief looks up the slots of the signals in the table, called once the pipeline is built
+        virtual void bind(const SignalTable & /*signals*/) {}
+        /// @brief runs the stage for one cycle, on the control loop's thread
+        virtual void step(EstimationFrame &frame) = 0;
+    };
+
+    class EstimationPipeline
+    {
+    public:
+        /// @brief adds a stage, before build()
+        void add_stage(std::unique_ptr<EstimationStage> stage);
+
+        /// @brief puts the stages in dependency order and binds them to the signal table
+        /// @return false if two stages write the same signal or stages depend on each other in a
+        ///         loop, the pipeline does not run any stages then
+        bool build();
+        bool built() const { return _built; }
+
+        /// @brief runs every stage once, in order. does nothing before the pipeline is built
+        void step(const core::RawInputData &raw, core::VehicleState &state, float dt_s);
+
+        /// @brief the stages in the order that they run in
+        size_t num_stages() const { return _stages.size(); }
+        const std::string &stage_name(size_t stage) const { return _stage_names[stage]; }
+        /// @brief step times of a stage, readable from any thread
+        const util::LatencyHistogram &stage_timing(size_t stage) const { return _stage_timings[stage]; }
+        /// @brief step times of the whole pipeline
+        const util::LatencyHistogram &total_timing() const { return _total_timing; }
+
+        /// @brief the signals as of the last step, control loop only
+        const SignalTable &signals() const { return _signals; }
+
+    private:
+        using state_setter = void (*)(core::VehicleState &, float);
+        struct StateOutput
+        {
+            size_t stage; // the one that writes it, in run order
+            size_t index;
+            state_setter set;
+        };
+
+        std::vector<std::unique_ptr<EstimationStage>> _stages;
+        std::vector<std::string> _stage_names;
+        std::unique_ptr<util::LatencyHistogram[]> _stage_timings;
+        util::LatencyHistogram _total_timing;
+        SignalTable _signals;
+        std::vector<StateOutput> _state_outputs; // in run order of their stages
+        bool _built = false;
+    };
+}
+#endif // __ESTIMATIONPIPELINE_H__
@@ -0,0 +1,106 @@
+#ifndef __ESTIMATIONSTAGES_H__
+#define __ESTIMATIONSTAGES_H__
+
+#include <EstimationPipeline.hpp>
+
+#include <array>
+#include <functional>
+#include <string>
+#include <vector>
+
+// the stages that come with the estimator. the StateEstimator adds the ones named in its
+// pipeline_stages param, anything else (eg. a codegen'd model wrapped in a FunctionStage) can be
+// added to StateEstimator::pipeline() before init.
+namespace estimation
+{
+    /// @brief steering_angle_deg from the analog steering sensor
+    class SteeringAngleStage : public EstimationStage
+    {
+    public:
+        struct config
+        {
+            float center_counts; // raw value with the wheel straight
+            float deg_per_count;
+        };
+        explicit SteeringAngleStage(config config) : _config(config) {}
+
+        std::string name() const override { return "steering_angle"; }
+        std::vector<std::string> inputs() const override { return {"raw_steering_analog"}; }
+        std::vector<std::string> outputs() const override { return {"steering_angle_deg"}; }
+        void bind(const SignalTable &signals) override;
+        void step(EstimationFrame &frame) override;
+
+    private:
+        config _config;
+        size_t _index = SignalTable::npos;
+    };
+
+    /// @brief longitudinal slip ratio of each wheel from the motor rpms and the body velocity,
+    ///        wheel_slip_fl, wheel_slip_fr, wheel_slip_rl and wheel_slip_rr
+    class WheelSlipStage : public EstimationStage
+    {
+    public:
+        struct config
+        {
+            float wheel_radius_m;
+            float gear_ratio;  // motor revolutions per wheel revolution
+            float min_speed_m_s; // below this the slip is relative to this speed, so it does not blow up at standstill
+        };
+        explicit WheelSlipStage(config config) : _config(config) {}
+
+        std::string name() const override { return "wheel_slip"; }
+        std::vector<std::string> inputs() const override { return {"current_rpms", "current_body_vel_ms"}; }
+        std::vector<std::string> outputs() const override { return {"wheel_slip_fl", "wheel_slip_fr", "wheel_slip_rl", "wheel_slip_rr"}; }
+        void bind(const SignalTable &signals) override;
+        void step(EstimationFrame &frame) override;
+
+    private:
+        config _config;
+        std::array<size_t, 4> _slip_indices{};
+    };
+
+    /// @brief first order low pass filter of a signal that another stage writes
+    class LowPassFilterStage : public EstimationStage
+    {
+    public:
+        LowPassFilterStage(std::string input, std::string output, float cutoff_hz)
+            : _input(std::move(input)), _output(std::move(output)), _cutoff_hz(cutoff_hz) {}
+
+        std::string name() const override { return "low_pass:" + _output; }
+        std::vector<std::string> inputs() const override { return {_input}; }
+        std::vector<std::string> outputs() const override { return {_output}; }
+        void bind(const SignalTable &signals) override;
+        void step(EstimationFrame &frame) override;
+
+    private:
+        std::string _input;
+        std::string _output;
+        float _cutoff_hz;
+        size_t _input_index = SignalTable::npos;
+        size_t _output_index = SignalTable::npos;
+        bool _started = false;
+    };
+
+    /// @brief a stage from a function, eg. for wrapping a codegen'd model. the tire model goes in as
+    ///        one that writes matlab_math_temp_out_fl to _rr, which end up in the state's
+    ///        matlab_math_temp_out
+    class FunctionStage : public EstimationStage
+    {
+    public:
+        using step_fn = std::function<void(EstimationFrame &)>;
+        FunctionStage(std::string name, std::vector<std::string> inputs, std::vector<std::string> outputs, step_fn step)
+            : _name(std::move(name)), _inputs(std::move(inputs)), _outputs(std::move(outputs)), _step(std::move(step)) {}
+
+        std::string name() const override { return _name; }
+        std::vector<std::string> inputs() const override { return _inputs; }
+        std::vector<std::string> outputs() const override { return _outputs; }
+        void step(EstimationFrame &frame) override { _step(frame); }
+
+    private:
+        std::string _name;
+        std::vector<std::string> _inputs;
+        std::vector<std::string> _outputs;
+        step_fn _step;
+    };
+}
+#endif // __ESTIMATIONSTAGES_H__
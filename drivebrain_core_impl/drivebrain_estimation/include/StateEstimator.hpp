@@ -15,11 +15,20 @@
 #include <mutex>
 #include <thread>
 #include <utility>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <unordered_map>
 
 #include "hytech_msgs.pb.h"
 #include "base_msgs.pb.h"
+#include "hytech.pb.h"
+#include <db_service/v1/estimation/input_staleness.pb.h>
+#include <db_service/v1/estimation/input_latency.pb.h>
+#include <db_service/v1/estimation/estimation_signals.pb.h>
 
 // protobuf
 #include <google/protobuf/any.pb.h>
@@ -32,12 +41,23 @@
 #include <MsgLogger.hpp>
 
 #include <Configurable.hpp>
+#include <MessagePool.hpp>
+#include <TripleBuffer.hpp>
+#include <LatencyHistogram.hpp>
+#include <EstimationPipeline.hpp>
 
 // while we can just have one queue input, if we allowed for multiple queue inputs that each have their own threads
 // that can update pieces of the state that would be optimal.
 
-// TODO:
-// - [ ] write tests for the timestamp checking / verification of the state data
+// the state is valid when none of its inputs are stale. every input has its own max age
+// (StateEstimator.<input>_max_age_ms, 0 = not checked), the mask of which ones are stale is logged
+// as a db_service.v1.estimation.InputStaleness with every VehicleData and handed to the control loop
+// so that it can keep going without the inputs that it does not need.
+
+// the timestamps of the inputs are their acquisition times (see AcquisitionTime.hpp), so an input
+// that sat in a queue before it got here is as old as it really is. how long each input takes from
+// acquisition to being in the state is kept in a histogram per input and published as a
+// db_service.v1.estimation.InputLatencies.
 
 // user story:
 // i want the ability to add in new estimation components by composition or construction
@@ -45,59 +65,214 @@
 // i dont want to have to change code in here every time we add a new state variable / data derived 
 // from the raw sensor data input
 
-// new ideas: 
-// for a more generic state estimator we can template the class based on the raw input data struct 
-// and the vehicle state struct. 
-
-// for now i will just move the state estimator into the estimation impl and call it a day 
+// -> the estimation components are stages of an estimation::EstimationPipeline (see
+// EstimationPipeline.hpp) that say which signals they read and write. the ones in pipeline_stages
+// are added in init, others can be added to pipeline() before it. the pipeline runs on every state
+// that the control loop gets and how long each stage takes goes out with the input latencies. what
+// the stages wrote goes out as a db_service.v1.estimation.EstimationSignals with every VehicleData.
 namespace core
 {
-    class StateEstimator
+    class StateEstimator : public core::common::Configurable
     {
 
     using loggertype = core::MsgLogger<std::shared_ptr<google::protobuf::Message>>;
 
     public:
         using tsq = core::common::ThreadSafeDeque<std::shared_ptr<google::protobuf::Message>>;
-        StateEstimator(core::Logger &shared_logger, std::shared_ptr<loggertype> message_logger)
-        : _logger(shared_logger), _message_logger(message_logger)
+        // current time since the system clock epoch
+        using clock_fn = std::function<std::chrono::microseconds()>;
+        // called with the message and its receive time
+        using handler_fn = std::function<void(const google::protobuf::Message &, std::chrono::microseconds)>;
+
+        /// @brief the inputs that the state is built from, in the order of their bits in the stale input mask
+        enum class Input : uint8_t
+        {
+            RearSuspension,
+            FrontSuspension,
+            Pedals,
+            Steering,
+            VectorNav,
+            Inverter1,
+            Inverter2,
+            Inverter3,
+            Inverter4,
+            Count
+        };
+        static constexpr size_t num_inputs = static_cast<size_t>(Input::Count);
+
+        /// @brief the bit of an input in the stale input mask
+        static constexpr uint32_t input_bit(Input input) { return 1u << static_cast<uint8_t>(input); }
+
+        // params (all live, an input without one keeps its default max age):
+        // - <input>_max_age_ms: how old the input can get before it is stale, 0 = never stale. the
+        //   inputs are rear_suspension, front_suspension, pedals, steering, vectornav and inverter1 to
+        //   inverter4. the suspension, pedals and steering default to 30 ms, the rest are not checked
+        // - latency_report_period_ms: how often the input latencies are published, 0 = never (default 1000)
+        // not live, read in init:
+        // - pipeline_stages: the stages of EstimationStages.hpp to run, a comma separated list of
+        //   steering_angle (needs steering_center_counts and steering_deg_per_count), wheel_slip
+        //   (wheel_radius_m, gear_ratio, slip_min_speed_m_s) and wheel_slip_filter (wheel_slip_filter_hz,
+        //   a low pass of each wheel_slip_* into wheel_slip_*_filtered). none by default
+        StateEstimator(core::Logger &shared_logger, core::JsonFileHandler &json_file_handler, std::shared_ptr<loggertype> message_logger)
+        : Configurable(shared_logger, json_file_handler, "StateEstimator"), _logger(shared_logger), _message_logger(message_logger)
         //  _matlab_estimator(matlab_estimator)
         {
             _vehicle_state = {}; // initialize to all zeros
             _raw_input_data = {};
             _vehicle_state.state_is_valid = true;
             _vehicle_state.prev_MCU_recv_millis = -1; // init the last mcu recv millis to < 0
-            // initialize the 3 state variables to have a zero timestamp
-            std::chrono::microseconds zero_start_time{0};
-            _timestamp_array = {zero_start_time, zero_start_time, zero_start_time, zero_start_time};
+            // a zero timestamp is an input that has not been received yet
+            _timestamp_array.fill(std::chrono::microseconds{0});
+            for (size_t i = 0; i < num_inputs; i++)
+            {
+                _max_age_us[i].store(_default_max_age_ms[i] * 1000);
+            }
+            _update_state([]() {});
+            _register_handlers();
         }
         ~StateEstimator() = default;
 
+        /// @brief reads the params and builds the estimation pipeline
+        /// @return false if a stage is missing its params or the stages do not fit together
+        bool init() override;
+
         void handle_recv_process(std::shared_ptr<google::protobuf::Message> message);
+        /// @brief same as above with the time that the message was acquired at (system clock epoch), used
+        ///        for the input timestamps instead of the time that the message gets processed
+        void handle_recv_process(std::shared_ptr<google::protobuf::Message> message, std::chrono::microseconds recv_time);
+        /// @brief the newest state with every input up to some point in it, never waits for the
+        ///        threads handling inputs. only from the control loop's thread
         std::pair<core::VehicleState, bool> get_latest_state_and_validity();
+        /// @brief goes into the next states, only from the control loop's thread too
         void set_previous_control_output(SpeedControlOut prev_control_output);
+        /// @brief the inputs that were stale in the last state from get_latest_state_and_validity, a
+        ///        bit from input_bit for each. the state is valid when there are none, only from the
+        ///        control loop's thread too
+        uint32_t get_stale_inputs() const { return _stale_inputs; }
+
+        /// @brief acquisition to state update latencies of an input, from any thread
+        const util::LatencyHistogram &get_input_latency(Input input) const { return _input_latencies[static_cast<size_t>(input)]; }
+
+        /// @brief the estimation stages that run on the state. add stages before init, the signals are
+        ///        only for the control loop's thread and the stage timings for any thread after it
+        estimation::EstimationPipeline &pipeline() { return _pipeline; }
+        const estimation::EstimationPipeline &pipeline() const { return _pipeline; }
+
+        /// @brief replaces the clock that the input timestamps are checked against (and that messages
+        ///        without a receive time are stamped with), eg. with the virtual clock of a replay.
+        ///        set before any messages come in
+        void set_clock(clock_fn clock) { _clock = std::move(clock); }
+
+        /// @brief makes handle_recv_process hand messages of a type to the handler, instead of the
+        ///        handler that was registered for it before. register before any messages come in
+        void register_handler(const google::protobuf::Descriptor *descriptor, handler_fn handler)
+        {
+            _handlers[descriptor] = std::move(handler);
+        }
+
+        /// @brief the same for a generated message type, the handler gets the message as that type
+        template <typename MsgType, typename Handler>
+        void register_handler(Handler handler)
+        {
+            register_handler(MsgType::descriptor(), [handler = std::move(handler)](const google::protobuf::Message &msg, std::chrono::microseconds recv_time)
+                             { handler(static_cast<const MsgType &>(msg), recv_time); });
+        }
 
     private:
-        void _recv_low_level_state(std::shared_ptr<google::protobuf::Message> message);
-        void _recv_inverter_states(std::shared_ptr<google::protobuf::Message> msg);
+        void _register_handlers();
+        bool _add_configured_stages();
+        void _handle_param_updates(const std::unordered_map<std::string, core::common::Configurable::ParamTypes> &new_param_map);
+        void _recv_vn_data(const hytech_msgs::VNData &in_msg, std::chrono::microseconds recv_time);
+        void _recv_rear_suspension(const hytech::rear_suspension &in_msg, std::chrono::microseconds recv_time);
+        void _recv_front_suspension(const hytech::front_suspension &in_msg, std::chrono::microseconds recv_time);
+        void _recv_pedals(const hytech::pedals_system_data &in_msg, std::chrono::microseconds recv_time);
+        void _recv_steering(const hytech::steering_data &in_msg, std::chrono::microseconds recv_time);
 
         template <size_t ind, typename inverter_dynamics_msg>
-        void _handle_set_inverter_dynamics(std::shared_ptr<google::protobuf::Message> msg);
+        void _handle_set_inverter_dynamics(const inverter_dynamics_msg &in_msg, std::chrono::microseconds recv_time);
+
+        /// @brief publishes the input latencies if latency_report_period_ms has passed since the last time
+        void _report_input_latencies(std::chrono::microseconds now);
+        /// @brief publishes the pipeline's signals as of its last step, if it has any
+        void _log_estimation_signals();
 
         std::shared_ptr<hytech_msgs::VehicleData> _set_ins_state_data(core::VehicleState current_state, std::shared_ptr<hytech_msgs::VehicleData> msg_out);
 
-        template <size_t arr_len>
-        bool _validate_stamps(const std::array<std::chrono::microseconds, arr_len> &timestamp_arr);
+        /// @brief the stale input mask of the timestamps, fills in how old each input is in us (-1 if
+        ///        it has not been received yet)
+        uint32_t _find_stale_inputs(const std::array<std::chrono::microseconds, num_inputs> &timestamps, std::chrono::microseconds now,
+                                    std::array<int64_t, num_inputs> &ages_us) const;
+
+        /// @brief changes the state with _state_mutex held and publishes the result to the control loop
+        template <typename Update>
+        void _update_state(Update &&update)
+        {
+            std::unique_lock lk(_state_mutex);
+            update();
+            auto &snapshot = _snapshots.write_buffer();
+            snapshot.vehicle_state = _vehicle_state;
+            snapshot.raw_input_data = _raw_input_data;
+            snapshot.timestamps = _timestamp_array;
+            _snapshots.publish();
+        }
+
+        /// @brief the same for a state update from an input, stamps the input with its acquisition time
+        ///        and counts how long it took to get into the published state
+        template <typename Update>
+        void _update_input(Input input, std::chrono::microseconds recv_time, Update &&update)
+        {
+            const auto index = static_cast<size_t>(input);
+            _update_state([&]()
+            {
+                _timestamp_array[index] = recv_time;
+                update();
+            });
+            _input_latencies[index].record(_clock() - recv_time);
+        }
 
     private:
-        
+        struct StateSnapshot
+        {
+            core::VehicleState vehicle_state;
+            core::RawInputData raw_input_data;
+            std::array<std::chrono::microseconds, num_inputs> timestamps;
+        };
+
+        static constexpr std::array<const char *, num_inputs> _input_names = {
+            "rear_suspension", "front_suspension", "pedals", "steering", "vectornav",
+            "inverter1", "inverter2", "inverter3", "inverter4"};
+        static constexpr std::array<int64_t, num_inputs> _default_max_age_ms = {30, 30, 30, 30, 0, 0, 0, 0, 0};
+
         core::Logger &_logger;
         bool _run_recv_threads = false;
+        // only taken by the threads handling inputs, they take turns updating the state. every update
+        // is published whole to the control loop through _snapshots
         std::mutex _state_mutex;
         core::VehicleState _vehicle_state;
         core::RawInputData _raw_input_data;
-        std::array<std::chrono::microseconds, 4> _timestamp_array;
+        // indexed by Input
+        std::array<std::chrono::microseconds, num_inputs> _timestamp_array;
+        util::TripleBuffer<StateSnapshot> _snapshots;
+        // 0 = never stale, set from the param thread and read by the control loop
+        std::array<std::atomic<int64_t>, num_inputs> _max_age_us;
+        SpeedControlOut _prev_controller_output{}; // control loop only
+        uint32_t _stale_inputs = 0; // control loop only
+        std::array<util::LatencyHistogram, num_inputs> _input_latencies;
+        std::atomic<int64_t> _latency_report_period_us{1000000};
+        std::chrono::microseconds _last_latency_report{0}; // control loop only
+        estimation::EstimationPipeline _pipeline; // stepped by the control loop only
+        std::chrono::microseconds _last_pipeline_step{0}; // control loop only
         std::shared_ptr<loggertype> _message_logger;
+        // VehicleData, InputStaleness, EstimationSignals and InputLatencies, only acquired from in
+        // get_latest_state_and_validity
+        util::MessagePool _msg_pool;
+        // the descriptors are the generated ones, so a message that matches one is of its generated
+        // class. only changed before messages come in
+        std::unordered_map<const google::protobuf::Descriptor *, handler_fn> _handlers;
+        clock_fn _clock = []()
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch());
+        };
 
     };
 }
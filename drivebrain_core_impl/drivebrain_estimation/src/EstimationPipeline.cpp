@@ -0,0 +1,142 @@
+#include <EstimationPipeline.hpp>
+
+#include <spdlog/spdlog.h>
+
+namespace
+{
+    // the signals that are fields of the state and how to put them there
+    const std::unordered_map<std::string, void (*)(core::VehicleState &, float)> &state_setters()
+    {
+        static const std::unordered_map<std::string, void (*)(core::VehicleState &, float)> setters = {
+            {"steering_angle_deg", [](core::VehicleState &state, float value) { state.steering_angle_deg = value; }},
+            {"matlab_math_temp_out_fl", [](core::VehicleState &state, float value) { state.matlab_math_temp_out.res_torque_lim_nm.FL = value; }},
+            {"matlab_math_temp_out_fr", [](core::VehicleState &state, float value) { state.matlab_math_temp_out.res_torque_lim_nm.FR = value; }},
+            {"matlab_math_temp_out_rl", [](core::VehicleState &state, float value) { state.matlab_math_temp_out.res_torque_lim_nm.RL = value; }},
+            {"matlab_math_temp_out_rr", [](core::VehicleState &state, float value) { state.matlab_math_temp_out.res_torque_lim_nm.RR = value; }}};
+        return setters;
+    }
+}
+
+namespace estimation
+{
+    void EstimationPipeline::add_stage(std::unique_ptr<EstimationStage> stage)
+    {
+        _stages.push_back(std::move(stage));
+        _built = false;
+    }
+
+    bool EstimationPipeline::build()
+    {
+        _built = false;
+        _signals = SignalTable();
+
+        // which stage writes each signal
+        std::unordered_map<std::string, size_t> writers;
+        for (size_t i = 0; i < _stages.size(); i++)
+        {
+            for (const auto &output : _stages[i]->outputs())
+            {
+                auto writer = writers.emplace(output, i);
+                if (!writer.second)
+                {
+                    spdlog::error("estimation stages {} and {} both write {}", _stages[writer.first->second]->name(), _stages[i]->name(), output);
+                    return false;
+                }
+                _signals._indices.emplace(output, _signals._names.size());
+                _signals._names.push_back(output);
+            }
+        }
+        _signals._values.assign(_signals._names.size(), 0.f);
+
+        // the stages each one has to wait for
+        std::vector<std::vector<size_t>> dependencies(_stages.size());
+        for (size_t i = 0; i < _stages.size(); i++)
+        {
+            for (const auto &input : _stages[i]->inputs())
+            {
+                auto writer = writers.find(input);
+                if (writer != writers.end() && writer->second != i)
+                {
+                    dependencies[i].push_back(writer->second);
+                }
+            }
+        }
+
+        // takes the first stage in the order they were added that has everything it reads, so the
+        // order only changes where it has to. a handful of stages, the quadratic search is fine
+        std::vector<size_t> order;
+        std::vector<bool> placed(_stages.size(), false);
+        while (order.size() < _stages.size())
+        {
+            size_t next = _stages.size();
+            for (size_t i = 0; i < _stages.size() && next == _stages.size(); i++)
+            {
+                bool ready = !placed[i];
+                for (size_t dependency : dependencies[i])
+                {
+                    ready = ready && placed[dependency];
+                }
+                if (ready)
+                {
+                    next = i;
+                }
+            }
+            if (next == _stages.size())
+            {
+                spdlog::error("estimation stages depend on each other in a loop");
+                return false;
+            }
+            placed[next] = true;
+            order.push_back(next);
+        }
+        std::vector<std::unique_ptr<EstimationStage>> ordered;
+        for (size_t i : order)
+        {
+            ordered.push_back(std::move(_stages[i]));
+        }
+        _stages = std::move(ordered);
+
+        _stage_names.clear();
+        _state_outputs.clear();
+        for (size_t i = 0; i < _stages.size(); i++)
+        {
+            _stage_names.push_back(_stages[i]->name());
+            _stages[i]->bind(_signals);
+            for (const auto &output : _stages[i]->outputs())
+            {
+                auto setter = state_setters().find(output);
+                if (setter != state_setters().end())
+                {
+                    _state_outputs.push_back({i, _signals.index(output), setter->second});
+                }
+            }
+        }
+        _stage_timings = std::make_unique<util::LatencyHistogram[]>(_stages.size());
+        _built = true;
+        return true;
+    }
+
+    void EstimationPipeline::step(const core::RawInputData &raw, core::VehicleState &state, float dt_s)
+    {
+        if (!_built)
+        {
+            return;
+        }
+        EstimationFrame frame{raw, state, _signals, dt_s};
+        const auto pipeline_start = std::chrono::steady_clock::now();
+        auto stage_start = pipeline_start;
+        size_t state_output = 0;
+        for (size_t i = 0; i < _stages.size(); i++)
+        {
+            _stages[i]->step(frame);
+            for (; state_output < _state_outputs.size() && _state_outputs[state_output].stage == i; state_output++)
+            {
+                _state_outputs[state_output].set(state, _signals[_state_outputs[state_output].index]);
+            }
+            const auto stage_end = std::chrono::steady_clock::now();
+            _stage_timings[i].record(std::chrono::duration_cast<std::chrono::microseconds>(stage_end - stage_start));
+            stage_start = stage_end;
+        }
+        _total_timing.record(std::chrono::duration_cast<std::chrono::microseconds>(stage_start - pipeline_start));
+    }
+}
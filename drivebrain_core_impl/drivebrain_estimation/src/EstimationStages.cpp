@@ -0,0 +1,72 @@
+#include <EstimationStages.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#include <spdlog/spdlog.h>
+
+namespace estimation
+{
+    void SteeringAngleStage::bind(const SignalTable &signals)
+    {
+        _index = signals.index(outputs()[0]);
+    }
+
+    void SteeringAngleStage::step(EstimationFrame &frame)
+    {
+        frame.signals[_index] = (frame.raw.raw_steering_analog - _config.center_counts) * _config.deg_per_count;
+    }
+
+    void WheelSlipStage::bind(const SignalTable &signals)
+    {
+        const auto names = outputs();
+        for (size_t i = 0; i < _slip_indices.size(); i++)
+        {
+            _slip_indices[i] = signals.index(names[i]);
+        }
+    }
+
+    void WheelSlipStage::step(EstimationFrame &frame)
+    {
+        constexpr float rpm_to_rad_s = 2.0f * static_cast<float>(M_PI) / 60.0f;
+        const float rpm_to_m_s = rpm_to_rad_s * _config.wheel_radius_m / _config.gear_ratio;
+        const float vx = frame.state.current_body_vel_ms.x;
+        const float reference = std::max(std::abs(vx), _config.min_speed_m_s);
+        const auto &rpms = frame.state.current_rpms;
+        const std::array<float, 4> wheel_rpms = {rpms.FL, rpms.FR, rpms.RL, rpms.RR};
+        for (size_t i = 0; i < wheel_rpms.size(); i++)
+        {
+            frame.signals[_slip_indices[i]] = (wheel_rpms[i] * rpm_to_m_s - vx) / reference;
+        }
+    }
+
+    void LowPassFilterStage::bind(const SignalTable &signals)
+    {
+        _input_index = signals.index(_input);
+        _output_index = signals.index(_output);
+        if (_input_index == SignalTable::npos)
+        {
+            spdlog::warn("no estimation stage writes {}, {} does nothing", _input, name());
+        }
+    }
+
+    void LowPassFilterStage::step(EstimationFrame &frame)
+    {
+        if (_input_index == SignalTable::npos)
+        {
+            return;
+        }
+        const float input = frame.signals[_input_index];
+        float &output = frame.signals[_output_index];
+        if (!_started || frame.dt_s <= 0.f)
+        {
+            // nothing to filter against yet
+            output = input;
+            _started = true;
+            return;
+        }
+        const float rc = 1.0f / (2.0f * static_cast<float>(M_PI) * _cutoff_hz);
+        const float alpha = frame.dt_s / (rc + frame.dt_s);
+        output += alpha * (input - output);
+    }
+}
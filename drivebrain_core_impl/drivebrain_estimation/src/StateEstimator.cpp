@@ -2,12 +2,18 @@
 
 #include <VehicleDataTypes.hpp>
 
+#include <EstimationStages.hpp>
+
 #include <chrono>
-#include <algorithm>
+#include <sstream>
+#include <string>
+#include <variant>
+#include <vector>
 
 #include <google/protobuf/message.h>
 #include <memory>
 #include <mutex>
+#include <spdlog/spdlog.h>
 
 #include <base_msgs.pb.h> // from HT_proto
 #include "hytech_msgs.pb.h" // from HT_proto
@@ -15,157 +21,324 @@
 
 using namespace core;
 
-void StateEstimator::handle_recv_process(std::shared_ptr<google::protobuf::Message> message)
+namespace
 {
-    if (message->GetTypeName() == "hytech_msgs.VNData")
+    std::vector<std::string> split_list(const std::string &list)
     {
-        auto in_msg = std::static_pointer_cast<hytech_msgs::VNData>(message);
-        xyz_vec<float> body_vel_ms = {
-            (in_msg->vn_vel_m_s().x()),
-            (in_msg->vn_vel_m_s().y()),
-            (in_msg->vn_vel_m_s().z())};
-
-        xyz_vec<float> body_accel_mss = {
-            (in_msg->vn_linear_accel_m_ss().x()),
-            (in_msg->vn_linear_accel_m_ss().y()),
-            (in_msg->vn_linear_accel_m_ss().z())};
-
-        xyz_vec<float> angular_rate_rads = {
-            (in_msg->vn_angular_rate_rad_s().x()),
-            (in_msg->vn_angular_rate_rad_s().y()),
-            (in_msg->vn_angular_rate_rad_s().z())};
+        std::vector<std::string> items;
+        std::stringstream stream(list);
+        std::string item;
+        while (std::getline(stream, item, ','))
+        {
+            item.erase(0, item.find_first_not_of(" \t"));
+            item.erase(item.find_last_not_of(" \t") + 1);
+            if (!item.empty())
+            {
+                items.push_back(item);
+            }
+        }
+        return items;
+    }
 
-        ypr_vec<float> ypr_rad = {
-            (in_msg->vn_ypr_rad().yaw()),
-            (in_msg->vn_ypr_rad().pitch()),
-            (in_msg->vn_ypr_rad().roll())};
+    // InputLatency and StageTiming have the same fields
+    template <typename LatencyMsg>
+    void set_latency(LatencyMsg *msg, const util::LatencyHistogram::Counts &counts)
+    {
+        uint64_t total = 0;
+        for (auto count : counts)
+        {
+            msg->add_bucket_counts(count);
+            total += count;
+        }
+        msg->set_count(total);
+        msg->set_p50_us(util::LatencyHistogram::quantile_us(counts, 0.5));
+        msg->set_p99_us(util::LatencyHistogram::quantile_us(counts, 0.99));
+    }
+}
 
+bool StateEstimator::init()
+{
+    for (size_t i = 0; i < num_inputs; i++)
+    {
+        const std::string name = std::string(_input_names[i]) + "_max_age_ms";
+        std::optional<int> max_age_ms = get_live_parameter<int>(name);
+        if (max_age_ms)
         {
-            std::unique_lock lk(_state_mutex);
-            _vehicle_state.current_body_vel_ms = body_vel_ms;
-            _vehicle_state.current_body_accel_mss = body_accel_mss;
-            _vehicle_state.current_angular_rate_rads = angular_rate_rads;
-            _vehicle_state.current_ypr_rad = ypr_rad;
+            _max_age_us[i].store(static_cast<int64_t>(*max_age_ms) * 1000);
         }
     }
-    else {
-        _recv_low_level_state(message);
+    std::optional<int> latency_report_period_ms = get_live_parameter<int>("latency_report_period_ms");
+    if (latency_report_period_ms)
+    {
+        _latency_report_period_us.store(static_cast<int64_t>(*latency_report_period_ms) * 1000);
+    }
+
+    if (!_add_configured_stages() || !_pipeline.build())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < _pipeline.num_stages(); i++)
+    {
+        spdlog::info("estimation stage {}: {}", i, _pipeline.stage_name(i));
     }
+
+    param_update_handler_sig.connect(std::bind(&StateEstimator::_handle_param_updates, this, std::placeholders::_1));
+    return true;
 }
 
-void StateEstimator::_recv_low_level_state(std::shared_ptr<google::protobuf::Message> message)
+bool StateEstimator::_add_configured_stages()
 {
-    if (message->GetTypeName() == "hytech.rear_suspension") {
-        auto in_msg = std::static_pointer_cast<hytech::rear_suspension>(message);        
+    // every param of a stage has to be there, a stage with a made up calibration is worse than none
+    bool have_params = true;
+    auto param = [this, &have_params](const std::string &name)
+    {
+        std::optional<float> value = get_parameter_value<float>(name);
+        if (!value)
         {
-            std::unique_lock lk(_state_mutex);
-            _timestamp_array[0] = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch());
-            _raw_input_data.raw_load_cell_values.RL = in_msg->rl_load_cell();
-            _raw_input_data.raw_load_cell_values.RR = in_msg->rr_load_cell();
-            _raw_input_data.raw_shock_pot_values.RL = in_msg->rl_shock_pot();
-            _raw_input_data.raw_shock_pot_values.RR = in_msg->rr_shock_pot();
+            spdlog::error("StateEstimator: missing float param {}", name);
+            have_params = false;
         }
-    } else if(message->GetTypeName() == "hytech.front_suspension")
+        return value.value_or(0.f);
+    };
+
+    for (const auto &stage : split_list(get_parameter_value<std::string>("pipeline_stages").value_or("")))
     {
-        auto in_msg = std::static_pointer_cast<hytech::front_suspension>(message);
+        if (stage == "steering_angle")
+        {
+            estimation::SteeringAngleStage::config config = {param("steering_center_counts"), param("steering_deg_per_count")};
+            _pipeline.add_stage(std::make_unique<estimation::SteeringAngleStage>(config));
+        }
+        else if (stage == "wheel_slip")
         {
-            std::unique_lock lk(_state_mutex);
-            _timestamp_array[1] = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch());
-            _raw_input_data.raw_load_cell_values.FL = in_msg->fl_load_cell();
-            _raw_input_data.raw_load_cell_values.FR = in_msg->fr_load_cell();
-            _raw_input_data.raw_shock_pot_values.FL = in_msg->fl_shock_pot();
-            _raw_input_data.raw_shock_pot_values.FR = in_msg->fr_shock_pot();
+            estimation::WheelSlipStage::config config = {param("wheel_radius_m"), param("gear_ratio"), param("slip_min_speed_m_s")};
+            _pipeline.add_stage(std::make_unique<estimation::WheelSlipStage>(config));
         }
-    } else if(message->GetTypeName() == "hytech.pedals_system_data")
+        else if (stage == "wheel_slip_filter")
+        {
+            const float cutoff_hz = param("wheel_slip_filter_hz");
+            for (const char *wheel : {"fl", "fr", "rl", "rr"})
+            {
+                const std::string slip = std::string("wheel_slip_") + wheel;
+                _pipeline.add_stage(std::make_unique<estimation::LowPassFilterStage>(slip, slip + "_filtered", cutoff_hz));
+            }
+        }
+        else
+        {
+            spdlog::error("StateEstimator: unknown estimation stage {}", stage);
+            return false;
+        }
+    }
+    return have_params;
+}
+
+void StateEstimator::_handle_param_updates(const std::unordered_map<std::string, core::common::Configurable::ParamTypes> &new_param_map)
+{
+    for (size_t i = 0; i < num_inputs; i++)
     {
-        auto in_msg = std::static_pointer_cast<hytech::pedals_system_data>(message);
-        core::DriverInput input = {(in_msg->accel_pedal()), (in_msg->brake_pedal())};
+        const std::string name = std::string(_input_names[i]) + "_max_age_ms";
+        auto param = new_param_map.find(name);
+        if (param == new_param_map.end())
+        {
+            continue;
+        }
+        if (auto pval = std::get_if<int>(&param->second))
         {
-            std::unique_lock lk(_state_mutex);
-            _timestamp_array[2] = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch());
-            _vehicle_state.input = input;
+            _max_age_us[i].store(static_cast<int64_t>(*pval) * 1000);
+            spdlog::info("Setting new {}: {} ms", name, *pval);
         }
-    } else if(message->GetTypeName() == "hytech.steering_data")
+    }
+    auto latency_report_period = new_param_map.find("latency_report_period_ms");
+    if (latency_report_period != new_param_map.end())
     {
-        auto in_msg = std::static_pointer_cast<hytech::steering_data>(message);
+        if (auto pval = std::get_if<int>(&latency_report_period->second))
         {
-            std::unique_lock lk(_state_mutex);
-            _timestamp_array[3] = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch());
-            _raw_input_data.raw_steering_analog = in_msg->steering_analog_raw();
-            _raw_input_data.raw_steering_digital = in_msg->steering_digital_raw();
+            _latency_report_period_us.store(static_cast<int64_t>(*pval) * 1000);
+            spdlog::info("Setting new latency report period: {} ms", *pval);
         }
-    } else {
-        _recv_inverter_states(message);
     }
 }
 
-// INV1_STATUS INV1_TEMPS INV1_DYNAMICS INV1_POWER INV1_FEEDBACK
-void StateEstimator::_recv_inverter_states(std::shared_ptr<google::protobuf::Message> msg)
+void StateEstimator::handle_recv_process(std::shared_ptr<google::protobuf::Message> message)
+{
+    handle_recv_process(message, _clock());
+}
+
+void StateEstimator::handle_recv_process(std::shared_ptr<google::protobuf::Message> message, std::chrono::microseconds recv_time)
 {
-    auto name = msg->GetTypeName();
-    if( name == "hytech.inv1_status" )
+    // most messages on the bus are not state inputs, those are one lookup and done
+    auto handler = _handlers.find(message->GetDescriptor());
+    if (handler != _handlers.end())
     {
+        handler->second(*message, recv_time);
+    }
+}
+
+void StateEstimator::_register_handlers()
+{
+    register_handler<hytech_msgs::VNData>([this](const hytech_msgs::VNData &msg, std::chrono::microseconds recv_time) { _recv_vn_data(msg, recv_time); });
+    register_handler<hytech::rear_suspension>([this](const hytech::rear_suspension &msg, std::chrono::microseconds recv_time) { _recv_rear_suspension(msg, recv_time); });
+    register_handler<hytech::front_suspension>([this](const hytech::front_suspension &msg, std::chrono::microseconds recv_time) { _recv_front_suspension(msg, recv_time); });
+    register_handler<hytech::pedals_system_data>([this](const hytech::pedals_system_data &msg, std::chrono::microseconds recv_time) { _recv_pedals(msg, recv_time); });
+    register_handler<hytech::steering_data>([this](const hytech::steering_data &msg, std::chrono::microseconds recv_time) { _recv_steering(msg, recv_time); });
+    // INV1_STATUS INV1_TEMPS INV1_DYNAMICS INV1_POWER INV1_FEEDBACK, only the dynamics are used so far
+    register_handler<hytech::inv1_dynamics>([this](const hytech::inv1_dynamics &msg, std::chrono::microseconds recv_time) { _handle_set_inverter_dynamics<0>(msg, recv_time); });
+    register_handler<hytech::inv2_dynamics>([this](const hytech::inv2_dynamics &msg, std::chrono::microseconds recv_time) { _handle_set_inverter_dynamics<1>(msg, recv_time); });
+    register_handler<hytech::inv3_dynamics>([this](const hytech::inv3_dynamics &msg, std::chrono::microseconds recv_time) { _handle_set_inverter_dynamics<2>(msg, recv_time); });
+    register_handler<hytech::inv4_dynamics>([this](const hytech::inv4_dynamics &msg, std::chrono::microseconds recv_time) { _handle_set_inverter_dynamics<3>(msg, recv_time); });
+}
 
-    } else if(name == "hytech.inv2_status")
+void StateEstimator::_recv_vn_data(const hytech_msgs::VNData &in_msg, std::chrono::microseconds recv_time)
+{
+    xyz_vec<float> body_vel_ms = {
+        (in_msg.vn_vel_m_s().x()),
+        (in_msg.vn_vel_m_s().y()),
+        (in_msg.vn_vel_m_s().z())};
+
+    xyz_vec<float> body_accel_mss = {
+        (in_msg.vn_linear_accel_m_ss().x()),
+        (in_msg.vn_linear_accel_m_ss().y()),
+        (in_msg.vn_linear_accel_m_ss().z())};
+
+    xyz_vec<float> angular_rate_rads = {
+        (in_msg.vn_angular_rate_rad_s().x()),
+        (in_msg.vn_angular_rate_rad_s().y()),
+        (in_msg.vn_angular_rate_rad_s().z())};
+
+    ypr_vec<float> ypr_rad = {
+        (in_msg.vn_ypr_rad().yaw()),
+        (in_msg.vn_ypr_rad().pitch()),
+        (in_msg.vn_ypr_rad().roll())};
+
+    _update_input(Input::VectorNav, recv_time, [&]()
     {
+        _vehicle_state.current_body_vel_ms = body_vel_ms;
+        _vehicle_state.current_body_accel_mss = body_accel_mss;
+        _vehicle_state.current_angular_rate_rads = angular_rate_rads;
+        _vehicle_state.current_ypr_rad = ypr_rad;
+    });
+}
 
-    } else if(name == "hytech.inv1_dynamics")
+void StateEstimator::_recv_rear_suspension(const hytech::rear_suspension &in_msg, std::chrono::microseconds recv_time)
+{
+    _update_input(Input::RearSuspension, recv_time, [&]()
     {
-        _handle_set_inverter_dynamics<0, hytech::inv1_dynamics>(msg);
-    } else if(name == "hytech.inv2_dynamics")
+        _raw_input_data.raw_load_cell_values.RL = in_msg.rl_load_cell();
+        _raw_input_data.raw_load_cell_values.RR = in_msg.rr_load_cell();
+        _raw_input_data.raw_shock_pot_values.RL = in_msg.rl_shock_pot();
+        _raw_input_data.raw_shock_pot_values.RR = in_msg.rr_shock_pot();
+    });
+}
+
+void StateEstimator::_recv_front_suspension(const hytech::front_suspension &in_msg, std::chrono::microseconds recv_time)
+{
+    _update_input(Input::FrontSuspension, recv_time, [&]()
     {
-        _handle_set_inverter_dynamics<1, hytech::inv2_dynamics>(msg);
-    } else if(name == "hytech.inv3_dynamics")
+        _raw_input_data.raw_load_cell_values.FL = in_msg.fl_load_cell();
+        _raw_input_data.raw_load_cell_values.FR = in_msg.fr_load_cell();
+        _raw_input_data.raw_shock_pot_values.FL = in_msg.fl_shock_pot();
+        _raw_input_data.raw_shock_pot_values.FR = in_msg.fr_shock_pot();
+    });
+}
+
+void StateEstimator::_recv_pedals(const hytech::pedals_system_data &in_msg, std::chrono::microseconds recv_time)
+{
+    core::DriverInput input = {(in_msg.accel_pedal()), (in_msg.brake_pedal())};
+    _update_input(Input::Pedals, recv_time, [&]()
     {
-        _handle_set_inverter_dynamics<2, hytech::inv3_dynamics>(msg);
-    } else if(name == "hytech.inv4_dynamics")
+        _vehicle_state.input = input;
+    });
+}
+
+void StateEstimator::_recv_steering(const hytech::steering_data &in_msg, std::chrono::microseconds recv_time)
+{
+    _update_input(Input::Steering, recv_time, [&]()
     {
-        _handle_set_inverter_dynamics<3, hytech::inv4_dynamics>(msg);
-    }
+        _raw_input_data.raw_steering_analog = in_msg.steering_analog_raw();
+        _raw_input_data.raw_steering_digital = in_msg.steering_digital_raw();
+    });
 }
 
 template <size_t ind, typename inverter_dynamics_msg>
-void StateEstimator::_handle_set_inverter_dynamics(std::shared_ptr<google::protobuf::Message> msg) {
-    auto in_msg = std::static_pointer_cast<inverter_dynamics_msg>(msg);
+void StateEstimator::_handle_set_inverter_dynamics(const inverter_dynamics_msg &in_msg, std::chrono::microseconds recv_time) {
+    _update_input(static_cast<Input>(static_cast<size_t>(Input::Inverter1) + ind), recv_time, [&]()
     {
-        std::unique_lock lk(_state_mutex);
-        _raw_input_data.raw_inverter_torques.set_from_index<ind>(in_msg->actual_torque_nm());
-        _raw_input_data.raw_inverter_power.set_from_index<ind>(in_msg->actual_power_w());
-        _vehicle_state.current_rpms.set_from_index<ind>(in_msg->actual_speed_rpm());
-    }
+        _raw_input_data.raw_inverter_torques.set_from_index<ind>(in_msg.actual_torque_nm());
+        _raw_input_data.raw_inverter_power.set_from_index<ind>(in_msg.actual_power_w());
+        _vehicle_state.current_rpms.set_from_index<ind>(in_msg.actual_speed_rpm());
+    });
 }
 
-// TODO parameterize the timeout threshold
-template <size_t arr_len>
-bool StateEstimator::_validate_stamps(const std::array<std::chrono::microseconds, arr_len> &timestamp_arr)
+uint32_t StateEstimator::_find_stale_inputs(const std::array<std::chrono::microseconds, num_inputs> &timestamps, std::chrono::microseconds now,
+                                           std::array<int64_t, num_inputs> &ages_us) const
 {
-    std::array<std::chrono::microseconds, arr_len> timestamp_array_to_sort;
+    // one pass over the inputs, each one only against its own max age
+    uint32_t stale_inputs = 0;
+    for (size_t i = 0; i < num_inputs; i++)
     {
-        std::unique_lock lk(_state_mutex);
-        timestamp_array_to_sort = timestamp_arr;
+        const bool received = timestamps[i].count() > 0; // count here is the count in microseconds
+        ages_us[i] = received ? (now - timestamps[i]).count() : -1;
+        const int64_t max_age_us = _max_age_us[i].load(std::memory_order_relaxed);
+        if (max_age_us > 0 && (!received || ages_us[i] > max_age_us))
+        {
+            stale_inputs |= 1u << i;
+        }
     }
-    const std::chrono::microseconds threshold(30000); // 30 milliseconds in microseconds
-
-    // Sort the array
-    std::sort(timestamp_array_to_sort.begin(), timestamp_array_to_sort.end());
+    return stale_inputs;
+}
 
-    // Check if the range between the smallest and largest timestamps is within the threshold
-    auto min_stamp = timestamp_array_to_sort.front();
-    auto max_stamp = timestamp_array_to_sort.back();
+void StateEstimator::_report_input_latencies(std::chrono::microseconds now)
+{
+    const int64_t period_us = _latency_report_period_us.load(std::memory_order_relaxed);
+    if (period_us <= 0 || (now - _last_latency_report).count() < period_us)
+    {
+        return;
+    }
+    _last_latency_report = now;
 
-    bool within_threshold = (max_stamp - min_stamp) <= threshold;
-    
-    auto curr_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now().time_since_epoch());
-    bool all_members_received = min_stamp.count() > 0; // count here is the count in microseconds
-    bool last_update_recent_enough = (std::chrono::duration_cast<std::chrono::microseconds>(curr_time - max_stamp)) < threshold;
+    auto report = _msg_pool.acquire<db_service::v1::estimation::InputLatencies>();
+    for (size_t i = 0; i < num_inputs; i++)
+    {
+        auto input = report->add_inputs();
+        input->set_input(_input_names[i]);
+        set_latency(input, _input_latencies[i].counts());
+    }
+    if (_pipeline.num_stages() > 0)
+    {
+        for (size_t i = 0; i < _pipeline.num_stages(); i++)
+        {
+            auto stage = report->add_stages();
+            stage->set_stage(_pipeline.stage_name(i));
+            set_latency(stage, _pipeline.stage_timing(i).counts());
+        }
+        auto total = report->add_stages();
+        total->set_stage("pipeline");
+        set_latency(total, _pipeline.total_timing().counts());
+    }
+    _message_logger->log_msg(static_cast<std::shared_ptr<google::protobuf::Message>>(report));
+}
 
-    return within_threshold && all_members_received && last_update_recent_enough;
+void StateEstimator::_log_estimation_signals()
+{
+    const auto &signals = _pipeline.signals();
+    const auto &names = signals.names();
+    if (names.empty())
+    {
+        return;
+    }
+    // a reused message still has the strings of its names, so setting them does not allocate
+    auto signals_out = _msg_pool.acquire<db_service::v1::estimation::EstimationSignals>();
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        auto signal = signals_out->add_signals();
+        signal->set_name(names[i]);
+        signal->set_value(signals[i]);
+    }
+    _message_logger->log_msg(static_cast<std::shared_ptr<google::protobuf::Message>>(signals_out));
 }
 
 void StateEstimator::set_previous_control_output(SpeedControlOut prev_control_output)
 {
-    std::unique_lock lk(_state_mutex);
-    _vehicle_state.prev_controller_output = prev_control_output;
+    _prev_controller_output = prev_control_output;
 }
 
 std::shared_ptr<hytech_msgs::VehicleData> StateEstimator::_set_ins_state_data(core::VehicleState current_state, std::shared_ptr<hytech_msgs::VehicleData> msg_out)
@@ -194,20 +367,30 @@ std::shared_ptr<hytech_msgs::VehicleData> StateEstimator::_set_ins_state_data(co
 
 std::pair<core::VehicleState, bool> StateEstimator::get_latest_state_and_validity()
 {
-    auto state_is_valid = _validate_stamps(_timestamp_array);
     auto state_estim_start = std::chrono::high_resolution_clock::now();
-    core::VehicleState current_state;
-    core::RawInputData current_raw_data;
-    auto state_mutex_start = std::chrono::high_resolution_clock::now();
+    auto state_snapshot_start = std::chrono::high_resolution_clock::now();
+    const StateSnapshot &snapshot = _snapshots.read();
+    core::VehicleState current_state = snapshot.vehicle_state;
+    core::RawInputData current_raw_data = snapshot.raw_input_data;
+    std::shared_ptr<db_service::v1::estimation::InputStaleness> staleness_out = _msg_pool.acquire<db_service::v1::estimation::InputStaleness>();
+    std::array<int64_t, num_inputs> input_ages_us;
+    const auto now = _clock();
+    _stale_inputs = _find_stale_inputs(snapshot.timestamps, now, input_ages_us);
+    const bool state_is_valid = _stale_inputs == 0;
+    current_state.prev_controller_output = _prev_controller_output;
+    const float dt_s = _last_pipeline_step.count() > 0 ? std::chrono::duration<float>(now - _last_pipeline_step).count() : 0.f;
+    _last_pipeline_step = now;
+    _pipeline.step(current_raw_data, current_state, dt_s);
+    auto state_snapshot_end = std::chrono::high_resolution_clock::now();
+
+    staleness_out->set_stale_inputs(_stale_inputs);
+    for (int64_t age_us : input_ages_us)
     {
-        std::unique_lock lk(_state_mutex);
-        current_state = _vehicle_state;
-        current_raw_data = _raw_input_data;
+        staleness_out->add_input_age_us(age_us);
     }
-    auto state_mutex_end = std::chrono::high_resolution_clock::now();
 
     // Create the proto message to send
-    std::shared_ptr<hytech_msgs::VehicleData> msg_out = std::make_shared<hytech_msgs::VehicleData>();
+    std::shared_ptr<hytech_msgs::VehicleData> msg_out = _msg_pool.acquire<hytech_msgs::VehicleData>();
 
     msg_out->set_is_ready_to_drive(true);
 
@@ -234,6 +417,9 @@ std::pair<core::VehicleState, bool> StateEstimator::get_latest_state_and_validit
 
     auto log_start = std::chrono::high_resolution_clock::now();
     _message_logger->log_msg(static_cast<std::shared_ptr<google::protobuf::Message>>(msg_out));
+    _message_logger->log_msg(static_cast<std::shared_ptr<google::protobuf::Message>>(staleness_out));
+    _log_estimation_signals();
+    _report_input_latencies(now);
     auto log_end = std::chrono::high_resolution_clock::now();
     
     auto state_estim_end = std::chrono::high_resolution_clock::now();
@@ -245,7 +431,7 @@ std::pair<core::VehicleState, bool> StateEstimator::get_latest_state_and_validit
     {
         std::cout << "WARNING: timing" << std::endl;
         std::cout << "total: " << (static_cast<float>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count())) << " us\n";
-        std::cout << "state mutex: " << (static_cast<float>(std::chrono::duration_cast<std::chrono::microseconds>(state_mutex_end - state_mutex_start).count())) << " us\n";
+        std::cout << "state snapshot: " << (static_cast<float>(std::chrono::duration_cast<std::chrono::microseconds>(state_snapshot_end - state_snapshot_start).count())) << " us\n";
         std::cout << "log time: " << (static_cast<float>(std::chrono::duration_cast<std::chrono::microseconds>(log_end - log_start).count())) << " us\n";
     }
 
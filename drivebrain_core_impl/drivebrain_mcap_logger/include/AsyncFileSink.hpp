@@ -0,0 +1,159 @@
+#ifndef __ASYNCFILESINK_H__
+#define __ASYNCFILESINK_H__
+
+#include <mcap/writer.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+// file sink for mcap::McapWriter that keeps the disk off the logger thread. the writer's records are
+// copied into big aligned blocks and a block is only written out once it is full, either with
+// io_uring (the logger thread queues the write and carries on) or, where io_uring is not available,
+// by a dedicated thread with pwrite. handleWrite only waits when every block is still on its way to
+// the disk, ie. the disk cannot keep up at all.
+
+// every sync period what is in the partially filled block is written out too and the file is
+// fdatasync'd behind the writes, so a crash loses at most about one sync period of data. the sync
+// does not hold up the logger thread either. the full block later goes to the same place with the
+// same bytes at the front, so it does not matter which of the two writes lands first.
+
+// with direct_io the file is opened with O_DIRECT so the blocks bypass the page cache, which keeps
+// writeback from piling up and stalling everything at once. filesystems without O_DIRECT support
+// fall back to normal writes.
+namespace common
+{
+    class AsyncFileSink : public mcap::IWritable
+    {
+    public:
+        enum class Backend
+        {
+            IoUring,
+            Thread
+        };
+
+        struct Options
+        {
+            size_t block_size = 1024 * 1024; // rounded up to a multiple of 4096
+            size_t num_blocks = 8;
+            bool direct_io = false;
+            std::chrono::milliseconds sync_period{1000}; // 0 only syncs when the file is closed
+            bool use_io_uring = true;
+        };
+
+        explicit AsyncFileSink(const Options &options);
+        ~AsyncFileSink() override;
+        AsyncFileSink(const AsyncFileSink &) = delete;
+        AsyncFileSink &operator=(const AsyncFileSink &) = delete;
+
+        /// @brief creates (or truncates) the file and starts the io_uring or the writer thread
+        /// @return false if the file could not be opened
+        bool open(const std::string &path);
+
+        Backend backend() const { return _backend; }
+        bool direct_io() const { return _direct; }
+
+        /// @brief writes out what has been written so far and syncs it, without waiting for it
+        void flush() override;
+
+        /// @brief writes out the rest, waits for everything to be on disk and closes the file.
+        ///        called by McapWriter::close
+        void end() override;
+
+        /// @brief bytes written to the sink so far, the file is this big once everything is out
+        uint64_t size() const override { return _size; }
+
+        /// @brief number of times handleWrite had to wait for the disk
+        uint64_t stalls() const { return _stalls; }
+
+        /// @brief true once a write or sync failed, everything after that is thrown away
+        bool failed() const { return _failed.load(); }
+
+    protected:
+        void handleWrite(const std::byte *data, uint64_t size) override;
+
+    private:
+        struct Block
+        {
+            std::byte *data;
+            size_t len = 0;      // bytes to write
+            size_t done = 0;     // bytes written so far, a write can come back short
+            uint64_t offset = 0; // in the file
+            bool sync = false;   // fdatasync once this is written
+        };
+        // a sync without a block to write before it
+        static constexpr size_t _sync_only = SIZE_MAX;
+
+        size_t _acquire_block();
+        void _submit(size_t block, size_t len, bool sync);
+        void _durability_point();
+        void _fail(const char *what, int err);
+
+        // io_uring, the logger thread submits and reaps
+        bool _setup_io_uring();
+        void _teardown_io_uring();
+        void _uring_submit(size_t block);
+        void _uring_submit_sync();
+        io_uring_sqe *_uring_get_sqe();
+        bool _uring_enter(unsigned to_submit, unsigned min_complete);
+        /// @return false if there was nothing in flight to wait for or waiting failed
+        bool _uring_reap(bool wait);
+
+        // the writer thread
+        void _handle_writes();
+
+    private:
+        Options _options;
+        Backend _backend = Backend::Thread;
+        bool _direct = false;
+        int _fd = -1;
+
+        std::unique_ptr<std::byte, void (*)(void *)> _memory{nullptr, nullptr};
+        std::vector<Block> _blocks;
+        std::vector<size_t> _free; // guarded by _mtx with the thread backend
+        size_t _current = _sync_only;
+        uint64_t _block_offset = 0; // file offset of the current block
+        uint64_t _size = 0;
+        uint64_t _stalls = 0;
+        std::atomic<bool> _failed{false};
+
+        std::chrono::steady_clock::time_point _next_sync;
+        uint32_t _writes_since_time_check = 0;
+        bool _written_since_sync = false;
+
+        struct Ring
+        {
+            int fd = -1;
+            void *sq_ptr = nullptr;
+            size_t sq_size = 0;
+            void *cq_ptr = nullptr;
+            size_t cq_size = 0;
+            io_uring_sqe *sqes = nullptr;
+            size_t sqes_size = 0;
+            unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+            unsigned *cq_head, *cq_tail, *cq_mask;
+            io_uring_cqe *cqes;
+            unsigned in_flight = 0;
+        } _ring;
+
+        std::thread _writer_thread;
+        std::mutex _mtx;
+        std::condition_variable _pending_cv;
+        std::condition_variable _free_cv;
+        std::deque<size_t> _pending;
+        bool _stop = false;
+    };
+}
+
+#endif // __ASYNCFILESINK_H__
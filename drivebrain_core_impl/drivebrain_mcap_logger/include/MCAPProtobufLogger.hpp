@@ -2,49 +2,242 @@
 #define __MCAPPROTOBUFLOGGER_H__
 
 #include <google/protobuf/message.h>
+#include <google/protobuf/descriptor.h>
 #include <mcap.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <memory>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <mcap/writer.hpp>
 #include <mcap/mcap.hpp>
 #include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <Configurable.hpp>
 #include <DriverBus.hpp>
+#include <Logger.hpp>
+#include <JsonFileHandler.hpp>
+#include <RingBus.hpp>
+#include <MessagePool.hpp>
+#include <ChannelDecimator.hpp>
+#include <AsyncFileSink.hpp>
+#include <AcquisitionTime.hpp>
+#include <db_service/v1/logger/logger_diagnostics.pb.h>
+#include <db_service/v1/estimation/input_staleness.pb.h>
+#include <db_service/v1/estimation/input_latency.pb.h>
+#include <db_service/v1/estimation/estimation_signals.pb.h>
 
 #include <thread>
 namespace common
 {
-    class MCAPProtobufLogger 
+    // params (read again for every new mcap, so live changes apply from the next log session on):
+    // - compression: "none", "lz4" or "zstd". chunks are compressed one at a time as they fill up
+    // - compression_level: "fastest", "fast", "default", "slow" or "slowest"
+    // - chunk_size_kb: uncompressed size a chunk is written out at. 0 turns chunking off (and with it
+    //   compression and the chunk index that lets foxglove seek)
+    // - file_sink: "buffered" writes the file with the mcap library's FILE* writer on the logger
+    //   thread, "async" through an AsyncFileSink so the logger thread does not wait for the disk
+    //   (default "buffered")
+    // - sync_period_ms: with the async sink, how often what has been written so far is made durable
+    //   (default 1000, 0 only when the file is closed)
+    // - direct_io: with the async sink, write the file with O_DIRECT past the page cache (default false)
+    // - rotate_size_mb / rotate_period_s: once the mcap is this big or this old it is closed and
+    //   logging carries on in <name>_001.mcap, <name>_002.mcap, ... 0 turns the limit off (default 0).
+    //   every finished part has its summary, so an unclean shutdown only costs the index of the last
+    //   one (mcap_recover rebuilds it)
+    // - decimation: which messages of a channel go into the mcap, a util::ChannelDecimator rule list, eg.
+    //   "VehicleData:hz=100, drivetrain_status_telem:on_change". checked in log_msg before anything is
+    //   serialized or queued. channels that are not in it are logged at full rate (default "")
+    // - live_decimation: the same for what goes out live on foxglove, see keep_live (default "")
+    // - deferred_serialization: log_msg only enqueues the message and the time, the logger thread
+    //   serializes it. the caller must not change a message after logging it (take a new one from a
+    //   util::MessagePool instead of reusing it)
+
+    // read once at construction, the queue cannot change size or policy while it is in use:
+    // - queue_capacity: messages waiting to be written, rounded up to a power of two (default 16384)
+    // - queue_policy: what log_msg does when the logger thread falls behind (default "drop_oldest")
+    //   - "block": waits until there is room. holds up the thread that logs, eg. the CAN io_context
+    //   - "drop_oldest": messages that have not been written yet are overwritten by new ones
+    //   - "priority": once the queue is 3/4 full, new messages of channels not in priority_channels
+    //     are dropped, past that like drop_oldest
+    // - priority_channels: comma separated message names kept by the "priority" policy
+    // - diagnostics_period_ms: how often a db_service.v1.logger.LoggerDiagnostics with the queue depth
+    //   and the enqueued / written / dropped counts per channel goes into the mcap and to the
+    //   diagnostics handler (default 1000). only while messages are being logged
+
+    // without deferred serialization log_msg serializes straight into one of two byte arenas. the
+    // logger thread writes the messages out of the other one and swaps them once it gets to messages
+    // in the one producers are filling, so after the arenas have grown to fit a burst nothing on the
+    // write path allocates. the channel of a message is looked up by its descriptor once in log_msg
+    // and carried along as the logger's channel number
+
+    // a file only gets the schemas and channels of the message types that are actually written to it,
+    // each added right before its first message. the schema data (the FileDescriptorSet of the
+    // message's .proto) is built once per process and shared by every message type of a .proto
+    class MCAPProtobufLogger : public core::common::Configurable
     {
     public:
         struct ProtobufRawMessage
         {
-            std::string serialized_data;
-            std::string message_name;
-            uint64_t log_time;
+            // only set with deferred serialization, the payload is not in an arena then
+            std::shared_ptr<google::protobuf::Message> msg;
+            uint16_t channel; // index into _channel_descriptors
+            uint8_t arena;
+            uint32_t offset;
+            uint32_t size;
+            uint64_t log_time; // steady clock, made into wall time on the logger thread. the acquisition time for received messages
+            uint64_t sequence; // per channel, goes into the mcap so gaps show where messages were dropped
         };
 
-        
+        enum class QueuePolicy
+        {
+            Block,
+            DropOldest,
+            Priority
+        };
+
+        struct SessionConfig
+        {
+            std::string compression;
+            std::string compression_level;
+            int chunk_size_kb;
+            std::string file_sink = "buffered";
+            int sync_period_ms = 1000;
+            bool direct_io = false;
+            int rotate_size_mb = 0;
+            int rotate_period_s = 0;
+        };
 
-        MCAPProtobufLogger(const std::string &base_dir);
+        MCAPProtobufLogger(core::Logger &logger, core::JsonFileHandler &json_file_handler, const std::string &base_dir);
         ~MCAPProtobufLogger();
 
-        /// @brief 
-        /// @param out_msg 
+        bool init() override;
+
+        /// @brief builds the writer options for a log session
+        /// @return nullopt if the compression or compression level is not one of the names above
+        static std::optional<mcap::McapWriterOptions> make_writer_options(const SessionConfig &config);
+
+        /// @return nullopt if the name is not one of the queue_policy names above
+        static std::optional<QueuePolicy> parse_queue_policy(const std::string &name);
+
+        /// @brief enqueues a message to be written to the current mcap, does nothing between log
+        ///        sessions (before open_new_mcap and after close_current_mcap)
+        /// @param out_msg not to be modified after this with deferred serialization on
         void log_msg(std::shared_ptr<google::protobuf::Message> out_msg);
         void open_new_mcap(const std::string &name);
         void close_current_mcap();
 
+        /// @brief name of a part of a rotated log session, part 0 is the name itself
+        /// @return eg. logs/run.mcap, 2 -> logs/run_002.mcap
+        static std::string part_name(const std::string &name, int part);
+
+        /// @brief applies the live_decimation rules to a message that is about to be sent out live
+        /// @return true if it should be sent, always for messages that are not logged
+        bool keep_live(const google::protobuf::Message &msg);
+
+        /// @brief number of messages lost so far, because the logger thread fell behind or they could
+        ///        not be written
+        uint64_t dropped() const;
+
+        struct ChannelCounts
+        {
+            uint64_t enqueued = 0;
+            uint64_t written = 0;
+            uint64_t dropped = 0;
+        };
+        /// @brief the counts of a message type so far, the same as in the diagnostics
+        ChannelCounts channel_counts(const google::protobuf::Descriptor *descriptor) const;
+
+        /// @brief gets every diagnostics message (on the logger thread), eg. to send it out live
+        ///        on foxglove. set before logging starts, cleared with nullptr before what it calls
+        ///        goes away (the logger thread runs until the logger is destroyed)
+        void set_diagnostics_handler(std::function<void(std::shared_ptr<google::protobuf::Message>)> handler);
+
     private:
+        struct ChannelStats
+        {
+            std::atomic<uint64_t> enqueued{0}; // also the last sequence number handed out
+            std::atomic<uint64_t> written{0};
+            // not enqueued because of the policy, overwritten in the queue, or not written to the file
+            std::atomic<uint64_t> dropped{0};
+        };
+
+        // growable byte buffer that keeps its memory, unlike std::vector it does not zero what it hands out
+        struct PayloadArena
+        {
+            std::unique_ptr<std::byte[]> data;
+            size_t size = 0;
+            size_t capacity = 0;
+        };
+        std::byte *_arena_alloc(size_t size);
+
+        // all of these with _logger_mtx held
+        void _open_file(const std::string &path);
+        void _close_file();
+        void _rotate_if_due();
+        /// @brief the mcap channel id of a channel in the current file, adds the channel if needed
+        mcap::ChannelId _mcap_channel(size_t channel);
+
         void _handle_log_to_file();
+        void _write_diagnostics(std::string &serialize_buffer);
+        void _handle_param_updates(const std::unordered_map<std::string, core::common::Configurable::ParamTypes> &new_param_map);
     private:
-        core::common::ThreadSafeDeque<ProtobufRawMessage> _input_deque;
+        // log_msg is called from every thread that receives or sends messages, they take turns
+        // publishing. the ring itself always overwrites, blocking is done in log_msg so that a
+        // waiting producer does not hold _publish_mtx
+        QueuePolicy _queue_policy;
+        std::string _queue_policy_name;
+        std::unique_ptr<util::RingBus<ProtobufRawMessage>> _input_bus;
+        std::mutex _publish_mtx;
+        std::condition_variable _space_cv;
+        std::atomic<int> _producers_waiting{0};
+        bool _closing = false; // guarded by _publish_mtx
+        std::unique_ptr<util::RingBus<ProtobufRawMessage>::Reader> _input_reader;
         std::thread _log_thread;
-        bool _running = false;
-        mcap::McapWriterOptions _options;
+        std::mutex _config_mtx;
+        SessionConfig _config;
+        std::atomic<bool> _deferred_serialization{false};
+        std::atomic<bool> _logging{false}; // between open_new_mcap and close_current_mcap
+        int64_t _wall_clock_offset_ns; // system clock - steady clock at construction
+        // only with the async file sink, guarded by _logger_mtx. declared first so the writer that
+        // still writes to it is destroyed before it
+        std::unique_ptr<AsyncFileSink> _sink;
         mcap::McapWriter _writer;
         std::mutex _logger_mtx;
-        std::unordered_map<std::string, uint32_t> _msg_name_id_map;
+        // the current log session, guarded by _logger_mtx
+        bool _file_open = false;
+        std::vector<mcap::ChannelId> _file_channel_ids; // per channel, 0 until it is added to the file
+        std::string _session_name;
+        int _session_part = 0;
+        SessionConfig _session_config;
+        std::optional<mcap::McapWriterOptions> _session_options;
+        std::chrono::steady_clock::time_point _file_opened_at;
+        // filled in the constructor and only read after that, so log_msg needs no lock for it
+        std::unordered_map<const google::protobuf::Descriptor *, uint16_t> _channel_ids;
+        // indexed by channel, same lifetime as _channel_ids
+        std::unique_ptr<ChannelStats[]> _channel_stats;
+        std::vector<const google::protobuf::Descriptor *> _channel_descriptors;
+        std::vector<uint8_t> _priority_channel;
+        // indexed by channel too
+        std::unique_ptr<util::ChannelDecimator> _disk_decimator;
+        std::unique_ptr<util::ChannelDecimator> _live_decimator;
+        uint16_t _diagnostics_channel;
+
+        std::chrono::milliseconds _diagnostics_period;
+        std::function<void(std::shared_ptr<google::protobuf::Message>)> _diagnostics_handler;
+        util::MessagePool _diagnostics_pool; // logger thread only
+
+        // guarded by _publish_mtx, only the logger thread changes _active_arena
+        std::array<PayloadArena, 2> _arenas;
+        uint8_t _active_arena = 0;
+        // a stalled logger thread drops messages instead of growing an arena without end
+        static constexpr size_t _arena_limit = 16 * 1024 * 1024;
+        static constexpr size_t _max_batch = 1024;
 
     };
 }
@@ -0,0 +1,46 @@
+#ifndef __MCAPSCHEMAPOOL_H__
+#define __MCAPSCHEMAPOOL_H__
+
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/descriptor_database.h>
+#include <google/protobuf/dynamic_message.h>
+#include <google/protobuf/message.h>
+
+#include <mcap/types.hpp>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// turns the schemas of a protobuf MCAP back into message types for the offline tools that read
+// logs (mcap_replay, mcap_columns). a schema whose name is a message type compiled into the program
+// gets that type, so the result can be cast to the generated class. any other schema is built from
+// the FileDescriptorSet stored in the MCAP (see util::serialized_file_descriptor_set) and gets a
+// DynamicMessage, eg. for messages that were logged by an older or newer version of the protos.
+
+// not thread safe. the prototypes it hands out live as long as the pool and can be used to create
+// messages (prototype->New()) from any thread
+namespace common
+{
+    class McapSchemaPool
+    {
+    public:
+        /// @return prototype of the schema's message type, nullptr if the schema is not protobuf or
+        ///         does not describe its message. asking again for the same schema is a lookup
+        const google::protobuf::Message *prototype(const mcap::Schema &schema);
+
+        /// @brief number of schemas that had to be built from the MCAP
+        size_t embedded_schemas() const { return _embedded_pools.size(); }
+
+    private:
+        const google::protobuf::Message *_make_prototype(const mcap::Schema &schema);
+
+    private:
+        // a pool needs its database and the dynamic prototypes need their pool
+        std::vector<std::unique_ptr<google::protobuf::SimpleDescriptorDatabase>> _embedded_databases;
+        std::vector<std::unique_ptr<google::protobuf::DescriptorPool>> _embedded_pools;
+        google::protobuf::DynamicMessageFactory _dynamic_factory;
+        std::unordered_map<mcap::SchemaId, const google::protobuf::Message *> _prototypes;
+    };
+}
+#endif // __MCAPSCHEMAPOOL_H__
@@ -0,0 +1,554 @@
+#include <AsyncFileSink.hpp>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+namespace common
+{
+    namespace
+    {
+        constexpr size_t alignment = 4096;
+
+        size_t align_up(size_t size)
+        {
+            return (size + alignment - 1) / alignment * alignment;
+        }
+
+        // the kernel and we share the ring indexes
+        unsigned load_acquire(const unsigned *p)
+        {
+            return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+        }
+
+        void store_release(unsigned *p, unsigned value)
+        {
+            __atomic_store_n(p, value, __ATOMIC_RELEASE);
+        }
+    }
+
+    AsyncFileSink::AsyncFileSink(const Options &options) : _options(options)
+    {
+        _options.block_size = align_up(std::max<size_t>(_options.block_size, alignment));
+        _options.num_blocks = std::max<size_t>(_options.num_blocks, 2);
+    }
+
+    AsyncFileSink::~AsyncFileSink()
+    {
+        end();
+    }
+
+    bool AsyncFileSink::open(const std::string &path)
+    {
+        end();
+        const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        _direct = false;
+        if (_options.direct_io)
+        {
+            _fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+            _direct = _fd >= 0;
+            if (!_direct)
+            {
+                spdlog::warn("O_DIRECT not supported for {} ({}), using buffered writes", path, std::strerror(errno));
+            }
+        }
+        if (_fd < 0)
+        {
+            _fd = ::open(path.c_str(), flags, 0644);
+        }
+        if (_fd < 0)
+        {
+            spdlog::error("failed to open {}: {}", path, std::strerror(errno));
+            return false;
+        }
+
+        if (!_memory)
+        {
+            void *memory = nullptr;
+            if (posix_memalign(&memory, alignment, _options.block_size * _options.num_blocks) != 0)
+            {
+                spdlog::error("failed to allocate {} blocks of {} bytes for {}", _options.num_blocks, _options.block_size, path);
+                ::close(_fd);
+                _fd = -1;
+                return false;
+            }
+            _memory = std::unique_ptr<std::byte, void (*)(void *)>(static_cast<std::byte *>(memory), std::free);
+            _blocks.resize(_options.num_blocks);
+            for (size_t i = 0; i < _blocks.size(); i++)
+            {
+                _blocks[i].data = _memory.get() + i * _options.block_size;
+            }
+        }
+        _free.clear();
+        for (size_t i = 0; i < _blocks.size(); i++)
+        {
+            _free.push_back(i);
+        }
+        _size = 0;
+        _block_offset = 0;
+        _stalls = 0;
+        _failed = false;
+        _written_since_sync = false;
+        _next_sync = std::chrono::steady_clock::now() + _options.sync_period;
+
+        if (_options.use_io_uring && _setup_io_uring())
+        {
+            _backend = Backend::IoUring;
+        }
+        else
+        {
+            _backend = Backend::Thread;
+            _stop = false;
+            _writer_thread = std::thread(&AsyncFileSink::_handle_writes, this);
+        }
+        _current = _acquire_block();
+        _blocks[_current].len = 0;
+        return true;
+    }
+
+    void AsyncFileSink::handleWrite(const std::byte *data, uint64_t size)
+    {
+        if (_fd < 0)
+        {
+            return;
+        }
+        _size += size;
+        if (_failed)
+        {
+            return;
+        }
+        while (size > 0)
+        {
+            Block &block = _blocks[_current];
+            const size_t n = std::min<uint64_t>(size, _options.block_size - block.len);
+            std::memcpy(block.data + block.len, data, n);
+            block.len += n;
+            data += n;
+            size -= n;
+            if (block.len == _options.block_size)
+            {
+                _submit(_current, block.len, false);
+                _block_offset += _options.block_size;
+                _current = _acquire_block();
+                _blocks[_current].len = 0;
+            }
+        }
+
+        // looking at the clock for every record is more than this needs
+        if (_options.sync_period.count() > 0 && ++_writes_since_time_check >= 64)
+        {
+            _writes_since_time_check = 0;
+            if (std::chrono::steady_clock::now() >= _next_sync)
+            {
+                _durability_point();
+            }
+        }
+    }
+
+    void AsyncFileSink::flush()
+    {
+        if (_fd >= 0 && !_failed)
+        {
+            _durability_point();
+        }
+    }
+
+    void AsyncFileSink::_durability_point()
+    {
+        _next_sync = std::chrono::steady_clock::now() + _options.sync_period;
+        if (_failed)
+        {
+            return;
+        }
+        // direct writes have to stay aligned, the last few bytes wait for the next time
+        const size_t used = _blocks[_current].len;
+        const size_t len = _direct ? used / alignment * alignment : used;
+        if (len > 0)
+        {
+            // the block is still being filled, write out a copy of what is in it
+            size_t copy = _acquire_block();
+            if (copy == _current)
+            {
+                // the write that failed while waiting for a free block was the last one
+                return;
+            }
+            std::memcpy(_blocks[copy].data, _blocks[_current].data, used);
+            _blocks[copy].len = used;
+            std::swap(_current, copy);
+            _submit(copy, len, true);
+        }
+        else if (_written_since_sync)
+        {
+            _submit(_sync_only, 0, true);
+        }
+    }
+
+    void AsyncFileSink::end()
+    {
+        if (_fd < 0)
+        {
+            return;
+        }
+        const size_t used = _blocks[_current].len;
+        if (used > 0)
+        {
+            _submit(_current, used, true);
+        }
+        else
+        {
+            {
+                std::unique_lock lk(_mtx);
+                _free.push_back(_current);
+            }
+            if (_written_since_sync)
+            {
+                _submit(_sync_only, 0, true);
+            }
+        }
+        _current = _sync_only;
+
+        if (_backend == Backend::IoUring)
+        {
+            // the blocks have to stay around until the kernel is done with them, failed or not
+            while (_ring.in_flight > 0 && _uring_reap(true))
+            {
+            }
+            _teardown_io_uring();
+        }
+        else
+        {
+            {
+                std::unique_lock lk(_mtx);
+                _stop = true;
+            }
+            _pending_cv.notify_all();
+            _writer_thread.join();
+        }
+
+        // direct writes are padded out to the alignment
+        if (_direct && ftruncate(_fd, static_cast<off_t>(_size)) != 0)
+        {
+            _fail("truncate", errno);
+        }
+        ::close(_fd);
+        _fd = -1;
+    }
+
+    size_t AsyncFileSink::_acquire_block()
+    {
+        if (_backend == Backend::IoUring)
+        {
+            _uring_reap(false);
+            if (_free.empty())
+            {
+                _stalls++;
+                while (_free.empty() && _uring_reap(true))
+                {
+                }
+            }
+            if (_free.empty())
+            {
+                // only after a failure, nothing gets written anymore so any block will do
+                return _current;
+            }
+            size_t block = _free.back();
+            _free.pop_back();
+            return block;
+        }
+
+        std::unique_lock lk(_mtx);
+        if (_free.empty())
+        {
+            _stalls++;
+            _free_cv.wait(lk, [this]()
+                          { return !_free.empty(); });
+        }
+        size_t block = _free.back();
+        _free.pop_back();
+        return block;
+    }
+
+    void AsyncFileSink::_submit(size_t block, size_t len, bool sync)
+    {
+        _written_since_sync = !sync;
+        if (block != _sync_only)
+        {
+            Block &b = _blocks[block];
+            b.offset = _block_offset;
+            b.done = 0;
+            b.sync = sync;
+            b.len = len;
+            if (_direct && len % alignment != 0)
+            {
+                // O_DIRECT only writes whole aligned blocks, the padding is cut off again in end()
+                b.len = align_up(len);
+                std::memset(b.data + len, 0, b.len - len);
+            }
+        }
+
+        if (_backend == Backend::IoUring)
+        {
+            if (block == _sync_only)
+            {
+                _uring_submit_sync();
+            }
+            else
+            {
+                _uring_submit(block);
+            }
+            return;
+        }
+
+        {
+            std::unique_lock lk(_mtx);
+            _pending.push_back(block);
+        }
+        _pending_cv.notify_one();
+    }
+
+    void AsyncFileSink::_fail(const char *what, int err)
+    {
+        if (!_failed.exchange(true))
+        {
+            spdlog::error("MCAP file {} failed: {}, the rest of the log is lost", what, std::strerror(err));
+        }
+    }
+
+    void AsyncFileSink::_handle_writes()
+    {
+        std::unique_lock lk(_mtx);
+        while (true)
+        {
+            _pending_cv.wait(lk, [this]()
+                             { return !_pending.empty() || _stop; });
+            if (_pending.empty())
+            {
+                return;
+            }
+            const size_t block = _pending.front();
+            _pending.pop_front();
+            lk.unlock();
+
+            bool sync = true;
+            if (block != _sync_only)
+            {
+                Block &b = _blocks[block];
+                sync = b.sync;
+                while (b.done < b.len && !_failed)
+                {
+                    ssize_t res = pwrite(_fd, b.data + b.done, b.len - b.done, static_cast<off_t>(b.offset + b.done));
+                    if (res < 0 && errno == EINTR)
+                    {
+                        continue;
+                    }
+                    if (res <= 0)
+                    {
+                        // nothing written without an error would be tried again forever
+                        _fail("write", res < 0 ? errno : EIO);
+                        break;
+                    }
+                    b.done += static_cast<size_t>(res);
+                }
+            }
+            if (sync && !_failed && fdatasync(_fd) != 0)
+            {
+                _fail("sync", errno);
+            }
+
+            lk.lock();
+            if (block != _sync_only)
+            {
+                _free.push_back(block);
+                _free_cv.notify_one();
+            }
+        }
+    }
+
+    bool AsyncFileSink::_setup_io_uring()
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        // every block can be in flight with a sync behind it
+        const unsigned entries = static_cast<unsigned>(_options.num_blocks * 2 + 2);
+        _ring.fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (_ring.fd < 0)
+        {
+            spdlog::info("io_uring not available ({}), writing MCAPs from a thread", std::strerror(errno));
+            return false;
+        }
+
+        _ring.sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _ring.cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap)
+        {
+            _ring.sq_size = _ring.cq_size = std::max(_ring.sq_size, _ring.cq_size);
+        }
+        _ring.sq_ptr = mmap(nullptr, _ring.sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring.fd, IORING_OFF_SQ_RING);
+        _ring.cq_ptr = single_mmap ? _ring.sq_ptr
+                                   : mmap(nullptr, _ring.cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring.fd, IORING_OFF_CQ_RING);
+        _ring.sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = mmap(nullptr, _ring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring.fd, IORING_OFF_SQES);
+        if (_ring.sq_ptr == MAP_FAILED || _ring.cq_ptr == MAP_FAILED || sqes == MAP_FAILED)
+        {
+            spdlog::info("could not map the io_uring ({}), writing MCAPs from a thread", std::strerror(errno));
+            _ring.sqes = (sqes == MAP_FAILED) ? nullptr : static_cast<io_uring_sqe *>(sqes);
+            _ring.sq_ptr = (_ring.sq_ptr == MAP_FAILED) ? nullptr : _ring.sq_ptr;
+            _ring.cq_ptr = (_ring.cq_ptr == MAP_FAILED) ? nullptr : _ring.cq_ptr;
+            _teardown_io_uring();
+            return false;
+        }
+        _ring.sqes = static_cast<io_uring_sqe *>(sqes);
+
+        auto sq = static_cast<char *>(_ring.sq_ptr);
+        _ring.sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+        _ring.sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        _ring.sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        _ring.sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        auto cq = static_cast<char *>(_ring.cq_ptr);
+        _ring.cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        _ring.cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        _ring.cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        _ring.cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+        _ring.in_flight = 0;
+        return true;
+    }
+
+    void AsyncFileSink::_teardown_io_uring()
+    {
+        if (_ring.sqes)
+        {
+            munmap(_ring.sqes, _ring.sqes_size);
+        }
+        if (_ring.cq_ptr && _ring.cq_ptr != _ring.sq_ptr)
+        {
+            munmap(_ring.cq_ptr, _ring.cq_size);
+        }
+        if (_ring.sq_ptr)
+        {
+            munmap(_ring.sq_ptr, _ring.sq_size);
+        }
+        if (_ring.fd >= 0)
+        {
+            ::close(_ring.fd);
+        }
+        _ring = Ring{};
+    }
+
+    io_uring_sqe *AsyncFileSink::_uring_get_sqe()
+    {
+        // every entry is submitted right after it is filled in, so the kernel has always taken the
+        // previous ones and the queue has room
+        const unsigned tail = *_ring.sq_tail;
+        const unsigned index = tail & *_ring.sq_mask;
+        io_uring_sqe *sqe = &_ring.sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        _ring.sq_array[index] = index;
+        return sqe;
+    }
+
+    bool AsyncFileSink::_uring_enter(unsigned to_submit, unsigned min_complete)
+    {
+        if (to_submit > 0)
+        {
+            store_release(_ring.sq_tail, *_ring.sq_tail + to_submit);
+        }
+        const unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+        while (syscall(__NR_io_uring_enter, _ring.fd, to_submit, min_complete, flags, nullptr, 0) < 0)
+        {
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            {
+                _fail("io_uring submit", errno);
+                return false;
+            }
+        }
+        _ring.in_flight += to_submit;
+        return true;
+    }
+
+    void AsyncFileSink::_uring_submit(size_t block)
+    {
+        Block &b = _blocks[block];
+        io_uring_sqe *sqe = _uring_get_sqe();
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = _fd;
+        sqe->addr = reinterpret_cast<uint64_t>(b.data + b.done);
+        sqe->len = static_cast<uint32_t>(b.len - b.done);
+        sqe->off = b.offset + b.done;
+        sqe->user_data = block;
+        if (!_uring_enter(1, 0))
+        {
+            // the kernel never saw it, nothing is going to hand the block back
+            _free.push_back(block);
+            return;
+        }
+        if (b.sync)
+        {
+            _uring_submit_sync();
+        }
+    }
+
+    void AsyncFileSink::_uring_submit_sync()
+    {
+        io_uring_sqe *sqe = _uring_get_sqe();
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fd = _fd;
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        sqe->user_data = _sync_only;
+        // writes are not ordered, the sync has to wait for every one queued before it
+        sqe->flags |= IOSQE_IO_DRAIN;
+        _uring_enter(1, 0);
+    }
+
+    bool AsyncFileSink::_uring_reap(bool wait)
+    {
+        if (wait && (_ring.in_flight == 0 || (*_ring.cq_head == load_acquire(_ring.cq_tail) && !_uring_enter(0, 1))))
+        {
+            return false;
+        }
+        unsigned head = *_ring.cq_head;
+        const unsigned tail = load_acquire(_ring.cq_tail);
+        for (; head != tail; head++)
+        {
+            const io_uring_cqe &cqe = _ring.cqes[head & *_ring.cq_mask];
+            const size_t block = static_cast<size_t>(cqe.user_data);
+            const int res = cqe.res;
+            _ring.in_flight--;
+            if (res < 0)
+            {
+                _fail(block == _sync_only ? "sync" : "write", -res);
+            }
+            if (block == _sync_only)
+            {
+                continue;
+            }
+            Block &b = _blocks[block];
+            if (res == 0 && b.done < b.len)
+            {
+                _fail("write", EIO);
+            }
+            if (res > 0 && !_failed)
+            {
+                b.done += static_cast<size_t>(res);
+                if (b.done < b.len)
+                {
+                    // short write, queue the rest. the sync that went in with the block only waited
+                    // for the first part, so a block that wants one gets another one behind the rest
+                    _uring_submit(block);
+                    continue;
+                }
+            }
+            _free.push_back(block);
+        }
+        store_release(_ring.cq_head, head);
+        return true;
+    }
+}
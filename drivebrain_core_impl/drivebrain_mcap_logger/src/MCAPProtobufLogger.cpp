@@ -8,139 +8,753 @@
 #include <mutex>
 #include <versions.h>
 #include <utility>
+#include <variant>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <filesystem>
 #include <spdlog/spdlog.h> 
 
 namespace common
 {
-    MCAPProtobufLogger::MCAPProtobufLogger(const std::string &base_dir)
-        : _options(mcap::McapWriterOptions(""))
+    namespace
     {
-        auto optional_map = util::generate_name_to_id_map({"hytech_msgs.proto", "hytech.proto"});
-        if (optional_map)
+        std::vector<std::string> split_list(const std::string &list)
         {
-            spdlog::info("Opened MCAP"); 
-            _msg_name_id_map = *optional_map;
+            std::vector<std::string> items;
+            std::stringstream stream(list);
+            std::string item;
+            while (std::getline(stream, item, ','))
+            {
+                item.erase(0, item.find_first_not_of(" \t"));
+                item.erase(item.find_last_not_of(" \t") + 1);
+                if (!item.empty())
+                {
+                    items.push_back(item);
+                }
+            }
+            return items;
         }
-        else
+    }
+
+    MCAPProtobufLogger::MCAPProtobufLogger(core::Logger &logger, core::JsonFileHandler &json_file_handler, const std::string &base_dir)
+        : Configurable(logger, json_file_handler, "MCAPProtobufLogger")
+    {
+        // the logger's own channel numbers, 0 is unused like in mcap. a message type only gets an mcap
+        // channel once it is written to a file, with whatever id the writer gives it there
+        _channel_descriptors.push_back(nullptr);
+        for (const auto &file_descriptor : util::get_pb_descriptors({"hytech_msgs.proto", "hytech.proto"}))
         {
-            spdlog::error("Error: No map generated"); 
+            for (int i = 0; i < file_descriptor->message_type_count(); ++i)
+            {
+                _channel_descriptors.push_back(file_descriptor->message_type(i));
+            }
+        }
+        if (_channel_descriptors.size() == 1)
+        {
+            spdlog::error("Error: no message descriptors to log"); 
         }
+        _channel_descriptors.push_back(db_service::v1::estimation::InputStaleness::descriptor());
+        _channel_descriptors.push_back(db_service::v1::estimation::InputLatencies::descriptor());
+        _channel_descriptors.push_back(db_service::v1::estimation::EstimationSignals::descriptor());
+        _channel_descriptors.push_back(db_service::v1::logger::LoggerDiagnostics::descriptor());
+        for (size_t id = 1; id < _channel_descriptors.size(); id++)
         {
-            std::unique_lock lk(_input_deque.mtx);
-            _running = true;
+            _channel_ids[_channel_descriptors[id]] = static_cast<uint16_t>(id);
         }
-        _options.noChunking = true;
+        _diagnostics_channel = static_cast<uint16_t>(_channel_descriptors.size() - 1);
+        _file_channel_ids.resize(_channel_descriptors.size(), 0);
+        _channel_stats = std::make_unique<ChannelStats[]>(_channel_descriptors.size());
+        _disk_decimator = std::make_unique<util::ChannelDecimator>(_channel_descriptors);
+        _live_decimator = std::make_unique<util::ChannelDecimator>(_channel_descriptors);
+
+        const int capacity = get_parameter_value<int>("queue_capacity").value_or(16384);
+        _queue_policy_name = get_parameter_value<std::string>("queue_policy").value_or("drop_oldest");
+        auto policy = parse_queue_policy(_queue_policy_name);
+        if (!policy)
+        {
+            spdlog::error("unknown MCAP logger queue policy {}, dropping the oldest messages", _queue_policy_name);
+            _queue_policy_name = "drop_oldest";
+            policy = QueuePolicy::DropOldest;
+        }
+        _queue_policy = *policy;
+        _priority_channel.resize(_channel_descriptors.size(), 0);
+        for (const auto &name : split_list(get_parameter_value<std::string>("priority_channels").value_or("")))
+        {
+            auto descriptor = std::find_if(_channel_descriptors.begin() + 1, _channel_descriptors.end(),
+                                           [&](const google::protobuf::Descriptor *desc) { return desc->name() == name; });
+            if (descriptor == _channel_descriptors.end())
+            {
+                spdlog::warn("priority channel {} is not a logged message", name);
+                continue;
+            }
+            _priority_channel[descriptor - _channel_descriptors.begin()] = 1;
+        }
+        _diagnostics_period = std::chrono::milliseconds(get_parameter_value<int>("diagnostics_period_ms").value_or(1000));
+
+        const auto steady_now = std::chrono::steady_clock::now().time_since_epoch();
+        const auto system_now = std::chrono::system_clock::now().time_since_epoch();
+        _wall_clock_offset_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(system_now - steady_now).count();
+
+        _input_bus = std::make_unique<util::RingBus<ProtobufRawMessage>>(static_cast<size_t>(std::max(capacity, 1)), util::RingPolicy::Overwrite);
+        // runs on the producer with _publish_mtx held, like the rest of the per channel accounting
+        _input_bus->on_overwrite([this](const ProtobufRawMessage &entry)
+                                 { _channel_stats[entry.channel].dropped.fetch_add(1, std::memory_order_relaxed); });
+        _input_reader = _input_bus->subscribe();
         _log_thread = std::thread(&MCAPProtobufLogger::_handle_log_to_file, this);
     }
     MCAPProtobufLogger::~MCAPProtobufLogger()
     {
         {
-            std::unique_lock lk(_input_deque.mtx);
-            _running = false;
+            // producers still waiting for room give up
+            std::unique_lock lk(_publish_mtx);
+            _closing = true;
         }
-        _input_deque.cv.notify_all();
+        _space_cv.notify_all();
+        // the logger thread gets everything that is still queued before take() tells it to stop
+        _input_bus->close();
         _log_thread.join();
+        // finishes the mcap properly on a clean shutdown, even if logging was never stopped
+        std::unique_lock lk(_logger_mtx);
+        _close_file();
     }
 
-    void MCAPProtobufLogger::open_new_mcap(const std::string &name)
+    bool MCAPProtobufLogger::init()
     {
-        spdlog::info("Open MCAP function called"); 
+        std::optional compression = get_live_parameter<std::string>("compression");
+        std::optional compression_level = get_live_parameter<std::string>("compression_level");
+        std::optional chunk_size_kb = get_live_parameter<int>("chunk_size_kb");
+        std::optional deferred_serialization = get_live_parameter<bool>("deferred_serialization");
 
-        const auto res = _writer.open(name.c_str(), _options);
-        if (!res.ok())
+        if (!(compression && compression_level && chunk_size_kb && deferred_serialization))
         {
-            spdlog::error("Failed to open {} for writing: {}", name, res.message);
+            return false;
         }
-        // TODO handle message name de-confliction for messages of the same name
-        // message-receiving .protos (non-base .proto files)
-        auto receiving_descriptors = util::get_pb_descriptors({"hytech_msgs.proto", "hytech.proto"});
-        // auto schema_only_descriptors = util::get_pb_descriptors({"base_msgs.proto"});
+        _deferred_serialization = *deferred_serialization;
 
-        auto add_schema_func = [this](const std::vector<const google::protobuf::FileDescriptor *> &descriptors, bool skip_channel)
+        SessionConfig config = {*compression, *compression_level, *chunk_size_kb};
+        config.file_sink = get_live_parameter<std::string>("file_sink").value_or(config.file_sink);
+        config.sync_period_ms = get_live_parameter<int>("sync_period_ms").value_or(config.sync_period_ms);
+        config.direct_io = get_live_parameter<bool>("direct_io").value_or(config.direct_io);
+        config.rotate_size_mb = get_live_parameter<int>("rotate_size_mb").value_or(config.rotate_size_mb);
+        config.rotate_period_s = get_live_parameter<int>("rotate_period_s").value_or(config.rotate_period_s);
+        _disk_decimator->set_rules(get_live_parameter<std::string>("decimation").value_or(""));
+        _live_decimator->set_rules(get_live_parameter<std::string>("live_decimation").value_or(""));
+        if (!make_writer_options(config))
+        {
+            spdlog::error("unknown MCAP compression {} or compression level {}", config.compression, config.compression_level);
+            return false;
+        }
+        {
+            std::unique_lock lk(_config_mtx);
+            _config = config;
+        }
+
+        param_update_handler_sig.connect(std::bind(&MCAPProtobufLogger::_handle_param_updates, this, std::placeholders::_1));
+        return true;
+    }
+
+    void MCAPProtobufLogger::_handle_param_updates(const std::unordered_map<std::string, core::common::Configurable::ParamTypes> &new_param_map)
+    {
+        std::unique_lock lk(_config_mtx);
+        if (auto pval = std::get_if<std::string>(&new_param_map.at("compression")))
         {
-            for (const auto &file_descriptor : descriptors)
+            _config.compression = *pval;
+        }
+        if (auto pval = std::get_if<std::string>(&new_param_map.at("compression_level")))
+        {
+            _config.compression_level = *pval;
+        }
+        if (auto pval = std::get_if<int>(&new_param_map.at("chunk_size_kb")))
+        {
+            _config.chunk_size_kb = *pval;
+        }
+        if (auto pval = std::get_if<bool>(&new_param_map.at("deferred_serialization")))
+        {
+            _deferred_serialization = *pval;
+        }
+        // optional params, not in every config
+        if (auto it = new_param_map.find("file_sink"); it != new_param_map.end())
+        {
+            if (auto pval = std::get_if<std::string>(&it->second))
             {
-                for (int i = 0; i < file_descriptor->message_type_count(); ++i)
-                {
-                    const google::protobuf::Descriptor *message_descriptor = file_descriptor->message_type(i);
-                    mcap::Schema schema(message_descriptor->full_name(), "protobuf",
-                                        util::build_file_descriptor_set(message_descriptor).SerializeAsString());
-                    _writer.addSchema(schema);
-                    mcap::Channel channel(message_descriptor->name(), "protobuf", schema.id);
-                    if (!skip_channel)
-                    {
-                        _writer.addChannel(channel);
-                    }
-                }
+                _config.file_sink = *pval;
+            }
+        }
+        if (auto it = new_param_map.find("sync_period_ms"); it != new_param_map.end())
+        {
+            if (auto pval = std::get_if<int>(&it->second))
+            {
+                _config.sync_period_ms = *pval;
+            }
+        }
+        if (auto it = new_param_map.find("direct_io"); it != new_param_map.end())
+        {
+            if (auto pval = std::get_if<bool>(&it->second))
+            {
+                _config.direct_io = *pval;
+            }
+        }
+        if (auto it = new_param_map.find("rotate_size_mb"); it != new_param_map.end())
+        {
+            if (auto pval = std::get_if<int>(&it->second))
+            {
+                _config.rotate_size_mb = *pval;
+            }
+        }
+        if (auto it = new_param_map.find("rotate_period_s"); it != new_param_map.end())
+        {
+            if (auto pval = std::get_if<int>(&it->second))
+            {
+                _config.rotate_period_s = *pval;
+            }
+        }
+        // a list that does not parse leaves the rules as they were
+        if (auto it = new_param_map.find("decimation"); it != new_param_map.end())
+        {
+            if (auto pval = std::get_if<std::string>(&it->second))
+            {
+                _disk_decimator->set_rules(*pval);
+            }
+        }
+        if (auto it = new_param_map.find("live_decimation"); it != new_param_map.end())
+        {
+            if (auto pval = std::get_if<std::string>(&it->second))
+            {
+                _live_decimator->set_rules(*pval);
             }
-        };
-        // add_schema_func(schema_only_descriptors, true);
-        add_schema_func(receiving_descriptors, false);
+        }
+    }
+
+    std::optional<mcap::McapWriterOptions> MCAPProtobufLogger::make_writer_options(const SessionConfig &config)
+    {
+        mcap::McapWriterOptions options("");
+
+        if (config.compression == "none")
+        {
+            options.compression = mcap::Compression::None;
+        }
+        else if (config.compression == "lz4")
+        {
+            options.compression = mcap::Compression::Lz4;
+        }
+        else if (config.compression == "zstd")
+        {
+            options.compression = mcap::Compression::Zstd;
+        }
+        else
+        {
+            return std::nullopt;
+        }
+
+        if (config.compression_level == "fastest")
+        {
+            options.compressionLevel = mcap::CompressionLevel::Fastest;
+        }
+        else if (config.compression_level == "fast")
+        {
+            options.compressionLevel = mcap::CompressionLevel::Fast;
+        }
+        else if (config.compression_level == "default")
+        {
+            options.compressionLevel = mcap::CompressionLevel::Default;
+        }
+        else if (config.compression_level == "slow")
+        {
+            options.compressionLevel = mcap::CompressionLevel::Slow;
+        }
+        else if (config.compression_level == "slowest")
+        {
+            options.compressionLevel = mcap::CompressionLevel::Slowest;
+        }
+        else
+        {
+            return std::nullopt;
+        }
+
+        // message indexes go after every chunk and the chunk index and statistics into the summary
+        // section written on close, that is what foxglove uses to seek without reading the whole file
+        options.noChunking = config.chunk_size_kb <= 0;
+        if (!options.noChunking)
+        {
+            options.chunkSize = static_cast<uint64_t>(config.chunk_size_kb) * 1024;
+        }
+        return options;
+    }
+
+    std::optional<MCAPProtobufLogger::QueuePolicy> MCAPProtobufLogger::parse_queue_policy(const std::string &name)
+    {
+        if (name == "block")
+        {
+            return QueuePolicy::Block;
+        }
+        else if (name == "drop_oldest")
+        {
+            return QueuePolicy::DropOldest;
+        }
+        else if (name == "priority")
+        {
+            return QueuePolicy::Priority;
+        }
+        return std::nullopt;
+    }
 
-        spdlog::info("Added message descriptions to MCAP"); 
+    void MCAPProtobufLogger::set_diagnostics_handler(std::function<void(std::shared_ptr<google::protobuf::Message>)> handler)
+    {
+        std::unique_lock lk(_logger_mtx);
+        _diagnostics_handler = std::move(handler);
+    }
+
+    void MCAPProtobufLogger::open_new_mcap(const std::string &name)
+    {
+        spdlog::info("Open MCAP function called"); 
+
+        SessionConfig config;
+        {
+            std::unique_lock lk(_config_mtx);
+            config = _config;
+        }
+        // an invalid live update falls back to uncompressed chunks instead of not logging at all
+        auto options = make_writer_options(config);
+        if (!options)
+        {
+            spdlog::error("unknown MCAP compression {} or compression level {}, logging uncompressed", config.compression, config.compression_level);
+            options = make_writer_options({"none", "default", config.chunk_size_kb});
+        }
+
+        std::unique_lock lk(_logger_mtx);
+        // the last mcap was not closed, finish it first
+        _close_file();
+        _session_name = name;
+        _session_part = 0;
+        _session_config = config;
+        _session_options = options;
+        _open_file(name);
+        _logging.store(true);
     }
 
     void MCAPProtobufLogger::close_current_mcap()
     {
         spdlog::info("Closing MCAP"); 
+        _logging.store(false);
+        std::unique_lock lk(_logger_mtx);
+        _close_file();
+    }
+
+    std::string MCAPProtobufLogger::part_name(const std::string &name, int part)
+    {
+        if (part == 0)
+        {
+            return name;
+        }
+        std::filesystem::path path(name);
+        const auto stem = path.stem().string();
+        const auto extension = path.extension().string();
+        std::string number = std::to_string(part);
+        number.insert(0, number.size() < 3 ? 3 - number.size() : 0, '0');
+        return (path.parent_path() / (stem + "_" + number + extension)).string();
+    }
+
+    void MCAPProtobufLogger::_open_file(const std::string &path)
+    {
+        // a new sink for every file
+        const auto &config = _session_config;
+        if (config.file_sink == "async")
+        {
+            AsyncFileSink::Options sink_options;
+            sink_options.sync_period = std::chrono::milliseconds(std::max(config.sync_period_ms, 0));
+            sink_options.direct_io = config.direct_io;
+            _sink = std::make_unique<AsyncFileSink>(sink_options);
+            if (!_sink->open(path))
+            {
+                _sink.reset();
+            }
+        }
+        else if (config.file_sink != "buffered")
+        {
+            spdlog::error("unknown MCAP file sink {}, using the buffered one", config.file_sink);
+        }
+
+        if (_sink)
+        {
+            _writer.open(*_sink, *_session_options);
+        }
+        else
+        {
+            const auto res = _writer.open(path.c_str(), *_session_options);
+            if (!res.ok())
+            {
+                spdlog::error("Failed to open {} for writing: {}", path, res.message);
+                return;
+            }
+        }
+        // schemas and channels are only added once a message of the type is written
+        std::fill(_file_channel_ids.begin(), _file_channel_ids.end(), 0);
+        _file_open = true;
+        _file_opened_at = std::chrono::steady_clock::now();
+    }
+
+    mcap::ChannelId MCAPProtobufLogger::_mcap_channel(size_t channel)
+    {
+        if (_file_channel_ids[channel] == 0)
+        {
+            // TODO handle message name de-confliction for messages of the same name
+            const auto descriptor = _channel_descriptors[channel];
+            mcap::Schema schema(descriptor->full_name(), "protobuf", util::serialized_file_descriptor_set(descriptor));
+            _writer.addSchema(schema);
+            mcap::Channel mcap_channel(descriptor->name(), "protobuf", schema.id);
+            _writer.addChannel(mcap_channel);
+            _file_channel_ids[channel] = mcap_channel.id;
+        }
+        return _file_channel_ids[channel];
+    }
+
+    void MCAPProtobufLogger::_close_file()
+    {
+        if (!_file_open)
+        {
+            return;
+        }
+        // writes out the last chunk and the summary section (chunk index, statistics)
         _writer.close();
+        if (_sink)
+        {
+            if (_sink->failed())
+            {
+                spdlog::error("MCAP was not completely written to disk");
+            }
+            _sink.reset();
+        }
+        _file_open = false;
+    }
+
+    void MCAPProtobufLogger::_rotate_if_due()
+    {
+        if (!_file_open)
+        {
+            return;
+        }
+        const auto *sink = _writer.dataSink();
+        const bool size_reached = _session_config.rotate_size_mb > 0 && sink != nullptr &&
+                                  sink->size() >= static_cast<uint64_t>(_session_config.rotate_size_mb) * 1024 * 1024;
+        const bool time_reached = _session_config.rotate_period_s > 0 &&
+                                  std::chrono::steady_clock::now() - _file_opened_at >= std::chrono::seconds(_session_config.rotate_period_s);
+        if (!(size_reached || time_reached))
+        {
+            return;
+        }
+        // between two messages on the logger thread, so the next file starts with the message after
+        // the last one in this one. whatever comes in meanwhile waits in the queue
+        _close_file();
+        _session_part++;
+        const auto next = part_name(_session_name, _session_part);
+        spdlog::info("MCAP reached its {} limit, continuing in {}", size_reached ? "size" : "time", next);
+        _open_file(next);
+    }
+
+    MCAPProtobufLogger::ChannelCounts MCAPProtobufLogger::channel_counts(const google::protobuf::Descriptor *descriptor) const
+    {
+        auto channel = _channel_ids.find(descriptor);
+        if (channel == _channel_ids.end())
+        {
+            return {};
+        }
+        const auto &stats = _channel_stats[channel->second];
+        return {stats.enqueued.load(std::memory_order_relaxed), stats.written.load(std::memory_order_relaxed),
+                stats.dropped.load(std::memory_order_relaxed)};
+    }
+
+    uint64_t MCAPProtobufLogger::dropped() const
+    {
+        uint64_t total = 0;
+        for (size_t id = 1; id < _channel_descriptors.size(); id++)
+        {
+            total += _channel_stats[id].dropped.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    std::byte *MCAPProtobufLogger::_arena_alloc(size_t size)
+    {
+        auto &arena = _arenas[_active_arena];
+        if (arena.size + size > arena.capacity)
+        {
+            if (arena.size + size > _arena_limit)
+            {
+                return nullptr;
+            }
+            // entries already published point into the arena by offset, so the contents move along
+            size_t capacity = std::max<size_t>(arena.capacity * 2, 64 * 1024);
+            while (capacity < arena.size + size)
+            {
+                capacity *= 2;
+            }
+            std::unique_ptr<std::byte[]> data(new std::byte[capacity]);
+            if (arena.size > 0)
+            {
+                std::memcpy(data.get(), arena.data.get(), arena.size);
+            }
+            arena.data = std::move(data);
+            arena.capacity = capacity;
+        }
+        std::byte *out = arena.data.get() + arena.size;
+        arena.size += size;
+        return out;
     }
 
     void MCAPProtobufLogger::_handle_log_to_file()
     {
-        core::common::ThreadSafeDeque<ProtobufRawMessage> q;
+        ProtobufRawMessage entry;
+        // deferred messages are serialized into this, it keeps its capacity from message to message
+        std::string serialize_buffer;
+        uint64_t reported_dropped = 0;
+        auto next_diagnostics = std::chrono::steady_clock::now() + _diagnostics_period;
 
         // this will occasionally take a while (~200ms) to complete a loop iteration so this is in its own thread
-        while (true)
+        while (_input_reader->take(entry))
         {
+            // write everything that is queued up in one go instead of locking for every message. a
+            // batch is capped so that diagnostics and rotation still happen while producers keep the
+            // queue from ever running empty
+            std::unique_lock lk(_logger_mtx);
+            size_t batch = 0;
+            do
             {
-                std::unique_lock lk(_input_deque.mtx);
-                _input_deque.cv.wait(lk, [this]()
-                                    { return !_input_deque.deque.empty() || !_running; });
-                if (!_running)
+                if (!entry.msg && entry.arena == _active_arena)
                 {
-                    _input_deque.deque.clear();
-                    return;
+                    // everything in the other arena has been written, producers can have it back.
+                    // the one this entry is in stays as it is until we are through it
+                    std::unique_lock publish_lk(_publish_mtx);
+                    _active_arena ^= 1;
+                    _arenas[_active_arena].size = 0;
                 }
-                q.deque = _input_deque.deque;
-                _input_deque.deque.clear();
-            }
-            for (auto &msg : q.deque)
-            {
-                mcap::Message msg_to_log;
-                msg_to_log.data = reinterpret_cast<const std::byte *>(msg.serialized_data.data());
-                msg_to_log.dataSize = msg.serialized_data.size();
-                msg_to_log.logTime = msg.log_time;
-                msg_to_log.publishTime = msg.log_time;
+                auto &stats = _channel_stats[entry.channel];
+                if (!_file_open)
+                {
+                    // the mcap could not be opened (or the next part of a rotation could not), or the
+                    // message was still queued when the session was closed
+                    stats.dropped.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                {
+                    const std::byte *data;
+                    size_t size;
+                    if (entry.msg)
+                    {
+                        serialize_buffer.resize(entry.msg->ByteSizeLong());
+                        entry.msg->SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t *>(serialize_buffer.data()));
+                        data = reinterpret_cast<const std::byte *>(serialize_buffer.data());
+                        size = serialize_buffer.size();
+                    }
+                    else
+                    {
+                        data = _arenas[entry.arena].data.get() + entry.offset;
+                        size = entry.size;
+                    }
+                    const mcap::Timestamp log_time = static_cast<mcap::Timestamp>(static_cast<int64_t>(entry.log_time) + _wall_clock_offset_ns);
 
-                // msg_to_log.sequence = 0; uh, idk https://github.com/foxglove/mcap/blob/main/cpp/mcap/include/mcap/types.hpp#L184
+                    mcap::Message msg_to_log;
+                    msg_to_log.channelId = _mcap_channel(entry.channel);
+                    // gaps in it show where messages were dropped. mcap sequences are 32 bit, so
+                    // it wraps after 2^32 messages of a channel
+                    msg_to_log.sequence = static_cast<uint32_t>(entry.sequence);
+                    msg_to_log.data = data;
+                    msg_to_log.dataSize = size;
+                    msg_to_log.logTime = log_time;
+                    msg_to_log.publishTime = log_time;
 
-                {
-                    std::unique_lock lk(_logger_mtx);
-                    msg_to_log.channelId = _msg_name_id_map[msg.message_name]; // under the mutex we also lookup in the map
-                    auto write_res = _writer.write(msg_to_log);
+                    const auto write_res = _writer.write(msg_to_log);
+                    (write_res.ok() ? stats.written : stats.dropped).fetch_add(1, std::memory_order_relaxed);
+                }
+
+                // hands a pooled message back to its pool right away
+                entry.msg.reset();
 
-                    spdlog::info("Logging message: {}", msg.message_name); 
+                // with the block policy, there is room in the queue (and maybe in the arena) again
+                if (_producers_waiting.load() > 0)
+                {
+                    std::unique_lock publish_lk(_publish_mtx);
+                    _space_cv.notify_all();
                 }
+            } while (++batch < _max_batch && _input_reader->try_take(entry));
+
+            if (std::chrono::steady_clock::now() >= next_diagnostics)
+            {
+                next_diagnostics += _diagnostics_period;
+                _write_diagnostics(serialize_buffer);
+            }
+            _rotate_if_due();
+            lk.unlock();
+
+            if (dropped() != reported_dropped)
+            {
+                reported_dropped = dropped();
+                spdlog::warn("MCAP logger has dropped {} messages so far", reported_dropped);
             }
-            q.deque.clear();
         }
     }
 
+    void MCAPProtobufLogger::_write_diagnostics(std::string &serialize_buffer)
+    {
+        auto diagnostics = _diagnostics_pool.acquire<db_service::v1::logger::LoggerDiagnostics>();
+        diagnostics->set_queue_policy(_queue_policy_name);
+        diagnostics->set_queue_capacity(static_cast<uint32_t>(_input_bus->capacity()));
+        diagnostics->set_queue_depth(static_cast<uint32_t>(_input_reader->depth()));
+        uint64_t enqueued = 0;
+        uint64_t written = 0;
+        uint64_t dropped = 0;
+        uint64_t decimated = 0;
+        for (size_t id = 1; id < _channel_descriptors.size(); id++)
+        {
+            const auto &stats = _channel_stats[id];
+            // enqueued last so that it is never behind written
+            const uint64_t channel_written = stats.written.load(std::memory_order_relaxed);
+            const uint64_t channel_dropped = stats.dropped.load(std::memory_order_relaxed);
+            const uint64_t channel_enqueued = stats.enqueued.load(std::memory_order_relaxed);
+            const uint64_t channel_decimated = _disk_decimator->decimated(id);
+            if (channel_enqueued + channel_dropped + channel_decimated == 0)
+            {
+                continue;
+            }
+            auto channel = diagnostics->add_channels();
+            channel->set_channel(_channel_descriptors[id]->name());
+            channel->set_enqueued(channel_enqueued);
+            channel->set_written(channel_written);
+            channel->set_dropped(channel_dropped);
+            channel->set_decimated(channel_decimated);
+            enqueued += channel_enqueued;
+            written += channel_written;
+            dropped += channel_dropped;
+            decimated += channel_decimated;
+        }
+        diagnostics->set_enqueued(enqueued);
+        diagnostics->set_written(written);
+        diagnostics->set_dropped(dropped);
+        diagnostics->set_decimated(decimated);
+
+        serialize_buffer.resize(diagnostics->ByteSizeLong());
+        diagnostics->SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t *>(serialize_buffer.data()));
+        const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+        mcap::Message msg_to_log;
+        if (_file_open)
+        {
+            // counted like every other channel, written straight from here instead of the queue
+            auto &stats = _channel_stats[_diagnostics_channel];
+            msg_to_log.channelId = _mcap_channel(_diagnostics_channel);
+            // wraps like the other channels' sequences
+            msg_to_log.sequence = static_cast<uint32_t>(stats.enqueued.fetch_add(1, std::memory_order_relaxed) + 1);
+            msg_to_log.data = reinterpret_cast<const std::byte *>(serialize_buffer.data());
+            msg_to_log.dataSize = serialize_buffer.size();
+            msg_to_log.logTime = static_cast<mcap::Timestamp>(now);
+            msg_to_log.publishTime = static_cast<mcap::Timestamp>(now);
+            const auto write_res = _writer.write(msg_to_log);
+            (write_res.ok() ? stats.written : stats.dropped).fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if (_diagnostics_handler)
+        {
+            _diagnostics_handler(std::move(diagnostics));
+        }
+    }
+
+    bool MCAPProtobufLogger::keep_live(const google::protobuf::Message &msg)
+    {
+        auto channel = _channel_ids.find(msg.GetDescriptor());
+        if (channel == _channel_ids.end())
+        {
+            return true;
+        }
+        const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        return _live_decimator->keep(channel->second, msg, now);
+    }
+
     void MCAPProtobufLogger::log_msg(std::shared_ptr<google::protobuf::Message> msg_out)
     {
-        mcap::Timestamp log_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        if (!_logging.load(std::memory_order_relaxed))
+        {
+            // no log session, nothing to count either
+            return;
+        }
         MCAPProtobufLogger::ProtobufRawMessage msg_to_enque;
-        msg_to_enque.serialized_data = msg_out->SerializeAsString();
-        msg_to_enque.message_name = msg_out->GetDescriptor()->name();
-        msg_to_enque.log_time = log_time;
+        // received messages are logged at the time they were acquired at (see AcquisitionTime.hpp), in
+        // the steady clock like the rest until the logger thread makes it wall time again
+        if (auto acquired = util::AcquisitionTime::current())
+        {
+            msg_to_enque.log_time = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(*acquired).count() - _wall_clock_offset_ns);
+        }
+        else
+        {
+            msg_to_enque.log_time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
 
+        auto channel = _channel_ids.find(msg_out->GetDescriptor());
+        if (channel == _channel_ids.end())
+        {
+            // not from one of the logged .protos, there is no channel for it
+            return;
+        }
+        if (!_disk_decimator->keep(channel->second, *msg_out, static_cast<int64_t>(msg_to_enque.log_time)))
         {
-            std::unique_lock lk(_input_deque.mtx);
-            _input_deque.deque.push_back(msg_to_enque);
-            _input_deque.cv.notify_all();
+            return;
         }
+        msg_to_enque.channel = channel->second;
+        auto &stats = _channel_stats[channel->second];
+
+        const bool deferred = _deferred_serialization.load(std::memory_order_relaxed);
+        // computes and caches the sizes of the sub messages for the serialization below
+        const size_t size = deferred ? 0 : msg_out->ByteSizeLong();
+        const size_t capacity = _input_bus->capacity();
 
-        
+        std::unique_lock lk(_publish_mtx);
+        if (_queue_policy == QueuePolicy::Block)
+        {
+            auto has_room = [&]()
+            {
+                return _closing || (_input_reader->depth() < capacity &&
+                                    (deferred || _arenas[_active_arena].size + size <= _arena_limit));
+            };
+            if (!has_room())
+            {
+                _producers_waiting.fetch_add(1);
+                _space_cv.wait(lk, has_room);
+                _producers_waiting.fetch_sub(1);
+            }
+        }
+        else if (_queue_policy == QueuePolicy::Priority && !_priority_channel[channel->second] &&
+                 _input_reader->depth() >= capacity / 4 * 3)
+        {
+            stats.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (_closing)
+        {
+            // the logger is being destroyed (producers that waited for room give up too), the bus
+            // does not take any more
+            stats.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        if (deferred)
+        {
+            msg_to_enque.msg = std::move(msg_out);
+        }
+        else
+        {
+            std::byte *payload = _arena_alloc(size);
+            // a message with every field at its default serializes to nothing, there may be no arena yet
+            if (payload == nullptr && size > 0)
+            {
+                stats.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            msg_out->SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t *>(payload));
+            msg_to_enque.arena = _active_arena;
+            msg_to_enque.offset = static_cast<uint32_t>(payload - _arenas[_active_arena].data.get());
+            msg_to_enque.size = static_cast<uint32_t>(size);
+        }
+        msg_to_enque.sequence = stats.enqueued.fetch_add(1, std::memory_order_relaxed) + 1;
+        _input_bus->publish(std::move(msg_to_enque));
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,54 @@
+#include <McapSchemaPool.hpp>
+
+#include <google/protobuf/descriptor.pb.h>
+
+#include <spdlog/spdlog.h>
+
+namespace common
+{
+    const google::protobuf::Message *McapSchemaPool::prototype(const mcap::Schema &schema)
+    {
+        auto prototype = _prototypes.find(schema.id);
+        if (prototype == _prototypes.end())
+        {
+            prototype = _prototypes.emplace(schema.id, _make_prototype(schema)).first;
+        }
+        return prototype->second;
+    }
+
+    const google::protobuf::Message *McapSchemaPool::_make_prototype(const mcap::Schema &schema)
+    {
+        if (schema.encoding != "protobuf")
+        {
+            spdlog::warn("schema {} is {}, not protobuf", schema.name, schema.encoding);
+            return nullptr;
+        }
+        const auto generated = google::protobuf::DescriptorPool::generated_pool()->FindMessageTypeByName(schema.name);
+        if (generated != nullptr)
+        {
+            return google::protobuf::MessageFactory::generated_factory()->GetPrototype(generated);
+        }
+
+        google::protobuf::FileDescriptorSet descriptor_set;
+        if (!descriptor_set.ParseFromArray(schema.data.data(), static_cast<int>(schema.data.size())))
+        {
+            spdlog::warn("schema of {} is not a FileDescriptorSet", schema.name);
+            return nullptr;
+        }
+        auto database = std::make_unique<google::protobuf::SimpleDescriptorDatabase>();
+        for (const auto &file : descriptor_set.file())
+        {
+            database->Add(file);
+        }
+        auto pool = std::make_unique<google::protobuf::DescriptorPool>(database.get());
+        const auto descriptor = pool->FindMessageTypeByName(schema.name);
+        if (descriptor == nullptr)
+        {
+            spdlog::warn("schema of {} does not describe it", schema.name);
+            return nullptr;
+        }
+        _embedded_databases.push_back(std::move(database));
+        _embedded_pools.push_back(std::move(pool));
+        return _dynamic_factory.GetPrototype(descriptor);
+    }
+}
@@ -19,7 +19,9 @@ in
       serviceConfig = {
         After = [ "network.target" ];
         ExecStart = "${pkgs.drivebrain_software}/bin/alpha_build /home/nixos/config/drivebrain_config.json ${pkgs.ht_can_pkg}/hytech.dbc";
-        ExecStop = "/bin/kill -9 $MAINPID";
+        # SIGTERM lets the logger finish the current mcap, only if that hangs it gets killed
+        KillSignal = "SIGTERM";
+        TimeoutStopSec = "10s";
         Restart = "on-failure";
       };
     };
@@ -0,0 +1,171 @@
+// benchmark for CAN frame decoding. compares the previous receive path (dbcppp message clone per frame,
+// string keyed map of signal values and by-name reflection) against the decode plans compiled by
+// comms::CANMessageCodec, with and without the typed functions generated from the DBC at build time.
+// frames are generated with random payloads for every message in the DBC.
+
+// usage: bench_can_decode [path to dbc] [number of frames]
+
+#include <CANCodec.hpp>
+#include <GeneratedCANCodec.hpp>
+#include <hytech.pb.h>
+
+#include <google/protobuf/dynamic_message.h>
+#include <google/protobuf/message.h>
+
+#include <linux/can.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+using FieldVariant = std::variant<int32_t, double>;
+
+// the decode path from before the codec, kept here only as the baseline
+static std::shared_ptr<google::protobuf::Message> legacy_decode(const std::unordered_map<uint64_t, std::unique_ptr<dbcppp::IMessage>> &messages, const can_frame &frame)
+{
+    auto iter = messages.find(frame.can_id);
+    if (iter == messages.end())
+    {
+        return nullptr;
+    }
+    auto msg = iter->second->Clone();
+    const auto *desc = google::protobuf::DescriptorPool::generated_pool()->FindMessageTypeByName("hytech." + comms::CANMessageCodec::to_lowercase(msg->Name()));
+    if (!desc)
+    {
+        return nullptr;
+    }
+    std::shared_ptr<google::protobuf::Message> out(google::protobuf::MessageFactory::generated_factory()->GetPrototype(desc)->New());
+
+    std::unordered_map<std::string, FieldVariant> field_map;
+    for (const dbcppp::ISignal &sig : msg->Signals())
+    {
+        auto raw_value = sig.Decode(frame.data);
+        if (sig.ValueEncodingDescriptions_Size() > 1)
+        {
+            field_map[sig.Name()] = static_cast<int>(raw_value);
+        }
+        else
+        {
+            field_map[sig.Name()] = sig.RawToPhys(raw_value);
+        }
+    }
+
+    const auto *reflection = out->GetReflection();
+    for (int i = 0; i < desc->field_count(); ++i)
+    {
+        const auto *field = desc->field(i);
+        auto it = field_map.find(field->name());
+        if (it == field_map.end() || field->is_repeated())
+        {
+            continue;
+        }
+        double value = std::holds_alternative<double>(it->second) ? std::get<double>(it->second) : std::get<int32_t>(it->second);
+        switch (field->type())
+        {
+        case google::protobuf::FieldDescriptor::TYPE_ENUM:
+            reflection->SetEnumValue(out.get(), field, static_cast<int>(value));
+            break;
+        case google::protobuf::FieldDescriptor::TYPE_FLOAT:
+            reflection->SetFloat(out.get(), field, static_cast<float>(value));
+            break;
+        case google::protobuf::FieldDescriptor::TYPE_BOOL:
+            reflection->SetBool(out.get(), field, static_cast<bool>(value));
+            break;
+        case google::protobuf::FieldDescriptor::TYPE_DOUBLE:
+            reflection->SetDouble(out.get(), field, value);
+            break;
+        case google::protobuf::FieldDescriptor::TYPE_INT32:
+            reflection->SetInt32(out.get(), field, static_cast<int32_t>(value));
+            break;
+        default:
+            break;
+        }
+    }
+    return out;
+}
+
+template <typename DecodeFunc>
+static double frames_per_sec(const std::vector<can_frame> &frames, size_t total_frames, DecodeFunc &&decode)
+{
+    size_t decoded = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < total_frames; ++i)
+    {
+        auto msg = decode(frames[i % frames.size()]);
+        decoded += (msg != nullptr);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double secs = std::chrono::duration<double>(end - start).count();
+    if (decoded == 0)
+    {
+        std::cerr << "no frames were decoded, check that the DBC matches hytech.proto" << std::endl;
+    }
+    return static_cast<double>(total_frames) / secs;
+}
+
+int main(int argc, char **argv)
+{
+    std::string dbc_path = (argc > 1) ? argv[1] : "config/hytech.dbc";
+    size_t total_frames = (argc > 2) ? std::stoul(argv[2]) : 1000000;
+
+    std::unique_ptr<dbcppp::INetwork> net;
+    {
+        std::ifstream idbc(dbc_path);
+        net = dbcppp::INetwork::LoadDBCFromIs(idbc);
+    }
+    if (!net)
+    {
+        std::cerr << "failed to load " << dbc_path << std::endl;
+        return 1;
+    }
+
+    std::unordered_map<uint64_t, std::unique_ptr<dbcppp::IMessage>> messages;
+    for (const auto &msg : net->Messages())
+    {
+        messages.insert(std::make_pair(msg.Id(), msg.Clone()));
+    }
+
+    comms::CANMessageCodec codec;
+    if (!codec.build(*net))
+    {
+        std::cerr << "failed to build decode plans" << std::endl;
+        return 1;
+    }
+    comms::CANMessageCodec generated_codec;
+    generated_codec.build(*net);
+    size_t num_generated = generated_codec.use_generated(comms::generated::message_codecs, comms::generated::num_message_codecs);
+
+    std::mt19937 rng(42);
+    std::vector<can_frame> frames;
+    for (const auto &plan : codec.decode_plans())
+    {
+        can_frame frame{};
+        frame.can_id = plan.can_id;
+        frame.len = plan.message_size;
+        for (auto &byte : frame.data)
+        {
+            byte = static_cast<uint8_t>(rng());
+        }
+        frames.push_back(frame);
+    }
+    std::shuffle(frames.begin(), frames.end(), rng);
+
+    std::cout << "decoding " << total_frames << " frames over " << frames.size() << " CAN IDs" << std::endl;
+
+    double legacy = frames_per_sec(frames, total_frames, [&](const can_frame &f) { return legacy_decode(messages, f); });
+    double planned = frames_per_sec(frames, total_frames, [&](const can_frame &f) { return codec.decode(f.can_id, f.data, f.len); });
+    double generated = frames_per_sec(frames, total_frames, [&](const can_frame &f) { return generated_codec.decode(f.can_id, f.data, f.len); });
+
+    std::cout << "legacy (clone + map + reflection by name): " << legacy << " frames/s" << std::endl;
+    std::cout << "decode plans:                              " << planned << " frames/s" << std::endl;
+    std::cout << "generated typed codec:                     " << generated << " frames/s (" << num_generated << " messages)" << std::endl;
+    std::cout << "speedup: " << (planned / legacy) << "x (plans), " << (generated / legacy) << "x (generated)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,173 @@
+// measures the CPU time that the CANDriver's io_context thread spends per second of wall time while a
+// synthetic load is put on a (v)can interface. run it once with "kernel_rx_filter" set to true and once
+// with it set to false in the CANDriver section of the config to compare. bring up vcan0 with vcan_bringup.sh.
+
+// the load is a mix of frames with IDs from the DBC and frames with IDs that are not in it (other ECUs
+// on the bus that we don't care about), only the latter get dropped by the kernel filter.
+
+// usage: bench_can_rx_filter [config path] [dbc path] [frames per second] [fraction of foreign frames] [seconds] [interface]
+
+#include <CANComms.hpp>
+#include <JsonFileHandler.hpp>
+#include <Logger.hpp>
+#include <MsgLogger.hpp>
+#include <StateEstimator.hpp>
+
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+static int open_send_socket(const std::string &interface_name)
+{
+    int sock = ::socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (sock < 0)
+    {
+        return -1;
+    }
+    struct ifreq ifr;
+    std::strcpy(ifr.ifr_name, interface_name.c_str());
+    ioctl(sock, SIOCGIFINDEX, &ifr);
+
+    struct sockaddr_can addr = {};
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (::bind(sock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+    {
+        ::close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+static std::chrono::nanoseconds thread_cpu_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+int main(int argc, char **argv)
+{
+    std::string config_path = (argc > 1) ? argv[1] : "config/drivebrain_config.json";
+    std::string dbc_path = (argc > 2) ? argv[2] : "config/hytech.dbc";
+    size_t frames_per_sec = (argc > 3) ? std::stoul(argv[3]) : 8000;
+    double foreign_fraction = (argc > 4) ? std::stod(argv[4]) : 0.5;
+    int seconds = (argc > 5) ? std::stoi(argv[5]) : 10;
+    std::string interface_name = (argc > 6) ? argv[6] : "vcan0";
+
+    core::Logger logger(core::LogLevel::INFO);
+    core::JsonFileHandler config(config_path);
+
+    std::function<void(std::shared_ptr<google::protobuf::Message>)> no_op_log = [](std::shared_ptr<google::protobuf::Message>) {};
+    auto message_logger = std::make_shared<core::MsgLogger<std::shared_ptr<google::protobuf::Message>>>(
+        ".mcap", false, no_op_log, []() {}, [](const std::string &) {}, no_op_log);
+    core::StateEstimator state_estimator(logger, config, message_logger);
+
+    boost::asio::io_context io_context;
+    comms::CANDriver::bustype tx_bus(64, util::RingPolicy::Overwrite);
+    bool construction_failed = false;
+    comms::CANDriver driver(config, logger, message_logger, tx_bus, io_context, dbc_path, construction_failed, state_estimator);
+    if (construction_failed)
+    {
+        std::cerr << "failed to construct CAN driver, is " << interface_name << " up?" << std::endl;
+        return 1;
+    }
+
+    // frames for the DBC messages plus standard IDs that are not in the DBC
+    std::unique_ptr<dbcppp::INetwork> net;
+    {
+        std::ifstream idbc(dbc_path);
+        net = dbcppp::INetwork::LoadDBCFromIs(idbc);
+    }
+    std::set<uint64_t> dbc_ids;
+    std::vector<can_frame> known_frames;
+    for (const auto &msg : net->Messages())
+    {
+        dbc_ids.insert(msg.Id());
+        can_frame frame = {};
+        frame.can_id = static_cast<canid_t>(msg.Id());
+        frame.len = static_cast<uint8_t>(std::min<uint64_t>(msg.MessageSize(), CAN_MAX_DLEN));
+        known_frames.push_back(frame);
+    }
+    std::vector<can_frame> foreign_frames;
+    for (canid_t id = 0; id <= CAN_SFF_MASK && foreign_frames.size() < 64; id++)
+    {
+        if (dbc_ids.count(id) == 0)
+        {
+            can_frame frame = {};
+            frame.can_id = id;
+            frame.len = 8;
+            foreign_frames.push_back(frame);
+        }
+    }
+
+    int send_sock = open_send_socket(interface_name);
+    if (send_sock < 0 || known_frames.empty())
+    {
+        std::cerr << "failed to open send socket" << std::endl;
+        return 1;
+    }
+
+    std::atomic<bool> measuring = true;
+    std::chrono::nanoseconds io_cpu_time{0};
+    std::thread io_thread([&]() {
+        auto start = thread_cpu_time();
+        while (measuring)
+        {
+            io_context.run_for(std::chrono::milliseconds(100));
+        }
+        io_cpu_time = thread_cpu_time() - start;
+    });
+
+    // frames are sent in 1ms bursts to get close to the requested rate without a busy loop
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    const size_t frames_per_ms = std::max<size_t>(1, frames_per_sec / 1000);
+    size_t sent = 0;
+    auto wall_start = std::chrono::steady_clock::now();
+    auto next_tick = wall_start;
+    while (std::chrono::steady_clock::now() - wall_start < std::chrono::seconds(seconds))
+    {
+        for (size_t i = 0; i < frames_per_ms; i++)
+        {
+            const auto &frame = (dist(rng) < foreign_fraction) ? foreign_frames[rng() % foreign_frames.size()]
+                                                               : known_frames[rng() % known_frames.size()];
+            if (::write(send_sock, &frame, sizeof(frame)) == sizeof(frame))
+            {
+                sent++;
+            }
+        }
+        next_tick += std::chrono::milliseconds(1);
+        std::this_thread::sleep_until(next_tick);
+    }
+    auto wall_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    measuring = false;
+    io_thread.join();
+    ::close(send_sock);
+
+    auto stats = driver.get_rx_stats();
+    double cpu_ms = std::chrono::duration<double, std::milli>(io_cpu_time).count();
+    std::cout << "sent " << sent << " frames in " << wall_time << " s (" << (sent / wall_time) << " frames/s, "
+              << (foreign_fraction * 100.0) << "% not in the DBC)" << std::endl;
+    std::cout << "driver received " << stats.frames << " frames in " << stats.wakeups << " wakeups" << std::endl;
+    std::cout << "io thread CPU time: " << (cpu_ms / wall_time) << " ms per second" << std::endl;
+    return 0;
+}
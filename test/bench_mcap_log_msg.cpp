@@ -0,0 +1,260 @@
+// measures the time each producer thread spends inside MCAPProtobufLogger::log_msg, once with the
+// messages serialized on the producer (deferred_serialization false, how the logger used to work) and
+// once with only the message handle and time enqueued and serialization done on the logger thread.
+
+// the producers stand in for the real ones: the io_context thread logging decoded CAN messages, the
+// VN driver at 400 Hz and the state estimator's VehicleData at 1 kHz. every producer takes its messages
+// from its own util::MessagePool like the drivers do.
+
+// the last part checks the whole logger keeps up with one producer logging 50k msgs/s: how many
+// messages get dropped and how much CPU the process uses for it.
+
+// first of all it times opening a new mcap and reports how big a file with no messages in it is,
+// which is what the schemas and channels cost.
+
+// usage: bench_mcap_log_msg [seconds per mode] [output directory]
+
+#include <MCAPProtobufLogger.hpp>
+#include <MessagePool.hpp>
+#include <JsonFileHandler.hpp>
+#include <Logger.hpp>
+#include <hytech.pb.h>
+#include <hytech_msgs.pb.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <time.h>
+
+struct Producer
+{
+    std::string name;
+    std::chrono::microseconds period;
+    // fills in a message from the pool, the argument is a running count
+    std::function<std::shared_ptr<google::protobuf::Message>(util::MessagePool &, int)> make_msg;
+};
+
+static void print_call_times(const std::string &name, std::vector<int64_t> &call_ns)
+{
+    std::sort(call_ns.begin(), call_ns.end());
+    int64_t total = 0;
+    for (auto ns : call_ns)
+    {
+        total += ns;
+    }
+    auto percentile = [&](double p)
+    { return call_ns[std::min(call_ns.size() - 1, static_cast<size_t>(p * call_ns.size()))]; };
+    std::cout << "  " << name << ": " << call_ns.size() << " calls, mean " << (total / static_cast<int64_t>(call_ns.size()))
+              << " ns, p50 " << percentile(0.5) << " ns, p99 " << percentile(0.99) << " ns, max " << call_ns.back() << " ns" << std::endl;
+}
+
+static std::chrono::nanoseconds process_cpu_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+static std::filesystem::path write_config(const std::filesystem::path &out_dir, bool deferred)
+{
+    const auto config_path = out_dir / "bench_mcap_log_msg.json";
+    std::ofstream config(config_path);
+    config << "{\"MCAPProtobufLogger\": {\"compression\": \"zstd\", \"compression_level\": \"fast\", "
+           << "\"chunk_size_kb\": 1024, \"deferred_serialization\": " << (deferred ? "true" : "false") << "}}";
+    return config_path;
+}
+
+static void run_mode(bool deferred, const std::vector<Producer> &producers, std::chrono::seconds duration, const std::filesystem::path &out_dir)
+{
+    const auto config_path = write_config(out_dir, deferred);
+    core::Logger logger(core::LogLevel::WARNING);
+    core::JsonFileHandler json_file_handler(config_path.string());
+    const auto mcap_path = out_dir / "bench_mcap_log_msg.mcap";
+
+    std::vector<std::vector<int64_t>> call_ns(producers.size());
+    {
+        common::MCAPProtobufLogger mcap_logger(logger, json_file_handler, "temp");
+        if (!mcap_logger.init())
+        {
+            std::cerr << "failed to init the logger from " << config_path << std::endl;
+            return;
+        }
+        mcap_logger.open_new_mcap(mcap_path.string());
+
+        std::atomic<bool> running{true};
+        std::vector<std::thread> threads;
+        for (size_t p = 0; p < producers.size(); p++)
+        {
+            threads.emplace_back([&, p]()
+                                 {
+                const auto &producer = producers[p];
+                util::MessagePool pool;
+                auto next = std::chrono::steady_clock::now();
+                for (int i = 0; running; i++)
+                {
+                    auto msg = producer.make_msg(pool, i);
+                    auto start = std::chrono::steady_clock::now();
+                    mcap_logger.log_msg(std::move(msg));
+                    call_ns[p].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+                    next += producer.period;
+                    std::this_thread::sleep_until(next);
+                } });
+        }
+        std::this_thread::sleep_for(duration);
+        running = false;
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        mcap_logger.close_current_mcap();
+    }
+    std::filesystem::remove(mcap_path);
+    std::filesystem::remove(config_path);
+
+    std::cout << (deferred ? "serialized on the logger thread" : "serialized in log_msg") << std::endl;
+    for (size_t p = 0; p < producers.size(); p++)
+    {
+        print_call_times(producers[p].name, call_ns[p]);
+    }
+}
+
+static void run_open_close(int iterations, const std::filesystem::path &out_dir)
+{
+    const auto config_path = write_config(out_dir, true);
+    core::Logger logger(core::LogLevel::WARNING);
+    core::JsonFileHandler json_file_handler(config_path.string());
+    const auto mcap_path = out_dir / "bench_mcap_log_msg_empty.mcap";
+
+    std::vector<int64_t> open_ns;
+    {
+        common::MCAPProtobufLogger mcap_logger(logger, json_file_handler, "temp");
+        if (!mcap_logger.init())
+        {
+            std::cerr << "failed to init the logger from " << config_path << std::endl;
+            return;
+        }
+        for (int i = 0; i < iterations; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            mcap_logger.open_new_mcap(mcap_path.string());
+            open_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+            mcap_logger.close_current_mcap();
+        }
+    }
+    const auto empty_size = std::filesystem::file_size(mcap_path);
+    std::filesystem::remove(mcap_path);
+    std::filesystem::remove(config_path);
+
+    std::cout << "opening an mcap" << std::endl;
+    print_call_times("open_new_mcap      ", open_ns);
+    std::cout << "  empty file: " << empty_size << " bytes" << std::endl;
+}
+
+static void run_sustained(bool deferred, const Producer &producer, int rate, std::chrono::seconds duration, const std::filesystem::path &out_dir)
+{
+    const auto config_path = write_config(out_dir, deferred);
+    core::Logger logger(core::LogLevel::WARNING);
+    core::JsonFileHandler json_file_handler(config_path.string());
+    const auto mcap_path = out_dir / "bench_mcap_log_msg.mcap";
+
+    uint64_t logged = 0;
+    uint64_t dropped = 0;
+    std::chrono::nanoseconds cpu_time{0};
+    {
+        common::MCAPProtobufLogger mcap_logger(logger, json_file_handler, "temp");
+        if (!mcap_logger.init())
+        {
+            std::cerr << "failed to init the logger from " << config_path << std::endl;
+            return;
+        }
+        mcap_logger.open_new_mcap(mcap_path.string());
+
+        util::MessagePool pool;
+        const auto period = std::chrono::nanoseconds(1000000000 / rate);
+        const auto start_cpu = process_cpu_time();
+        const auto end = std::chrono::steady_clock::now() + duration;
+        auto next = std::chrono::steady_clock::now();
+        // sleeping for every 20 us is too coarse, log what is due every 1 ms instead
+        for (int i = 0; next < end; i++)
+        {
+            mcap_logger.log_msg(producer.make_msg(pool, i));
+            logged++;
+            next += period;
+            if (i % (rate / 1000) == 0)
+            {
+                std::this_thread::sleep_until(next);
+            }
+        }
+        mcap_logger.close_current_mcap();
+        cpu_time = process_cpu_time() - start_cpu;
+        dropped = mcap_logger.dropped();
+    }
+    std::filesystem::remove(mcap_path);
+    std::filesystem::remove(config_path);
+
+    std::cout << "  " << (deferred ? "serialized on the logger thread" : "serialized in log_msg ") << ": " << logged << " logged, "
+              << dropped << " dropped, " << (100.0 * std::chrono::duration<double>(cpu_time).count() / duration.count()) << "% of a core" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    std::chrono::seconds duration((argc > 1) ? std::stoi(argv[1]) : 5);
+    const std::filesystem::path out_dir = (argc > 2) ? argv[2] : std::filesystem::temp_directory_path();
+
+    const std::vector<Producer> producers = {
+        {"CAN (io_context)   ", std::chrono::microseconds(250), [](util::MessagePool &pool, int i) -> std::shared_ptr<google::protobuf::Message>
+         {
+             if (i % 2)
+             {
+                 auto msg = pool.acquire<hytech::drivetrain_rpms_telem>();
+                 msg->set_fl_motor_rpm(i % 20000);
+                 msg->set_fr_motor_rpm(i % 20000 + 1);
+                 msg->set_rl_motor_rpm(i % 20000 + 2);
+                 msg->set_rr_motor_rpm(i % 20000 + 3);
+                 return msg;
+             }
+             auto msg = pool.acquire<hytech::drivetrain_status_telem>();
+             msg->set_mc1_dc_on(i % 4 == 0);
+             return msg;
+         }},
+        {"VNData (400 Hz)    ", std::chrono::microseconds(2500), [](util::MessagePool &pool, int i) -> std::shared_ptr<google::protobuf::Message>
+         {
+             auto msg = pool.acquire<hytech_msgs::VNData>();
+             msg->mutable_vn_vel_m_s()->set_x(i * 0.01f);
+             msg->mutable_vn_linear_accel_m_ss()->set_y(i * 0.02f);
+             msg->mutable_vn_angular_rate_rad_s()->set_z(i * 0.03f);
+             msg->mutable_vn_ypr_rad()->set_yaw(i * 0.001f);
+             msg->mutable_vn_gps()->set_lat(33.7f);
+             return msg;
+         }},
+        {"VehicleData (1 kHz)", std::chrono::microseconds(1000), [](util::MessagePool &pool, int i) -> std::shared_ptr<google::protobuf::Message>
+         {
+             auto msg = pool.acquire<hytech_msgs::VehicleData>();
+             msg->set_is_ready_to_drive(true);
+             msg->mutable_current_inputs()->set_accel_percent((i % 100) * 0.01f);
+             msg->mutable_current_body_vel_ms()->set_x(i * 0.01f);
+             msg->mutable_current_rpms()->set_fl(i % 20000);
+             msg->mutable_driver_torque()->set_rr(i % 21);
+             msg->set_state_is_valid(true);
+             return msg;
+         }},
+    };
+
+    run_open_close(20, out_dir);
+    run_mode(false, producers, duration, out_dir);
+    run_mode(true, producers, duration, out_dir);
+
+    constexpr int sustained_rate = 50000;
+    std::cout << "one producer at " << sustained_rate << " msgs/s" << std::endl;
+    run_sustained(false, producers[0], sustained_rate, duration, out_dir);
+    run_sustained(true, producers[0], sustained_rate, duration, out_dir);
+    return 0;
+}
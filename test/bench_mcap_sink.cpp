@@ -0,0 +1,151 @@
+// compares the file sinks the mcap writer can write through: the mcap library's FileWriter (buffered
+// FILE* on the logger thread, what McapWriter::open(name) uses) and common::AsyncFileSink with its
+// writer thread, with io_uring and with io_uring and O_DIRECT.
+
+// records the size of mcap messages are written at a steady rate like the logger thread does, and the
+// time every write takes is what the logger thread would lose to the disk. with a rate of 0 the
+// records are written as fast as the sink takes them, for the throughput. the FileWriter never syncs,
+// the async sinks sync every second, so with the same numbers the async ones are also durable.
+
+// usage: bench_mcap_sink [seconds] [MB/s] [directory...]
+// the directories default to /dev/shm (tmpfs) and the current one
+
+#include <AsyncFileSink.hpp>
+#include <mcap/writer.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SinkConfig
+{
+    std::string name;
+    // opens the sink on the path, nullptr if it could not
+    std::function<std::unique_ptr<mcap::IWritable>(const std::string &)> open;
+};
+
+static std::unique_ptr<mcap::IWritable> open_async(const std::string &path, bool use_io_uring, bool direct_io)
+{
+    common::AsyncFileSink::Options options;
+    options.use_io_uring = use_io_uring;
+    options.direct_io = direct_io;
+    auto sink = std::make_unique<common::AsyncFileSink>(options);
+    if (!sink->open(path))
+    {
+        return nullptr;
+    }
+    return sink;
+}
+
+static void run(const SinkConfig &config, const std::filesystem::path &path, std::chrono::seconds duration, double rate_mb_s)
+{
+    auto sink = config.open(path.string());
+    if (!sink)
+    {
+        std::cerr << "  " << config.name << ": could not open " << path << std::endl;
+        return;
+    }
+
+    // the same records for every sink
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<size_t> record_size(50, 2000);
+    std::vector<std::byte> data(4096);
+    for (auto &b : data)
+    {
+        b = static_cast<std::byte>(rng());
+    }
+
+    std::vector<int64_t> write_ns;
+    write_ns.reserve(1 << 20);
+    const auto start = std::chrono::steady_clock::now();
+    const auto end = start + duration;
+    auto next = start;
+    uint64_t written = 0;
+    while (std::chrono::steady_clock::now() < end)
+    {
+        const size_t size = record_size(rng);
+        auto write_start = std::chrono::steady_clock::now();
+        sink->write(data.data(), size);
+        write_ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - write_start).count());
+        written += size;
+        if (rate_mb_s > 0)
+        {
+            // sleeping for every record is too coarse, catch up every 1 ms instead
+            next += std::chrono::nanoseconds(static_cast<int64_t>(size * 1000.0 / rate_mb_s));
+            if (write_ns.size() % 64 == 0)
+            {
+                std::this_thread::sleep_until(next);
+            }
+        }
+    }
+    auto end_start = std::chrono::steady_clock::now();
+    sink->end();
+    const auto end_time = std::chrono::steady_clock::now() - end_start;
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::sort(write_ns.begin(), write_ns.end());
+    auto percentile = [&](double p)
+    { return write_ns[std::min(write_ns.size() - 1, static_cast<size_t>(p * write_ns.size()))]; };
+    std::cout << "  " << config.name << ": " << (written / seconds / 1e6) << " MB/s, write p50 " << percentile(0.5)
+              << " ns, p99.9 " << percentile(0.999) << " ns, max " << (write_ns.back() / 1000) << " us, end "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end_time).count() << " ms";
+    if (auto async_sink = dynamic_cast<common::AsyncFileSink *>(sink.get()))
+    {
+        std::cout << ", " << async_sink->stalls() << " stalls" << (async_sink->direct_io() ? ", O_DIRECT" : "")
+                  << (async_sink->failed() ? ", FAILED" : "");
+    }
+    std::cout << std::endl;
+    sink.reset();
+    std::filesystem::remove(path);
+}
+
+int main(int argc, char **argv)
+{
+    std::chrono::seconds duration((argc > 1) ? std::stoi(argv[1]) : 5);
+    const double rate_mb_s = (argc > 2) ? std::stod(argv[2]) : 20.0;
+    std::vector<std::filesystem::path> dirs;
+    for (int i = 3; i < argc; i++)
+    {
+        dirs.emplace_back(argv[i]);
+    }
+    if (dirs.empty())
+    {
+        dirs = {"/dev/shm", std::filesystem::current_path()};
+    }
+
+    const std::vector<SinkConfig> configs = {
+        {"mcap::FileWriter    ", [](const std::string &path) -> std::unique_ptr<mcap::IWritable>
+         {
+             auto sink = std::make_unique<mcap::FileWriter>();
+             if (!sink->open(path).ok())
+             {
+                 return nullptr;
+             }
+             return sink;
+         }},
+        {"async, thread       ", [](const std::string &path)
+         { return open_async(path, false, false); }},
+        {"async, io_uring     ", [](const std::string &path)
+         { return open_async(path, true, false); }},
+        {"async, io_uring+odir", [](const std::string &path)
+         { return open_async(path, true, true); }},
+    };
+
+    for (const auto &dir : dirs)
+    {
+        std::cout << dir.string() << ", " << (rate_mb_s > 0 ? std::to_string(rate_mb_s) + " MB/s" : std::string("as fast as possible")) << std::endl;
+        for (const auto &config : configs)
+        {
+            run(config, dir / "bench_mcap_sink.mcap", duration, rate_mb_s);
+        }
+    }
+    return 0;
+}
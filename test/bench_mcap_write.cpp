@@ -0,0 +1,155 @@
+// benchmark for the MCAP output options of the MCAPProtobufLogger. reads every message of a recorded
+// mcap into memory and writes them out again with each compression / chunk size setting, reporting
+// write throughput, CPU time per MB of messages and the file size relative to the unchunked,
+// uncompressed output the logger used to write.
+
+// usage: bench_mcap_write [recorded mcap] [output directory]
+
+// the mcap implementation comes from drivebrain_mcap_logger
+#include <MCAPProtobufLogger.hpp>
+
+#include <mcap/reader.hpp>
+#include <mcap/writer.hpp>
+
+#include <time.h>
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct RecordedMessage
+{
+    mcap::ChannelId channel_id;
+    mcap::Timestamp log_time;
+    std::vector<std::byte> data;
+};
+
+static std::chrono::nanoseconds thread_cpu_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: bench_mcap_write [recorded mcap] [output directory]" << std::endl;
+        return 1;
+    }
+    const std::string recording_path = argv[1];
+    const std::filesystem::path out_dir = (argc > 2) ? argv[2] : std::filesystem::temp_directory_path();
+
+    mcap::McapReader reader;
+    auto status = reader.open(recording_path);
+    if (!status.ok())
+    {
+        std::cerr << "failed to open " << recording_path << ": " << status.message << std::endl;
+        return 1;
+    }
+
+    std::vector<RecordedMessage> messages;
+    std::unordered_map<mcap::ChannelId, std::shared_ptr<mcap::Channel>> channels;
+    std::unordered_map<mcap::SchemaId, std::shared_ptr<mcap::Schema>> schemas;
+    uint64_t total_bytes = 0;
+    auto on_problem = [](const mcap::Status &problem)
+    { std::cerr << "problem reading the recording: " << problem.message << std::endl; };
+    for (const auto &view : reader.readMessages(on_problem, mcap::ReadMessageOptions{}))
+    {
+        channels[view.channel->id] = view.channel;
+        if (view.schema)
+        {
+            schemas[view.schema->id] = view.schema;
+        }
+        messages.push_back({view.message.channelId, view.message.logTime, std::vector<std::byte>(view.message.data, view.message.data + view.message.dataSize)});
+        total_bytes += view.message.dataSize;
+    }
+    reader.close();
+    if (messages.empty())
+    {
+        std::cerr << "no messages in " << recording_path << std::endl;
+        return 1;
+    }
+    const double total_mb = static_cast<double>(total_bytes) / (1024.0 * 1024.0);
+    std::cout << messages.size() << " messages (" << total_mb << " MB of serialized protobufs) on " << channels.size() << " channels" << std::endl;
+
+    const std::vector<common::MCAPProtobufLogger::SessionConfig> configs = {
+        {"none", "default", 0}, // what the logger wrote before chunking
+        {"none", "default", 1024},
+        {"lz4", "fast", 1024},
+        {"lz4", "default", 1024},
+        {"zstd", "fastest", 1024},
+        {"zstd", "fast", 1024},
+        {"zstd", "default", 1024},
+        {"zstd", "fast", 4096},
+    };
+
+    uint64_t baseline_size = 0;
+    for (const auto &config : configs)
+    {
+        auto options = common::MCAPProtobufLogger::make_writer_options(config);
+        const auto out_path = out_dir / ("bench_" + config.compression + "_" + config.compression_level + "_" + std::to_string(config.chunk_size_kb) + ".mcap");
+
+        auto start = std::chrono::steady_clock::now();
+        auto start_cpu = thread_cpu_time();
+
+        mcap::McapWriter writer;
+        status = writer.open(out_path.string(), *options);
+        if (!status.ok())
+        {
+            std::cerr << "failed to open " << out_path << ": " << status.message << std::endl;
+            return 1;
+        }
+        // the writer hands out its own ids, map the ones from the recording to them
+        std::unordered_map<mcap::SchemaId, mcap::SchemaId> schema_ids;
+        for (auto &[id, schema] : schemas)
+        {
+            mcap::Schema copy = *schema;
+            writer.addSchema(copy);
+            schema_ids[id] = copy.id;
+        }
+        std::unordered_map<mcap::ChannelId, mcap::ChannelId> channel_ids;
+        for (auto &[id, channel] : channels)
+        {
+            mcap::Channel copy = *channel;
+            copy.schemaId = schema_ids[channel->schemaId];
+            writer.addChannel(copy);
+            channel_ids[id] = copy.id;
+        }
+        for (const auto &recorded : messages)
+        {
+            mcap::Message msg;
+            msg.channelId = channel_ids[recorded.channel_id];
+            msg.logTime = recorded.log_time;
+            msg.publishTime = recorded.log_time;
+            msg.data = recorded.data.data();
+            msg.dataSize = recorded.data.size();
+            writer.write(msg);
+        }
+        writer.close();
+
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double cpu_ms = std::chrono::duration<double, std::milli>(thread_cpu_time() - start_cpu).count();
+        uint64_t size = std::filesystem::file_size(out_path);
+        if (baseline_size == 0)
+        {
+            baseline_size = size;
+        }
+        std::filesystem::remove(out_path);
+
+        std::cout << std::left << std::setw(6) << config.compression << std::setw(9) << config.compression_level
+                  << std::setw(11) << (config.chunk_size_kb > 0 ? std::to_string(config.chunk_size_kb) + "kB" : "no chunks")
+                  << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << (total_mb / secs) << " MB/s"
+                  << std::setw(10) << (cpu_ms / total_mb) << " CPU ms/MB"
+                  << std::setw(12) << (static_cast<double>(size) / (1024.0 * 1024.0)) << " MB"
+                  << std::setprecision(3) << std::setw(8) << (static_cast<double>(size) / baseline_size) << "x of unchunked" << std::endl;
+    }
+    return 0;
+}
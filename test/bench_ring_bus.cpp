@@ -0,0 +1,196 @@
+// benchmark for handing protobuf messages between threads. measures the latency from a message being
+// enqueued on the producer thread to it being dequeued on the consumer thread for the previous
+// core::common::ThreadSafeDeque pattern (producer pushes under the mutex and notifies, the consumer
+// copies the whole deque under the mutex and clears it) and for util::RingBus with one and with
+// several readers.
+
+// the producer runs paced (a message every [period] us, consumers go to sleep in between like the
+// drivers do) and in bursts (64 messages back to back every ms, like a batch of CAN frames).
+
+// usage: bench_ring_bus [number of messages] [period in us]
+
+#include <DriverBus.hpp>
+#include <RingBus.hpp>
+#include <hytech.pb.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct StampedMessage
+{
+    int64_t enqueued_ns = 0;
+    std::shared_ptr<google::protobuf::Message> msg;
+};
+
+static int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// spins instead of sleeping so the producer keeps its pace
+static void wait_until(int64_t deadline_ns)
+{
+    while (now_ns() < deadline_ns)
+    {
+    }
+}
+
+struct Pacing
+{
+    size_t num_msgs;
+    int64_t period_ns; // between messages, 0 for bursts
+    size_t burst_size;
+    int64_t burst_period_ns;
+};
+
+template <typename PublishFunc>
+static void produce(const Pacing &pacing, PublishFunc &&publish)
+{
+    auto msg = std::make_shared<hytech::drivetrain_rpms_telem>();
+    int64_t next = now_ns();
+    for (size_t i = 0; i < pacing.num_msgs; i++)
+    {
+        if (pacing.period_ns > 0)
+        {
+            next += pacing.period_ns;
+            wait_until(next);
+        }
+        else if (i % pacing.burst_size == 0)
+        {
+            next += pacing.burst_period_ns;
+            wait_until(next);
+        }
+        publish(StampedMessage{now_ns(), msg});
+    }
+}
+
+static void print_latencies(const std::string &name, std::vector<int64_t> &latencies, uint64_t dropped)
+{
+    if (latencies.empty())
+    {
+        std::cout << name << ": nothing received" << std::endl;
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p)
+    { return latencies[std::min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))]; };
+    std::cout << name << ": p50 " << percentile(0.5) << " ns, p99 " << percentile(0.99) << " ns, p99.9 "
+              << percentile(0.999) << " ns, max " << latencies.back() << " ns";
+    if (dropped > 0)
+    {
+        std::cout << ", " << dropped << " dropped";
+    }
+    std::cout << std::endl;
+}
+
+static void bench_deque(const std::string &name, const Pacing &pacing)
+{
+    core::common::ThreadSafeDeque<StampedMessage> input;
+    bool done = false;
+    std::vector<int64_t> latencies;
+    latencies.reserve(pacing.num_msgs);
+
+    std::thread consumer([&]()
+                         {
+        core::common::ThreadSafeDeque<StampedMessage> q;
+        while (true)
+        {
+            {
+                std::unique_lock lk(input.mtx);
+                input.cv.wait(lk, [&]() { return !input.deque.empty() || done; });
+                if (input.deque.empty())
+                {
+                    return;
+                }
+                q.deque = input.deque;
+                input.deque.clear();
+            }
+            const int64_t dequeued = now_ns();
+            for (const auto &msg : q.deque)
+            {
+                latencies.push_back(dequeued - msg.enqueued_ns);
+            }
+            q.deque.clear();
+        } });
+
+    produce(pacing, [&](StampedMessage msg)
+            {
+        std::unique_lock lk(input.mtx);
+        input.deque.push_back(std::move(msg));
+        input.cv.notify_all(); });
+    {
+        std::unique_lock lk(input.mtx);
+        done = true;
+    }
+    input.cv.notify_all();
+    consumer.join();
+    print_latencies(name, latencies, 0);
+}
+
+static void bench_ring(const std::string &name, const Pacing &pacing, util::RingPolicy policy, size_t num_readers)
+{
+    util::RingBus<StampedMessage> bus(1024, policy);
+    std::vector<std::unique_ptr<util::RingBus<StampedMessage>::Reader>> readers;
+    std::vector<std::vector<int64_t>> latencies(num_readers);
+    std::vector<std::thread> consumers;
+    for (size_t r = 0; r < num_readers; r++)
+    {
+        readers.push_back(bus.subscribe());
+        latencies[r].reserve(pacing.num_msgs);
+    }
+    for (size_t r = 0; r < num_readers; r++)
+    {
+        consumers.emplace_back([&, r]()
+                               {
+            StampedMessage msg;
+            while (readers[r]->read(msg))
+            {
+                latencies[r].push_back(now_ns() - msg.enqueued_ns);
+            } });
+    }
+
+    produce(pacing, [&](StampedMessage msg)
+            { bus.publish(std::move(msg)); });
+    bus.close();
+    for (auto &consumer : consumers)
+    {
+        consumer.join();
+    }
+
+    // every reader saw the same messages, report them all together
+    std::vector<int64_t> all;
+    for (auto &reader_latencies : latencies)
+    {
+        all.insert(all.end(), reader_latencies.begin(), reader_latencies.end());
+    }
+    print_latencies(name, all, bus.dropped());
+}
+
+int main(int argc, char **argv)
+{
+    size_t num_msgs = (argc > 1) ? std::stoul(argv[1]) : 200000;
+    int64_t period_us = (argc > 2) ? std::stol(argv[2]) : 20;
+
+    const Pacing paced{num_msgs, period_us * 1000, 1, 0};
+    const Pacing bursts{num_msgs, 0, 64, 1000000};
+
+    std::cout << "paced, " << num_msgs << " messages every " << period_us << " us" << std::endl;
+    bench_deque("  ThreadSafeDeque             ", paced);
+    bench_ring("  RingBus block, 1 reader     ", paced, util::RingPolicy::Block, 1);
+    bench_ring("  RingBus overwrite, 1 reader ", paced, util::RingPolicy::Overwrite, 1);
+    bench_ring("  RingBus overwrite, 3 readers", paced, util::RingPolicy::Overwrite, 3);
+
+    std::cout << "bursts of 64 every ms, " << num_msgs << " messages" << std::endl;
+    bench_deque("  ThreadSafeDeque             ", bursts);
+    bench_ring("  RingBus block, 1 reader     ", bursts, util::RingPolicy::Block, 1);
+    bench_ring("  RingBus overwrite, 1 reader ", bursts, util::RingPolicy::Overwrite, 1);
+    bench_ring("  RingBus overwrite, 3 readers", bursts, util::RingPolicy::Overwrite, 3);
+    return 0;
+}
@@ -0,0 +1,96 @@
+// benchmark for the control loop getting the vehicle state while the input threads keep updating
+// it. the writer threads push state inputs into the StateEstimator as fast as they can (the worst a
+// burst of CAN frames gets), the reader takes a state every [period] us like the control loop does
+// and the time each get_latest_state_and_validity takes is reported. run with 0 writers for the
+// uncontended time.
+
+// usage: bench_state_snapshot [number of snapshots] [period in us] [number of writers] [config path]
+
+#include <JsonFileHandler.hpp>
+#include <StateEstimator.hpp>
+#include <hytech.pb.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int main(int argc, char **argv)
+{
+    const size_t num_snapshots = (argc > 1) ? std::stoul(argv[1]) : 200000;
+    const int64_t period_ns = ((argc > 2) ? std::stol(argv[2]) : 20) * 1000;
+    const int num_writers = (argc > 3) ? std::stoi(argv[3]) : 2;
+    const std::string config_path = (argc > 4) ? argv[4] : "config/drivebrain_config.json";
+
+    core::Logger logger(core::LogLevel::INFO);
+    core::JsonFileHandler config(config_path);
+    std::function<void(std::shared_ptr<google::protobuf::Message>)> no_op_log = [](std::shared_ptr<google::protobuf::Message>) {};
+    auto message_logger = std::make_shared<core::MsgLogger<std::shared_ptr<google::protobuf::Message>>>(
+        ".mcap", false, no_op_log, []() {}, [](const std::string &) {}, no_op_log);
+    core::StateEstimator estimator(logger, config, message_logger);
+    estimator.init();
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> inputs{0};
+    std::vector<std::thread> writers;
+    for (int w = 0; w < num_writers; w++)
+    {
+        writers.emplace_back([&, w]()
+        {
+            std::vector<std::shared_ptr<google::protobuf::Message>> msgs = {
+                std::make_shared<hytech::pedals_system_data>(),
+                std::make_shared<hytech::front_suspension>(),
+                std::make_shared<hytech::rear_suspension>(),
+                std::make_shared<hytech::steering_data>(),
+                std::make_shared<hytech::inv1_dynamics>(),
+                std::make_shared<hytech::drivetrain_rpms_telem>()};
+            uint64_t sent = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                estimator.handle_recv_process(msgs[(sent + w) % msgs.size()]);
+                sent++;
+            }
+            inputs += sent;
+        });
+    }
+
+    std::vector<int64_t> latencies;
+    latencies.reserve(num_snapshots);
+    float checksum = 0;
+    int64_t next = now_ns();
+    const int64_t start = next;
+    for (size_t i = 0; i < num_snapshots; i++)
+    {
+        while (now_ns() < next)
+        {
+        }
+        next += period_ns;
+        const int64_t before = now_ns();
+        const auto state = estimator.get_latest_state_and_validity();
+        latencies.push_back(now_ns() - before);
+        checksum += state.first.input.requested_accel;
+    }
+    const double seconds = (now_ns() - start) / 1e9;
+    stop.store(true);
+    for (auto &writer : writers)
+    {
+        writer.join();
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+    const auto at = [&](double quantile) { return latencies[static_cast<size_t>(quantile * (latencies.size() - 1))] / 1000.0; };
+    std::cout << num_snapshots << " snapshots every " << period_ns / 1000 << " us with " << num_writers << " writers ("
+              << static_cast<uint64_t>(inputs.load() / seconds) << " inputs/s)" << std::endl;
+    std::cout << "get_latest_state_and_validity: p50 " << at(0.5) << " us, p99 " << at(0.99) << " us, p99.9 " << at(0.999)
+              << " us, max " << at(1.0) << " us" << (checksum < 0 ? " " : "") << std::endl;
+    return 0;
+}
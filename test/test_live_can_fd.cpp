@@ -0,0 +1,199 @@
+// this is not a unit test since it requires actually sending and receiving
+
+// sends a mix of classic and CAN FD frames encoded by comms::CANMessageCodec over a (v)can interface
+// with CAN_RAW_FD_FRAMES enabled, reads them back on a second socket the same way CANDriver does
+// (into canfd_frame buffers, telling classic and FD frames apart by the read size) and checks that
+// every message decodes back to what was sent. bring up vcan0 with vcan_bringup.sh, which sets the
+// FD MTU.
+
+// usage: test_live_can_fd [number of frames] [interface]
+
+#include <CANCodec.hpp>
+
+#include <google/protobuf/descriptor.pb.h>
+#include <google/protobuf/dynamic_message.h>
+#include <google/protobuf/text_format.h>
+
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <vector>
+
+static const char *test_dbc = R"(VERSION ""
+
+NS_ :
+
+BS_:
+
+BU_: ECU
+
+BO_ 256 CLASSIC_MSG: 8 ECU
+ SG_ rpm : 0|16@1- (1,0) [0|0] "" Vector__XXX
+ SG_ torque : 16|16@1+ (1,0) [0|0] "" Vector__XXX
+
+BO_ 512 SUSPENSION_FD: 48 ECU
+ SG_ fl_load_cell : 0|32@1+ (1,0) [0|0] "" Vector__XXX
+ SG_ fr_load_cell : 32|32@1+ (1,0) [0|0] "" Vector__XXX
+ SG_ rl_shock_pot : 263|16@0+ (1,0) [0|0] "" Vector__XXX
+ SG_ rr_shock_pot : 352|32@1+ (1,0) [0|0] "" Vector__XXX
+
+BO_ 2550588916 EXT_FD: 64 ECU
+ SG_ last : 480|32@1+ (1,0) [0|0] "" Vector__XXX
+)";
+
+static const char *test_proto = R"(
+name: "fd_test.proto"
+package: "fd_test"
+syntax: "proto3"
+message_type {
+  name: "classic_msg"
+  field { name: "rpm" number: 1 label: LABEL_OPTIONAL type: TYPE_INT32 }
+  field { name: "torque" number: 2 label: LABEL_OPTIONAL type: TYPE_UINT32 }
+}
+message_type {
+  name: "suspension_fd"
+  field { name: "fl_load_cell" number: 1 label: LABEL_OPTIONAL type: TYPE_UINT32 }
+  field { name: "fr_load_cell" number: 2 label: LABEL_OPTIONAL type: TYPE_UINT32 }
+  field { name: "rl_shock_pot" number: 3 label: LABEL_OPTIONAL type: TYPE_UINT32 }
+  field { name: "rr_shock_pot" number: 4 label: LABEL_OPTIONAL type: TYPE_UINT32 }
+}
+message_type {
+  name: "ext_fd"
+  field { name: "last" number: 1 label: LABEL_OPTIONAL type: TYPE_UINT32 }
+}
+)";
+
+static int open_fd_socket(const std::string &interface_name)
+{
+    int sock = ::socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (sock < 0)
+    {
+        return -1;
+    }
+    int enable = 1;
+    if (::setsockopt(sock, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &enable, sizeof(enable)) < 0)
+    {
+        ::close(sock);
+        return -1;
+    }
+    struct ifreq ifr;
+    std::strcpy(ifr.ifr_name, interface_name.c_str());
+    ioctl(sock, SIOCGIFINDEX, &ifr);
+
+    struct sockaddr_can addr = {};
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (::bind(sock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+    {
+        ::close(sock);
+        return -1;
+    }
+    struct timeval timeout = {1, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return sock;
+}
+
+// fills every field with a random value that fits its signal so the round trip is exact
+static void randomize(google::protobuf::Message &msg, std::mt19937 &rng)
+{
+    const auto *desc = msg.GetDescriptor();
+    const auto *refl = msg.GetReflection();
+    for (int i = 0; i < desc->field_count(); i++)
+    {
+        const auto *field = desc->field(i);
+        switch (field->type())
+        {
+        case google::protobuf::FieldDescriptor::TYPE_INT32:
+            refl->SetInt32(&msg, field, static_cast<int16_t>(rng()));
+            break;
+        case google::protobuf::FieldDescriptor::TYPE_UINT32:
+            // the 16 bit signals
+            refl->SetUInt32(&msg, field, (field->name() == "torque" || field->name() == "rl_shock_pot") ? (rng() & 0xFFFF) : rng());
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t num_frames = (argc > 1) ? std::stoul(argv[1]) : 3000;
+    std::string interface_name = (argc > 2) ? argv[2] : "vcan0";
+
+    google::protobuf::DescriptorPool pool;
+    google::protobuf::DynamicMessageFactory factory;
+    google::protobuf::FileDescriptorProto file_proto;
+    google::protobuf::TextFormat::ParseFromString(test_proto, &file_proto);
+    pool.BuildFile(file_proto);
+
+    std::istringstream dbc(test_dbc);
+    auto net = dbcppp::INetwork::LoadDBCFromIs(dbc);
+    comms::CANMessageCodec codec;
+    if (!net || !codec.build(*net, &pool, &factory, "fd_test"))
+    {
+        std::cerr << "failed to build the codec" << std::endl;
+        return 1;
+    }
+
+    int tx_sock = open_fd_socket(interface_name);
+    int rx_sock = open_fd_socket(interface_name);
+    if (tx_sock < 0 || rx_sock < 0)
+    {
+        std::cerr << "failed to open CAN FD sockets, is " << interface_name << " up with an MTU of 72?" << std::endl;
+        return 1;
+    }
+
+    std::vector<const google::protobuf::Descriptor *> types = {
+        pool.FindMessageTypeByName("fd_test.classic_msg"),
+        pool.FindMessageTypeByName("fd_test.suspension_fd"),
+        pool.FindMessageTypeByName("fd_test.ext_fd")};
+
+    std::mt19937 rng(7);
+    size_t classic = 0, fd = 0, mismatched = 0, lost = 0;
+    for (size_t i = 0; i < num_frames; i++)
+    {
+        std::unique_ptr<google::protobuf::Message> msg(factory.GetPrototype(types[i % types.size()])->New());
+        randomize(*msg, rng);
+        auto frame = codec.encode(*msg);
+        const size_t mtu = (frame->flags & CANFD_FDF) ? CANFD_MTU : CAN_MTU;
+        if (::write(tx_sock, &(*frame), mtu) != static_cast<ssize_t>(mtu))
+        {
+            std::cerr << "send failed: " << strerror(errno) << std::endl;
+            return 1;
+        }
+
+        struct canfd_frame rx_frame;
+        ssize_t nbytes = ::read(rx_sock, &rx_frame, sizeof(rx_frame));
+        if (nbytes != CAN_MTU && nbytes != CANFD_MTU)
+        {
+            lost++;
+            continue;
+        }
+        (nbytes == CANFD_MTU) ? fd++ : classic++;
+
+        auto decoded = codec.decode(rx_frame.can_id, rx_frame.data, rx_frame.len);
+        if (!decoded || decoded->SerializeAsString() != msg->SerializeAsString())
+        {
+            mismatched++;
+        }
+    }
+    ::close(tx_sock);
+    ::close(rx_sock);
+
+    std::cout << "sent " << num_frames << " frames: received " << classic << " classic, " << fd << " FD, "
+              << lost << " lost, " << mismatched << " did not decode to what was sent" << std::endl;
+    bool passed = (lost == 0) && (mismatched == 0) && (classic > 0) && (fd > 0);
+    std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+// this is not a unit test since it requires actually sending and receiving
+
+// runs one CANDriver on two (v)can interfaces with a different DBC on each: a powertrain DBC that
+// only has DRIVETRAIN_STATUS_TELEM on the first bus and the full DBC on the second. checks that each
+// outgoing message is only put on the bus whose DBC has it first, that frames are decoded with the DBC
+// of the bus they came in on, and that both sockets are read by the one io_context thread.
+// bring up vcan0 and vcan1 with vcan_bringup.sh.
+
+// usage: test_live_can_multibus [dbc path] [number of messages per bus] [first interface] [second interface]
+
+#include <CANComms.hpp>
+#include <JsonFileHandler.hpp>
+#include <Logger.hpp>
+#include <MsgLogger.hpp>
+#include <StateEstimator.hpp>
+#include <hytech.pb.h>
+
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+static const char *powertrain_dbc = R"(VERSION ""
+
+NS_ :
+
+BS_:
+
+BU_: ECU
+
+BO_ 514 DRIVETRAIN_STATUS_TELEM: 8 ECU
+ SG_ accel_percent : 48|8@1+ (1,0) [0|100] "" Vector__XXX
+ SG_ brake_percent : 40|8@1+ (1,0) [0|100] "" Vector__XXX
+)";
+
+static int open_raw_socket(const std::string &interface_name)
+{
+    int sock = ::socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (sock < 0)
+    {
+        return -1;
+    }
+    struct ifreq ifr;
+    std::strcpy(ifr.ifr_name, interface_name.c_str());
+    ioctl(sock, SIOCGIFINDEX, &ifr);
+
+    struct sockaddr_can addr = {};
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (::bind(sock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+    {
+        ::close(sock);
+        return -1;
+    }
+    struct timeval timeout = {0, 100000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return sock;
+}
+
+struct BusCounts
+{
+    std::atomic<uint64_t> rpms{0};
+    std::atomic<uint64_t> status{0};
+};
+
+int main(int argc, char **argv)
+{
+    std::string dbc_path = (argc > 1) ? argv[1] : "config/hytech.dbc";
+    size_t num_msgs = (argc > 2) ? std::stoul(argv[2]) : 1000;
+    std::string powertrain_bus = (argc > 3) ? argv[3] : "vcan0";
+    std::string telem_bus = (argc > 4) ? argv[4] : "vcan1";
+
+    const std::string powertrain_dbc_path = "/tmp/test_live_can_multibus.dbc";
+    const std::string config_path = "/tmp/test_live_can_multibus.json";
+    {
+        std::ofstream dbc_out(powertrain_dbc_path);
+        dbc_out << powertrain_dbc;
+        std::ofstream config_out(config_path);
+        config_out << "{\"CANDriver\": {\"canbus_device\": \"" << powertrain_bus << ", " << telem_bus
+                   << "\", \"path_to_dbc\": \"\", \"batched_receive\": true, \"kernel_rx_filter\": false, \"can_fd\": false}}";
+    }
+
+    core::Logger logger(core::LogLevel::INFO);
+    core::JsonFileHandler config(config_path);
+
+    std::function<void(std::shared_ptr<google::protobuf::Message>)> no_op_log = [](std::shared_ptr<google::protobuf::Message>) {};
+    auto message_logger = std::make_shared<core::MsgLogger<std::shared_ptr<google::protobuf::Message>>>(
+        ".mcap", false, no_op_log, []() {}, [](const std::string &) {}, no_op_log);
+    core::StateEstimator state_estimator(logger, config, message_logger);
+
+    int powertrain_sock = open_raw_socket(powertrain_bus);
+    int telem_sock = open_raw_socket(telem_bus);
+    if (powertrain_sock < 0 || telem_sock < 0)
+    {
+        std::cerr << "failed to open raw sockets, are " << powertrain_bus << " and " << telem_bus << " up?" << std::endl;
+        return 1;
+    }
+
+    std::atomic<bool> receiving = true;
+    BusCounts powertrain_counts, telem_counts;
+    auto count_frames = [&receiving](int sock, BusCounts &counts) {
+        struct can_frame frame;
+        while (receiving)
+        {
+            if (::read(sock, &frame, sizeof(frame)) != sizeof(frame))
+            {
+                continue;
+            }
+            if (frame.can_id == 512)
+            {
+                counts.rpms++;
+            }
+            else if (frame.can_id == 514)
+            {
+                counts.status++;
+            }
+        }
+    };
+    std::thread powertrain_thread(count_frames, powertrain_sock, std::ref(powertrain_counts));
+    std::thread telem_thread(count_frames, telem_sock, std::ref(telem_counts));
+
+    boost::asio::io_context io_context;
+    comms::CANDriver::bustype tx_bus(64, util::RingPolicy::Overwrite);
+    bool construction_failed = false;
+    bool passed = false;
+    {
+        comms::CANDriver driver(config, logger, message_logger, tx_bus, io_context, powertrain_dbc_path + "," + dbc_path, construction_failed, state_estimator);
+        if (!construction_failed && driver.num_buses() == 2)
+        {
+            std::thread io_thread([&io_context]() { io_context.run(); });
+
+            // transmit: rpms is only in the full DBC (second bus), status is in both so it goes on the first
+            for (size_t i = 0; i < num_msgs; i++)
+            {
+                auto rpms = std::make_shared<hytech::drivetrain_rpms_telem>();
+                rpms->set_fl_motor_rpm(static_cast<int32_t>(i % 1000));
+                auto status = std::make_shared<hytech::drivetrain_status_telem>();
+                status->set_accel_percent(i % 100);
+                std::array<std::shared_ptr<google::protobuf::Message>, 2> cycle_msgs = {rpms, status};
+                tx_bus.publish(cycle_msgs.begin(), cycle_msgs.end());
+                std::this_thread::sleep_for(std::chrono::microseconds(250));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            auto tx_stats = driver.get_tx_stats();
+
+            // receive: the same frames on both buses, read by the driver's sockets on the one io thread
+            struct can_frame rpms_frame = {};
+            rpms_frame.can_id = 512;
+            rpms_frame.len = 8;
+            for (size_t i = 0; i < num_msgs; i++)
+            {
+                ::write(powertrain_sock, &rpms_frame, sizeof(rpms_frame));
+                ::write(telem_sock, &rpms_frame, sizeof(rpms_frame));
+                if (i % 32 == 0)
+                {
+                    std::this_thread::sleep_for(std::chrono::microseconds(500));
+                }
+            }
+            auto start = std::chrono::steady_clock::now();
+            while (driver.get_rx_stats().frames < 2 * num_msgs && (std::chrono::steady_clock::now() - start) < std::chrono::seconds(5))
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            auto rx_stats = driver.get_rx_stats();
+
+            // decoding uses the DBC of the bus the frame was received on
+            bool decoded_per_bus = !driver.pb_msg_recv(rpms_frame, 0) && driver.pb_msg_recv(rpms_frame, 1);
+
+            io_context.stop();
+            io_thread.join();
+
+            std::cout << "tx: " << tx_stats.frames_sent << " sent, " << tx_stats.frames_coalesced << " coalesced, " << tx_stats.frames_dropped << " dropped" << std::endl;
+            std::cout << powertrain_bus << " saw " << powertrain_counts.rpms << " rpms / " << powertrain_counts.status << " status frames, "
+                      << telem_bus << " saw " << telem_counts.rpms << " rpms / " << telem_counts.status << " status frames" << std::endl;
+            std::cout << "rx: sent " << 2 * num_msgs << " frames over both buses, driver received " << rx_stats.frames << std::endl;
+
+            bool routed = (powertrain_counts.rpms == 0) && (telem_counts.status == 0) &&
+                          (powertrain_counts.status + telem_counts.rpms == tx_stats.frames_sent) && (tx_stats.frames_sent > 0);
+            passed = routed && decoded_per_bus && (rx_stats.frames == 2 * num_msgs);
+        }
+        else
+        {
+            std::cerr << "failed to construct CAN driver on " << powertrain_bus << " and " << telem_bus << std::endl;
+        }
+    }
+
+    receiving = false;
+    powertrain_thread.join();
+    telem_thread.join();
+    ::close(powertrain_sock);
+    ::close(telem_sock);
+    std::remove(powertrain_dbc_path.c_str());
+    std::remove(config_path.c_str());
+
+    std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+    return passed ? 0 : 1;
+}
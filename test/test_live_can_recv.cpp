@@ -1 +1,135 @@
-// this is not a unit test since it requires actually sending and receiving
\ No newline at end of file
+// this is not a unit test since it requires actually sending and receiving
+
+// sends a burst of frames for the messages in the DBC on a (v)can interface and checks that the
+// CANDriver received all of them with kernel receive timestamps. bring up vcan0 with vcan_bringup.sh
+// and set "batched_receive" in the CANDriver section of the config to test the recvmmsg path.
+
+// usage: test_live_can_recv [config path] [dbc path] [number of frames] [interface, same as canbus_device in the config]
+
+#include <CANComms.hpp>
+#include <JsonFileHandler.hpp>
+#include <Logger.hpp>
+#include <MsgLogger.hpp>
+#include <StateEstimator.hpp>
+
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+static int open_send_socket(const std::string &interface_name)
+{
+    int sock = ::socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (sock < 0)
+    {
+        return -1;
+    }
+    struct ifreq ifr;
+    std::strcpy(ifr.ifr_name, interface_name.c_str());
+    ioctl(sock, SIOCGIFINDEX, &ifr);
+
+    struct sockaddr_can addr = {};
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (::bind(sock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+    {
+        ::close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+int main(int argc, char **argv)
+{
+    std::string config_path = (argc > 1) ? argv[1] : "config/drivebrain_config.json";
+    std::string dbc_path = (argc > 2) ? argv[2] : "config/hytech.dbc";
+    size_t num_frames = (argc > 3) ? std::stoul(argv[3]) : 8000;
+    std::string interface_name = (argc > 4) ? argv[4] : "vcan0";
+
+    core::Logger logger(core::LogLevel::INFO);
+    core::JsonFileHandler config(config_path);
+
+    std::function<void(std::shared_ptr<google::protobuf::Message>)> no_op_log = [](std::shared_ptr<google::protobuf::Message>) {};
+    auto message_logger = std::make_shared<core::MsgLogger<std::shared_ptr<google::protobuf::Message>>>(
+        ".mcap", false, no_op_log, []() {}, [](const std::string &) {}, no_op_log);
+    core::StateEstimator state_estimator(logger, config, message_logger);
+
+    boost::asio::io_context io_context;
+    comms::CANDriver::bustype tx_bus(64, util::RingPolicy::Overwrite);
+    bool construction_failed = false;
+    comms::CANDriver driver(config, logger, message_logger, tx_bus, io_context, dbc_path, construction_failed, state_estimator);
+    if (construction_failed)
+    {
+        std::cerr << "failed to construct CAN driver, is vcan0 up?" << std::endl;
+        return 1;
+    }
+    std::thread io_thread([&io_context]() { io_context.run(); });
+
+    std::unique_ptr<dbcppp::INetwork> net;
+    {
+        std::ifstream idbc(dbc_path);
+        net = dbcppp::INetwork::LoadDBCFromIs(idbc);
+    }
+    std::vector<can_frame> frames;
+    for (const auto &msg : net->Messages())
+    {
+        can_frame frame = {};
+        frame.can_id = static_cast<canid_t>(msg.Id());
+        frame.len = static_cast<uint8_t>(std::min<uint64_t>(msg.MessageSize(), CAN_MAX_DLEN));
+        frames.push_back(frame);
+    }
+
+    int send_sock = open_send_socket(interface_name);
+    if (send_sock < 0 || frames.empty())
+    {
+        std::cerr << "failed to open send socket" << std::endl;
+        io_context.stop();
+        io_thread.join();
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < num_frames; i++)
+    {
+        const auto &frame = frames[i % frames.size()];
+        while (::write(send_sock, &frame, sizeof(frame)) < 0)
+        {
+            if (errno != ENOBUFS)
+            {
+                std::cerr << "send failed: " << strerror(errno) << std::endl;
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    // the driver counts every frame including ones we sent that it has no decode plan for
+    while (driver.get_rx_stats().frames < num_frames && (std::chrono::steady_clock::now() - start) < std::chrono::seconds(5))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    auto stats = driver.get_rx_stats();
+    ::close(send_sock);
+    io_context.stop();
+    io_thread.join();
+
+    std::cout << "sent " << num_frames << " frames, received " << stats.frames << " in " << stats.wakeups << " wakeups ("
+              << (stats.wakeups ? static_cast<double>(stats.frames) / stats.wakeups : 0.0) << " frames / wakeup), "
+              << stats.kernel_stamped_frames << " with kernel timestamps" << std::endl;
+
+    bool passed = (stats.frames == num_frames) && (stats.kernel_stamped_frames == stats.frames);
+    std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+    return passed ? 0 : 1;
+}
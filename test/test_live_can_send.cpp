@@ -1,2 +1,138 @@
 // this is not a unit test since it requires actually sending and receiving
 
+// pushes control cycles worth of messages into the CANDriver tx queue and checks that every frame the
+// driver reports as sent shows up on a raw socket listening on the same (v)can interface, and that
+// every queued message was either sent, dropped, coalesced or overwritten on the tx bus. bring up
+// vcan0 with vcan_bringup.sh.
+
+// usage: test_live_can_send [config path] [dbc path] [number of cycles] [interface, same as canbus_device in the config]
+
+#include <CANComms.hpp>
+#include <JsonFileHandler.hpp>
+#include <Logger.hpp>
+#include <MsgLogger.hpp>
+#include <StateEstimator.hpp>
+#include <hytech.pb.h>
+
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+static int open_recv_socket(const std::string &interface_name)
+{
+    int sock = ::socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    if (sock < 0)
+    {
+        return -1;
+    }
+    struct ifreq ifr;
+    std::strcpy(ifr.ifr_name, interface_name.c_str());
+    ioctl(sock, SIOCGIFINDEX, &ifr);
+
+    struct sockaddr_can addr = {};
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (::bind(sock, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+    {
+        ::close(sock);
+        return -1;
+    }
+    struct timeval timeout = {0, 100000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return sock;
+}
+
+int main(int argc, char **argv)
+{
+    std::string config_path = (argc > 1) ? argv[1] : "config/drivebrain_config.json";
+    std::string dbc_path = (argc > 2) ? argv[2] : "config/hytech.dbc";
+    size_t num_cycles = (argc > 3) ? std::stoul(argv[3]) : 4000;
+    std::string interface_name = (argc > 4) ? argv[4] : "vcan0";
+
+    core::Logger logger(core::LogLevel::INFO);
+    core::JsonFileHandler config(config_path);
+
+    std::function<void(std::shared_ptr<google::protobuf::Message>)> no_op_log = [](std::shared_ptr<google::protobuf::Message>) {};
+    auto message_logger = std::make_shared<core::MsgLogger<std::shared_ptr<google::protobuf::Message>>>(
+        ".mcap", false, no_op_log, []() {}, [](const std::string &) {}, no_op_log);
+    core::StateEstimator state_estimator(logger, config, message_logger);
+
+    int recv_sock = open_recv_socket(interface_name);
+    if (recv_sock < 0)
+    {
+        std::cerr << "failed to open receive socket, is " << interface_name << " up?" << std::endl;
+        return 1;
+    }
+
+    std::atomic<bool> receiving = true;
+    std::atomic<uint64_t> received = 0;
+    std::thread recv_thread([&]() {
+        struct can_frame frame;
+        while (receiving)
+        {
+            if (::read(recv_sock, &frame, sizeof(frame)) == sizeof(frame))
+            {
+                received++;
+            }
+        }
+    });
+
+    boost::asio::io_context io_context;
+    comms::CANDriver::bustype tx_bus(64, util::RingPolicy::Overwrite);
+    bool construction_failed = false;
+    {
+        comms::CANDriver driver(config, logger, message_logger, tx_bus, io_context, dbc_path, construction_failed, state_estimator);
+        if (construction_failed)
+        {
+            std::cerr << "failed to construct CAN driver" << std::endl;
+            receiving = false;
+            recv_thread.join();
+            return 1;
+        }
+
+        // first half paced like the control loop, second half pushed as fast as possible to
+        // provoke coalescing and interface back-pressure
+        size_t queued = 0;
+        for (size_t i = 0; i < num_cycles; i++)
+        {
+            auto rpms = std::make_shared<hytech::drivetrain_rpms_telem>();
+            rpms->set_fl_motor_rpm(static_cast<int32_t>(i % 1000));
+            auto status = std::make_shared<hytech::drivetrain_status_telem>();
+            status->set_mc1_dc_on(i % 2);
+            std::array<std::shared_ptr<google::protobuf::Message>, 2> cycle_msgs = {rpms, status};
+            tx_bus.publish(cycle_msgs.begin(), cycle_msgs.end());
+            queued += 2;
+            if (i < num_cycles / 2)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(250));
+            }
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        auto stats = driver.get_tx_stats();
+        receiving = false;
+        recv_thread.join();
+        ::close(recv_sock);
+
+        std::cout << "queued " << queued << " messages: " << stats.frames_sent << " sent in " << stats.flushes << " flushes, "
+                  << stats.frames_coalesced << " coalesced, " << stats.frames_dropped << " dropped, "
+                  << stats.queue_dropped << " overwritten on the tx bus, "
+                  << stats.enobufs_events << " ENOBUFS events. " << received << " frames seen on the bus" << std::endl;
+
+        bool accounted = (stats.frames_sent + stats.frames_coalesced + stats.frames_dropped + stats.queue_dropped) == queued;
+        bool passed = accounted && (received == stats.frames_sent);
+        std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+        return passed ? 0 : 1;
+    }
+}
@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include <AsyncFileSink.hpp>
+
+#include <unistd.h>
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    // records of random size like the mcap writer's, with a few bigger than a block
+    std::vector<std::byte> write_records(common::AsyncFileSink &sink, size_t total) {
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<size_t> small(1, 300);
+        std::vector<std::byte> expected;
+        while (expected.size() < total) {
+            const size_t size = (expected.size() % 7 == 0) ? small(rng) * 100 : small(rng);
+            std::vector<std::byte> record(size);
+            for (auto &b : record) {
+                b = static_cast<std::byte>(rng());
+            }
+            sink.write(record.data(), record.size());
+            expected.insert(expected.end(), record.begin(), record.end());
+        }
+        return expected;
+    }
+
+    std::vector<std::byte> read_file(const std::filesystem::path &path) {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<char> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        auto data = reinterpret_cast<const std::byte *>(contents.data());
+        return std::vector<std::byte>(data, data + contents.size());
+    }
+
+    void check_roundtrip(bool use_io_uring, bool direct_io) {
+        const auto path = std::filesystem::temp_directory_path() / ("async_sink_test_" + std::to_string(getpid()) + ".bin");
+        common::AsyncFileSink::Options options;
+        options.block_size = 64 * 1024;
+        options.num_blocks = 3;
+        options.direct_io = direct_io;
+        options.sync_period = std::chrono::milliseconds(1);
+        options.use_io_uring = use_io_uring;
+
+        common::AsyncFileSink sink(options);
+        ASSERT_TRUE(sink.open(path.string()));
+        if (use_io_uring && sink.backend() != common::AsyncFileSink::Backend::IoUring) {
+            sink.end();
+            std::filesystem::remove(path);
+            GTEST_SKIP() << "no io_uring here, the sink fell back to its thread";
+        }
+        ASSERT_EQ(sink.backend(), use_io_uring ? common::AsyncFileSink::Backend::IoUring : common::AsyncFileSink::Backend::Thread);
+        auto expected = write_records(sink, 300 * 1024);
+        // a durability point with a partly filled block, then more on top of it
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        sink.flush();
+        auto more = write_records(sink, 10000);
+        expected.insert(expected.end(), more.begin(), more.end());
+        EXPECT_EQ(sink.size(), expected.size());
+        sink.end();
+
+        EXPECT_FALSE(sink.failed());
+        EXPECT_EQ(read_file(path), expected);
+        std::filesystem::remove(path);
+    }
+}
+
+TEST(AsyncFileSink, WritesEverythingInOrderWithAThread) {
+    check_roundtrip(false, false);
+}
+
+TEST(AsyncFileSink, WritesEverythingInOrderWithIoUring) {
+    check_roundtrip(true, false);
+}
+
+TEST(AsyncFileSink, DirectWritesAreTrimmedToTheSize) {
+    check_roundtrip(false, true);
+    check_roundtrip(true, true);
+}
+
+TEST(AsyncFileSink, ReopensForTheNextFile) {
+    const auto path = std::filesystem::temp_directory_path() / ("async_sink_reopen_" + std::to_string(getpid()) + ".bin");
+    common::AsyncFileSink sink(common::AsyncFileSink::Options{});
+    for (int i = 0; i < 2; i++) {
+        ASSERT_TRUE(sink.open(path.string()));
+        auto expected = write_records(sink, 1000 + i);
+        sink.end();
+        EXPECT_EQ(read_file(path), expected);
+    }
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,256 @@
+#include <gtest/gtest.h>
+#include <CANCodec.hpp>
+
+#include <google/protobuf/descriptor.pb.h>
+#include <google/protobuf/dynamic_message.h>
+#include <google/protobuf/text_format.h>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+// the codec is tested against a small DBC and a matching protobuf schema built at runtime so
+// that the tests do not depend on the version of hytech.dbc / hytech.proto that gets pulled in
+
+static const char *test_dbc = R"(VERSION ""
+
+NS_ :
+
+BS_:
+
+BU_: ECU
+
+BO_ 256 TEST_MSG: 8 ECU
+ SG_ speed_rpm : 0|16@1- (1,0) [0|0] "" Vector__XXX
+ SG_ temp_c : 16|8@1+ (0.5,-40) [0|0] "" Vector__XXX
+ SG_ motorola_val : 39|12@0+ (1,0) [0|0] "" Vector__XXX
+ SG_ state : 48|3@1+ (1,0) [0|0] "" Vector__XXX
+ SG_ enabled : 51|1@1+ (1,0) [0|0] "" Vector__XXX
+
+BO_ 2550588916 EXT_MSG: 2 ECU
+ SG_ value : 0|16@1+ (0.1,0) [0|0] "" Vector__XXX
+
+BO_ 512 FD_MSG: 64 ECU
+ SG_ first : 0|16@1+ (1,0) [0|0] "" Vector__XXX
+ SG_ middle : 103|16@0- (1,0) [0|0] "" Vector__XXX
+ SG_ last : 480|32@1+ (1,0) [0|0] "" Vector__XXX
+
+VAL_ 256 state 0 "OFF" 1 "ON" 2 "FAULT" ;
+)";
+
+static const char *test_proto = R"(
+name: "codec_test.proto"
+package: "codec_test"
+syntax: "proto3"
+enum_type { name: "state_enum" value { name: "OFF" number: 0 } value { name: "ON" number: 1 } value { name: "FAULT" number: 2 } }
+message_type {
+  name: "test_msg"
+  field { name: "speed_rpm" number: 1 label: LABEL_OPTIONAL type: TYPE_FLOAT }
+  field { name: "temp_c" number: 2 label: LABEL_OPTIONAL type: TYPE_FLOAT }
+  field { name: "motorola_val" number: 3 label: LABEL_OPTIONAL type: TYPE_INT32 }
+  field { name: "state" number: 4 label: LABEL_OPTIONAL type: TYPE_ENUM type_name: ".codec_test.state_enum" }
+  field { name: "enabled" number: 5 label: LABEL_OPTIONAL type: TYPE_BOOL }
+}
+message_type {
+  name: "ext_msg"
+  field { name: "value" number: 1 label: LABEL_OPTIONAL type: TYPE_DOUBLE }
+}
+message_type {
+  name: "fd_msg"
+  field { name: "first" number: 1 label: LABEL_OPTIONAL type: TYPE_UINT32 }
+  field { name: "middle" number: 2 label: LABEL_OPTIONAL type: TYPE_INT32 }
+  field { name: "last" number: 3 label: LABEL_OPTIONAL type: TYPE_UINT32 }
+}
+)";
+
+class CANCodecTest : public testing::Test {
+
+    protected:
+        google::protobuf::DescriptorPool pool;
+        google::protobuf::DynamicMessageFactory factory;
+        comms::CANMessageCodec codec;
+
+        void SetUp() override {
+            google::protobuf::FileDescriptorProto file_proto;
+            ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(test_proto, &file_proto));
+            ASSERT_NE(pool.BuildFile(file_proto), nullptr);
+
+            std::istringstream dbc(test_dbc);
+            auto net = dbcppp::INetwork::LoadDBCFromIs(dbc);
+            ASSERT_TRUE(net);
+            ASSERT_TRUE(codec.build(*net, &pool, &factory, "codec_test"));
+        }
+};
+
+TEST(CANSignalLayout, IntelExtractInsert) {
+    auto layout = comms::CANSignalLayout::create(4, 12, false, false, comms::CANSignalLayout::ValueKind::Integer, 1, 0);
+    uint8_t data[8] = {};
+    layout.insert(data, 0xABC);
+    EXPECT_EQ(data[0], 0xC0);
+    EXPECT_EQ(data[1], 0xAB);
+    EXPECT_EQ(layout.extract(data), 0xABCu);
+}
+
+TEST(CANSignalLayout, MotorolaExtractInsert) {
+    // msb at bit 7 of byte 0, spanning into the high nibble of byte 1
+    auto layout = comms::CANSignalLayout::create(7, 12, true, false, comms::CANSignalLayout::ValueKind::Integer, 1, 0);
+    uint8_t data[8] = {};
+    data[1] = 0x0F; // bits not part of the signal stay untouched
+    layout.insert(data, 0xABC);
+    EXPECT_EQ(data[0], 0xAB);
+    EXPECT_EQ(data[1], 0xCF);
+    EXPECT_EQ(layout.extract(data), 0xABCu);
+}
+
+TEST(CANSignalLayout, SignedScaling) {
+    auto layout = comms::CANSignalLayout::create(0, 12, false, true, comms::CANSignalLayout::ValueKind::Integer, 0.5, 1.0);
+    EXPECT_EQ(layout.to_integer(0xFFF), -1);
+    EXPECT_DOUBLE_EQ(layout.raw_to_phys(0xFFF), 0.5);
+    EXPECT_EQ(layout.phys_to_raw(0.5), 0xFFFu);
+}
+
+TEST(CANSignalLayout, ClampsOutOfRangeValues) {
+    auto is_signed = comms::CANSignalLayout::create(0, 12, false, true, comms::CANSignalLayout::ValueKind::Integer, 1, 0);
+    EXPECT_EQ(is_signed.phys_to_raw(5000.0), 0x7FFu);
+    EXPECT_EQ(is_signed.phys_to_raw(-5000.0), 0x800u);
+    EXPECT_EQ(is_signed.phys_to_raw(std::nan("")), 0u);
+    auto is_unsigned = comms::CANSignalLayout::create(0, 8, false, false, comms::CANSignalLayout::ValueKind::Integer, 0.1, 0);
+    EXPECT_EQ(is_unsigned.phys_to_raw(1e30), 0xFFu);
+    EXPECT_EQ(is_unsigned.phys_to_raw(-3.0), 0u);
+    EXPECT_EQ(is_unsigned.phys_to_raw(-std::numeric_limits<double>::infinity()), 0u);
+    auto wide = comms::CANSignalLayout::create(0, 64, false, true, comms::CANSignalLayout::ValueKind::Integer, 1, 0);
+    EXPECT_EQ(wide.phys_to_raw(1e300), 0x7FFFFFFFFFFFFFFFu);
+    EXPECT_EQ(wide.phys_to_raw(-1e300), 0x8000000000000000u);
+}
+
+TEST_F(CANCodecTest, DecodeStandardFrame) {
+    uint8_t data[8] = {};
+    const int16_t speed = -1234;
+    std::memcpy(data, &speed, sizeof(speed));
+    data[2] = 180;  // 180 * 0.5 - 40 = 50 C
+    data[4] = 0x12; // motorola 0x123
+    data[5] = 0x30;
+    data[6] = 0x02 | (1 << 3); // FAULT, enabled
+
+    auto msg = codec.decode(256, data, sizeof(data));
+    ASSERT_NE(msg, nullptr);
+    const auto *desc = msg->GetDescriptor();
+    const auto *refl = msg->GetReflection();
+    EXPECT_EQ(desc->full_name(), "codec_test.test_msg");
+    EXPECT_FLOAT_EQ(refl->GetFloat(*msg, desc->FindFieldByName("speed_rpm")), -1234.0f);
+    EXPECT_FLOAT_EQ(refl->GetFloat(*msg, desc->FindFieldByName("temp_c")), 50.0f);
+    EXPECT_EQ(refl->GetInt32(*msg, desc->FindFieldByName("motorola_val")), 0x123);
+    EXPECT_EQ(refl->GetEnumValue(*msg, desc->FindFieldByName("state")), 2);
+    EXPECT_TRUE(refl->GetBool(*msg, desc->FindFieldByName("enabled")));
+}
+
+TEST_F(CANCodecTest, DecodeExtendedFrame) {
+    uint8_t data[8] = {0x10, 0x27}; // 10000 * 0.1
+    auto msg = codec.decode(2550588916u, data, 2);
+    ASSERT_NE(msg, nullptr);
+    const auto *desc = msg->GetDescriptor();
+    EXPECT_DOUBLE_EQ(msg->GetReflection()->GetDouble(*msg, desc->FindFieldByName("value")), 1000.0);
+}
+
+TEST_F(CANCodecTest, UnknownIdIsNotDecoded) {
+    uint8_t data[8] = {};
+    EXPECT_EQ(codec.decode(257, data, sizeof(data)), nullptr);
+    EXPECT_EQ(codec.decode(0x1FFFFFFF | CAN_EFF_FLAG, data, sizeof(data)), nullptr);
+}
+
+TEST_F(CANCodecTest, EncodeDecodeRoundTrip) {
+    const auto *desc = pool.FindMessageTypeByName("codec_test.test_msg");
+    std::unique_ptr<google::protobuf::Message> msg(factory.GetPrototype(desc)->New());
+    const auto *refl = msg->GetReflection();
+    refl->SetFloat(msg.get(), desc->FindFieldByName("speed_rpm"), -1234.0f);
+    refl->SetFloat(msg.get(), desc->FindFieldByName("temp_c"), 50.0f);
+    refl->SetInt32(msg.get(), desc->FindFieldByName("motorola_val"), 0x123);
+    refl->SetEnumValue(msg.get(), desc->FindFieldByName("state"), 2);
+    refl->SetBool(msg.get(), desc->FindFieldByName("enabled"), true);
+
+    auto frame = codec.encode(*msg);
+    ASSERT_TRUE(frame);
+    EXPECT_EQ(frame->can_id, 256u);
+    EXPECT_EQ(frame->len, 8);
+    EXPECT_EQ(frame->flags, 0); // classic frame
+    EXPECT_EQ(frame->data[4], 0x12);
+    EXPECT_EQ(frame->data[5], 0x30);
+    EXPECT_EQ(frame->data[6], 0x02 | (1 << 3)); // FAULT gets sent as its DBC raw value
+
+    auto decoded = codec.decode(frame->can_id, frame->data, frame->len);
+    ASSERT_NE(decoded, nullptr);
+    EXPECT_EQ(decoded->SerializeAsString(), msg->SerializeAsString());
+}
+
+TEST_F(CANCodecTest, UnknownMessageIsNotEncoded) {
+    google::protobuf::FileDescriptorProto file_proto;
+    EXPECT_FALSE(codec.encode(file_proto));
+}
+
+TEST_F(CANCodecTest, RxFiltersCoverDBCIds) {
+    auto filters = codec.make_rx_filters();
+    ASSERT_EQ(filters.size(), 3u);
+    for (const auto &filter : filters) {
+        if (filter.can_id & CAN_EFF_FLAG) {
+            EXPECT_EQ(filter.can_id, 2550588916u);
+            EXPECT_EQ(filter.can_mask, CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_EFF_MASK);
+        } else {
+            EXPECT_TRUE(filter.can_id == 256u || filter.can_id == 512u);
+            EXPECT_EQ(filter.can_mask, CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_SFF_MASK);
+        }
+    }
+}
+
+TEST_F(CANCodecTest, RxFiltersNarrowedByAllowList) {
+    // names are case insensitive, extended IDs work with or without the EFF flag, unknown entries are skipped
+    auto by_name = codec.make_rx_filters({"TEST_MSG", "not_a_message"});
+    ASSERT_EQ(by_name.size(), 1u);
+    EXPECT_EQ(by_name[0].can_id, 256u);
+
+    auto by_id = codec.make_rx_filters({"0x1806E5F4", "256", "256"});
+    ASSERT_EQ(by_id.size(), 2u);
+    EXPECT_EQ(by_id[0].can_id, 256u);
+    EXPECT_EQ(by_id[1].can_id, 2550588916u);
+}
+
+TEST_F(CANCodecTest, FDEncodeDecodeRoundTrip) {
+    const auto *desc = pool.FindMessageTypeByName("codec_test.fd_msg");
+    std::unique_ptr<google::protobuf::Message> msg(factory.GetPrototype(desc)->New());
+    const auto *refl = msg->GetReflection();
+    refl->SetUInt32(msg.get(), desc->FindFieldByName("first"), 0xBEEF);
+    refl->SetInt32(msg.get(), desc->FindFieldByName("middle"), -2);
+    refl->SetUInt32(msg.get(), desc->FindFieldByName("last"), 0xDEADBEEF);
+
+    auto frame = codec.encode(*msg);
+    ASSERT_TRUE(frame);
+    EXPECT_EQ(frame->can_id, 512u);
+    EXPECT_EQ(frame->len, 64);
+    EXPECT_EQ(frame->flags, CANFD_FDF);
+    EXPECT_EQ(frame->data[12], 0xFF); // motorola signal in the middle of the payload
+    EXPECT_EQ(frame->data[13], 0xFE);
+    EXPECT_EQ(frame->data[60], 0xEF);
+    EXPECT_EQ(frame->data[63], 0xDE);
+
+    auto decoded = codec.decode(frame->can_id, frame->data, frame->len);
+    ASSERT_NE(decoded, nullptr);
+    EXPECT_EQ(decoded->SerializeAsString(), msg->SerializeAsString());
+}
+
+TEST_F(CANCodecTest, ShortFrameIsZeroPadded) {
+    // a classic frame for an FD message only has the first 8 bytes of the payload
+    uint8_t data[CANFD_MAX_DLEN];
+    std::memset(data, 0xFF, sizeof(data));
+    auto msg = codec.decode(512, data, CAN_MAX_DLEN);
+    ASSERT_NE(msg, nullptr);
+    const auto *desc = msg->GetDescriptor();
+    EXPECT_EQ(msg->GetReflection()->GetUInt32(*msg, desc->FindFieldByName("first")), 0xFFFFu);
+    EXPECT_EQ(msg->GetReflection()->GetUInt32(*msg, desc->FindFieldByName("last")), 0u);
+}
+
+TEST(CANMessageCodec, FDFrameLen) {
+    EXPECT_EQ(comms::CANMessageCodec::fd_frame_len(8), 8);
+    EXPECT_EQ(comms::CANMessageCodec::fd_frame_len(9), 12);
+    EXPECT_EQ(comms::CANMessageCodec::fd_frame_len(33), 48);
+    EXPECT_EQ(comms::CANMessageCodec::fd_frame_len(64), 64);
+}
@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+#include <ChannelDecimator.hpp>
+#include <hytech.pb.h>
+#include <hytech_msgs.pb.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+    util::ChannelDecimator make_decimator()
+    {
+        return util::ChannelDecimator({nullptr,
+                                       hytech::drivetrain_rpms_telem::descriptor(),
+                                       hytech::drivetrain_status_telem::descriptor(),
+                                       hytech_msgs::VehicleData::descriptor()});
+    }
+
+    constexpr int64_t ms = 1000000;
+}
+
+TEST(ChannelDecimator, ParsesRules)
+{
+    EXPECT_EQ(util::ChannelDecimator::parse_rule("full")->mode, util::ChannelDecimator::Mode::Full);
+    EXPECT_EQ(util::ChannelDecimator::parse_rule("on_change")->mode, util::ChannelDecimator::Mode::OnChange);
+    EXPECT_EQ(util::ChannelDecimator::parse_rule("every=4")->every, 4u);
+    EXPECT_DOUBLE_EQ(util::ChannelDecimator::parse_rule("hz=12.5")->max_hz, 12.5);
+    EXPECT_FALSE(util::ChannelDecimator::parse_rule("every=0"));
+    EXPECT_FALSE(util::ChannelDecimator::parse_rule("every=4x"));
+    EXPECT_FALSE(util::ChannelDecimator::parse_rule("hz=-1"));
+    EXPECT_FALSE(util::ChannelDecimator::parse_rule("hz="));
+    EXPECT_FALSE(util::ChannelDecimator::parse_rule("sometimes"));
+}
+
+TEST(ChannelDecimator, KeepsEverythingWithoutRules)
+{
+    auto decimator = make_decimator();
+    hytech_msgs::VehicleData msg;
+    for (int i = 0; i < 100; i++)
+    {
+        EXPECT_TRUE(decimator.keep(msg, i));
+    }
+    EXPECT_EQ(decimator.decimated(3), 0u);
+}
+
+TEST(ChannelDecimator, KeepsEveryNth)
+{
+    auto decimator = make_decimator();
+    ASSERT_TRUE(decimator.set_rules("drivetrain_rpms_telem:every=3"));
+    hytech::drivetrain_rpms_telem rpms;
+    hytech_msgs::VehicleData other;
+    int kept = 0;
+    for (int i = 0; i < 30; i++)
+    {
+        kept += decimator.keep(rpms, i);
+        EXPECT_TRUE(decimator.keep(other, i));
+    }
+    EXPECT_EQ(kept, 10);
+    EXPECT_EQ(decimator.decimated(1), 20u);
+}
+
+TEST(ChannelDecimator, LimitsTheRate)
+{
+    auto decimator = make_decimator();
+    ASSERT_TRUE(decimator.set_rules(" VehicleData : hz=100 "));
+    hytech_msgs::VehicleData msg;
+    // 1 kHz for a second
+    int kept = 0;
+    for (int i = 0; i < 1000; i++)
+    {
+        kept += decimator.keep(msg, 1000 * ms + i * ms);
+    }
+    EXPECT_EQ(kept, 100);
+
+    // after a pause the next message goes through right away, but there is no burst
+    EXPECT_TRUE(decimator.keep(msg, 5000 * ms));
+    EXPECT_FALSE(decimator.keep(msg, 5000 * ms + 1));
+    EXPECT_TRUE(decimator.keep(msg, 5010 * ms));
+}
+
+TEST(ChannelDecimator, KeepsOnlyChanges)
+{
+    auto decimator = make_decimator();
+    ASSERT_TRUE(decimator.set_rules("drivetrain_status_telem:on_change"));
+    hytech::drivetrain_status_telem msg;
+    EXPECT_TRUE(decimator.keep(msg, 0));
+    EXPECT_FALSE(decimator.keep(msg, 1));
+    msg.set_mc1_dc_on(true);
+    EXPECT_TRUE(decimator.keep(msg, 2));
+    EXPECT_FALSE(decimator.keep(msg, 3));
+    msg.set_mc1_dc_on(false);
+    EXPECT_TRUE(decimator.keep(msg, 4));
+    EXPECT_EQ(decimator.decimated(2), 2u);
+}
+
+TEST(ChannelDecimator, BadRulesLeaveTheOldOnes)
+{
+    auto decimator = make_decimator();
+    ASSERT_TRUE(decimator.set_rules("drivetrain_rpms_telem:every=2"));
+    EXPECT_FALSE(decimator.set_rules("drivetrain_rpms_telem:every=3, VehicleData"));
+    // unknown messages are skipped, not an error
+    EXPECT_TRUE(decimator.set_rules("not_a_message:every=5"));
+    hytech::drivetrain_rpms_telem rpms;
+    EXPECT_TRUE(decimator.keep(rpms, 0));
+    EXPECT_TRUE(decimator.keep(rpms, 1));
+
+    ASSERT_TRUE(decimator.set_rules("drivetrain_rpms_telem:every=2"));
+    ASSERT_TRUE(decimator.set_rules(""));
+    EXPECT_TRUE(decimator.keep(rpms, 2));
+    EXPECT_TRUE(decimator.keep(rpms, 3));
+}
+
+TEST(ChannelDecimator, RateLimitHoldsAcrossThreads)
+{
+    auto decimator = make_decimator();
+    ASSERT_TRUE(decimator.set_rules("VehicleData:hz=1000"));
+    // every thread offers a message for every microsecond of the same 100 ms, 100 slots in total
+    std::atomic<int> kept{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&]()
+                             {
+            hytech_msgs::VehicleData msg;
+            for (int64_t us = 0; us < 100000; us++)
+            {
+                kept += decimator.keep(msg, 1000 * ms + us * 1000);
+            } });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    EXPECT_LE(kept.load(), 100);
+    EXPECT_GE(kept.load(), 99);
+}
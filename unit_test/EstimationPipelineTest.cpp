@@ -0,0 +1,220 @@
+#include <gtest/gtest.h>
+#include <JsonFileHandler.hpp>
+#include <EstimationPipeline.hpp>
+#include <EstimationStages.hpp>
+#include <StateEstimator.hpp>
+#include <hytech.pb.h>
+#include "TestMessageLogger.hpp"
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+    using estimation::EstimationFrame;
+    using estimation::FunctionStage;
+
+    // a stage that notes when it ran and writes 1 + the sum of what it reads
+    std::unique_ptr<FunctionStage> make_counting_stage(const std::string &name, std::vector<std::string> inputs, std::vector<std::string> outputs,
+                                                       std::vector<std::string> &ran)
+    {
+        return std::make_unique<FunctionStage>(name, inputs, outputs, [name, inputs, outputs, &ran](EstimationFrame &frame)
+        {
+            ran.push_back(name);
+            float sum = 1.f;
+            for (const auto &input : inputs)
+            {
+                sum += frame.signals[frame.signals.index(input)];
+            }
+            for (const auto &output : outputs)
+            {
+                frame.signals[frame.signals.index(output)] = sum;
+            }
+        });
+    }
+}
+
+TEST(EstimationPipeline, RunsStagesAfterTheStagesTheyReadFrom)
+{
+    std::vector<std::string> ran;
+    estimation::EstimationPipeline pipeline;
+    pipeline.add_stage(make_counting_stage("c", {"b"}, {"c"}, ran));
+    pipeline.add_stage(make_counting_stage("unrelated", {}, {"u"}, ran));
+    pipeline.add_stage(make_counting_stage("b", {"a"}, {"b"}, ran));
+    pipeline.add_stage(make_counting_stage("a", {}, {"a"}, ran));
+    ASSERT_TRUE(pipeline.build());
+
+    core::RawInputData raw = {};
+    core::VehicleState state = {};
+    pipeline.step(raw, state, 0.f);
+
+    EXPECT_EQ(ran, (std::vector<std::string>{"unrelated", "a", "b", "c"}));
+    ASSERT_EQ(pipeline.num_stages(), 4u);
+    EXPECT_EQ(pipeline.stage_name(0), "unrelated");
+    const auto &signals = pipeline.signals();
+    EXPECT_EQ(signals[signals.index("c")], 3.f);
+    EXPECT_EQ(signals.index("current_rpms"), estimation::SignalTable::npos);
+}
+
+TEST(EstimationPipeline, RejectsTwoWritersAndLoops)
+{
+    std::vector<std::string> ran;
+    estimation::EstimationPipeline two_writers;
+    two_writers.add_stage(make_counting_stage("a", {}, {"x"}, ran));
+    two_writers.add_stage(make_counting_stage("b", {}, {"x"}, ran));
+    EXPECT_FALSE(two_writers.build());
+
+    estimation::EstimationPipeline loop;
+    loop.add_stage(make_counting_stage("a", {"y"}, {"x"}, ran));
+    loop.add_stage(make_counting_stage("b", {"x"}, {"y"}, ran));
+    EXPECT_FALSE(loop.build());
+
+    core::RawInputData raw = {};
+    core::VehicleState state = {};
+    loop.step(raw, state, 0.f);
+    EXPECT_TRUE(ran.empty());
+}
+
+TEST(EstimationPipeline, TimesEveryStep)
+{
+    std::vector<std::string> ran;
+    estimation::EstimationPipeline pipeline;
+    pipeline.add_stage(make_counting_stage("a", {}, {"a"}, ran));
+    pipeline.add_stage(make_counting_stage("b", {"a"}, {"b"}, ran));
+    ASSERT_TRUE(pipeline.build());
+
+    core::RawInputData raw = {};
+    core::VehicleState state = {};
+    for (int i = 0; i < 10; i++)
+    {
+        pipeline.step(raw, state, 0.001f);
+    }
+
+    auto total = [](const util::LatencyHistogram &histogram)
+    {
+        uint64_t count = 0;
+        for (auto bucket : histogram.counts())
+        {
+            count += bucket;
+        }
+        return count;
+    };
+    EXPECT_EQ(total(pipeline.stage_timing(0)), 10u);
+    EXPECT_EQ(total(pipeline.stage_timing(1)), 10u);
+    EXPECT_EQ(total(pipeline.total_timing()), 10u);
+}
+
+TEST(EstimationStages, SteeringAngleAndWheelSlip)
+{
+    estimation::EstimationPipeline pipeline;
+    pipeline.add_stage(std::make_unique<estimation::LowPassFilterStage>("wheel_slip_rl", "wheel_slip_rl_filtered", 10.f));
+    pipeline.add_stage(std::make_unique<estimation::WheelSlipStage>(estimation::WheelSlipStage::config{0.2f, 10.f, 1.f}));
+    pipeline.add_stage(std::make_unique<estimation::SteeringAngleStage>(estimation::SteeringAngleStage::config{2000.f, 0.5f}));
+    ASSERT_TRUE(pipeline.build());
+
+    core::RawInputData raw = {};
+    raw.raw_steering_analog = 2100.f;
+    core::VehicleState state = {};
+    state.current_body_vel_ms.x = 10.f;
+    // 10 m/s at the wheel is 10 / 0.2 rad/s at the wheel, 10x that at the motor
+    const float rpm_at_10_m_s = 10.f / 0.2f * 10.f * 60.f / (2.f * static_cast<float>(M_PI));
+    state.current_rpms = {rpm_at_10_m_s, rpm_at_10_m_s, rpm_at_10_m_s * 1.1f, rpm_at_10_m_s * 1.1f};
+    pipeline.step(raw, state, 0.f);
+
+    EXPECT_FLOAT_EQ(state.steering_angle_deg, 50.f);
+    const auto &signals = pipeline.signals();
+    EXPECT_FLOAT_EQ(signals[signals.index("steering_angle_deg")], 50.f);
+    EXPECT_NEAR(signals[signals.index("wheel_slip_fl")], 0.f, 1e-5f);
+    EXPECT_NEAR(signals[signals.index("wheel_slip_rr")], 0.1f, 1e-5f);
+    // the filter starts at its input
+    EXPECT_NEAR(signals[signals.index("wheel_slip_rl_filtered")], 0.1f, 1e-5f);
+
+    // standing still the slip is against the min speed
+    state.current_body_vel_ms.x = 0.f;
+    state.current_rpms = {0.f, 0.f, rpm_at_10_m_s * 0.1f, 0.f};
+    pipeline.step(raw, state, 0.01f);
+    EXPECT_NEAR(signals[signals.index("wheel_slip_rl")], 1.f, 1e-5f);
+    const float rc = 1.f / (2.f * static_cast<float>(M_PI) * 10.f);
+    const float alpha = 0.01f / (rc + 0.01f);
+    EXPECT_NEAR(signals[signals.index("wheel_slip_rl_filtered")], 0.1f + alpha * 0.9f, 1e-5f);
+}
+
+TEST(EstimationPipeline, CopiesStateSignalsIntoTheState)
+{
+    estimation::EstimationPipeline pipeline;
+    pipeline.add_stage(std::make_unique<estimation::LowPassFilterStage>("steering_angle_deg", "steering_angle_deg_filtered", 10.f));
+    pipeline.add_stage(std::make_unique<estimation::SteeringAngleStage>(estimation::SteeringAngleStage::config{0.f, 1.f}));
+    // stands in for the tire model, reads the steering angle out of the state
+    pipeline.add_stage(std::make_unique<FunctionStage>("tire_model", std::vector<std::string>{"steering_angle_deg"},
+                                                       std::vector<std::string>{"matlab_math_temp_out_fl", "matlab_math_temp_out_rr"},
+                                                       [](EstimationFrame &frame)
+    {
+        frame.signals[frame.signals.index("matlab_math_temp_out_fl")] = frame.state.steering_angle_deg;
+        frame.signals[frame.signals.index("matlab_math_temp_out_rr")] = -1.f;
+    }));
+    ASSERT_TRUE(pipeline.build());
+
+    core::RawInputData raw = {};
+    raw.raw_steering_analog = 20.f;
+    core::VehicleState state = {};
+    pipeline.step(raw, state, 0.f);
+    EXPECT_FLOAT_EQ(state.steering_angle_deg, 20.f);
+    EXPECT_FLOAT_EQ(state.matlab_math_temp_out.res_torque_lim_nm.FL, 20.f);
+    EXPECT_FLOAT_EQ(state.matlab_math_temp_out.res_torque_lim_nm.RR, -1.f);
+    EXPECT_FLOAT_EQ(state.matlab_math_temp_out.res_torque_lim_nm.FR, 0.f);
+
+    raw.raw_steering_analog = 30.f;
+    pipeline.step(raw, state, 0.01f);
+    const auto &signals = pipeline.signals();
+    const float rc = 1.f / (2.f * static_cast<float>(M_PI) * 10.f);
+    const float alpha = 0.01f / (rc + 0.01f);
+    EXPECT_NEAR(signals[signals.index("steering_angle_deg_filtered")], 20.f + alpha * 10.f, 1e-5f);
+}
+
+TEST(StateEstimator, RunsTheEstimationPipelineOnTheState)
+{
+    core::Logger logger(core::LogLevel::INFO);
+    core::JsonFileHandler config(TEST_CONFIG_DIR "/state_estimator.json");
+    core::StateEstimator estimator(logger, config, test::make_message_logger());
+    estimator.pipeline().add_stage(std::make_unique<estimation::SteeringAngleStage>(estimation::SteeringAngleStage::config{100.f, 0.25f}));
+    ASSERT_TRUE(estimator.init());
+
+    auto steering = std::make_shared<hytech::steering_data>();
+    steering->set_steering_analog_raw(140);
+    estimator.handle_recv_process(steering);
+
+    auto state = estimator.get_latest_state_and_validity().first;
+    EXPECT_FLOAT_EQ(state.steering_angle_deg, 10.f);
+    EXPECT_EQ(estimator.pipeline().stage_name(0), "steering_angle");
+}
+
+TEST(StateEstimator, PublishesTheEstimationSignals)
+{
+    core::Logger logger(core::LogLevel::INFO);
+    core::JsonFileHandler config(TEST_CONFIG_DIR "/state_estimator.json");
+    std::vector<std::shared_ptr<db_service::v1::estimation::EstimationSignals>> published;
+    auto message_logger = test::make_message_logger([&published](test::message_ptr msg)
+    {
+        if (msg->GetDescriptor() == db_service::v1::estimation::EstimationSignals::descriptor())
+        {
+            published.push_back(std::static_pointer_cast<db_service::v1::estimation::EstimationSignals>(msg));
+        }
+    });
+    core::StateEstimator estimator(logger, config, message_logger);
+    estimator.pipeline().add_stage(std::make_unique<estimation::SteeringAngleStage>(estimation::SteeringAngleStage::config{100.f, 0.25f}));
+    estimator.pipeline().add_stage(std::make_unique<estimation::LowPassFilterStage>("steering_angle_deg", "steering_angle_deg_filtered", 10.f));
+    ASSERT_TRUE(estimator.init());
+
+    auto steering = std::make_shared<hytech::steering_data>();
+    steering->set_steering_analog_raw(140);
+    estimator.handle_recv_process(steering);
+    estimator.get_latest_state_and_validity();
+
+    ASSERT_EQ(published.size(), 1u);
+    ASSERT_EQ(published[0]->signals_size(), 2);
+    EXPECT_EQ(published[0]->signals(0).name(), "steering_angle_deg");
+    EXPECT_FLOAT_EQ(published[0]->signals(0).value(), 10.f);
+    EXPECT_EQ(published[0]->signals(1).name(), "steering_angle_deg_filtered");
+    EXPECT_FLOAT_EQ(published[0]->signals(1).value(), 10.f);
+}
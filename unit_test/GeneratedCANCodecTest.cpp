@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+#include <CANCodec.hpp>
+#include <GeneratedCANCodec.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+
+// differential test of the typed codec generated from config/hytech.dbc against the DBC plans:
+// both have to produce byte for byte identical protobufs for random payloads of every message,
+// and identical frames when encoding those messages back
+
+class GeneratedCANCodecTest : public testing::Test {
+    protected:
+        comms::CANMessageCodec plan_codec;
+        comms::CANMessageCodec generated_codec;
+        size_t num_generated = 0;
+
+        void SetUp() override {
+            std::ifstream idbc(HYTECH_DBC_PATH);
+            auto net = dbcppp::INetwork::LoadDBCFromIs(idbc);
+            ASSERT_TRUE(net);
+            ASSERT_TRUE(plan_codec.build(*net));
+            ASSERT_TRUE(generated_codec.build(*net));
+            num_generated = generated_codec.use_generated(comms::generated::message_codecs, comms::generated::num_message_codecs);
+        }
+};
+
+TEST_F(GeneratedCANCodecTest, EveryMessageUsesGeneratedCode) {
+    // generated from the same DBC so every fingerprint matches
+    EXPECT_EQ(num_generated, plan_codec.decode_plans().size());
+    for (const auto &plan : generated_codec.decode_plans()) {
+        EXPECT_NE(plan.typed_decode, nullptr) << plan.descriptor->name();
+        EXPECT_EQ(plan_codec.find_decode_plan(plan.can_id)->typed_decode, nullptr);
+    }
+}
+
+TEST_F(GeneratedCANCodecTest, RandomFramesDecodeIdentically) {
+    std::mt19937_64 rng(1234);
+    for (const auto &plan : plan_codec.decode_plans()) {
+        for (int i = 0; i < 200; i++) {
+            uint8_t data[CANFD_MAX_DLEN];
+            for (auto &byte : data) {
+                byte = static_cast<uint8_t>(rng());
+            }
+            // every so often a short frame, which the codec zero pads
+            const size_t len = (i % 10 == 0) ? rng() % (plan.message_size + 1) : plan.message_size;
+
+            auto expected = plan_codec.decode(plan.can_id, data, len);
+            auto generated = generated_codec.decode(plan.can_id, data, len);
+            ASSERT_TRUE(expected && generated);
+            ASSERT_EQ(expected->SerializeAsString(), generated->SerializeAsString())
+                << plan.descriptor->name() << "\n plans: " << expected->ShortDebugString() << "\n generated: " << generated->ShortDebugString();
+        }
+    }
+}
+
+TEST_F(GeneratedCANCodecTest, DecodedMessagesEncodeIdentically) {
+    std::mt19937_64 rng(4321);
+    for (const auto &plan : plan_codec.decode_plans()) {
+        for (int i = 0; i < 200; i++) {
+            uint8_t data[CANFD_MAX_DLEN];
+            for (auto &byte : data) {
+                byte = static_cast<uint8_t>(rng());
+            }
+            auto msg = plan_codec.decode(plan.can_id, data, plan.message_size);
+            ASSERT_TRUE(msg);
+
+            auto expected = plan_codec.encode(*msg);
+            auto generated = generated_codec.encode(*msg);
+            ASSERT_TRUE(expected && generated);
+            EXPECT_EQ(expected->can_id, generated->can_id);
+            EXPECT_EQ(expected->len, generated->len);
+            EXPECT_EQ(expected->flags, generated->flags);
+            ASSERT_EQ(std::memcmp(expected->data, generated->data, sizeof(expected->data)), 0) << plan.descriptor->name();
+        }
+    }
+}
+
+TEST_F(GeneratedCANCodecTest, ChangedMessageFallsBackToPlans) {
+    // a DBC where one message differs from what the code was generated from (different scaling)
+    const auto &first = plan_codec.decode_plans().front();
+    comms::CANMessageCodec codec;
+    std::ifstream idbc(HYTECH_DBC_PATH);
+    std::string dbc((std::istreambuf_iterator<char>(idbc)), std::istreambuf_iterator<char>());
+    const std::string header = "BO_ " + std::to_string(first.can_id) + " ";
+    auto msg_pos = dbc.find(header);
+    ASSERT_NE(msg_pos, std::string::npos);
+    auto scale_pos = dbc.find(" (", msg_pos);
+    ASSERT_NE(scale_pos, std::string::npos);
+    dbc.insert(scale_pos + 2, "1");
+
+    std::istringstream changed(dbc);
+    auto net = dbcppp::INetwork::LoadDBCFromIs(changed);
+    ASSERT_TRUE(net);
+    ASSERT_TRUE(codec.build(*net));
+    EXPECT_EQ(codec.use_generated(comms::generated::message_codecs, comms::generated::num_message_codecs), num_generated - 1);
+    EXPECT_EQ(codec.find_decode_plan(first.can_id)->typed_decode, nullptr);
+}
@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+#include <LatencyHistogram.hpp>
+#include <AcquisitionTime.hpp>
+
+#include <chrono>
+#include <thread>
+
+TEST(LatencyHistogram, CountsInPowerOfTwoBuckets)
+{
+    EXPECT_EQ(util::LatencyHistogram::bucket(-5), 0u);
+    EXPECT_EQ(util::LatencyHistogram::bucket(0), 0u);
+    EXPECT_EQ(util::LatencyHistogram::bucket(1), 1u);
+    EXPECT_EQ(util::LatencyHistogram::bucket(3), 2u);
+    EXPECT_EQ(util::LatencyHistogram::bucket(4), 3u);
+    EXPECT_EQ(util::LatencyHistogram::bucket(1000), 10u);
+    EXPECT_EQ(util::LatencyHistogram::bucket(int64_t{1} << 40), util::LatencyHistogram::num_buckets - 1);
+
+    util::LatencyHistogram histogram;
+    EXPECT_EQ(util::LatencyHistogram::quantile_us(histogram.counts(), 0.5), 0);
+    for (int i = 0; i < 99; i++)
+    {
+        histogram.record(std::chrono::microseconds(100));
+    }
+    histogram.record(std::chrono::milliseconds(5));
+
+    const auto counts = histogram.counts();
+    EXPECT_EQ(counts[7], 99u);
+    EXPECT_EQ(counts[13], 1u);
+    EXPECT_EQ(util::LatencyHistogram::quantile_us(counts, 0.5), 128);
+    EXPECT_EQ(util::LatencyHistogram::quantile_us(counts, 0.99), 128);
+    EXPECT_EQ(util::LatencyHistogram::quantile_us(counts, 1.0), 8192);
+}
+
+TEST(AcquisitionTime, IsSetForItsScopeOnItsThread)
+{
+    EXPECT_FALSE(util::AcquisitionTime::current());
+    {
+        util::AcquisitionTime outer(std::chrono::microseconds(10));
+        {
+            util::AcquisitionTime inner(std::chrono::microseconds(20));
+            EXPECT_EQ(util::AcquisitionTime::current()->count(), 20);
+        }
+        EXPECT_EQ(util::AcquisitionTime::current()->count(), 10);
+
+        bool set_on_other_thread = true;
+        std::thread other([&]() { set_on_other_thread = util::AcquisitionTime::current().has_value(); });
+        other.join();
+        EXPECT_FALSE(set_on_other_thread);
+    }
+    EXPECT_FALSE(util::AcquisitionTime::current());
+}
@@ -0,0 +1,295 @@
+#include <gtest/gtest.h>
+#include <JsonFileHandler.hpp>
+#include <Logger.hpp>
+#include <MCAPProtobufLogger.hpp>
+#include <mcap/reader.hpp>
+#include <hytech_msgs.pb.h>
+#include <db_service/v1/estimation/input_staleness.pb.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace {
+    // holds up the logger thread in the diagnostics handler (called after every batch with
+    // diagnostics_period_ms 0) so that the queue fills up behind it
+    class LoggerStall
+    {
+    public:
+        void handler(std::shared_ptr<google::protobuf::Message>)
+        {
+            std::unique_lock lk(_mtx);
+            if (_released)
+            {
+                return;
+            }
+            _stalled = true;
+            _cv.notify_all();
+            _cv.wait(lk, [this]() { return _released; });
+        }
+
+        void wait_until_stalled()
+        {
+            std::unique_lock lk(_mtx);
+            _cv.wait(lk, [this]() { return _stalled; });
+        }
+
+        void release()
+        {
+            {
+                std::unique_lock lk(_mtx);
+                _released = true;
+            }
+            _cv.notify_all();
+        }
+
+    private:
+        std::mutex _mtx;
+        std::condition_variable _cv;
+        bool _stalled = false;
+        bool _released = false;
+    };
+
+    class MCAPProtobufLoggerTest : public testing::Test
+    {
+    protected:
+        void SetUp() override
+        {
+            const auto *test = testing::UnitTest::GetInstance()->current_test_info();
+            _dir = std::filesystem::temp_directory_path() / (std::string("MCAPProtobufLoggerTest_") + test->name());
+            std::filesystem::remove_all(_dir);
+            std::filesystem::create_directories(_dir);
+        }
+
+        void TearDown() override
+        {
+            std::filesystem::remove_all(_dir);
+        }
+
+        std::unique_ptr<common::MCAPProtobufLogger> make_logger(const std::string &queue_policy, int queue_capacity, const std::string &extra_params = "")
+        {
+            const auto config_path = _dir / "config.json";
+            {
+                std::ofstream config(config_path);
+                config << "{\"MCAPProtobufLogger\": {\"compression\": \"none\", \"compression_level\": \"default\", \"chunk_size_kb\": 0, "
+                       << "\"deferred_serialization\": false, \"diagnostics_period_ms\": 0, \"priority_channels\": \"VehicleData\", "
+                       << "\"queue_policy\": \"" << queue_policy << "\", \"queue_capacity\": " << queue_capacity << extra_params << "}}";
+            }
+            _config = std::make_unique<core::JsonFileHandler>(config_path.string());
+            auto logger = std::make_unique<common::MCAPProtobufLogger>(_logger, *_config, _dir.string());
+            EXPECT_TRUE(logger->init());
+            return logger;
+        }
+
+        // waits for the logger thread to get through the queue
+        static void wait_until_written(common::MCAPProtobufLogger &logger, const google::protobuf::Descriptor *descriptor, uint64_t written)
+        {
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+            while (logger.channel_counts(descriptor).written < written && std::chrono::steady_clock::now() < deadline)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        // the number of messages of a topic in an mcap
+        static size_t count_messages(const std::filesystem::path &path, const std::string &topic)
+        {
+            mcap::McapReader reader;
+            if (!reader.open(path.string()).ok())
+            {
+                return 0;
+            }
+            size_t count = 0;
+            for (const auto &view : reader.readMessages())
+            {
+                count += view.channel->topic == topic ? 1 : 0;
+            }
+            reader.close();
+            return count;
+        }
+
+        static std::shared_ptr<hytech_msgs::VehicleData> make_vehicle_data(float accel)
+        {
+            auto msg = std::make_shared<hytech_msgs::VehicleData>();
+            msg->mutable_current_inputs()->set_accel_percent(accel);
+            return msg;
+        }
+
+        static std::shared_ptr<db_service::v1::estimation::InputStaleness> make_staleness(uint32_t stale_inputs)
+        {
+            auto msg = std::make_shared<db_service::v1::estimation::InputStaleness>();
+            msg->set_stale_inputs(stale_inputs);
+            return msg;
+        }
+
+        std::filesystem::path _dir;
+        core::Logger _logger{core::LogLevel::WARNING};
+        std::unique_ptr<core::JsonFileHandler> _config;
+    };
+}
+
+TEST_F(MCAPProtobufLoggerTest, LogsNothingOutsideOfASession)
+{
+    auto logger = make_logger("drop_oldest", 16);
+    logger->log_msg(make_vehicle_data(1.f));
+    const auto counts = logger->channel_counts(hytech_msgs::VehicleData::descriptor());
+    EXPECT_EQ(counts.enqueued, 0u);
+    EXPECT_EQ(counts.dropped, 0u);
+}
+
+TEST_F(MCAPProtobufLoggerTest, DropOldestOverwritesWhatWasNotWrittenYet)
+{
+    auto logger = make_logger("drop_oldest", 16);
+    LoggerStall stall;
+    logger->set_diagnostics_handler([&](std::shared_ptr<google::protobuf::Message> msg) { stall.handler(msg); });
+    logger->open_new_mcap((_dir / "log.mcap").string());
+
+    logger->log_msg(make_vehicle_data(0.f));
+    stall.wait_until_stalled();
+    for (int i = 1; i <= 20; i++)
+    {
+        logger->log_msg(make_vehicle_data(static_cast<float>(i)));
+    }
+    stall.release();
+
+    const auto descriptor = hytech_msgs::VehicleData::descriptor();
+    wait_until_written(*logger, descriptor, 17);
+    const auto counts = logger->channel_counts(descriptor);
+    EXPECT_EQ(counts.enqueued, 21u);
+    EXPECT_EQ(counts.written, 17u);
+    EXPECT_EQ(counts.dropped, 4u);
+    EXPECT_EQ(logger->dropped(), 4u);
+}
+
+TEST_F(MCAPProtobufLoggerTest, PriorityKeepsRoomForThePriorityChannels)
+{
+    auto logger = make_logger("priority", 16);
+    LoggerStall stall;
+    logger->set_diagnostics_handler([&](std::shared_ptr<google::protobuf::Message> msg) { stall.handler(msg); });
+    logger->open_new_mcap((_dir / "log.mcap").string());
+
+    logger->log_msg(make_vehicle_data(0.f));
+    stall.wait_until_stalled();
+    // the queue is 3/4 full after 12, the next two are dropped without being enqueued
+    for (uint32_t i = 1; i <= 14; i++)
+    {
+        logger->log_msg(make_staleness(i));
+    }
+    // VehicleData fills the rest and then overwrites the two oldest
+    for (int i = 1; i <= 6; i++)
+    {
+        logger->log_msg(make_vehicle_data(static_cast<float>(i)));
+    }
+    stall.release();
+
+    const auto vehicle_data = hytech_msgs::VehicleData::descriptor();
+    const auto staleness = db_service::v1::estimation::InputStaleness::descriptor();
+    wait_until_written(*logger, vehicle_data, 7);
+    wait_until_written(*logger, staleness, 10);
+    const auto priority = logger->channel_counts(vehicle_data);
+    EXPECT_EQ(priority.enqueued, 7u);
+    EXPECT_EQ(priority.written, 7u);
+    EXPECT_EQ(priority.dropped, 0u);
+    const auto other = logger->channel_counts(staleness);
+    EXPECT_EQ(other.enqueued, 12u);
+    EXPECT_EQ(other.written, 10u);
+    EXPECT_EQ(other.dropped, 4u);
+}
+
+TEST_F(MCAPProtobufLoggerTest, BlockWaitsForRoom)
+{
+    auto logger = make_logger("block", 16);
+    LoggerStall stall;
+    logger->set_diagnostics_handler([&](std::shared_ptr<google::protobuf::Message> msg) { stall.handler(msg); });
+    logger->open_new_mcap((_dir / "log.mcap").string());
+
+    logger->log_msg(make_vehicle_data(0.f));
+    stall.wait_until_stalled();
+    for (int i = 1; i <= 16; i++)
+    {
+        logger->log_msg(make_vehicle_data(static_cast<float>(i)));
+    }
+    std::atomic<bool> logged{false};
+    std::thread producer([&]()
+    {
+        logger->log_msg(make_vehicle_data(17.f));
+        logged = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(logged);
+    stall.release();
+    producer.join();
+
+    const auto descriptor = hytech_msgs::VehicleData::descriptor();
+    wait_until_written(*logger, descriptor, 18);
+    const auto counts = logger->channel_counts(descriptor);
+    EXPECT_EQ(counts.enqueued, 18u);
+    EXPECT_EQ(counts.written, 18u);
+    EXPECT_EQ(counts.dropped, 0u);
+}
+
+TEST_F(MCAPProtobufLoggerTest, DestroyingWritesEverythingStillQueued)
+{
+    const auto path = _dir / "log.mcap";
+    constexpr int num_msgs = 1000;
+    auto logger = make_logger("drop_oldest", 16384);
+    LoggerStall stall;
+    logger->set_diagnostics_handler([&](std::shared_ptr<google::protobuf::Message> msg) { stall.handler(msg); });
+    logger->open_new_mcap(path.string());
+
+    logger->log_msg(make_vehicle_data(0.f));
+    stall.wait_until_stalled();
+    for (int i = 1; i < num_msgs; i++)
+    {
+        logger->log_msg(make_vehicle_data(static_cast<float>(i)));
+    }
+    // the logger thread only gets going again once the logger is being destroyed
+    std::thread release([&]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        stall.release();
+    });
+    logger.reset();
+    release.join();
+
+    EXPECT_EQ(count_messages(path, "VehicleData"), static_cast<size_t>(num_msgs));
+}
+
+TEST_F(MCAPProtobufLoggerTest, RotatesIntoNumberedParts)
+{
+    const auto path = _dir / "log.mcap";
+    constexpr int num_msgs = 40000;
+    auto logger = make_logger("block", 16384, ", \"rotate_size_mb\": 1");
+    logger->open_new_mcap(path.string());
+    for (int i = 0; i < num_msgs; i++)
+    {
+        auto msg = make_vehicle_data(static_cast<float>(i));
+        msg->mutable_current_body_vel_ms()->set_x(static_cast<float>(i));
+        msg->mutable_current_body_accel_mss()->set_y(static_cast<float>(i));
+        msg->mutable_current_angular_rate_rads()->set_z(static_cast<float>(i));
+        logger->log_msg(std::move(msg));
+    }
+    logger.reset();
+
+    size_t logged = 0;
+    int parts = 0;
+    for (; std::filesystem::exists(common::MCAPProtobufLogger::part_name(path.string(), parts)); parts++)
+    {
+        logged += count_messages(common::MCAPProtobufLogger::part_name(path.string(), parts), "VehicleData");
+    }
+    EXPECT_GE(parts, 2);
+    EXPECT_EQ(logged, static_cast<size_t>(num_msgs));
+}
+
+TEST(MCAPProtobufLogger, NamesThePartsOfASession)
+{
+    EXPECT_EQ(common::MCAPProtobufLogger::part_name("logs/run.mcap", 0), "logs/run.mcap");
+    EXPECT_EQ(common::MCAPProtobufLogger::part_name("logs/run.mcap", 2), "logs/run_002.mcap");
+    EXPECT_EQ(common::MCAPProtobufLogger::part_name("run.mcap", 1234), "run_1234.mcap");
+}
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include <McapSchemaPool.hpp>
+#include <ProtobufUtils.hpp>
+#include <hytech_msgs.pb.h>
+
+#include <google/protobuf/descriptor.pb.h>
+
+#include <string>
+
+namespace {
+    mcap::Schema make_schema(mcap::SchemaId id, const std::string &name, const std::string &data)
+    {
+        mcap::Schema schema(name, "protobuf", data);
+        schema.id = id;
+        return schema;
+    }
+
+    // a .proto that is not compiled in, like one from a newer version of the protos
+    std::string unknown_descriptor_set()
+    {
+        google::protobuf::FileDescriptorProto file;
+        file.set_name("replay_test/unknown.proto");
+        file.set_package("replay_test");
+        file.set_syntax("proto3");
+        auto msg = file.add_message_type();
+        msg->set_name("Unknown");
+        auto field = msg->add_field();
+        field->set_name("speed");
+        field->set_number(1);
+        field->set_type(google::protobuf::FieldDescriptorProto::TYPE_FLOAT);
+        field->set_label(google::protobuf::FieldDescriptorProto::LABEL_OPTIONAL);
+
+        google::protobuf::FileDescriptorSet set;
+        *set.add_file() = file;
+        return set.SerializeAsString();
+    }
+}
+
+TEST(McapSchemaPool, UsesCompiledInTypes)
+{
+    common::McapSchemaPool pool;
+    const auto descriptor = hytech_msgs::VehicleData::descriptor();
+    const auto prototype = pool.prototype(make_schema(1, descriptor->full_name(), util::serialized_file_descriptor_set(descriptor)));
+    ASSERT_NE(prototype, nullptr);
+    EXPECT_EQ(prototype, &hytech_msgs::VehicleData::default_instance());
+    EXPECT_EQ(pool.embedded_schemas(), 0u);
+}
+
+TEST(McapSchemaPool, BuildsOtherTypesFromTheSchema)
+{
+    common::McapSchemaPool pool;
+    const auto prototype = pool.prototype(make_schema(1, "replay_test.Unknown", unknown_descriptor_set()));
+    ASSERT_NE(prototype, nullptr);
+    EXPECT_EQ(pool.embedded_schemas(), 1u);
+    const auto field = prototype->GetDescriptor()->FindFieldByName("speed");
+    ASSERT_NE(field, nullptr);
+
+    // the bytes of a message with speed = 2.5
+    const std::string payload = {0x0d, 0x00, 0x00, 0x20, 0x40};
+    std::unique_ptr<google::protobuf::Message> msg(prototype->New());
+    ASSERT_TRUE(msg->ParseFromString(payload));
+    EXPECT_FLOAT_EQ(msg->GetReflection()->GetFloat(*msg, field), 2.5f);
+
+    // the same schema again is not built again
+    EXPECT_EQ(pool.prototype(make_schema(1, "replay_test.Unknown", unknown_descriptor_set())), prototype);
+    EXPECT_EQ(pool.embedded_schemas(), 1u);
+}
+
+TEST(McapSchemaPool, RejectsSchemasItCannotUse)
+{
+    common::McapSchemaPool pool;
+    mcap::Schema json_schema("replay_test.Unknown", "jsonschema", std::string("{}"));
+    json_schema.id = 1;
+    EXPECT_EQ(pool.prototype(json_schema), nullptr);
+    EXPECT_EQ(pool.prototype(make_schema(2, "replay_test.Other", unknown_descriptor_set())), nullptr);
+    EXPECT_EQ(pool.prototype(make_schema(3, "replay_test.Unknown", "not a descriptor set")), nullptr);
+}
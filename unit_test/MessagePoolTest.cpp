@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+#include <CANCodec.hpp>
+#include <MessagePool.hpp>
+#include <hytech.pb.h>
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <random>
+#include <vector>
+
+// counts every heap allocation made on a thread while counting is turned on, so that the tests can
+// check that the pooled receive path does not allocate at all and not just that the pool says so
+static std::atomic<size_t> heap_allocations{0};
+static thread_local bool count_allocations = false;
+
+void *operator new(size_t size)
+{
+    if (count_allocations)
+    {
+        heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (void *ptr = std::malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+class CountAllocations
+{
+public:
+    CountAllocations() : _start(heap_allocations.load())
+    {
+        count_allocations = true;
+    }
+    ~CountAllocations()
+    {
+        count_allocations = false;
+    }
+    size_t count() const { return heap_allocations.load() - _start; }
+
+private:
+    size_t _start;
+};
+
+TEST(MessagePool, ReleasedMessageIsReusedCleared) {
+    util::MessagePool pool;
+    auto msg = pool.acquire<hytech::drivetrain_rpms_telem>();
+    msg->set_fl_motor_rpm(1234);
+    const auto *first = msg.get();
+    msg.reset();
+
+    auto again = pool.acquire<hytech::drivetrain_rpms_telem>();
+    EXPECT_EQ(again.get(), first);
+    EXPECT_EQ(again->fl_motor_rpm(), 0);
+    EXPECT_EQ(pool.allocations(), 1u);
+    EXPECT_EQ(pool.reuses(), 1u);
+}
+
+TEST(MessagePool, HeldMessagesAreNotReused) {
+    util::MessagePool pool;
+    auto held = pool.acquire<hytech::drivetrain_rpms_telem>();
+    auto copy = held; // eg. one for the estimator and one in the logger queue
+    held.reset();
+
+    auto other = pool.acquire<hytech::drivetrain_rpms_telem>();
+    EXPECT_NE(other.get(), copy.get());
+    EXPECT_EQ(pool.allocations(), 2u);
+
+    // types have their own messages
+    auto status = pool.acquire<hytech::drivetrain_status_telem>();
+    EXPECT_EQ(status->GetDescriptor(), hytech::drivetrain_status_telem::descriptor());
+    EXPECT_EQ(pool.allocations(), 3u);
+}
+
+TEST(MessagePool, FullPoolFallsBackToUnpooledMessages) {
+    util::MessagePool pool(2);
+    std::vector<std::shared_ptr<hytech::drivetrain_rpms_telem>> in_flight;
+    for (int i = 0; i < 4; i++) {
+        in_flight.push_back(pool.acquire<hytech::drivetrain_rpms_telem>());
+    }
+    EXPECT_EQ(pool.allocations(), 4u);
+    in_flight.clear();
+
+    // only the two pooled ones come back
+    for (int i = 0; i < 3; i++) {
+        in_flight.push_back(pool.acquire<hytech::drivetrain_rpms_telem>());
+    }
+    EXPECT_EQ(pool.reuses(), 2u);
+    EXPECT_EQ(pool.allocations(), 5u);
+}
+
+TEST(MessagePool, SteadyStateDecodeDoesNotAllocate) {
+    std::ifstream idbc(HYTECH_DBC_PATH);
+    auto net = dbcppp::INetwork::LoadDBCFromIs(idbc);
+    ASSERT_TRUE(net);
+    comms::CANMessageCodec codec;
+    ASSERT_TRUE(codec.build(*net));
+
+    std::mt19937 rng(42);
+    std::vector<std::pair<uint32_t, std::array<uint8_t, CANFD_MAX_DLEN>>> frames;
+    for (const auto &plan : codec.decode_plans()) {
+        std::array<uint8_t, CANFD_MAX_DLEN> data;
+        for (auto &byte : data) {
+            byte = static_cast<uint8_t>(rng());
+        }
+        frames.emplace_back(plan.can_id, data);
+    }
+
+    // like the driver: each decoded message is fanned out and held for a while (estimator,
+    // logger queue) before being dropped
+    util::MessagePool pool;
+    std::vector<std::shared_ptr<google::protobuf::Message>> in_flight(16);
+    size_t next_slot = 0;
+    auto receive = [&](size_t num_frames) {
+        for (size_t i = 0; i < num_frames; i++) {
+            const auto &frame = frames[i % frames.size()];
+            auto msg = codec.decode(frame.first, frame.second.data(), CANFD_MAX_DLEN, &pool);
+            auto logged = msg;
+            in_flight[next_slot] = std::move(logged);
+            next_slot = (next_slot + 1) % in_flight.size();
+        }
+    };
+
+    receive(frames.size() * 4); // warm up, every type gets its messages
+    const size_t warm_allocations = pool.allocations();
+
+    size_t steady_state_allocations = 0;
+    {
+        CountAllocations counter;
+        receive(frames.size() * 50);
+        steady_state_allocations = counter.count();
+    }
+    EXPECT_EQ(steady_state_allocations, 0u);
+    EXPECT_EQ(pool.allocations(), warm_allocations);
+    EXPECT_GE(pool.reuses(), frames.size() * 50);
+}
@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+#include <RingBus.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+TEST(RingBus, EveryReaderGetsEveryMessageInOrder) {
+    util::RingBus<std::shared_ptr<int>> bus(8, util::RingPolicy::Block);
+    auto first = bus.subscribe();
+    auto second = bus.subscribe();
+    ASSERT_TRUE(first && second);
+
+    for (int i = 0; i < 5; i++) {
+        ASSERT_TRUE(bus.publish(std::make_shared<int>(i)));
+    }
+    EXPECT_EQ(first->depth(), 5u);
+
+    std::shared_ptr<int> msg;
+    for (int i = 0; i < 5; i++) {
+        ASSERT_TRUE(first->try_read(msg));
+        EXPECT_EQ(*msg, i);
+    }
+    EXPECT_FALSE(first->try_read(msg));
+    EXPECT_EQ(first->depth(), 0u);
+    // the other reader still has all of them
+    EXPECT_EQ(second->depth(), 5u);
+    EXPECT_EQ(bus.max_depth(), 5u);
+}
+
+TEST(RingBus, TakeReleasesTheMessage) {
+    util::RingBus<std::shared_ptr<int>> bus(8, util::RingPolicy::Overwrite);
+    auto reader = bus.subscribe();
+    auto msg = std::make_shared<int>(1);
+    bus.publish(msg);
+    EXPECT_EQ(msg.use_count(), 2);
+
+    std::shared_ptr<int> taken;
+    ASSERT_TRUE(reader->try_take(taken));
+    taken.reset();
+    // only the producer's reference is left, eg. a pooled message can be reused right away
+    EXPECT_EQ(msg.use_count(), 1);
+}
+
+TEST(RingBus, OverwriteDropsTheOldestMessages) {
+    util::RingBus<int> bus(4, util::RingPolicy::Overwrite);
+    auto reader = bus.subscribe();
+    for (int i = 0; i < 10; i++) {
+        ASSERT_TRUE(bus.publish(i));
+    }
+    EXPECT_EQ(reader->dropped(), 6u);
+    EXPECT_EQ(bus.dropped(), 6u);
+
+    int msg = -1;
+    for (int i = 6; i < 10; i++) {
+        ASSERT_TRUE(reader->try_read(msg));
+        EXPECT_EQ(msg, i);
+    }
+    EXPECT_FALSE(reader->try_read(msg));
+}
+
+TEST(RingBus, OverwriteHandlerSeesEveryDroppedMessage) {
+    util::RingBus<int> bus(4, util::RingPolicy::Overwrite);
+    auto reader = bus.subscribe();
+    std::vector<int> overwritten;
+    bus.on_overwrite([&](const int &msg) { overwritten.push_back(msg); });
+
+    int msg = -1;
+    for (int i = 0; i < 6; i++) {
+        ASSERT_TRUE(bus.publish(i));
+    }
+    ASSERT_TRUE(reader->try_read(msg));
+    EXPECT_EQ(msg, 2);
+    // 2 was read, so only 3 is lost here
+    for (int i = 6; i < 8; i++) {
+        ASSERT_TRUE(bus.publish(i));
+    }
+    EXPECT_EQ(overwritten, (std::vector<int>{0, 1, 3}));
+    EXPECT_EQ(reader->dropped(), overwritten.size());
+}
+
+TEST(RingBus, BlockWaitsForTheSlowestReader) {
+    util::RingBus<int> bus(4, util::RingPolicy::Block);
+    auto reader = bus.subscribe();
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(bus.publish(i));
+    }
+
+    std::atomic<bool> published{false};
+    std::thread producer([&]() {
+        bus.publish(4);
+        published = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_FALSE(published);
+
+    int msg = -1;
+    ASSERT_TRUE(reader->read(msg));
+    EXPECT_EQ(msg, 0);
+    producer.join();
+    EXPECT_TRUE(published);
+    EXPECT_EQ(reader->depth(), 4u);
+    EXPECT_EQ(reader->dropped(), 0u);
+}
+
+TEST(RingBus, ReadWakesUpForMessagesAndStop) {
+    util::RingBus<int> bus(16, util::RingPolicy::Overwrite);
+    auto reader = bus.subscribe();
+    std::vector<int> received;
+    std::thread consumer([&]() {
+        int msg;
+        while (reader->read(msg)) {
+            received.push_back(msg);
+        }
+    });
+
+    std::vector<int> batch = {1, 2, 3};
+    bus.publish(batch.begin(), batch.end());
+    while (reader->depth() > 0) {
+        std::this_thread::yield();
+    }
+    reader->stop();
+    consumer.join();
+    EXPECT_EQ(received, batch);
+}
+
+TEST(RingBus, ConcurrentReadersSeeEverySequenceNumber) {
+    constexpr uint64_t num_msgs = 200000;
+    util::RingBus<uint64_t> bus(64, util::RingPolicy::Overwrite);
+    std::vector<std::unique_ptr<util::RingBus<uint64_t>::Reader>> readers;
+    for (int i = 0; i < 3; i++) {
+        readers.push_back(bus.subscribe());
+    }
+
+    // readers lose messages when they fall behind but whatever they read has to be in order and
+    // read + dropped has to add up
+    std::vector<std::thread> consumers;
+    std::vector<uint64_t> num_read(readers.size(), 0);
+    std::vector<int> in_order(readers.size(), 1);
+    for (size_t r = 0; r < readers.size(); r++) {
+        consumers.emplace_back([&, r]() {
+            uint64_t msg = 0;
+            uint64_t last = 0;
+            while (readers[r]->read(msg)) {
+                in_order[r] = in_order[r] && (num_read[r] == 0 || msg > last);
+                last = msg;
+                num_read[r]++;
+            }
+        });
+    }
+
+    for (uint64_t i = 0; i < num_msgs; i++) {
+        bus.publish(i);
+    }
+    bus.close();
+    for (auto &consumer : consumers) {
+        consumer.join();
+    }
+    for (size_t r = 0; r < readers.size(); r++) {
+        EXPECT_TRUE(in_order[r]);
+        EXPECT_EQ(num_read[r] + readers[r]->dropped(), num_msgs);
+    }
+}
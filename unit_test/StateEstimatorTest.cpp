@@ -0,0 +1,239 @@
+#include <gtest/gtest.h>
+#include <JsonFileHandler.hpp>
+#include <StateEstimator.hpp>
+#include <hytech.pb.h>
+#include <hytech_msgs.pb.h>
+#include "TestMessageLogger.hpp"
+
+#include <google/protobuf/descriptor.pb.h>
+#include <google/protobuf/dynamic_message.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+namespace {
+    using test::make_message_logger;
+    using test::message_ptr;
+
+    std::shared_ptr<hytech::pedals_system_data> make_pedals(float accel, float brake)
+    {
+        auto msg = std::make_shared<hytech::pedals_system_data>();
+        msg->set_accel_pedal(accel);
+        msg->set_brake_pedal(brake);
+        return msg;
+    }
+}
+
+TEST(StateEstimator, RoutesInputsByType)
+{
+    core::Logger logger(core::LogLevel::INFO);
+    core::JsonFileHandler config(TEST_CONFIG_DIR "/state_estimator.json");
+    core::StateEstimator estimator(logger, config, make_message_logger());
+
+    estimator.handle_recv_process(make_pedals(0.5f, 0.25f));
+    auto inv2 = std::make_shared<hytech::inv2_dynamics>();
+    inv2->set_actual_speed_rpm(1200);
+    estimator.handle_recv_process(inv2);
+
+    const auto state = estimator.get_latest_state_and_validity().first;
+    EXPECT_FLOAT_EQ(state.input.requested_accel, 0.5f);
+    EXPECT_FLOAT_EQ(state.input.requested_brake, 0.25f);
+    EXPECT_FLOAT_EQ(state.current_rpms.FR, 1200);
+    EXPECT_FLOAT_EQ(state.current_rpms.FL, 0);
+}
+
+TEST(StateEstimator, IgnoresMessagesWithoutHandler)
+{
+    core::Logger logger(core::LogLevel::INFO);
+    core::JsonFileHandler config(TEST_CONFIG_DIR "/state_estimator.json");
+    core::StateEstimator estimator(logger, config, make_message_logger());
+
+    auto rpms = std::make_shared<hytech::drivetrain_rpms_telem>();
+    rpms->set_fl_motor_rpm(100);
+    estimator.handle_recv_process(rpms);
+
+    const auto state = estimator.get_latest_state_and_validity().first;
+    EXPECT_FLOAT_EQ(state.current_rpms.FL, 0);
+}
+
+TEST(StateEstimator, RegisteredHandlersGetTheirMessages)
+{
+    core::Logger logger(core::LogLevel::INFO);
+    core::JsonFileHandler config(TEST_CONFIG_DIR "/state_estimator.json");
+    core::StateEstimator estimator(logger, config, make_message_logger());
+
+    int calls = 0;
+    int32_t fl_rpm = 0;
+    std::chrono::microseconds stamp{0};
+    estimator.register_handler<hytech::drivetrain_rpms_telem>([&](const hytech::drivetrain_rpms_telem &msg, std::chrono::microseconds recv_time)
+                                                              {
+                                                                  calls++;
+                                                                  fl_rpm = msg.fl_motor_rpm();
+                                                                  stamp = recv_time;
+                                                              });
+    auto rpms = std::make_shared<hytech::drivetrain_rpms_telem>();
+    rpms->set_fl_motor_rpm(100);
+    estimator.handle_recv_process(rpms, std::chrono::microseconds(42));
+    EXPECT_EQ(calls, 1);
+    EXPECT_EQ(fl_rpm, 100);
+    EXPECT_EQ(stamp.count(), 42);
+
+    // replaces the built in handler
+    estimator.register_handler<hytech::pedals_system_data>([&](const hytech::pedals_system_data &, std::chrono::microseconds) { calls++; });
+    estimator.handle_recv_process(make_pedals(0.5f, 0.f));
+    EXPECT_EQ(calls, 2);
+    EXPECT_FLOAT_EQ(estimator.get_latest_state_and_validity().first.input.requested_accel, 0.f);
+}
+
+TEST(StateEstimator, DoesNotHandleOtherTypesOfTheSameName)
+{
+    core::Logger logger(core::LogLevel::INFO);
+    core::JsonFileHandler config(TEST_CONFIG_DIR "/state_estimator.json");
+    core::StateEstimator estimator(logger, config, make_message_logger());
+
+    // a pedals message that is not the generated class, eg. decoded with the schema in an mcap
+    google::protobuf::FileDescriptorProto file;
+    hytech::pedals_system_data::descriptor()->file()->CopyTo(&file);
+    google::protobuf::DescriptorPool pool;
+    ASSERT_NE(pool.BuildFile(file), nullptr);
+    google::protobuf::DynamicMessageFactory factory;
+    const auto descriptor = pool.FindMessageTypeByName("hytech.pedals_system_data");
+    ASSERT_NE(descriptor, nullptr);
+    message_ptr msg(factory.GetPrototype(descriptor)->New());
+    msg->GetReflection()->SetFloat(msg.get(), descriptor->FindFieldByName("accel_pedal"), 0.5f);
+
+    estimator.handle_recv_process(msg);
+    EXPECT_FLOAT_EQ(estimator.get_latest_state_and_validity().first.input.requested_accel, 0.f);
+}
+
+TEST(StateEstimator, SnapshotsAreConsistentUnderConcurrentInputs)
+{
+    core::Logger logger(core::LogLevel::INFO);
+    core::JsonFileHandler config(TEST_CONFIG_DIR "/state_estimator.json");
+    core::StateEstimator estimator(logger, config, make_message_logger());
+    constexpr int num_msgs = 50000;
+    std::atomic<int> writers_done{0};
+
+    // every message keeps its two values equal, a snapshot with them different is torn
+    std::thread pedals_writer([&]()
+    {
+        for (int i = 1; i <= num_msgs; i++)
+        {
+            estimator.handle_recv_process(make_pedals(static_cast<float>(i), static_cast<float>(i)), std::chrono::microseconds(i));
+        }
+        writers_done++;
+    });
+    std::thread suspension_writer([&]()
+    {
+        auto msg = std::make_shared<hytech::front_suspension>();
+        for (int i = 1; i <= num_msgs; i++)
+        {
+            msg->set_fl_load_cell(static_cast<float>(i));
+            msg->set_fr_load_cell(static_cast<float>(i));
+            estimator.handle_recv_process(msg, std::chrono::microseconds(i));
+        }
+        writers_done++;
+    });
+
+    int torn = 0;
+    float last_accel = 0;
+    int snapshots = 0;
+    while (writers_done.load() < 2 || last_accel < num_msgs)
+    {
+        const auto state = estimator.get_latest_state_and_validity().first;
+        torn += state.input.requested_accel != state.input.requested_brake;
+        EXPECT_GE(state.input.requested_accel, last_accel);
+        last_accel = state.input.requested_accel;
+        snapshots++;
+    }
+    pedals_writer.join();
+    suspension_writer.join();
+
+    EXPECT_EQ(torn, 0);
+    EXPECT_GT(snapshots, 0);
+    EXPECT_FLOAT_EQ(estimator.get_latest_state_and_validity().first.input.requested_accel, static_cast<float>(num_msgs));
+}
+
+TEST(StateEstimator, FlagsEachStaleInput)
+{
+    core::Logger logger(core::LogLevel::INFO);
+    core::JsonFileHandler config(TEST_CONFIG_DIR "/state_estimator.json");
+    core::StateEstimator estimator(logger, config, make_message_logger());
+    std::chrono::microseconds now{1000000};
+    estimator.set_clock([&]() { return now; });
+    ASSERT_TRUE(estimator.init());
+    using Input = core::StateEstimator::Input;
+    const uint32_t checked = core::StateEstimator::input_bit(Input::RearSuspension) | core::StateEstimator::input_bit(Input::FrontSuspension) |
+                             core::StateEstimator::input_bit(Input::Pedals) | core::StateEstimator::input_bit(Input::Steering);
+
+    // nothing received yet, the inputs without a max age are never stale
+    EXPECT_FALSE(estimator.get_latest_state_and_validity().second);
+    EXPECT_EQ(estimator.get_stale_inputs(), checked);
+
+    estimator.handle_recv_process(std::make_shared<hytech::rear_suspension>());
+    estimator.handle_recv_process(std::make_shared<hytech::front_suspension>());
+    estimator.handle_recv_process(make_pedals(0.f, 0.f));
+    estimator.handle_recv_process(std::make_shared<hytech::steering_data>());
+    EXPECT_TRUE(estimator.get_latest_state_and_validity().second);
+    EXPECT_EQ(estimator.get_stale_inputs(), 0u);
+
+    // the pedals keep coming, the rest are too old (the test config has 30 ms for all four)
+    now += std::chrono::milliseconds(31);
+    estimator.handle_recv_process(make_pedals(0.f, 0.f));
+    EXPECT_FALSE(estimator.get_latest_state_and_validity().second);
+    EXPECT_EQ(estimator.get_stale_inputs(), checked & ~core::StateEstimator::input_bit(Input::Pedals));
+}
+
+TEST(StateEstimator, TakesTheMaxAgesFromTheParams)
+{
+    core::Logger logger(core::LogLevel::INFO);
+    core::JsonFileHandler config(TEST_CONFIG_DIR "/state_estimator.json");
+    core::StateEstimator estimator(logger, config, make_message_logger());
+    std::chrono::microseconds now{1000000};
+    estimator.set_clock([&]() { return now; });
+    ASSERT_TRUE(estimator.init());
+
+    estimator.handle_recv_process(std::make_shared<hytech::rear_suspension>());
+    estimator.handle_recv_process(std::make_shared<hytech::front_suspension>());
+    estimator.handle_recv_process(make_pedals(0.f, 0.f));
+    estimator.handle_recv_process(std::make_shared<hytech::steering_data>());
+    now += std::chrono::milliseconds(31);
+
+    estimator.handle_live_param_update("rear_suspension_max_age_ms", 50);
+    estimator.handle_live_param_update("front_suspension_max_age_ms", 0);
+    estimator.handle_live_param_update("pedals_max_age_ms", 50);
+    estimator.handle_live_param_update("steering_max_age_ms", 50);
+    EXPECT_TRUE(estimator.get_latest_state_and_validity().second);
+
+    // an input that has a max age now is checked from then on
+    estimator.handle_live_param_update("vectornav_max_age_ms", 10);
+    EXPECT_FALSE(estimator.get_latest_state_and_validity().second);
+    EXPECT_EQ(estimator.get_stale_inputs(), core::StateEstimator::input_bit(core::StateEstimator::Input::VectorNav));
+    estimator.handle_recv_process(std::make_shared<hytech_msgs::VNData>());
+    EXPECT_TRUE(estimator.get_latest_state_and_validity().second);
+}
+
+TEST(StateEstimator, CountsAcquisitionToUpdateLatencyPerInput)
+{
+    core::Logger logger(core::LogLevel::INFO);
+    core::JsonFileHandler config(TEST_CONFIG_DIR "/state_estimator.json");
+    core::StateEstimator estimator(logger, config, make_message_logger());
+    std::chrono::microseconds now{1000000};
+    estimator.set_clock([&]() { return now; });
+
+    estimator.handle_recv_process(make_pedals(0.f, 0.f), now - std::chrono::milliseconds(5));
+    estimator.handle_recv_process(make_pedals(0.f, 0.f), now - std::chrono::microseconds(100));
+    const auto pedals = estimator.get_input_latency(core::StateEstimator::Input::Pedals).counts();
+    EXPECT_EQ(pedals[util::LatencyHistogram::bucket(5000)], 1u);
+    EXPECT_EQ(pedals[util::LatencyHistogram::bucket(100)], 1u);
+
+    const auto steering = estimator.get_input_latency(core::StateEstimator::Input::Steering).counts();
+    EXPECT_EQ(util::LatencyHistogram::quantile_us(steering, 0.5), 0);
+
+    // a frame that sat in a queue for longer than its max age is stale as soon as it gets here
+    estimator.handle_recv_process(make_pedals(0.f, 0.f), now - std::chrono::milliseconds(40));
+    estimator.get_latest_state_and_validity();
+    EXPECT_NE(estimator.get_stale_inputs() & core::StateEstimator::input_bit(core::StateEstimator::Input::Pedals), 0u);
+}
@@ -0,0 +1,24 @@
+#ifndef __TESTMESSAGELOGGER_H__
+#define __TESTMESSAGELOGGER_H__
+
+#include <MsgLogger.hpp>
+
+#include <google/protobuf/message.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+// a message logger for the tests of what logs through one, it never logs to a file and hands every
+// message to live (eg. to look at what was published)
+namespace test
+{
+    using message_ptr = std::shared_ptr<google::protobuf::Message>;
+
+    inline std::shared_ptr<core::MsgLogger<message_ptr>> make_message_logger(std::function<void(message_ptr)> live = [](message_ptr) {})
+    {
+        std::function<void(message_ptr)> no_op_log = [](message_ptr) {};
+        return std::make_shared<core::MsgLogger<message_ptr>>(".mcap", false, no_op_log, []() {}, [](const std::string &) {}, std::move(live));
+    }
+}
+#endif // __TESTMESSAGELOGGER_H__
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include <TripleBuffer.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+TEST(TripleBuffer, ReadsTheNewestPublishedValue)
+{
+    util::TripleBuffer<int> buffer(7);
+    EXPECT_EQ(buffer.read(), 7);
+
+    buffer.write_buffer() = 1;
+    buffer.publish();
+    buffer.write_buffer() = 2;
+    buffer.publish();
+    EXPECT_EQ(buffer.read(), 2);
+
+    // nothing new, the same value again
+    EXPECT_EQ(buffer.read(), 2);
+
+    // not published yet
+    buffer.write_buffer() = 3;
+    EXPECT_EQ(buffer.read(), 2);
+    buffer.publish();
+    EXPECT_EQ(buffer.read(), 3);
+}
+
+TEST(TripleBuffer, ReaderNeverSeesAHalfWrittenValue)
+{
+    // big enough to take many stores to fill in
+    struct Value
+    {
+        std::array<uint64_t, 64> words;
+    };
+    util::TripleBuffer<Value> buffer;
+    constexpr uint64_t num_writes = 200000;
+    std::atomic<bool> done{false};
+
+    std::thread writer([&]()
+    {
+        for (uint64_t i = 1; i <= num_writes; i++)
+        {
+            buffer.write_buffer().words.fill(i);
+            buffer.publish();
+        }
+        done.store(true);
+    });
+
+    uint64_t last = 0;
+    uint64_t torn = 0;
+    uint64_t backwards = 0;
+    while (!done.load() || last != num_writes)
+    {
+        const Value &value = buffer.read();
+        for (const auto word : value.words)
+        {
+            torn += word != value.words[0];
+        }
+        backwards += value.words[0] < last;
+        last = value.words[0];
+    }
+    writer.join();
+
+    EXPECT_EQ(torn, 0u);
+    EXPECT_EQ(backwards, 0u);
+    EXPECT_EQ(last, num_writes);
+}
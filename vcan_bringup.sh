@@ -3,7 +3,11 @@
 [ "$UID" -eq 0 ] || exec sudo bash "$0" "$@"
 # Load the kernel module.
 modprobe vcan
-# Create the virtual CAN interface.
-ip link add dev vcan0 type vcan
-# Bring the virtual CAN interface online.
-ip link set up vcan0
\ No newline at end of file
+# Create the virtual CAN interfaces, vcan1 is the second bus for multi-bus setups.
+for dev in vcan0 vcan1; do
+    ip link add dev $dev type vcan
+    # Allow CAN FD frames (CANFD_MTU), classic frames still work.
+    ip link set dev $dev mtu 72
+    # Bring the virtual CAN interface online.
+    ip link set up $dev
+done
\ No newline at end of file